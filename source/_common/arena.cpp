@@ -0,0 +1,177 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                        Common Arena Allocator                              */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __ARENA_CPP__
+#define __ARENA_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define ARENA_MIN_BLOCK    16                   //Initial number of records per block
+#define ARENA_MAX_BLOCK    8192                 //Maximum number of records per block (when growing)
+
+
+/*---------------------------------------------------------------------------
+  The arena class. Allocates records of type T from large blocks, rather
+  than one at a time. Records can't be released individually, all of them
+  are released at once with Free( ). The blocks grow geometrically, unless
+  the exact size is given with Reserve( ).
+  ---------------------------------------------------------------------------*/
+template <class T> class ArenaClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   struct BlockRec
+      {
+      T*          Data;                         //Record array
+      dword       Size;                         //Number of records in the block
+      dword       Used;                         //Number of allocated records
+      BlockRec*   Next;
+      };
+
+   BlockRec* BlockList;                         //Block list, the current block is the head
+   dword     NextSize;                          //Size of the next block
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   dword     Count;                             //Number of allocated records
+   dword     Capacity;                          //Number of records in all blocks
+   dword     BlockCount;                        //Number of blocks
+
+   /*---- Constructor --------------------------------------------------------*/
+   ArenaClass(void)
+      {
+      BlockList  = NULL;
+      NextSize   = ARENA_MIN_BLOCK;
+      Count      = 0;
+      Capacity   = 0;
+      BlockCount = 0;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~ArenaClass(void) {Free();}
+
+   /*-------------------------------------------------------------------------
+      Releases all the blocks, and all the records allocated from them.
+     -------------------------------------------------------------------------*/
+   void Free(void)
+      {
+      while (BlockList != NULL)
+         {
+         BlockRec* Next = BlockList->Next;
+         delete[] BlockList->Data;
+         delete BlockList;
+         BlockList = Next;
+         }
+
+      NextSize   = ARENA_MIN_BLOCK;
+      Count      = 0;
+      Capacity   = 0;
+      BlockCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Ensures that at least Size records can be allocated from the current
+      block. Use this when the number of records is known in advance, so
+      that they are allocated contiguously. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Reserve(dword Size)
+      {
+      if (Size == 0) {return true;}
+      if ((BlockList != NULL) && (BlockList->Size - BlockList->Used >= Size)) {return true;}
+
+      BlockRec* Block = new BlockRec;
+      if (Block == NULL) {return false;}
+
+      Block->Data = new T[Size];
+      if (Block->Data == NULL) {delete Block; return false;}
+
+      Block->Size = Size;
+      Block->Used = 0;
+      Block->Next = BlockList;
+      BlockList   = Block;
+
+      Capacity += Size;
+      BlockCount++;
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Allocates a record. The record is default constructed. Returns NULL on
+      fail.
+     -------------------------------------------------------------------------*/
+   inline T* New(void)
+      {
+      if ((BlockList == NULL) || (BlockList->Used >= BlockList->Size))
+         {
+         if (!Reserve(NextSize)) {return NULL;}
+         if (NextSize < ARENA_MAX_BLOCK) {NextSize <<= 1;}
+         }
+
+      Count++;
+      return &BlockList->Data[BlockList->Used++];
+      }
+
+   /*-------------------------------------------------------------------------
+      Takes over all the blocks of OldArena. OldArena becomes empty on
+      return. The current block of *this arena is unchanged.
+     -------------------------------------------------------------------------*/
+   void Merge(ArenaClass<T> &OldArena)
+      {
+      if ((OldArena.BlockList == NULL) || (&OldArena == this)) {return;}
+
+      if (BlockList == NULL) {BlockList = OldArena.BlockList;}
+      else
+         {
+         //Insert the old block list after the current block
+         BlockRec* OldListEnd = OldArena.BlockList;
+         while (OldListEnd->Next != NULL) {OldListEnd = OldListEnd->Next;}
+
+         OldListEnd->Next = BlockList->Next;
+         BlockList->Next  = OldArena.BlockList;
+         }
+
+      Count      += OldArena.Count;
+      Capacity   += OldArena.Capacity;
+      BlockCount += OldArena.BlockCount;
+
+      OldArena.BlockList  = NULL;
+      OldArena.NextSize   = ARENA_MIN_BLOCK;
+      OldArena.Count      = 0;
+      OldArena.Capacity   = 0;
+      OldArena.BlockCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the number of bytes used by the blocks.
+     -------------------------------------------------------------------------*/
+   inline dword Bytes(void)
+      {
+      return Capacity * sizeof(T) + BlockCount * sizeof(BlockRec);
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -0,0 +1,221 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                        Common Read-Only File View                          */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __FILEVIEW_CPP__
+#define __FILEVIEW_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+
+#if !defined (WIN32) && !defined (WIN32_NT)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+
+/*---------------------------------------------------------------------------
+  The file view class. Maps an entire file into memory for reading, so that
+  the file formats can decode their data in bulk, straight from the view,
+  rather than with one fread( ) per field. If the file can't be mapped, it
+  is read into a buffer with a single fread( ) instead.
+
+  The view also has a read cursor (Pos), which is restricted to the range
+  [Pos, Limit). The Take( ), Read( ) and Skip( ) functions fail if they
+  would go past the Limit, so a reader can't overrun the current chunk or
+  the end of the file. The data is in the file's byte order, use the Get*( )
+  functions to decode little endian fields at any alignment.
+  ---------------------------------------------------------------------------*/
+class FileViewClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   bool      Mapped;                            //Set if Data is a mapped view, rather than a buffer
+
+   //==== Win32 specific ====
+   #if defined (WIN32) || defined (WIN32_NT)
+   HANDLE    File;
+   HANDLE    Mapping;
+   #endif
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   byte*     Data;                              //File contents
+   dword     Size;                              //Number of bytes in the file
+   dword     Pos;                               //Read cursor
+   dword     Limit;                             //End of the readable range
+
+   /*---- Constructor --------------------------------------------------------*/
+   FileViewClass(void)
+      {
+      Mapped = false;
+      Data   = NULL;
+      Size   = 0;
+      Pos    = 0;
+      Limit  = 0;
+
+      #if defined (WIN32) || defined (WIN32_NT)
+         File    = INVALID_HANDLE_VALUE;
+         Mapping = NULL;
+      #endif
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~FileViewClass(void) {Close();}
+
+   /*-------------------------------------------------------------------------
+      Opens and maps the entire file. The cursor is set to the start of the
+      file, and the Limit to the end of it. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Open(char* FileName)
+      {
+      if (FileName == NULL) {return false;}
+      Close();
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         File = CreateFile(FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+         if (File == INVALID_HANDLE_VALUE) {return false;}
+
+         Size = GetFileSize(File, NULL);
+         if (Size == 0xFFFFFFFF) {Close(); return false;}
+
+         if (Size > 0)
+            {
+            Mapping = CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (Mapping != NULL) {Data = (byte*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);}
+            Mapped = (Data != NULL);
+            }
+
+      //==== Other OS ====
+      #else
+         int File = open(FileName, O_RDONLY);
+         if (File < 0) {return false;}
+
+         struct stat Stat;
+         if (fstat(File, &Stat) != 0) {close(File); return false;}
+         Size = (dword)Stat.st_size;
+
+         if (Size > 0)
+            {
+            void* View = mmap(NULL, Size, PROT_READ, MAP_PRIVATE, File, 0);
+            if (View != MAP_FAILED) {Data = (byte*)View; Mapped = true;}
+            }
+         close(File);
+      #endif
+
+      //-- Fall back to reading the file into a buffer --
+      if ((Size > 0) && !Mapped)
+         {
+         FILE* Stream = fopen(FileName, "rb");
+         if (Stream == NULL) {Close(); return false;}
+
+         Data = new byte[Size];
+         if (Data == NULL) {printf("FileViewClass::Open( ): Memory allocation failed.\n"); fclose(Stream); Close(); return false;}
+
+         if (fread(Data, 1, Size, Stream) != Size) {printf("FileViewClass::Open( ): File read error.\n"); fclose(Stream); Close(); return false;}
+         fclose(Stream);
+         }
+
+      Pos   = 0;
+      Limit = Size;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Releases the view, and closes the file.
+     -------------------------------------------------------------------------*/
+   void Close(void)
+      {
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         if (Mapped && (Data != NULL)) {UnmapViewOfFile(Data); Data = NULL;}
+         if (Mapping != NULL)              {CloseHandle(Mapping); Mapping = NULL;}
+         if (File != INVALID_HANDLE_VALUE) {CloseHandle(File); File = INVALID_HANDLE_VALUE;}
+
+      //==== Other OS ====
+      #else
+         if (Mapped && (Data != NULL)) {munmap(Data, Size); Data = NULL;}
+      #endif
+
+      if (Data != NULL) {delete[] Data; Data = NULL;}
+
+      Mapped = false;
+      Size   = 0;
+      Pos    = 0;
+      Limit  = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Moves the cursor to NewPos, and restricts the reads to Bytes from
+      there. Returns false if the range is outside the file.
+     -------------------------------------------------------------------------*/
+   inline bool Seek(dword NewPos, dword Bytes)
+      {
+      if ((NewPos > Size) || (Bytes > Size - NewPos)) {return false;}
+      Pos   = NewPos;
+      Limit = NewPos + Bytes;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the number of bytes left before the Limit.
+     -------------------------------------------------------------------------*/
+   inline dword Left(void) {return Limit - Pos;}
+
+   /*-------------------------------------------------------------------------
+      Returns a pointer to the next Bytes of data in the view, and advances
+      the cursor. Returns NULL if there aren't enough bytes left.
+     -------------------------------------------------------------------------*/
+   inline byte* Take(dword Bytes)
+      {
+      if (Bytes > Limit - Pos) {return NULL;}
+      byte* Ptr = &Data[Pos];
+      Pos += Bytes;
+      return Ptr;
+      }
+
+   /*-------------------------------------------------------------------------
+      Copies the next Bytes of data to Dest, or skips them. Returns false if
+      there aren't enough bytes left.
+     -------------------------------------------------------------------------*/
+   inline bool Read(void* Dest, dword Bytes)
+      {
+      byte* Ptr = Take(Bytes);
+      if (Ptr == NULL) {return false;}
+      memcpy(Dest, Ptr, Bytes);
+      return true;
+      }
+
+   inline bool Skip(dword Bytes) {return Take(Bytes) != NULL;}
+
+   /*-------------------------------------------------------------------------
+      Decode little endian fields at Ptr (which doesn't need to be aligned).
+      NOTE: Like the rest of the file IO, this assumes a little endian CPU.
+     -------------------------------------------------------------------------*/
+   static inline word  GetWord(byte* Ptr)  {word  Value; memcpy(&Value, Ptr, 2); return Value;}
+   static inline dword GetDword(byte* Ptr) {dword Value; memcpy(&Value, Ptr, 4); return Value;}
+   static inline float GetFloat(byte* Ptr) {float Value; memcpy(&Value, Ptr, 4); return Value;}
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
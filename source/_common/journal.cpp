@@ -0,0 +1,104 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                           Common Change Journal                            */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __JOURNAL_CPP__
+#define __JOURNAL_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define JOURNAL_MIN_SIZE   64                   //Initial number of entries
+
+
+/*---------------------------------------------------------------------------
+  The change journal class. Records the objects that were modified since
+  the journal was last cleared, so that the consumers only need to process
+  those objects, rather than walking all of them. The objects must ensure
+  that they're recorded only once, and they keep track of the kind of
+  change themselves. If an entry can't be recorded, the Overflow flag is
+  set, and the consumers must assume that everything was modified.
+  ---------------------------------------------------------------------------*/
+class JournalClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   void**    Entries;                           //Modified objects
+   dword     Size;                              //Allocated number of entries
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   dword     Count;                             //Number of entries
+   bool      Overflow;                          //Set if some changes were not recorded
+
+   /*---- Constructor --------------------------------------------------------*/
+   JournalClass(void)
+      {
+      Entries  = NULL;
+      Size     = 0;
+      Count    = 0;
+      Overflow = false;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~JournalClass(void) {if (Entries != NULL) {delete[] Entries; Entries = NULL;}}
+
+   /*-------------------------------------------------------------------------
+      Records a modified object. The entries grow geometrically. Returns
+      false on fail, and sets the Overflow flag.
+     -------------------------------------------------------------------------*/
+   bool Record(void* Object)
+      {
+      if (Count >= Size)
+         {
+         dword  NewSize    = (Size > 0) ? (Size << 1) : JOURNAL_MIN_SIZE;
+         void** NewEntries = new void*[NewSize];
+         if (NewEntries == NULL) {printf("JournalClass::Record( ): Memory allocation failed.\n"); Overflow = true; return false;}
+
+         if (Count > 0) {memcpy(NewEntries, Entries, Count * sizeof(void*));}
+         if (Entries != NULL) {delete[] Entries;}
+         Entries = NewEntries;
+         Size    = NewSize;
+         }
+
+      Entries[Count++] = Object;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the entry I, which must be less than Count.
+     -------------------------------------------------------------------------*/
+   inline void* Entry(dword I) {return Entries[I];}
+
+   /*-------------------------------------------------------------------------
+      Releases the entries (the storage is kept for the next use).
+     -------------------------------------------------------------------------*/
+   inline void Clear(void)
+      {
+      Count    = 0;
+      Overflow = false;
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -58,10 +58,11 @@ char* __cdecl str_compose_new(char* FormatSpec, ...)
    vsprintf(String, FormatSpec, Arguments);           //Write formatted output using a pointer to a list of arguments
    va_end(Arguments);
 
-   char* Temp = (char*)realloc(String, strlen(String)+1); //Resize allocated block to fit string
-   if (Temp == NULL) {delete[] String; return NULL;}
+   char* Temp = new char[strlen(String)+1];           //Copy to a block that fits the string (String must not be realloc'd, it's from new[])
+   if (Temp != NULL) {strcpy(Temp, String);}
+   delete[] String;
 
-   return String;
+   return Temp;
    }
 
 /*----------------------------------------------------------------------------
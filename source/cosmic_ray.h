@@ -33,6 +33,9 @@
 #include "_common/std_3d.h"
 #include "_common/std_str.cpp"
 #include "_common/list.cpp"
+#include "_common/arena.cpp"
+#include "_common/journal.cpp"
+#include "_common/fileview.cpp"
 #include "_common/stack.h"
 
 //-- Data and memory management --
@@ -43,6 +46,7 @@
 #include "mem_data/polygon.cpp"
 #include "mem_data/nurb.cpp"
 #include "mem_data/light.cpp"
+#include "mem_data/recpool.cpp"
 #include "mem_data/entity.cpp"
 #include "mem_data/world.cpp"
 
@@ -51,9 +55,12 @@
 #include "math/colorrec.h"
 #include "math/pointrec.h"
 #include "math/texpointrec.h"
+#include "math/xformrec.cpp"
+#include "math/simplify.cpp"
 #include "math/mathpoly.cpp"
 #include "math/primitive.cpp"
 #include "math/equsolver.cpp"
+#include "math/profcurve.cpp"
 
 //-- Bitmap editing --
 #include "bmp_edit/pixel.h"
@@ -72,17 +79,23 @@
 #include "render/render_opengl.cpp"
 #include "render/render_ray.cpp"
 #include "render/transform.cpp"
+#include "render/edgecache.cpp"
 #include "render/shade.cpp"
 
 //-- Disk interface --
 #include "disk_io/tga_fmt.cpp"
 #include "disk_io/ppm_fmt.cpp"
+#include "disk_io/y4m_fmt.cpp"
 #include "disk_io/cob_fmt.cpp"
+#include "disk_io/scn_cache.cpp"
+#include "disk_io/scr_token.cpp"
 #include "disk_io/scr_fmt.cpp"
 #include "disk_io/asc_fmt.cpp"
 
 //-- System routines --
 #include "system/systimer.cpp"
+#include "system/jobs.cpp"
+#include "system/framequeue.cpp"
 
 //-- Contol interface --
 #include "ctrl_io/keyboard.cpp"
@@ -27,12 +27,17 @@ bool CosmosInit(void)
 
    //Process command line arguments
    if (SystemFlags.ArgCount < 2)
-      {printf("\n%s\n\nUsage: %s [script_file.scr]\n", Title, SystemFlags.Argv[0]); return false;}
+      {printf("\n%s\n\nUsage: %s [script_file.scr] [playback.y4m | -]\n", Title, SystemFlags.Argv[0]); return false;}
    
    //Read the script file
    if (!SCR.Read(SystemFlags.Argv[1], &Config, &World))
       {printf("CosmosInit( ): SCR.Read( ) failed.\n"); return false;}
 
+   //Display the memory used by the scene
+   RecPoolStatRec PoolStat = World.PoolStats();
+   printf("Scene memory: %u vertices, %u polygons, %u materials, %u list nodes in %u blocks (%u KB).\n",
+          PoolStat.Vertices, PoolStat.Polygons, PoolStat.Materials, PoolStat.Nodes, PoolStat.Blocks, PoolStat.Bytes >> 10);
+
    //Check if we have the decent video config
    if ((Config.Video.X_Res == 0) || 
        (Config.Video.Y_Res == 0) || 
@@ -67,6 +72,8 @@ bool CosmosInit(void)
    Render->AA_Treshold     = Config.Render.AA_Treshold;
    Render->PCompFlag       = Config.Render.PCompFlag;
    Render->POffset         = Config.Render.POffset;
+   Render->LOD_Pixels      = Config.Render.LOD_Pixels;
+   Render->NURB_Pixels     = Config.Render.NURB_Pixels;
 
    //Setup the world data
    World.VOrigin           = Config.World.VOrigin;
@@ -121,6 +128,8 @@ bool RenderModeSwitch(dword RenderDevice)
    Render->AA_Treshold     = Config.Render.AA_Treshold;
    Render->PCompFlag       = Config.Render.PCompFlag;
    Render->POffset         = Config.Render.POffset;
+   Render->LOD_Pixels      = Config.Render.LOD_Pixels;
+   Render->NURB_Pixels     = Config.Render.NURB_Pixels;
 
    return true;
    }
@@ -161,6 +170,14 @@ bool CosmosShutDown(void)
       }
 
 
+   //-- Save the frames still in the output queue --
+   if (!FrameQueue.Flush())
+      {printf("FrameQueue.Flush( ) failed.\n"); StatusFlag = false;}
+   FrameQueue.Shutdown();
+
+   if (!Y4M.Close())
+      {printf("Y4M.Close( ) failed.\n"); StatusFlag = false;}
+
    //-- Delete world data --
    World.Nuke();
 
@@ -277,6 +294,11 @@ bool CTRL_Interface(void)
             if (!Recorder.InitPlay())
                {printf("Recorder.InitPlay( ) failed.\n"); return false;}
 
+            //Optionally stream the playback into a single video file, or the standard output.
+            //The stream is opened once, and each playback is appended to it.
+            if ((SystemFlags.ArgCount > 2) && !Y4M.IsOpen() && !Y4M.Open(SystemFlags.Argv[2], Y4M_FPS))
+               {printf("Y4M.Open( ) failed.\n"); return false;}
+
             printf("Motion Record Disabled.\nMotion Playback Enabled.\n");
             }
          
@@ -285,6 +307,7 @@ bool CTRL_Interface(void)
             {
             RecorderFlag = false;
             Recorder.ShutDown();
+            if (!Y4M.Flush()) {printf("Y4M.Flush( ) failed.\n");}
             printf("Motion Record\\Playback Disabled.\n");
             }
 
@@ -297,23 +320,33 @@ bool CTRL_Interface(void)
          {
          if (RecorderFlag) {break;}
 
+         //The frame stays on screen, so the ray tracer hands out a copy of it
          BitmapRec Bitmap;
-         if (!Video->CaptureFrame(&Bitmap)) {printf("Video->CaptureFrame( ) failed.\n"); return false;}
+         if (!Render->CaptureFrame(&Bitmap, false) && !Video->CaptureFrame(&Bitmap))
+            {printf("Video->CaptureFrame( ) failed.\n"); return false;}
 
          char FileName[64]; *FileName = 0;
          if (Char == KEYB_F11)
             {
             str_compose(FileName, "screen-frame-%.8d.ppm", SystemFlags.Frame);
-            if (!PPM.Save(FileName, &Bitmap, false)) {printf("PPM.Save( ) failed.\n"); return false;}
+            if (!FrameQueue.Push(&Bitmap, FileName, FRAMEQ_PPM)) {printf("FrameQueue.Push( ) failed.\n"); return false;}
             }
          else
             {
             str_compose(FileName, "screen-frame-%.8d.tga", SystemFlags.Frame);
-            if (!TGA.Save(FileName, &Bitmap, true)) {printf("TGA.Save( ) failed.\n"); return false;}
+            if (!FrameQueue.Push(&Bitmap, FileName, FRAMEQ_TGA)) {printf("FrameQueue.Push( ) failed.\n"); return false;}
             }
 
          printf("\nFrame captured to \"%s\".\n", FileName);
 
+         //The ray tracer also saves its float colors, before quantization
+         if ((Char == KEYB_F11) && (Render->CurrentDevice == RENDER_RAY))
+            {
+            str_compose(FileName, "screen-frame-%.8d.pfm", SystemFlags.Frame);
+            if (!RenderRay.SaveHDR(FileName)) {printf("RenderRay.SaveHDR( ) failed.\n"); return false;}
+            printf("HDR frame captured to \"%s\".\n", FileName);
+            }
+
          Bitmap.DeleteData();
          break;
          }
@@ -340,17 +373,27 @@ bool CTRL_Interface(void)
       bool SequenceEnd = false;
       if (!Recorder.RecMode)
          {
-         Render->RenderDone = false;
-
+         //The next frame is rendered anyway, so the ray tracer hands over its
+         //frame buffer without a copy
          BitmapRec Bitmap;
-         if (!Video->CaptureFrame(&Bitmap)) {printf("Video->CaptureFrame( ) failed.\n"); return false;}
+         if (!Render->CaptureFrame(&Bitmap, true) && !Video->CaptureFrame(&Bitmap))
+            {printf("Video->CaptureFrame( ) failed.\n"); return false;}
 
-         char FileName[64]; *FileName = 0;
-         str_compose(FileName, "screen-frame-%.8d.tga", SystemFlags.Frame);
-         if (!TGA.Save(FileName, &Bitmap, true)) {printf("TGA.Save( ) failed.\n"); return false;}
+         Render->RenderDone = false;
 
-         printf("\nFrame captured to \"%s\".\n", FileName);
-         Bitmap.DeleteData();
+         if (Y4M.IsOpen())
+            {
+            if (!Y4M.Write(&Bitmap)) {printf("Y4M.Write( ) failed.\n"); return false;}
+            printf("\nFrame %u streamed.\n", Y4M.FrameCount);
+            }
+         else
+            {
+            char FileName[64]; *FileName = 0;
+            str_compose(FileName, "screen-frame-%.8d.tga", SystemFlags.Frame);
+            if (!FrameQueue.Push(&Bitmap, FileName, FRAMEQ_TGA)) {printf("FrameQueue.Push( ) failed.\n"); return false;}
+
+            printf("\nFrame captured to \"%s\".\n", FileName);
+            }
       
          if (!Recorder.PlayFrame(World.VOrientation, World.VOrigin, SequenceEnd))
             {printf("Recorder.PlayFrame( ) failed.\n"); return false;}
@@ -362,6 +405,8 @@ bool CTRL_Interface(void)
             {
             RecorderFlag = false;
             Recorder.ShutDown();
+            if (!FrameQueue.Flush()) {printf("FrameQueue.Flush( ) failed.\n");}
+            if (!Y4M.Flush()) {printf("Y4M.Flush( ) failed.\n");}
             printf("Motion Recorder\\Playback Disabled.\n");
             }
          }
@@ -386,6 +431,11 @@ bool CTRL_Interface(void)
 
             if (!Recorder.InitPlay())
                {printf("Recorder.InitPlay( ) failed.\n"); return false;}
+
+            //Optionally stream the playback into a single video file, or the standard output.
+            //The stream is opened once, and each playback is appended to it.
+            if ((SystemFlags.ArgCount > 2) && !Y4M.IsOpen() && !Y4M.Open(SystemFlags.Argv[2], Y4M_FPS))
+               {printf("Y4M.Open( ) failed.\n"); return false;}
             }
          }
       }
@@ -401,6 +451,9 @@ void __cdecl MainLoop(void)
    //-- Render the scene --
    if (!Render->DrawScene(World.EntityList, World.LightList, &World))
       {printf("Render->DrawScene( ) failed.\n"); SystemFlags.ShutDown = true;}
+
+   //-- The changes of this frame were consumed by the renderer --
+   World.Commit();
         
    //-- Handle user Interface --
    if (!CTRL_Interface())
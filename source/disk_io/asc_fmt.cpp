@@ -52,8 +52,8 @@ class ASC_Class
 
          for (int I = 0; I < POLY_PT_COUNT; I++)
             {
-            Polygon->Vertex[I]->tCoord.X = Polygon->TexCoord[I].U;
-            Polygon->Vertex[I]->tCoord.Y = Polygon->TexCoord[I].V;
+            Polygon->Vertex[I]->tCoord.X = Polygon->Cold->TexCoord[I].U;
+            Polygon->Vertex[I]->tCoord.Y = Polygon->Cold->TexCoord[I].V;
             }
 
          PolygonCount++;
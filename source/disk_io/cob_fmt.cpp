@@ -19,9 +19,11 @@
 #include "../_common/std_inc.h"
 #include "../_common/std_str.cpp"
 #include "../_common/list.cpp"
+#include "../_common/fileview.cpp"
 #include "../math/texpointrec.h"
 #include "../mem_data/vertex.cpp"
 #include "../mem_data/polygon.cpp"
+#include "../mem_data/recpool.cpp"
 #include "../mem_data/entity.cpp"
 
 
@@ -68,6 +70,12 @@
 #define F_HOLE       0x08                          //
 #define F_BACKCULL   0x10                          //Back face cull flag
 
+//End of a hash bucket in COB_Class::AssignMaterials( )
+#define COB_HASH_NONE            0xFFFFFFFF
+
+//Size of a chunk header in the file
+#define COB_CHUNK_HEADER_SIZE    20
+
 
 /*---------------------------------------------------------------------------
   The COB file IO class.
@@ -103,6 +111,13 @@ class COB_Class
       dword DataSize;                              //Number of bytes in the chunk data
       };
 
+   //Chunk directory entry
+   struct ChunkRec
+      {
+      ChunkHeaderRec Header;
+      dword          Offset;                       //File offset of the chunk data
+      };
+
    //Material structure
    struct Mat1Rec
       {
@@ -129,6 +144,16 @@ class COB_Class
       PolygonRec* Polygon;                         //Pointer to the Polygon 
       };
 
+   //Material key structure, used to find the material of a Polygon
+   struct MatKeyRec
+      {
+      dword        Object;                         //Index of the parent Object
+      word         Number;                         //Material number
+      Mat1Rec*     Mat;                            //The material
+      MaterialRec* Material;                       //Material record in the Object's pool (allocated on demand)
+      dword        Next;                           //Next key in the same hash bucket
+      };
+
    //Object structure
    struct PolHRec
       {
@@ -140,6 +165,7 @@ class COB_Class
       VertexRec*   *VertexArray;
       TexPointRec* TexPointArray;
       PolyDataRec* PolygonArray;
+      RecPoolClass Pool;                           //Storage for the Vertices and Polygons
       };
    
 
@@ -163,15 +189,12 @@ class COB_Class
 
    /*-------------------------------------------------------------------------
       Deletes a Vertex array data structure and returns NULL in VertexArray.
+      The Vertices are owned by the PolH pool, so they are not deleted here.
      -------------------------------------------------------------------------*/
    void DeleteVertexArray(VertexRec* *&VertexArray, dword VertexCount)
       {
       if (VertexArray == NULL) {return;}
       
-      //Delete all the allocated VertexRec data
-      for (dword I = 0; I < VertexCount; I++) 
-         {if (VertexArray[I] != NULL) {delete VertexArray[I];}}
-
       delete[] VertexArray;
       VertexArray = NULL;
       }
@@ -219,21 +242,19 @@ class COB_Class
 
    /*-------------------------------------------------------------------------
       Deletes a Polygon array data structure and returns NULL in PolygonArray.
+      The Polygons are owned by the PolH pool, so they are not deleted here.
      -------------------------------------------------------------------------*/
    void DeletePolygonArray(PolyDataRec* &PolygonArray, dword PolygonCount)
       {
       if (PolygonArray == NULL) {return;}
       
-      //Delete all the allocated PolygonRec data
-      for (dword I = 0; I < PolygonCount; I++)
-         {if (PolygonArray[I].Polygon != NULL) {delete PolygonArray[I].Polygon;}}
-
       delete[] PolygonArray;
       PolygonArray = NULL;
       }
 
    /*-------------------------------------------------------------------------
-      Deletes a PolHRec data structure and returns NULL in PolH.
+      Deletes a PolHRec data structure and returns NULL in PolH. Any Vertices
+      and Polygons still in the PolH pool are released as well.
      -------------------------------------------------------------------------*/
    void DeletePolH(PolHRec* &PolH)
       {
@@ -252,6 +273,189 @@ class COB_Class
    /*================ POST PROCESSING ========================================*/
 
 
+   /*-------------------------------------------------------------------------
+      Computes the hash value of a key for the AssignMaterials( ) tables.
+     -------------------------------------------------------------------------*/
+   inline dword KeyHash(dword Key)
+      {
+      return Key * 0x9E3779B1;
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets up the material data of every Polygon in the Objects. The Objects
+      are hashed by their ID, and the materials by their parent Object and
+      material number, so the Polygons are assigned in a single pass over
+      them. Each material that is used by an Object is allocated once from
+      the Object's pool, and it's shared by all the matching Polygons. If 
+      an Object has more than one material with the same number, the first
+      one in the file is used. Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool AssignMaterials(void)
+      {
+      //Local variables
+      ListRec*     Mat1Node;
+      ListRec*     PolHNode;
+      PolHRec*   *Objects   = NULL;        //Objects in list order
+      dword*       ObjHead   = NULL;        //First Object in each hash bucket
+      dword*       ObjNext   = NULL;        //Next Object in the same hash bucket
+      MatKeyRec*   Keys      = NULL;        //Material of each Object and material number
+      dword*       KeyHead   = NULL;        //First key in each hash bucket
+      dword        ObjCount  = 0;
+      dword        ObjSize   = 1;
+      dword        KeyCount  = 0;
+      dword        KeySize   = 1;
+      dword        I, J, K, H;
+      int          Pass;
+
+      //-- Index the Objects, and hash them by their ID --
+      for (PolHNode = PolHList; PolHNode != NULL; PolHNode = PolHNode->Next)
+         {
+         if (PolHNode->Data == NULL) {goto _ExitError;}
+         ObjCount++;
+         }
+      if ((ObjCount == 0) || (Mat1List == NULL)) {return true;}
+
+      while (ObjSize < ObjCount * 2) {ObjSize <<= 1;}
+
+      Objects = new PolHRec*[ObjCount];
+      ObjHead = new dword[ObjSize];
+      ObjNext = new dword[ObjCount];
+      if ((Objects == NULL) || (ObjHead == NULL) || (ObjNext == NULL)) {goto _ExitError;}
+
+      for (H = 0; H < ObjSize; H++) {ObjHead[H] = COB_HASH_NONE;}
+
+      for (I = 0, PolHNode = PolHList; PolHNode != NULL; I++, PolHNode = PolHNode->Next)
+         {
+         Objects[I] = (PolHRec*)PolHNode->Data;
+         H          = KeyHash(Objects[I]->ID) & (ObjSize - 1);
+         ObjNext[I] = ObjHead[H];
+         ObjHead[H] = I;
+         }
+
+
+      //---- Hash the materials by their parent Object and number. The first
+      //     pass counts the keys, the second one inserts them. The list 
+      //     is in reverse file order, so later materials overwrite the 
+      //     existing keys. ----
+      for (Pass = 0; Pass < 2; Pass++)
+         {
+         for (Mat1Node = Mat1List; Mat1Node != NULL; Mat1Node = Mat1Node->Next)
+            {
+            #define Mat1 ((Mat1Rec*)Mat1Node->Data)
+            if (Mat1 == NULL) {goto _ExitError;}
+
+            //Find the parent Objects of the material
+            for (I = ObjHead[KeyHash(Mat1->ParentID) & (ObjSize - 1)]; I != COB_HASH_NONE; I = ObjNext[I])
+               {
+               if (Objects[I]->ID != Mat1->ParentID) {continue;}
+               if (Pass == 0) {KeyCount++; continue;}
+
+               H = KeyHash((I << 16) ^ (dword)Mat1->Number) & (KeySize - 1);
+               for (K = KeyHead[H]; K != COB_HASH_NONE; K = Keys[K].Next)
+                  {
+                  if ((Keys[K].Object == I) && (Keys[K].Number == Mat1->Number)) {break;}
+                  }
+
+               if (K == COB_HASH_NONE)
+                  {
+                  K = KeyCount++;
+                  Keys[K].Object = I;
+                  Keys[K].Number = Mat1->Number;
+                  Keys[K].Next   = KeyHead[H];
+                  KeyHead[H]     = K;
+                  }
+               Keys[K].Mat      = Mat1;
+               Keys[K].Material = NULL;
+               }
+            #undef Mat1
+            }
+
+         //Allocate the key tables after the first pass
+         if (Pass == 0)
+            {
+            if (KeyCount == 0) {break;}
+            while (KeySize < KeyCount * 2) {KeySize <<= 1;}
+
+            Keys    = new MatKeyRec[KeyCount];
+            KeyHead = new dword[KeySize];
+            if ((Keys == NULL) || (KeyHead == NULL)) {goto _ExitError;}
+
+            for (H = 0; H < KeySize; H++) {KeyHead[H] = COB_HASH_NONE;}
+            KeyCount = 0;
+            }
+         }
+
+
+      //---- Setup the material data of each Polygon ----
+      for (I = 0; (I < ObjCount) && (KeyCount > 0); I++)
+         {
+         #define PolH Objects[I]
+         for (J = 0; J < PolH->PolygonCount; J++) 
+            {
+            //Define a temp macro to make the code readable
+            #define Polygon PolH->PolygonArray[J].Polygon
+            if (Polygon == NULL) {goto _ExitError;}
+
+            //Find the material of the Polygon
+            word Number = PolH->PolygonArray[J].Mat1Index;
+            for (K = KeyHead[KeyHash((I << 16) ^ (dword)Number) & (KeySize - 1)]; K != COB_HASH_NONE; K = Keys[K].Next)
+               {
+               if ((Keys[K].Object == I) && (Keys[K].Number == Number)) {break;}
+               }
+            if (K == COB_HASH_NONE) {continue;}
+
+            #define Mat1 Keys[K].Mat
+
+            //All matching polygons share the same material record
+            if (Keys[K].Material == NULL)
+               {
+               MaterialRec* Material = Keys[K].Material = PolH->Pool.NewMaterial();
+               if (Material == NULL) {goto _ExitError;}
+
+               Material->kAmb    = Mat1->kAmb;
+               Material->Reflect = Mat1->kSpec * Mat1->nSpec;
+               Material->Trans   = 1.0f - Mat1->Opacity;
+               Material->Opacity = Mat1->Opacity;
+               Material->kDiff   = ColorRec(Mat1->kDiff_R, Mat1->kDiff_G, Mat1->kDiff_B, 0.0f);
+               Material->kSpec   = Mat1->kSpec;
+               Material->nSpec   = Mat1->nSpec * 100.0f;
+               Material->IdxRefr = Mat1->IdxRefr;
+               }
+
+            if (Mat1->FacetType == 'f')
+               {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = true;}
+            else if (Mat1->FacetType == 'a')
+               {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = false;}
+            else if (Mat1->FacetType == 's')
+               {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = false;}
+
+            Polygon->Material = Keys[K].Material;
+
+            #undef Mat1
+            #undef Polygon
+            }
+         #undef PolH
+         }
+
+
+      //-- Normal exit --
+      if (Objects != NULL) {delete[] Objects;}
+      if (ObjHead != NULL) {delete[] ObjHead;}
+      if (ObjNext != NULL) {delete[] ObjNext;}
+      if (Keys    != NULL) {delete[] Keys;}
+      if (KeyHead != NULL) {delete[] KeyHead;}
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      if (Objects != NULL) {delete[] Objects;}
+      if (ObjHead != NULL) {delete[] ObjHead;}
+      if (ObjNext != NULL) {delete[] ObjNext;}
+      if (Keys    != NULL) {delete[] Keys;}
+      if (KeyHead != NULL) {delete[] KeyHead;}
+      return false;
+      }
+
    /*-------------------------------------------------------------------------
       This function allocates all the required Entities and su Entities, and
       intializes these objects with the Polygon and Vertex data. The Poygons
@@ -264,79 +468,22 @@ class COB_Class
             as specified by the ParentID fields in the chunk headers. It simply 
             assigns the first Object as the base Entity, and the rest become 
             sub Entities. (This will be fixed l8r.)
+
+      WeldEpsilon : Vertex welding distance, see EntityRec::Weld( ).
      -------------------------------------------------------------------------*/
-   bool ProstProcess(EntityRec* &Entity)
+   bool ProstProcess(EntityRec* &Entity, float WeldEpsilon)
       {
       //Delete any existing Entities
       if (Entity != NULL) {delete Entity; Entity = NULL;}
 
       //Local variables
       EntityRec* NewEntity = NULL;
-      ListRec*   Mat1Node  = NULL;
       ListRec*   PolHNode  = NULL;
       dword      I;
 
 
-      //==== Go through every material and setup all the relevant Polygon 
-      //     data for each Object ====
-      Mat1Node = Mat1List;
-      while (Mat1Node != NULL)
-         {
-         #define Mat1 ((Mat1Rec*)Mat1Node->Data)
-         if (Mat1 == NULL) {goto _ExitError;}
-
-         //See wich Object is the parent for the current material
-         PolHNode = PolHList;
-         while (PolHNode != NULL)
-            {
-            #define PolH ((PolHRec*)PolHNode->Data)
-            if (PolH == NULL) {goto _ExitError;}
-
-            //If the parent ID of material matches this object,
-            // setup all the relevant polygons.
-            if (PolH->ID == Mat1->ParentID)
-               {
-               //Search for matching polygon               
-               for (I = 0; I < PolH->PolygonCount; I++) 
-                  {
-                  //See if the polygon's material index matches this material
-                  if (PolH->PolygonArray[I].Mat1Index == Mat1->Number)
-                     {
-                     //Define a temp macro to make the code readable
-                     #define Polygon PolH->PolygonArray[I].Polygon
-                     if (Polygon == NULL) {goto _ExitError;}
-
-                     if (Mat1->FacetType == 'f')
-                        {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = true;}
-                     else if (Mat1->FacetType == 'a')
-                        {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = false;}
-                     else if (Mat1->FacetType == 's')
-                        {Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = false;}
-
-                     Polygon->kAmb    = Mat1->kAmb;
-                     Polygon->Reflect = Mat1->kSpec * Mat1->nSpec;
-                     Polygon->Trans   = 1.0f - Mat1->Opacity;
-                     Polygon->Opacity = Mat1->Opacity;
-                     Polygon->kDiff   = ColorRec(Mat1->kDiff_R, Mat1->kDiff_G, Mat1->kDiff_B, 0.0f);
-                     Polygon->kSpec   = Mat1->kSpec;
-                     Polygon->nSpec   = Mat1->nSpec * 100.0f;
-                     Polygon->IdxRefr = Mat1->IdxRefr;
-
-                     #undef Polygon
-                     }
-                  }
-               }
-
-            //Advance to the next Object
-            PolHNode = PolHNode->Next;
-            #undef PolH 
-            }
-
-         //Advance to the next material
-         Mat1Node = Mat1Node->Next;
-         #undef Mat1
-         }
-
+      //==== Setup the material data of the Polygons ====
+      if (!AssignMaterials()) {goto _ExitError;}
 
 
       //==== Allocate each Object as an Entity ====
@@ -349,23 +496,29 @@ class COB_Class
          NewEntity = new EntityRec;
          if (NewEntity == NULL) {goto _ExitError;}
 
+         //The Entity takes over the Vertices and Polygons of the Object
+         NewEntity->Pool.Merge(PolH->Pool);
+         if (!NewEntity->Pool.Nodes.Reserve(PolH->VertexCount + PolH->PolygonCount)) {delete NewEntity; goto _ExitError;}
+
          //Insert each Vertex into the Entity's Vertex list
          for (I = 0; I < PolH->VertexCount; I++) 
             {
-            //Insert, then de reference from the array so that the entries 
-            // will not be deleted on exit
-            if (!LinkedList.Insert(NewEntity->VertexList, PolH->VertexArray[I])) {goto _ExitError;}
+            //Insert, then de reference from the array
+            if (!NewEntity->Pool.Insert(NewEntity->VertexList, PolH->VertexArray[I])) {delete NewEntity; goto _ExitError;}
             PolH->VertexArray[I] = NULL;
             }
          
          //Insert each Polygon into the Entity's Polygon list
          for (I = 0; I < PolH->PolygonCount; I++) 
             {
-            //Insert, then de reference from the array so that the entries 
-            // will not be deleted on exit
-            if (!LinkedList.Insert(NewEntity->PolygonList, PolH->PolygonArray[I].Polygon)) {goto _ExitError;}
+            //Insert, then de reference from the array
+            if (!NewEntity->Pool.Insert(NewEntity->PolygonList, PolH->PolygonArray[I].Polygon)) {delete NewEntity; goto _ExitError;}
             PolH->PolygonArray[I].Polygon = NULL;
             }
+
+         //Weld the duplicated Vertices, and setup the indexed mesh
+         if (!NewEntity->Weld(WeldEpsilon)) {delete NewEntity; goto _ExitError;}
+         if (!NewEntity->BuildMesh())       {delete NewEntity; goto _ExitError;}
          
 
          //If Entity is NULL, the first object becomes the base Entity,
@@ -410,58 +563,127 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads a chunk header.
 
-      COB_File    : File pointer. It is assumed that the file offset is at the
-                    position of the data.
+      View        : File view. It is assumed that the cursor is at the
+                    position of the header.
       ChunkHeader : Chunk header data to read into.
      -------------------------------------------------------------------------*/
-   bool ReadChunkHeader(FILE* COB_File, ChunkHeaderRec* ChunkHeader)
+   bool ReadChunkHeader(FileViewClass* View, ChunkHeaderRec* ChunkHeader)
       {
-      if ((COB_File == NULL) || (ChunkHeader == NULL)) {return false;}
+      if ((View == NULL) || (ChunkHeader == NULL)) {return false;}
    
       //Read the chunk header
-      fread(&ChunkHeader->Type,     4, 1, COB_File);
-      fread(&ChunkHeader->VerMajor, 2, 1, COB_File);
-      fread(&ChunkHeader->VerMinor, 2, 1, COB_File);
-      fread(&ChunkHeader->ChunkID,  4, 1, COB_File);
-      fread(&ChunkHeader->ParentID, 4, 1, COB_File);
-      fread(&ChunkHeader->DataSize, 4, 1, COB_File);
-      if (ferror(COB_File) != 0) {printf("COB_Class::ReadChunkHeader( ): File read error.\n"); return false;}
+      byte* Ptr = View->Take(COB_CHUNK_HEADER_SIZE);
+      if (Ptr == NULL) {printf("COB_Class::ReadChunkHeader( ): Unexpected end of file.\n"); return false;}
+
+      memcpy(ChunkHeader->Type, Ptr, 4);
+      ChunkHeader->VerMajor = FileViewClass::GetWord(Ptr + 4);
+      ChunkHeader->VerMinor = FileViewClass::GetWord(Ptr + 6);
+      ChunkHeader->ChunkID  = FileViewClass::GetDword(Ptr + 8);
+      ChunkHeader->ParentID = FileViewClass::GetDword(Ptr + 12);
+      ChunkHeader->DataSize = FileViewClass::GetDword(Ptr + 16);
       
       return true;
       }
 
+   /*-------------------------------------------------------------------------
+      Builds the chunk directory, by walking the chunk headers from the 
+      cursor up to the END chunk. The chunk data is not read, but it must
+      be within the file. The first pass counts the chunks, the second one
+      fills in the directory. On success, the function returns true, and 
+      the allocated directory (without the END chunk) in Directory. 
+
+      View       : File view. It is assumed that the cursor is at the 
+                   position of the first chunk header.
+      Directory  : Returns an allocated directory, or NULL if there are no
+                   chunks. On entry, this MUST be NULL.
+      ChunkCount : Returns the number of entries in the Directory.
+     -------------------------------------------------------------------------*/
+   bool ReadDirectory(FileViewClass* View, ChunkRec* &Directory, dword &ChunkCount)
+      {
+      if ((View == NULL) || (Directory != NULL)) {return false;}
+
+      //Local variables
+      ChunkHeaderRec ChunkHeader;
+      dword          Start = View->Pos;
+      dword          Count;
+      int            Pass;
+
+      ChunkCount = 0;
+
+      for (Pass = 0; Pass < 2; Pass++)
+         {
+         if (!View->Seek(Start, View->Size - Start)) {goto _ExitError;}
+
+         //Walk the chunks
+         for (Count = 0; ; Count++)
+            {
+            if (!ReadChunkHeader(View, &ChunkHeader)) {goto _ExitError;}
+            if (strncmp(ChunkHeader.Type, CHUNK_END, 4) == 0) {break;}
+
+            if (Directory != NULL)
+               {
+               Directory[Count].Header = ChunkHeader;
+               Directory[Count].Offset = View->Pos;
+               }
+
+            if (!View->Skip(ChunkHeader.DataSize))
+               {printf("COB_Class::ReadDirectory( ): Chunk exceeds the end of file.\n"); goto _ExitError;}
+            }
+
+         //Allocate the directory after the first pass
+         if ((Pass == 0) && (Count > 0))
+            {
+            Directory = new ChunkRec[Count];
+            if (Directory == NULL) {printf("COB_Class::ReadDirectory( ): Memory allocation failed.\n"); goto _ExitError;}
+            }
+         }
+
+      ChunkCount = Count;
+
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      if (Directory != NULL) {delete[] Directory; Directory = NULL;}
+      ChunkCount = 0;
+      return false;
+      }
+
    /*-------------------------------------------------------------------------
       Reads a name field (usually within a chunk).
 
-      COB_File : File pointer. It is assumed that the file offset is at the
+      View     : File view. It is assumed that the cursor is at the
                  position of the data.
       Name     : An allocated name string (0 terminated) will be returned here.
                  On entry, this MUST be NULL.
      -------------------------------------------------------------------------*/
-   bool ReadName(FILE* COB_File, char* &Name)
+   bool ReadName(FileViewClass* View, char* &Name)
       {
-      if ((COB_File == NULL) || (Name != NULL)) {return false;}
+      if ((View == NULL) || (Name != NULL)) {return false;}
    
       //Local data
       char* TempName = NULL;
+      byte* Ptr;
       word  NameDupeCount;
       word  NameLength;
 
       //Read the duplicate count number for the name and 
       // the number of bytes in the name string.
-      fread(&NameDupeCount, 2, 1, COB_File);
-      fread(&NameLength,    2, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadName( ): File read error.\n"); goto _ExitError;}
+      if ((Ptr = View->Take(4)) == NULL)
+         {printf("COB_Class::ReadName( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
+      NameDupeCount = FileViewClass::GetWord(Ptr);
+      NameLength    = FileViewClass::GetWord(Ptr + 2);
       
       //Allocate the name buffer
       TempName = new char[NameLength+1];
       if (TempName == NULL) {goto _ExitError;}
 
       //Read the name
-      fread(TempName, (dword)NameLength, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadName( ): File read error.\n"); goto _ExitError;}
+      if (!View->Read(TempName, (dword)NameLength))
+         {printf("COB_Class::ReadName( ): Unexpected end of chunk.\n"); goto _ExitError;}
 
       //Terminate with 0
       TempName[NameLength] = 0;
@@ -489,30 +711,28 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads the local axes (usually within a chunk).
 
-      COB_File : File pointer. It is assumed that the file offset is at the
+      View     : File view. It is assumed that the cursor is at the
                  position of the data.
       Axes     : Returns an allocated array of 4 points. On entry, this 
                  MUST be NULL.
      -------------------------------------------------------------------------*/
-   bool ReadLocalAxes(FILE* COB_File, PointRec* &Axes)
+   bool ReadLocalAxes(FileViewClass* View, PointRec* &Axes)
       {
-      if ((COB_File == NULL) || (Axes != NULL)) {return false;}
+      if ((View == NULL) || (Axes != NULL)) {return false;}
+
+      //The axes are 4 points of 3 floats each
+      byte* Ptr = View->Take(48);
+      if (Ptr == NULL) {printf("COB_Class::ReadLocalAxes( ): Unexpected end of chunk.\n"); return false;}
 
       //Allocate a new array
       if ((Axes = new PointRec[4]) == NULL) {return false;}
    
-      //Read in the point data
-      for (int Incr = 0; Incr < 4; Incr++)
+      //Decode the point data
+      for (int Incr = 0; Incr < 4; Incr++, Ptr += 12)
          {
-         fread(&Axes[Incr].X, 4, 1, COB_File);
-         fread(&Axes[Incr].Y, 4, 1, COB_File);
-         fread(&Axes[Incr].Z, 4, 1, COB_File);
-         if (ferror(COB_File) != 0) 
-            {
-            printf("COB_Class::ReadLocalAxes( ): File read error.\n"); 
-            delete[] Axes; Axes = NULL;
-            return false;
-            }
+         Axes[Incr].X = FileViewClass::GetFloat(Ptr);
+         Axes[Incr].Y = FileViewClass::GetFloat(Ptr + 4);
+         Axes[Incr].Z = FileViewClass::GetFloat(Ptr + 8);
          }
       
       return true;
@@ -521,32 +741,29 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads the current postion (usually within a chunk).
 
-      COB_File : File pointer. It is assumed that the file offset
-                 is at the position of the data.
+      View     : File view. It is assumed that the cursor is at the 
+                 position of the data.
       CurPos   : Returns an allocated array of 4 points. On entry, this 
                  MUST be NULL.
      -------------------------------------------------------------------------*/
-   bool ReadCurPos(FILE* COB_File, PointRec* &CurPos)
+   bool ReadCurPos(FileViewClass* View, PointRec* &CurPos)
       {
-      if ((COB_File == NULL) || (CurPos != NULL)) {return false;}
+      if ((View == NULL) || (CurPos != NULL)) {return false;}
+
+      //NOTE: The binary version reads only 3 transforamtion vectors!! 
+      //      The fourth is initialized seperately (see below).
+      byte* Ptr = View->Take(48);
+      if (Ptr == NULL) {printf("COB_Class::ReadCurPos( ): Unexpected end of chunk.\n"); return false;}
 
       //Allocate a new array
       if ((CurPos = new PointRec[4]) == NULL) {return false;}
    
-      //NOTE: The binary version reads only 3 transforamtion vectors!! 
-      //      The fourth is initialized seperately (see below).
-      for (int Incr = 0; Incr < 3; Incr++)
+      for (int Incr = 0; Incr < 3; Incr++, Ptr += 16)
          {
-         fread(&CurPos[Incr].X, 4, 1, COB_File);
-         fread(&CurPos[Incr].Y, 4, 1, COB_File);
-         fread(&CurPos[Incr].Z, 4, 1, COB_File);
-         fread(&CurPos[Incr].t, 4, 1, COB_File);
-         if (ferror(COB_File) != 0) 
-            {
-            printf("COB_Class::ReadCurPos( ): File read error.\n"); 
-            delete[] CurPos; CurPos = NULL;
-            return false;
-            }
+         CurPos[Incr].X = FileViewClass::GetFloat(Ptr);
+         CurPos[Incr].Y = FileViewClass::GetFloat(Ptr + 4);
+         CurPos[Incr].Z = FileViewClass::GetFloat(Ptr + 8);
+         CurPos[Incr].t = FileViewClass::GetFloat(Ptr + 12);
          }
 
       CurPos[3] = PointRec(0.0f, 0.0f, 0.0f, 1.0f);
@@ -555,47 +772,64 @@ class COB_Class
       }
 
    /*-------------------------------------------------------------------------
-      Reads the entire Vertex list within a chunk.
+      Reads the entire Vertex list within a chunk. The Vertices are decoded
+      in one pass, straight from the view into a single block of the PolH
+      pool, and they're transformed to the world space on the way.
 
-      COB_File    : File pointer. It is assumed that the file offset
-                    is at the position of the data.
+      View        : File view. It is assumed that the cursor is at the 
+                    position of the data.
       PolH        : The Object structure to save the vertices. Returns an 
                     allocated array of vertex pointers in VertexArray. Each 
                     vertex pointer entry is allocated with a vertex. If there 
                     are no vertices in this chunk, NULL is returned.
+      CurPos      : The transformation matrix of the Object (see 
+                    ReadCurPos( )).
      -------------------------------------------------------------------------*/
-   bool ReadVertexList(FILE* COB_File, PolHRec* PolH)
+   bool ReadVertexList(FileViewClass* View, PolHRec* PolH, PointRec* CurPos)
       {
-      if ((COB_File == NULL) || (PolH == NULL)) {return false;}
+      if ((View == NULL) || (PolH == NULL) || (CurPos == NULL)) {return false;}
 
       //Delete exisitng arrays
       DeleteVertexArray(PolH->VertexArray, PolH->VertexCount);
 
+      //Local variables
+      PointRec Coord;
+      byte*    Ptr;
+      dword    I;
+
 
       //Read the number of Vertices
-      fread(&PolH->VertexCount, 4, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadVertexList( ): File read error.\n"); goto _ExitError;}
+      if ((Ptr = View->Take(4)) == NULL) 
+         {printf("COB_Class::ReadVertexList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+      PolH->VertexCount = FileViewClass::GetDword(Ptr);
   
       //-- Do further processing if VertexCount is not 0 --
       if (PolH->VertexCount != 0)
          {
+         //The entire list must be in the chunk, 3 floats per Vertex
+         if ((PolH->VertexCount > View->Left() / 12) || ((Ptr = View->Take(PolH->VertexCount * 12)) == NULL)) 
+            {printf("COB_Class::ReadVertexList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
          //Allocate the and reset the array
          PolH->VertexArray = AllocVertexArray(PolH->VertexCount);
          if (PolH->VertexArray == NULL) {goto _ExitError;}
 
-         //Read the entire Vertex list
-         for (dword I = 0; I < PolH->VertexCount; I++)
+         //Allocate the Vertices in one block
+         if (!PolH->Pool.Vertices.Reserve(PolH->VertexCount)) {goto _ExitError;}
+
+         //-- Decode the entire Vertex list, and transform each Vertex to 
+         //   the world space by multiplying it with the CurPos matrix --
+         for (I = 0; I < PolH->VertexCount; I++, Ptr += 12)
             {
-            //Allocate and insert each Vertex into the Entity's list
-            if ((PolH->VertexArray[I] = new VertexRec) == NULL) {goto _ExitError;}
-         
-            //Read vertex data
-            fread(&PolH->VertexArray[I]->Coord.X, 4, 1, COB_File);
-            fread(&PolH->VertexArray[I]->Coord.Y, 4, 1, COB_File);
-            fread(&PolH->VertexArray[I]->Coord.Z, 4, 1, COB_File);
-            if (ferror(COB_File) != 0) 
-               {printf("COB_Class::ReadVertexList( ): File read error.\n"); goto _ExitError;}
+            if ((PolH->VertexArray[I] = PolH->Pool.NewVertex()) == NULL) {goto _ExitError;}
+
+            Coord = PointRec(FileViewClass::GetFloat(Ptr), FileViewClass::GetFloat(Ptr + 4), FileViewClass::GetFloat(Ptr + 8), 0.0f);
+
+            //Multiply then translate
+            PolH->VertexArray[I]->Coord = 
+               PointRec(CurPos[0].Dot(Coord) + CurPos[0].t,
+                        CurPos[1].Dot(Coord) + CurPos[1].t,
+                        CurPos[2].Dot(Coord) + CurPos[2].t, 0.0f);
             }
          }
 
@@ -612,37 +846,42 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads the entire texture coordinate list within a chunk.
 
-      COB_File      : File pointer. It is assumed that the file offset
-                      is at the position of the data.
+      View          : File view. It is assumed that the cursor is at the 
+                      position of the data.
       PolH          : The Object structure to save the texture poits. Returns an 
                       allocated array of texture points in TexPointArray.
      -------------------------------------------------------------------------*/
-   bool ReadTexPointList(FILE* COB_File, PolHRec* PolH)
+   bool ReadTexPointList(FileViewClass* View, PolHRec* PolH)
       {
-      if ((COB_File == NULL) || (PolH == NULL)) {return false;}
+      if ((View == NULL) || (PolH == NULL)) {return false;}
 
       //Delete exisitng arrays
       DeleteTexPointArray(PolH->TexPointArray, PolH->TexPointCount);
 
+      //Local variables
+      byte* Ptr;
+      dword I;
+
 
       //Read the number of texture coordinates
-      fread(&PolH->TexPointCount, 4, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadTexPointList( ): File read error.\n"); goto _ExitError;}
+      if ((Ptr = View->Take(4)) == NULL) 
+         {printf("COB_Class::ReadTexPointList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+      PolH->TexPointCount = FileViewClass::GetDword(Ptr);
   
       //If TexPointCount is not 0, allocate a temp array
       if (PolH->TexPointCount != 0)
          {
+         //The entire list must be in the chunk, 2 floats per texture coordinate
+         if ((PolH->TexPointCount > View->Left() / 8) || ((Ptr = View->Take(PolH->TexPointCount * 8)) == NULL)) 
+            {printf("COB_Class::ReadTexPointList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
          PolH->TexPointArray = new TexPointRec[PolH->TexPointCount];
          if (PolH->TexPointArray == NULL) {goto _ExitError;}
 
-         //Read the entire texture coordinate list
-         for (dword I = 0; I < PolH->TexPointCount; I++)
+         //Decode the entire texture coordinate list
+         for (I = 0; I < PolH->TexPointCount; I++, Ptr += 8)
             {
-            fread(&PolH->TexPointArray[I].U, 4, 1, COB_File);
-            fread(&PolH->TexPointArray[I].V, 4, 1, COB_File);
-            if (ferror(COB_File) != 0) 
-               {printf("COB_Class::ReadTexPointList( ): File read error.\n"); goto _ExitError;}
+            PolH->TexPointArray[I] = TexPointRec(FileViewClass::GetFloat(Ptr), FileViewClass::GetFloat(Ptr + 4), 0.0f, 0.0f);
             }
          }
 
@@ -659,7 +898,8 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads the entire Polygon list within a chunk.
 
-      COB_File      : File pointer. It is assumed that the file offset
+      View          : File view. It is assumed that the cursor is at the 
+                      position of the data.
       PolH          : The Object structure to save the polygons. The following
                       the VertexArray and the TexPointArray related fields must 
                       be initialized. On return, an array of Polygon pointers are
@@ -667,9 +907,9 @@ class COB_Class
                       Polygon. If there are no Polygons in this chunk, NULL is 
                       returned in PolygonArray.
      -------------------------------------------------------------------------*/
-   bool ReadPolygonList(FILE* COB_File, PolHRec* PolH)
+   bool ReadPolygonList(FileViewClass* View, PolHRec* PolH)
       {
-      if ((COB_File == NULL) || (PolH == NULL)) {return false;}
+      if ((View == NULL) || (PolH == NULL)) {return false;}
       if ((PolH->VertexArray   == NULL) && (PolH->VertexCount   != 0)) {return false;}
       if ((PolH->TexPointArray == NULL) && (PolH->TexPointCount != 0)) {return false;}
       
@@ -677,61 +917,77 @@ class COB_Class
       DeletePolygonArray(PolH->PolygonArray, PolH->PolygonCount);
 
       //Local variables
-      byte  PolygonFlag;
-      word  PolygonPtCount;
-      dword VertexIndex;
-      dword TexPointIndex;
-      dword PtRev;
-      dword I;
+      byte*       Ptr;
+      byte        PolygonFlag;
+      word        PolygonPtCount;
+      dword       VertexIndex;
+      dword       TexPointIndex;
+      dword       PtRev;
+      dword       Pt;
+      dword       I;
+      PolygonRec* Polygon;
 
       //Read the number of Polygons
-      fread(&PolH->PolygonCount, 4, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadPolygonList( ): File read error.\n"); goto _ExitError;}
+      if ((Ptr = View->Take(4)) == NULL) 
+         {printf("COB_Class::ReadPolygonList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+      PolH->PolygonCount = FileViewClass::GetDword(Ptr);
   
       //-- Do further processing if PolygonCount is not 0 --
       if (PolH->PolygonCount != 0)
          {
+         //Each Polygon takes at least 3 bytes, don't allocate more than the chunk can hold
+         if (PolH->PolygonCount > View->Left() / 3) 
+            {printf("COB_Class::ReadPolygonList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
          //Allocate and reset the array
          PolH->PolygonArray = AllocPolygonArray(PolH->PolygonCount);
          if (PolH->PolygonArray == NULL) {goto _ExitError;}
 
+         //Allocate the Polygons (and their cold data) in one block
+         if (!PolH->Pool.Polygons.Reserve(PolH->PolygonCount) ||
+             !PolH->Pool.Colds.Reserve(PolH->PolygonCount)) {goto _ExitError;}
+
          //Read the entire Polygon list
          for (I = 0; I < PolH->PolygonCount; I++)
             {
             //Allocate and insert Polygon
-            PolH->PolygonArray[I].Polygon = new PolygonRec;
-            if (PolH->PolygonArray[I].Polygon == NULL) {goto _ExitError;}
+            Polygon = PolH->PolygonArray[I].Polygon = PolH->Pool.NewPolygon();
+            if (Polygon == NULL) {goto _ExitError;}
+
+            //Read the Polygon flag and the number of points
+            if ((Ptr = View->Take(3)) == NULL) 
+               {printf("COB_Class::ReadPolygonList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+            PolygonFlag    = Ptr[0];
+            PolygonPtCount = FileViewClass::GetWord(Ptr + 1);
 
-            //Read Polygon data
-            fread(&PolygonFlag,     1, 1, COB_File);  //Read the Polygon flag
-            fread(&PolygonPtCount,  2, 1, COB_File);  //Get number of points
             if ((PolygonFlag & F_HOLE) == 0)          //Check for F_HOLE flag
                {
-               fread(&PolH->PolygonArray[I].Mat1Index, 2, 1, COB_File); //Read material index 
+               if ((Ptr = View->Take(2)) == NULL)     //Read material index 
+                  {printf("COB_Class::ReadPolygonList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+               PolH->PolygonArray[I].Mat1Index = FileViewClass::GetWord(Ptr);
                }
             else {PolH->PolygonArray[I].Mat1Index = 0xFFFF;} //Set flag to indicate that there is no material
 
-            //Assign Polygon vertices, and texture coordinates
-            for (dword Pt = 0; Pt < PolygonPtCount; Pt++)
+            //Get the Vertex and texture coordinate index pairs
+            if ((Ptr = View->Take((dword)PolygonPtCount * 8)) == NULL) 
+               {printf("COB_Class::ReadPolygonList( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
+            //Assign Polygon vertices, and texture coordinates (number of 
+            // assinemnts must be < POLY_PT_COUNT, the rest are ignored)
+            for (Pt = 0; (Pt < PolygonPtCount) && (Pt < POLY_PT_COUNT); Pt++, Ptr += 8)
                {
-               fread(&VertexIndex,   4, 1, COB_File); //Read the Vertex index
-               fread(&TexPointIndex, 4, 1, COB_File); //Read the Texture coordiante index
+               VertexIndex   = FileViewClass::GetDword(Ptr);
+               TexPointIndex = FileViewClass::GetDword(Ptr + 4);
 
-               if (Pt < POLY_PT_COUNT)                //Number of assinemnts must be < POLY_PT_COUNT
-                  {
-                  //Ensure that indeces don't exceed array bounds
-                  if ((VertexIndex   >= PolH->VertexCount) || 
-                      (TexPointIndex >= PolH->TexPointCount)) {goto _ExitError;}
-               
-                  //Triangulate in reverse
-                  PtRev = POLY_PT_COUNT - Pt - 1;
-                  if (PolH->VertexCount   > 0) {PolH->PolygonArray[I].Polygon->Vertex[PtRev]   = PolH->VertexArray[VertexIndex];}
-                  if (PolH->TexPointCount > 0) {PolH->PolygonArray[I].Polygon->TexCoord[PtRev] = PolH->TexPointArray[TexPointIndex];}
-                  }
-               }                                      //END for(Pt = 0...)
+               //Ensure that indeces don't exceed array bounds
+               if ((VertexIndex   >= PolH->VertexCount) || 
+                   (TexPointIndex >= PolH->TexPointCount)) {goto _ExitError;}
             
-            if (ferror(COB_File) != 0) {printf("COB_Class::ReadPolygonList( ): File read error.\n"); goto _ExitError;}
+               //Triangulate in reverse
+               PtRev = POLY_PT_COUNT - Pt - 1;
+               if (PolH->VertexCount   > 0) {Polygon->Vertex[PtRev]         = PolH->VertexArray[VertexIndex];}
+               if (PolH->TexPointCount > 0) {Polygon->Cold->TexCoord[PtRev] = PolH->TexPointArray[TexPointIndex];}
+               }                                      //END for(Pt = 0...)
             }                                         //END for(dword I = 0...)
          }                                            //END if()
 
@@ -749,18 +1005,18 @@ class COB_Class
    /*-------------------------------------------------------------------------
       Reads a 'Polygonal Data Chunk'.
 
-      COB_File    : File to read from.
+      View        : File view, the cursor and the limit are set to the 
+                    chunk data.
       ChunkHeader : Pointer to the chunk header structure
      -------------------------------------------------------------------------*/
-   bool ReadChunk_POLH(FILE* COB_File, ChunkHeaderRec* ChunkHeader)
+   bool ReadChunk_POLH(FileViewClass* View, ChunkHeaderRec* ChunkHeader)
       {
-      if ((COB_File == NULL) || (ChunkHeader == NULL)) {return false;}
+      if ((View == NULL) || (ChunkHeader == NULL)) {return false;}
 
       //Setup local data
       char*        Name          = NULL;
       PointRec*    Axes          = NULL;
       PointRec*    CurPos        = NULL;
-      dword        I;
 
       
       //Allocate a new Object data
@@ -779,36 +1035,22 @@ class COB_Class
 
 
       //Read the name of this chunk
-      if (!ReadName(COB_File, Name)) {goto _ExitError;}
+      if (!ReadName(View, Name)) {goto _ExitError;}
       
       //Read the axis information
-      if (!ReadLocalAxes(COB_File, Axes)) {goto _ExitError;}
+      if (!ReadLocalAxes(View, Axes)) {goto _ExitError;}
       
       //Read the current position
-      if (!ReadCurPos(COB_File, CurPos)) {goto _ExitError;}
+      if (!ReadCurPos(View, CurPos)) {goto _ExitError;}
 
-      //Read Vertex data
-      if (!ReadVertexList(COB_File, PolH)) {goto _ExitError;}
+      //Read Vertex data, and transform it to the world space
+      if (!ReadVertexList(View, PolH, CurPos)) {goto _ExitError;}
 
       //Read texture coordinate data
-      if (!ReadTexPointList(COB_File, PolH)) {goto _ExitError;}
+      if (!ReadTexPointList(View, PolH)) {goto _ExitError;}
 
       //Read Polygon data
-      if (!ReadPolygonList(COB_File, PolH)) {goto _ExitError;}
-
-
-
-      //-- Transform all the local vertices to the world space by multiplying
-      //   them with the CurPos transformation matrix. --
-      for (I = 0; I < PolH->VertexCount; I++)
-         {
-         //Multiply then translate
-         PolH->VertexArray[I]->Coord = 
-            PointRec(CurPos[0].Dot(PolH->VertexArray[I]->Coord),
-                     CurPos[1].Dot(PolH->VertexArray[I]->Coord),
-                     CurPos[2].Dot(PolH->VertexArray[I]->Coord), 0.0f) + 
-            PointRec(CurPos[0].t, CurPos[1].t, CurPos[2].t, 0.0f);
-         }
+      if (!ReadPolygonList(View, PolH)) {goto _ExitError;}
 
 
       //-- Normal exit --
@@ -828,20 +1070,26 @@ class COB_Class
       }
 
    /*-------------------------------------------------------------------------
-      Reads a 'Material Data Chunk'.
+      Reads a 'Material Data Chunk'. The environment, texture and bump map
+      data at the end of the chunk is not used, so it's not read at all.
 
-      COB_File    : File to read from.
+      View        : File view, the cursor and the limit are set to the 
+                    chunk data.
       ChunkHeader : Pointer to the chunk header structure
      -------------------------------------------------------------------------*/
-   bool ReadChunk_MAT1(FILE* COB_File, ChunkHeaderRec* ChunkHeader)
+   bool ReadChunk_MAT1(FileViewClass* View, ChunkHeaderRec* ChunkHeader)
       {
-      if ((COB_File == NULL) || (ChunkHeader == NULL)) {return false;}
+      if ((View == NULL) || (ChunkHeader == NULL)) {return false;}
 
       //Local variables
-      bool     SkipFlag;
-      Mat1Rec* Material;
+      Mat1Rec* Material = NULL;
+      byte*    Ptr;
 
 
+      //-- The material attributes are 5 bytes and 8 floats --
+      if ((Ptr = View->Take(37)) == NULL) 
+         {printf("COB_Class::ReadChunk_MAT1( ): Unexpected end of chunk.\n"); goto _ExitError;}
+
       //-- Allocate and initialize the material data --
       if ((Material = new Mat1Rec) == NULL) {goto _ExitError;}
 
@@ -849,60 +1097,19 @@ class COB_Class
       Material->ID       = ChunkHeader->ChunkID;
       Material->ParentID = ChunkHeader->ParentID;
 
-      //Read the material attributes
-      fread(&Material->Number,     2, 1, COB_File);
-      fread(&Material->ShaderType, 1, 1, COB_File);
-      fread(&Material->FacetType,  1, 1, COB_File);
-      fread(&Material->FacetAngle, 1, 1, COB_File);
-      fread(&Material->kDiff_R,    4, 1, COB_File);
-      fread(&Material->kDiff_G,    4, 1, COB_File);
-      fread(&Material->kDiff_B,    4, 1, COB_File);
-      fread(&Material->Opacity,    4, 1, COB_File);
-      fread(&Material->kAmb,       4, 1, COB_File);
-      fread(&Material->kSpec,      4, 1, COB_File);
-      fread(&Material->nSpec,      4, 1, COB_File);
-      fread(&Material->IdxRefr,    4, 1, COB_File);
-      if (ferror(COB_File) != 0) 
-         {printf("COB_Class::ReadChunk_MAT1( ): File read error.\n"); goto _ExitError;}
-
-
-      //-- Skip environment map, texture map and bump map data --
-      SkipFlag = true;
-      while (SkipFlag)
-         {
-         char MapID[2];
-         word StrLen;                            
-
-         fread(&MapID, 2, 1, COB_File);                   //Read the next ID field
-         if (strncmp(MapID, "e:", 2) == 0)
-            {
-            fseek(COB_File, 1, SEEK_CUR);                //Skip flags
-            fread(&StrLen, 2, 1, COB_File);              //Read string length
-            fseek(COB_File, (dword)StrLen, SEEK_CUR);    //Skip string
-            }
-         else if (strncmp(MapID, "t:", 2) == 0)
-            {
-            fseek(COB_File, 1, SEEK_CUR);                //Skip flags
-            fread(&StrLen, 2, 1, COB_File);              //Read string length
-            fseek(COB_File, (dword)StrLen, SEEK_CUR);    //Skip string
-            fseek(COB_File, 16, SEEK_CUR);               //Skip data
-            }
-         else if (strncmp(MapID, "b:", 2) == 0)
-            {
-            fseek(COB_File, 1, SEEK_CUR);                //Skip flags
-            fread(&StrLen, 2, 1, COB_File);              //Read string length
-            fseek(COB_File, (dword)StrLen, SEEK_CUR);    //Skip string
-            fseek(COB_File, 20, SEEK_CUR);               //Skip data
-            }
-         else {SkipFlag = false;}
-
-         if (ferror(COB_File) != 0) 
-            {printf("COB_Class::ReadChunk_MAT1( ): File read error.\n"); goto _ExitError;}
-         }
-      
-      
-      //Compensate for illegal ID field read
-      if (fseek(COB_File, -2, SEEK_CUR) != 0) {goto _ExitError;}
+      //Decode the material attributes
+      Material->Number     = FileViewClass::GetWord(Ptr);
+      Material->ShaderType = (char)Ptr[2];
+      Material->FacetType  = (char)Ptr[3];
+      Material->FacetAngle = Ptr[4];
+      Material->kDiff_R    = FileViewClass::GetFloat(Ptr + 5);
+      Material->kDiff_G    = FileViewClass::GetFloat(Ptr + 9);
+      Material->kDiff_B    = FileViewClass::GetFloat(Ptr + 13);
+      Material->Opacity    = FileViewClass::GetFloat(Ptr + 17);
+      Material->kAmb       = FileViewClass::GetFloat(Ptr + 21);
+      Material->kSpec      = FileViewClass::GetFloat(Ptr + 25);
+      Material->nSpec      = FileViewClass::GetFloat(Ptr + 29);
+      Material->IdxRefr    = FileViewClass::GetFloat(Ptr + 33);
 
       
       //Insert this material into the list
@@ -944,13 +1151,18 @@ class COB_Class
 
    /*-------------------------------------------------------------------------
       Reads an geometric object from a COB/SCN file and returns it in Entity. 
-      The function returns true on success.
-
-      FileName : File to open.
-      Entity   : The allocated Entity pointer is returned here. This becoses 
-                 NULL on fail.
+      The function returns true on success. The file is mapped into memory,
+      and the chunk directory is built first, so each chunk is read from 
+      its own range of the view, regardless of what the previous chunks
+      contained.
+
+      FileName    : File to open.
+      Entity      : The allocated Entity pointer is returned here. This becoses 
+                    NULL on fail.
+      WeldEpsilon : Vertices closer than this are welded together (0 disables 
+                    welding).
      -------------------------------------------------------------------------*/
-   bool Read(char* FileName, EntityRec* &Entity)
+   bool Read(char* FileName, EntityRec* &Entity, float WeldEpsilon)
       {
       if (FileName == NULL) {return false;}
 
@@ -961,23 +1173,23 @@ class COB_Class
       PointRec       Sum;
       ListRec*       PolHNode;
       FileHeaderRec  Header;
-      ChunkHeaderRec ChunkHeader;
-      bool           EndFlag = false;
+      FileViewClass  View;
+      ChunkRec*      Directory  = NULL;
+      dword          ChunkCount = 0;
+      dword          I;
 
 
       //-- Open the COB file --
-      FILE* COB_File = fopen(FileName, "rb");
-      if (COB_File == NULL) {return false;}
+      if (!View.Open(FileName)) {return false;}
    
       //-- Read the file header --
-      fseek(COB_File, 0, SEEK_SET);
-      fread(&Header.ID,       9, 1, COB_File);
-      fread(&Header.Version,  6, 1, COB_File);
-      fread(&Header.Format,   1, 1, COB_File);
-      fread(&Header.Order,    2, 1, COB_File);
-      fread(&Header.Blank,   13, 1, COB_File);
-      fread(&Header.NewLine,  1, 1, COB_File);
-      if (ferror(COB_File) != 0) {printf("COB_Class::Read( ): File read error.\n"); goto _ExitError;}
+      if (!View.Read(&Header.ID,       9) ||
+          !View.Read(&Header.Version,  6) ||
+          !View.Read(&Header.Format,   1) ||
+          !View.Read(&Header.Order,    2) ||
+          !View.Read(&Header.Blank,   13) ||
+          !View.Read(&Header.NewLine,  1))
+         {printf("COB_Class::Read( ): Invalid or unsupported file format.\n"); goto _ExitError;}
 
       //Check the file header
       if ((strncmp(Header.ID,      "Caligari ", 9) != 0) ||
@@ -988,23 +1200,27 @@ class COB_Class
 
 
 
-      //---- The the entire file ----
-      while (!EndFlag)
+      //---- Find all the chunks ----
+      if (!ReadDirectory(&View, Directory, ChunkCount)) {goto _ExitError;}
+
+      //---- Read the chunks ----
+      for (I = 0; I < ChunkCount; I++)
          {
-         //Read a chunk
-         if (!ReadChunkHeader(COB_File, &ChunkHeader)) {goto _ExitError;}
+         //Restrict the view to the chunk data
+         if (!View.Seek(Directory[I].Offset, Directory[I].Header.DataSize)) {goto _ExitError;}
 
          //Perform specific operations for each chunk
-         if      (strncmp(ChunkHeader.Type, CHUNK_END , 4) == 0) {EndFlag = true;}
-         else if (strncmp(ChunkHeader.Type, CHUNK_POLH, 4) == 0) {if (!ReadChunk_POLH(COB_File, &ChunkHeader)) {goto _ExitError;}}
-         else if (strncmp(ChunkHeader.Type, CHUNK_MAT1, 4) == 0) {if (!ReadChunk_MAT1(COB_File, &ChunkHeader)) {goto _ExitError;}}
-         else if (fseek(COB_File, ChunkHeader.DataSize, SEEK_CUR) != 0) {goto _ExitError;}
+         if      (strncmp(Directory[I].Header.Type, CHUNK_POLH, 4) == 0) {if (!ReadChunk_POLH(&View, &Directory[I].Header)) {goto _ExitError;}}
+         else if (strncmp(Directory[I].Header.Type, CHUNK_MAT1, 4) == 0) {if (!ReadChunk_MAT1(&View, &Directory[I].Header)) {goto _ExitError;}}
          }
 
+      //The file is no longer needed
+      View.Close();
+
 
 
       //-- Setup other attributes --
-      if (!ProstProcess(Entity))          {goto _ExitError;}
+      if (!ProstProcess(Entity, WeldEpsilon)) {goto _ExitError;}
       if (!Entity->SetFacet(deg2rad(24.0f), true)) {goto _ExitError;} //Setup facet and normals
       if (!Entity->FindCentroid(0, &Sum)) {goto _ExitError;}
       if (!Entity->FindBoundingBox(true)) {goto _ExitError;}
@@ -1017,7 +1233,7 @@ class COB_Class
       while (PolHNode != NULL) {DeletePolH(((PolHRec*&)PolHNode->Data)); PolHNode = PolHNode->Next;}
       LinkedList.Nuke(PolHList);
 
-      if (COB_File != NULL) {fclose(COB_File);}
+      if (Directory != NULL) {delete[] Directory;}
       return true;
 
 
@@ -1029,8 +1245,8 @@ class COB_Class
       while (PolHNode != NULL) {DeletePolH(((PolHRec*&)PolHNode->Data)); PolHNode = PolHNode->Next;}
       LinkedList.Nuke(PolHList);
 
-      if (COB_File != NULL) {fclose(COB_File);}
-      if (Entity   != NULL) {delete Entity; Entity = NULL;}
+      if (Directory != NULL) {delete[] Directory;}
+      if (Entity    != NULL) {delete Entity; Entity = NULL;}
       return false;
       }
 
@@ -7,7 +7,7 @@
 
 
 /*---------------------------------------------------------------------------
-   Don't include this file if it's already defined.   
+   Don't include this file if it's already defined.
   ---------------------------------------------------------------------------*/
 #ifndef __PPM_FMT_CPP__
 #define __PPM_FMT_CPP__
@@ -20,19 +20,268 @@
 #include "../mem_data/bitmap.cpp"
 
 
+/*----------------------------------------------------------------------------
+  PPM related definitions.
+  ----------------------------------------------------------------------------*/
+#define PPM_READ_SIZE      0x10000                 //Size of the read buffer
+#define PPM_HEADER_SIZE    0x200                   //Space reserved for the file header when saving
+#define PPM_MAX_VALUE      0xFFFF                  //Largest sample value allowed by the format
+
+
 /*---------------------------------------------------------------------------
-  The PPM file IO class.
+  The PPM file IO class. It reads the PPM (P3, P6) and PGM (P2, P5) formats,
+  and saves PPM files, or PFM files from float colors. The saved files are
+  converted into a memory buffer, and written with a single fwrite( ). The
+  files are read through a buffer, one scanline at a time. The buffer is
+  kept for the next use.
   ---------------------------------------------------------------------------*/
 class PPM_Class
    {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   /*---- Private Data -------------------------------------------------------*/
+   byte*     Buffer;                               //Read/write buffer
+   dword     BufferSize;                           //Allocated size of the buffer
+
+   FILE*     File;                                 //File being read
+   byte*     ReadPtr;                              //Next unread byte in the read buffer
+   byte*     ReadEnd;                              //End of the data in the read buffer
+
+   /*-------------------------------------------------------------------------
+      Ensures that the buffer has at least Size bytes. Returns true on
+      success.
+     -------------------------------------------------------------------------*/
+   bool ReserveBuffer(dword Size)
+      {
+      if (Size <= BufferSize) {return true;}
+
+      if (Buffer != NULL) {delete[] Buffer;}
+      BufferSize = 0;
+
+      Buffer = new byte[Size];
+      if (Buffer == NULL) {printf("PPM_Class::ReserveBuffer( ): Memory allocation failed.\n"); return false;}
+
+      BufferSize = Size;
+      return true;
+      }
+
+
+   /*=========================================================================
+     PPM file reading functions. The file is read through Buffer.
+     =========================================================================*/
+
+   /*-------------------------------------------------------------------------
+      Returns the next character from the file, or -1 at the end of it.
+     -------------------------------------------------------------------------*/
+   inline int GetChar(void)
+      {
+      if (ReadPtr == ReadEnd)
+         {
+         ReadPtr = Buffer;
+         ReadEnd = Buffer + fread(Buffer, 1, PPM_READ_SIZE, File);
+         if (ReadPtr == ReadEnd) {return -1;}
+         }
+
+      return *ReadPtr++;
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads Size bytes to Dest. The buffered bytes are copied first, then the
+      rest is read straight from the file. Returns false if the file is too
+      short.
+     -------------------------------------------------------------------------*/
+   bool GetBytes(byte* Dest, dword Size)
+      {
+      dword Count = ReadEnd - ReadPtr;
+      if (Count > Size) {Count = Size;}
+
+      memcpy(Dest, ReadPtr, Count);
+      ReadPtr += Count;
+      Size    -= Count;
+
+      if (Size == 0) {return true;}
+      return fread(Dest + Count, 1, Size, File) == Size;
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads an unsigned decimal number, skipping the white spaces and
+      comments before it. Returns false if there is no number, or it's
+      larger than Max.
+     -------------------------------------------------------------------------*/
+   bool GetNumber(dword &Value, dword Max)
+      {
+      int Char = GetChar();
+      while ((Char == ' ') || (Char == '\t') || (Char == '\r') || (Char == '\n') || (Char == '#'))
+         {
+         if (Char == '#') {while ((Char != '\n') && (Char != -1)) {Char = GetChar();}}
+         Char = GetChar();
+         }
+
+      if ((Char < '0') || (Char > '9')) {return false;}
+
+      Value = 0;
+      while ((Char >= '0') && (Char <= '9'))
+         {
+         Value = Value * 10 + (dword)(Char - '0');
+         if (Value > Max) {return false;}
+         Char = GetChar();
+         }
+
+      //The character after the number is a single white space, which is
+      //consumed here (the binary data follows it in the header)
+      return (Char == -1) || (Char == ' ') || (Char == '\t') || (Char == '\r') || (Char == '\n');
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads a scanline of samples, and scales them to the 0 - 255 range.
+      Returns true on success.
+
+      Dest     : Scanline of the bitmap.
+      Samples  : Buffer for the scanline's samples, when they need scaling.
+      Count    : Number of samples in the scanline.
+      MaxValue : The largest sample value in the file.
+      Binary   : Set true for the binary formats.
+     -------------------------------------------------------------------------*/
+   bool ReadScanLine(byte* Dest, byte* Samples, dword Count, dword MaxValue, bool Binary)
+      {
+      dword Sample;
+      dword Half = MaxValue >> 1;
+
+      //-- ASCII samples --
+      if (!Binary)
+         {
+         for (; Count > 0; Count--)
+            {
+            if (!GetNumber(Sample, PPM_MAX_VALUE)) {return false;}
+            if (Sample > MaxValue) {Sample = MaxValue;}
+            *Dest++ = (byte)((Sample * 255 + Half) / MaxValue);
+            }
+         return true;
+         }
+
+      //-- Binary samples, stored as they are --
+      if (MaxValue == 255) {return GetBytes(Dest, Count);}
+
+      //-- Binary samples, in one byte, or two bytes with the MSB first --
+      dword SampleSize = (MaxValue < 256) ? 1 : 2;
+      byte* Src        = Samples;
+      if (!GetBytes(Src, Count * SampleSize)) {return false;}
+
+      for (; Count > 0; Count--)
+         {
+         Sample = (SampleSize == 1) ? (dword)Src[0] : (((dword)Src[0] << 8) | (dword)Src[1]);
+         if (Sample > MaxValue) {Sample = MaxValue;}
+         *Dest++ = (byte)((Sample * 255 + Half) / MaxValue);
+         Src    += SampleSize;
+         }
+
+      return true;
+      }
+
+
    /*==== Public Declarations ================================================*/
    public:
 
+   /*---- Constructor --------------------------------------------------------*/
+   PPM_Class(void)
+      {
+      Buffer     = NULL;
+      BufferSize = 0;
+      File       = NULL;
+      ReadPtr    = NULL;
+      ReadEnd    = NULL;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~PPM_Class(void) {if (Buffer != NULL) {delete[] Buffer; Buffer = NULL;}}
+
    /*-------------------------------------------------------------------------
-      Read is not supported.
+      Reads a PPM or PGM file, in ASCII or binary format. PPM files are read
+      into an RGB bitmap, and PGM files into a grey scale (Alpha) bitmap.
+      Samples are scaled to the 0 - 255 range. Returns true on success.
+
+      FileName : File name and path to open.
+      Bitmap   : Pointer to a BitmapRec data. This structure will be
+                 initialised if the function is successful. The existing
+                 structre will be deleted on entry.
      -------------------------------------------------------------------------*/
    bool Read(char* FileName, BitmapRec* Bitmap)
-      {return false;}
+      {
+      if ((FileName == NULL) || (Bitmap == NULL)) {return false;}
+
+      //-- Declare data --
+      dword U_Res, V_Res, MaxValue;
+      dword SamplesPerPixel;
+      bool  Binary;
+      byte* ScanLinePtr;
+      byte* Samples = NULL;
+      int   Magic;
+
+      //-- Reset some of the data records in Bitmap --
+      Bitmap->DeleteData();
+
+      //-- Open the PPM file --
+      File = fopen(FileName, "rb");
+      if (File == NULL) {return false;}
+
+      if (!ReserveBuffer(PPM_READ_SIZE)) {goto _ReadPPM_ExitError;}
+      ReadPtr = ReadEnd = Buffer;
+
+      //-- Read the file header --
+      if (GetChar() != 'P') {printf("PPM_Class::Read( ): File contains an unknown image type.\n"); goto _ReadPPM_ExitError;}
+
+      Magic = GetChar();
+      switch (Magic)
+         {
+         case '2' : Bitmap->Flags = BMP_TEXTURE | BMP_TYPE_A;   SamplesPerPixel = 1; Binary = false; break;
+         case '3' : Bitmap->Flags = BMP_TEXTURE | BMP_TYPE_RGB; SamplesPerPixel = 3; Binary = false; break;
+         case '5' : Bitmap->Flags = BMP_TEXTURE | BMP_TYPE_A;   SamplesPerPixel = 1; Binary = true;  break;
+         case '6' : Bitmap->Flags = BMP_TEXTURE | BMP_TYPE_RGB; SamplesPerPixel = 3; Binary = true;  break;
+         default  : printf("PPM_Class::Read( ): File contains an unknown image type.\n"); goto _ReadPPM_ExitError;
+         }
+
+      if (!GetNumber(U_Res, PPM_MAX_VALUE) || !GetNumber(V_Res, PPM_MAX_VALUE) ||
+          !GetNumber(MaxValue, PPM_MAX_VALUE) || (MaxValue == 0))
+         {printf("PPM_Class::Read( ): Invalid file header.\n"); goto _ReadPPM_ExitError;}
+
+      //-- Setup the texture data --
+      Bitmap->U_Res      = U_Res;
+      Bitmap->V_Res      = V_Res;
+      Bitmap->FrameCount = 1;
+      if (!Bitmap->AllocateData()) {goto _ReadPPM_ExitError;}
+
+      //Samples that need scaling are read into a separate buffer first
+      if (Binary && (MaxValue != 255))
+         {
+         Samples = new byte[Bitmap->BytesPerLine * 2];
+         if (Samples == NULL) {printf("PPM_Class::Read( ): Memory allocation failed.\n"); goto _ReadPPM_ExitError;}
+         }
+
+      //-- Read the bitmap --
+      ScanLinePtr = Bitmap->BitmapPtr;
+      for (dword V = 0; V < V_Res; V++)
+         {
+         if (!ReadScanLine(ScanLinePtr, Samples, U_Res * SamplesPerPixel, MaxValue, Binary))
+            {printf("PPM_Class::Read( ): File read error.\n"); goto _ReadPPM_ExitError;}
+
+         ScanLinePtr += Bitmap->BytesPerLine;
+         }
+
+      //-- Normal exit --
+      if (Samples != NULL) {delete[] Samples;}
+      fclose(File);
+      File = NULL;
+      return true;
+
+      //-- Exit on error --
+      _ReadPPM_ExitError:
+      if (Samples != NULL) {delete[] Samples;}
+      fclose(File);
+      File = NULL;
+      Bitmap->DeleteData();
+      return false;
+      }
 
    /*-------------------------------------------------------------------------
       Saves to a PPM file. If the bitmap is a multi-frame image, only the current
@@ -49,13 +298,13 @@ class PPM_Class
       //Check if the bitmap is valid
       if (!Bitmap->Check()) {return false;}
 
-      //-- Open the PPM file --
-      FILE* PPM_File = fopen(FileName, "wt");
-      if (PPM_File == NULL) {return false;}
-
       //---- Save the bitmap data in ASCII format ----
       if (SaveASCII)
          {
+         //-- Open the PPM file --
+         FILE* PPM_File = fopen(FileName, "wt");
+         if (PPM_File == NULL) {return false;}
+
          //-- Write the file header --
          fprintf(PPM_File, "P3\n#Generated by %s\n%d %d\n255\n\n", Title, Bitmap->U_Res, Bitmap->V_Res);
 
@@ -65,52 +314,110 @@ class PPM_Class
             {
             iColorRec Color;
             Bitmap->Pixel->Read(PixelPtr, &Color); //Read color
-      
+
             CharsPerLine += fprintf(PPM_File, "%d %d %d  ", Color.R, Color.G, Color.B);
             if (CharsPerLine > 50) {fprintf(PPM_File, "\n"); CharsPerLine = 0;}
-      
+
             PixelPtr += Bitmap->BytesPerPixel;
             }
+
+         if (fclose(PPM_File) != 0) {printf("PPM_Class::Save( ): File write error.\n"); return false;}
+         return true;
          }
 
       //---- Save the bitmap data in binary format ----
-      else
+      dword PixelCount = Bitmap->U_Res * Bitmap->V_Res;
+      if (!ReserveBuffer(PPM_HEADER_SIZE + PixelCount * 3)) {return false;}
+
+      //-- Store the file header --
+      byte* Ptr = Buffer;
+      Ptr += sprintf((char*)Ptr, "P6\n#Generated by %.*s\n%d %d\n255\n", PPM_HEADER_SIZE - 64, Title, Bitmap->U_Res, Bitmap->V_Res);
+
+      //-- Convert the frame. RGB is stored as it is, other formats are
+      //   converted in one pass. --
+      byte* PixelPtr = Bitmap->FramePtr;
+      switch (Bitmap->Flags & BMP_TYPE_MASK)
          {
-         //Re-open the file in binary mode
-         PPM_File = freopen(FileName, "ab+", PPM_File);
-         if (PPM_File == NULL) {return false;}
-         fseek(PPM_File, SEEK_END, 0);
+         case BMP_TYPE_RGB  : memcpy(Ptr, PixelPtr, PixelCount * 3); Ptr += PixelCount * 3; break;
 
-         //-- Write the file header --
-         fprintf(PPM_File, "P6\n#Generated by %s\n%d %d\n255\n", Title, Bitmap->U_Res, Bitmap->V_Res);
+         case BMP_TYPE_RGBA : {
+                              for (dword Count = PixelCount; Count > 0; Count--, PixelPtr += 4, Ptr += 3)
+                                 {Ptr[0] = PixelPtr[0]; Ptr[1] = PixelPtr[1]; Ptr[2] = PixelPtr[2];}
+                              break;
+                              }
 
-         byte* PixelPtr = Bitmap->FramePtr;
-         while (PixelPtr < Bitmap->FramePtr + Bitmap->Size)
+         case BMP_TYPE_BGR  : {
+                              for (dword Count = PixelCount; Count > 0; Count--, PixelPtr += 3, Ptr += 3)
+                                 {Ptr[0] = PixelPtr[2]; Ptr[1] = PixelPtr[1]; Ptr[2] = PixelPtr[0];}
+                              break;
+                              }
+
+         default            : {
+                              iColorRec Color;
+                              for (dword Count = PixelCount; Count > 0; Count--, PixelPtr += Bitmap->BytesPerPixel, Ptr += 3)
+                                 {
+                                 Bitmap->Pixel->Read(PixelPtr, &Color);
+                                 Ptr[0] = (byte)Color.R;
+                                 Ptr[1] = (byte)Color.G;
+                                 Ptr[2] = (byte)Color.B;
+                                 }
+                              break;
+                              }
+         }
+
+      //-- Write the whole file --
+      FILE* PPM_File = fopen(FileName, "wb");
+      if (PPM_File == NULL) {return false;}
+
+      bool Status = (fwrite(Buffer, Ptr - Buffer, 1, PPM_File) == 1);
+      if (fclose(PPM_File) != 0) {Status = false;}
+      if (!Status) {printf("PPM_Class::Save( ): File write error.\n");}
+
+      return Status;
+      }
+
+   /*-------------------------------------------------------------------------
+      Saves float colors to a PFM file, without clamping or quantization, so
+      that HDR images can be stored. The colors are stored as little endian
+      floats, with the scanlines in bottom to top order, as the format
+      requires. Returns true on success.
+
+      FileName : File name with path to save.
+      Colors   : Colors of the image, stored top to bottom, left to right.
+      U_Res    : Horizontal resolution of the image.
+      V_Res    : Vertical resolution of the image.
+     -------------------------------------------------------------------------*/
+   bool SavePFM(char* FileName, ColorRec* Colors, dword U_Res, dword V_Res)
+      {
+      if ((FileName == NULL) || (Colors == NULL) || (U_Res == 0) || (V_Res == 0)) {return false;}
+
+      if (!ReserveBuffer(PPM_HEADER_SIZE + U_Res * V_Res * 3 * sizeof(float))) {return false;}
+
+      //-- Store the file header (a negative scale means little endian) --
+      byte* Ptr = Buffer;
+      Ptr += sprintf((char*)Ptr, "PF\n%u %u\n-1.0\n", U_Res, V_Res);
+
+      //-- Store the scanlines, bottom to top --
+      for (dword V = V_Res; V > 0; V--)
+         {
+         ColorRec* Color = Colors + (V - 1) * U_Res;
+         for (dword U = 0; U < U_Res; U++, Color++, Ptr += 3 * sizeof(float))
             {
-            iColorRec Color;
-            Bitmap->Pixel->Read(PixelPtr, &Color); //Read color
-      
-            fwrite(&Color.R, 1, 1, PPM_File);
-            fwrite(&Color.G, 1, 1, PPM_File);
-            fwrite(&Color.B, 1, 1, PPM_File);
-            if (ferror(PPM_File) != 0) 
-               {
-               printf("PPM_Class::SavePPM( ): File write error.\n");
-               goto _SavePPM_ExitError;
-               }
-      
-            PixelPtr += Bitmap->BytesPerPixel;
+            memcpy(Ptr,                     &Color->R, sizeof(float));
+            memcpy(Ptr +     sizeof(float), &Color->G, sizeof(float));
+            memcpy(Ptr + 2 * sizeof(float), &Color->B, sizeof(float));
             }
          }
 
-      //---- Normal exit ----
-      if (PPM_File != NULL) {fclose(PPM_File);}
-      return true;
+      //-- Write the whole file --
+      FILE* PFM_File = fopen(FileName, "wb");
+      if (PFM_File == NULL) {return false;}
 
-      //---- Exit on error ----
-      _SavePPM_ExitError:
-      if (PPM_File != NULL) {fclose(PPM_File);}
-      return false;
+      bool Status = (fwrite(Buffer, Ptr - Buffer, 1, PFM_File) == 1);
+      if (fclose(PFM_File) != 0) {Status = false;}
+      if (!Status) {printf("PPM_Class::SavePFM( ): File write error.\n");}
+
+      return Status;
       }
 
    /*==== End of Class =======================================================*/
@@ -0,0 +1,693 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                      Compiled Scene Cache Reader/Saver                     */
+/*============================================================================*/
+
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __SCN_CACHE_CPP__
+#define __SCN_CACHE_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/list.cpp"
+#include "../_common/fileview.cpp"
+#include "../mem_data/cfg_data.cpp"
+#include "../mem_data/nurb.cpp"
+#include "../mem_data/light.cpp"
+#include "../mem_data/entity.cpp"
+#include "../mem_data/world.cpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define SCENE_CACHE_EXT    ".scc"               //Appended to the script file name
+#define SCENE_CACHE_ID     "CRSCENE"            //File ID (including the 0 terminator)
+#define SCENE_VERSION      1                    //Format version, change it whenever the layout is modified
+#define SCENE_ALIGN        16                   //Every block in the file is padded to this many bytes
+#define SCENE_MAX_DEPTH    64                   //Maximum nesting of sub-Entities and levels of detail
+#define SCENE_MIN_SOURCES  16                   //Initial number of source entries
+#define SCENE_HASH_BASIS   0x811C9DC5           //Initial value of Hash( )
+
+//Entity attributes
+#define SCENE_ENTITY_BV    0x00000001           //The Vertices are followed by the bounding volume
+#define SCENE_ENTITY_LOD   0x00000002           //A coarser level of detail follows the Entity
+#define SCENE_ENTITY_NURB  0x00000004           //The Nurb surface follows the mesh
+#define SCENE_ENTITY_TESS  0x00000008           //The mesh is the current tessellation of the Nurb
+
+
+/*---------------------------------------------------------------------------
+  The scene cache class. Stores the result of a script (the config, and
+  the Entities and Lights of the World) in a compiled form next to the
+  script, so the next start up can skip the parsing, the mesh import, the
+  welding, the normals, and the level of detail construction.
+
+  The Entities are stored in the world space, as the flat arrays of
+  BuildMesh( ), and they are restored with EntityRec::SetMesh( ) in bulk.
+  The pointers in the records are rebuilt from the indices, so the file
+  is relocatable, and it's read through a FileViewClass (memory mapped).
+  Every block is padded to SCENE_ALIGN bytes.
+
+  The cache is keyed on the script contents, and on the size and
+  modification time of every file the script imported (see AddSource( )).
+  The record layout is part of the key as well, so a cache written by a
+  different build is ignored.
+  ---------------------------------------------------------------------------*/
+class SceneCacheClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   /*---- File Records -------------------------------------------------------*/
+   struct SceneHeaderRec
+      {
+      char     ID[8];                           //SCENE_CACHE_ID
+      dword    Version;                         //SCENE_VERSION
+      dword    Layout;                          //Hash of the record sizes (see Layout( ))
+      dword    ScriptHash;                      //Hash of the script contents
+      dword    ScriptSize;                      //Size of the script
+      dword    SourceCount;                     //Number of imported files
+      dword    EntityCount;                     //Number of Entities in the World
+      dword    LightCount;                      //Number of Lights in the World
+      dword    ProfEquLength;                   //Length of the profile equation, including the 0 (0 if NULL)
+      dword    Reserved[2];
+      };
+
+   struct SceneSourceRec
+      {
+      dword    Size;                            //File size
+      dword    Time;                            //Modification time
+      dword    NameLength;                      //Length of the file name, including the 0
+      dword    Reserved;
+      };
+
+   struct SceneEntityRec
+      {
+      dword    Attrib;                          //SCENE_ENTITY_* flags
+      dword    Flags;                           //EntityRec::Flags
+      dword    VertexCount;                     //Number of Vertices, excluding the bounding volume
+      dword    PolygonCount;
+      dword    MaterialCount;
+      dword    SubCount;                        //Number of sub-Entities
+      float    NurbTolerance;                   //EntityRec::NurbTolerance
+      dword    Reserved;
+      PointRec Centroid;
+      PointRec ScaleConst;
+      PointRec Velocity;
+      PointRec Rotation;
+      };
+
+   struct SceneNurbRec
+      {
+      dword    Flags;                           //NURB_* attributes
+      dword    S_Res;
+      dword    T_Res;
+      dword    S_Order;
+      dword    T_Order;
+      dword    Reserved[3];
+      };
+
+   /*---- Private Data -------------------------------------------------------*/
+   char**    Sources;                           //Files imported by the script
+   dword     SourceCount;
+   dword     SourceSize;                        //Allocated number of entries
+   bool      SourceError;                       //Set if a source file couldn't be recorded
+
+   /*-------------------------------------------------------------------------
+      Rounds Bytes up to the block alignment.
+     -------------------------------------------------------------------------*/
+   inline dword Align(dword Bytes) {return (Bytes + (SCENE_ALIGN-1)) & ~(SCENE_ALIGN-1);}
+
+   /*-------------------------------------------------------------------------
+      Returns a hash of the record sizes, so that a cache written with a
+      different layout (or compiler) is rejected.
+     -------------------------------------------------------------------------*/
+   dword Layout(void)
+      {
+      dword Sizes[] =
+         {
+         sizeof(SceneHeaderRec), sizeof(SceneSourceRec), sizeof(SceneEntityRec), sizeof(SceneNurbRec),
+         sizeof(ConfigVideo), sizeof(ConfigRender), sizeof(ConfigWorld), sizeof(LightRec),
+         sizeof(VertexRec), sizeof(PolygonRec), sizeof(PolyColdRec), sizeof(MaterialRec),
+         sizeof(PointRec), sizeof(ColorRec), sizeof(TexPointRec), POLY_PT_COUNT, ENTITY_BV_COUNT
+         };
+      return Hash((byte*)Sizes, sizeof(Sizes));
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the size and the modification time of a file. Returns false if
+      the file doesn't exist.
+     -------------------------------------------------------------------------*/
+   bool FileStamp(char* FileName, dword &Size, dword &Time)
+      {
+      struct stat Stat;
+      if ((FileName == NULL) || (stat(FileName, &Stat) != 0)) {return false;}
+
+      Size = (dword)Stat.st_size;
+      Time = (dword)Stat.st_mtime;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Writes the padding after a block of Bytes. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool PutPadding(FILE* File, dword Bytes)
+      {
+      static byte Zero[SCENE_ALIGN] = {0};
+      dword Padding = Align(Bytes) - Bytes;
+
+      return (Padding == 0) || (fwrite(Zero, 1, Padding, File) == Padding);
+      }
+
+   /*-------------------------------------------------------------------------
+      Writes a block, followed by the padding. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Put(FILE* File, void* Data, dword Bytes)
+      {
+      if ((Bytes > 0) && (fwrite(Data, 1, Bytes, File) != Bytes)) {return false;}
+      return PutPadding(File, Bytes);
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns a pointer to the next block of the view, along with the
+      padding. Count records of RecSize bytes are expected. Returns NULL if
+      the view is too short.
+     -------------------------------------------------------------------------*/
+   byte* Get(FileViewClass &View, dword Count, dword RecSize)
+      {
+      if ((RecSize > 0) && (Count > View.Left() / RecSize)) {return NULL;}
+
+      dword Bytes = Count * RecSize;
+      byte* Ptr   = View.Take(Bytes);
+      if (Ptr == NULL) {return NULL;}
+
+      //The padding may be missing at the end of the file
+      View.Pos += (Align(Bytes) - Bytes < View.Left()) ? Align(Bytes) - Bytes : View.Left();
+      return Ptr;
+      }
+
+   /*-------------------------------------------------------------------------
+      Writes an Entity, it's Nurb surface, it's levels of detail and it's
+      sub-Entities. The Entity must be in the world space (see
+      EntityRec::Rebase( )). Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool WriteEntity(FILE* File, EntityRec* Entity)
+      {
+      SceneEntityRec Rec;
+      ListRec*       EntityNode;
+      ListRec*       Tail = NULL;
+      dword          I;
+
+      Rec.Attrib        = 0;
+      Rec.Flags         = Entity->Flags & ~(ENTITY_SHADE | ENTITY_XFORM);
+      Rec.VertexCount   = Entity->VertexCount;
+      Rec.PolygonCount  = Entity->PolygonCount;
+      Rec.MaterialCount = Entity->MaterialCount;
+      Rec.NurbTolerance = Entity->NurbTolerance;
+      Rec.Centroid      = Entity->Centroid;
+      Rec.ScaleConst    = Entity->ScaleConst;
+      Rec.Velocity      = Entity->Velocity;
+      Rec.Rotation      = Entity->Rotation;
+      Rec.SubCount      = 0;
+      Rec.Reserved      = 0;
+
+      if (Entity->BV[0] != NULL) {Rec.Attrib |= SCENE_ENTITY_BV;}
+      if (Entity->LOD   != NULL) {Rec.Attrib |= SCENE_ENTITY_LOD;}
+      if (Entity->Nurb  != NULL)
+         {
+         Rec.Attrib |= SCENE_ENTITY_NURB;
+         if (Entity->NurbStamp == Entity->Nurb->Stamp) {Rec.Attrib |= SCENE_ENTITY_TESS;}
+         }
+
+      for (EntityNode = Entity->EntityList; EntityNode != NULL; EntityNode = EntityNode->Next)
+         {
+         Rec.SubCount++;
+         Tail = EntityNode;
+         }
+
+      //The arrays are only valid after BuildMesh( )
+      if ((Entity->VertexArray == NULL) && (Entity->VertexCount + ((Entity->BV[0] != NULL) ? ENTITY_BV_COUNT : 0) > 0)) {return false;}
+      if (((Entity->PolygonArray == NULL) || (Entity->IndexArray == NULL)) && (Entity->PolygonCount > 0)) {return false;}
+
+      //-- The mesh --
+      if (!Put(File, &Rec, sizeof(Rec))) {return false;}
+      if (!Put(File, Entity->VertexArray,   (Rec.VertexCount + (((Rec.Attrib & SCENE_ENTITY_BV) != 0) ? ENTITY_BV_COUNT : 0)) * sizeof(VertexRec))) {return false;}
+      if (!Put(File, Entity->PolygonArray,  Rec.PolygonCount * sizeof(PolygonRec))) {return false;}
+      if (!Put(File, Entity->IndexArray,    Rec.PolygonCount * POLY_PT_COUNT * sizeof(dword))) {return false;}
+      if (!Put(File, Entity->MaterialArray, Rec.MaterialCount * sizeof(MaterialRec))) {return false;}
+
+      //The cold data is in a single pool block after BuildMesh( ), but that's not guaranteed
+      for (I = 0; I < Rec.PolygonCount; I++)
+         {
+         if (fwrite(Entity->PolygonArray[I].Cold, sizeof(PolyColdRec), 1, File) != 1) {return false;}
+         }
+      if (!PutPadding(File, Rec.PolygonCount * sizeof(PolyColdRec))) {return false;}
+
+      //-- The Nurb surface --
+      if (Entity->Nurb != NULL)
+         {
+         NurbRec*     Nurb = Entity->Nurb;
+         SceneNurbRec Surface;
+
+         memset(&Surface, 0, sizeof(Surface));
+         Surface.Flags   = Nurb->Flags & (NURB_COLOR | NURB_TEXTURE | NURB_POINT | NURB_WEIGHT);
+         Surface.S_Res   = Nurb->S_Res;
+         Surface.T_Res   = Nurb->T_Res;
+         Surface.S_Order = Nurb->S_Order;
+         Surface.T_Order = Nurb->T_Order;
+
+         if (!Put(File, &Surface, sizeof(Surface))) {return false;}
+         if (!Put(File, Nurb->S_Knots, Nurb->S_KnotRes * sizeof(float))) {return false;}
+         if (!Put(File, Nurb->T_Knots, Nurb->T_KnotRes * sizeof(float))) {return false;}
+         if ((Nurb->Points    != NULL) && !Put(File, Nurb->Points,    Nurb->TotalCount * sizeof(PointRec)))    {return false;}
+         if ((Nurb->Weights   != NULL) && !Put(File, Nurb->Weights,   Nurb->TotalCount * sizeof(float)))       {return false;}
+         if ((Nurb->Colors    != NULL) && !Put(File, Nurb->Colors,    Nurb->TotalCount * sizeof(ColorRec)))    {return false;}
+         if ((Nurb->TexPoints != NULL) && !Put(File, Nurb->TexPoints, Nurb->TotalCount * sizeof(TexPointRec))) {return false;}
+         }
+
+      //-- The levels of detail --
+      if ((Entity->LOD != NULL) && !WriteEntity(File, Entity->LOD)) {return false;}
+
+      //-- The sub-Entities, from the tail, so that inserting them in the
+      //   file order restores the list order --
+      for (EntityNode = Tail; EntityNode != NULL; EntityNode = EntityNode->Prev)
+         {
+         if (!WriteEntity(File, (EntityRec*)EntityNode->Data)) {return false;}
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads an Entity written by WriteEntity( ). Returns false on fail, and
+      Entity is set to NULL.
+     -------------------------------------------------------------------------*/
+   bool ReadEntity(FileViewClass &View, EntityRec* &Entity, dword Depth)
+      {
+      //Local variables
+      SceneEntityRec Rec;
+      byte*          Ptr;
+      byte*          Vertices;
+      byte*          Polygons;
+      byte*          Indices;
+      byte*          Materials;
+      byte*          Colds;
+      dword          I;
+
+      Entity = NULL;
+      if (Depth > SCENE_MAX_DEPTH) {goto _ExitError;}
+
+      Ptr = Get(View, 1, sizeof(Rec));
+      if (Ptr == NULL) {goto _ExitError;}
+      Rec = *(SceneEntityRec*)Ptr;
+
+      //-- The mesh --
+      Vertices  = Get(View, Rec.VertexCount + (((Rec.Attrib & SCENE_ENTITY_BV) != 0) ? ENTITY_BV_COUNT : 0), sizeof(VertexRec));
+      Polygons  = Get(View, Rec.PolygonCount, sizeof(PolygonRec));
+      Indices   = Get(View, Rec.PolygonCount, POLY_PT_COUNT * sizeof(dword));
+      Materials = Get(View, Rec.MaterialCount, sizeof(MaterialRec));
+      Colds     = Get(View, Rec.PolygonCount, sizeof(PolyColdRec));
+      if ((Vertices == NULL) || (Polygons == NULL) || (Indices == NULL) || (Materials == NULL) || (Colds == NULL)) {goto _ExitError;}
+
+      Entity = new EntityRec;
+      if (Entity == NULL) {goto _ExitError;}
+
+      if (!Entity->SetMesh((VertexRec*)Vertices, Rec.VertexCount, (Rec.Attrib & SCENE_ENTITY_BV) != 0, (PolygonRec*)Polygons,
+                           (PolyColdRec*)Colds, (dword*)Indices, Rec.PolygonCount, (MaterialRec*)Materials, Rec.MaterialCount)) {goto _ExitError;}
+
+      //The textures aren't stored
+      for (I = 0; I < Entity->PolygonCount; I++)
+         {
+         Entity->PolygonArray[I].Cold->Texture   = NULL;
+         Entity->PolygonArray[I].Cold->ShadowMap = NULL;
+         }
+
+      Entity->Flags      = Rec.Flags | (Entity->Flags & ENTITY_SHADE);
+      Entity->Centroid   = Rec.Centroid;
+      Entity->ScaleConst = Rec.ScaleConst;
+      Entity->Velocity   = Rec.Velocity;
+      Entity->Rotation   = Rec.Rotation;
+
+      //-- The Nurb surface. The tessellation is already in the mesh, so it's
+      //   only rebuilt if it was out of date. --
+      if ((Rec.Attrib & SCENE_ENTITY_NURB) != 0)
+         {
+         SceneNurbRec Surface;
+         NurbRec*     Nurb;
+
+         Ptr = Get(View, 1, sizeof(Surface));
+         if (Ptr == NULL) {goto _ExitError;}
+         memcpy(&Surface, Ptr, sizeof(Surface));
+         if ((Surface.S_Res > 0xFFFF) || (Surface.T_Res > 0xFFFF)) {goto _ExitError;}
+
+         //The Entity owns the Nurb from here on
+         Nurb = Entity->Nurb = new NurbRec(Surface.S_Res, Surface.T_Res, Surface.Flags);
+         if ((Nurb == NULL) || ((Nurb->Flags & NURB_VALID) == NURB_NULL)) {goto _ExitError;}
+         if ((Nurb->S_Res != Surface.S_Res) || (Nurb->T_Res != Surface.T_Res)) {goto _ExitError;}
+         if (((Nurb->S_Order != Surface.S_Order) || (Nurb->T_Order != Surface.T_Order)) && !Nurb->SetOrder(Surface.S_Order, Surface.T_Order)) {goto _ExitError;}
+         if ((Nurb->S_Order != Surface.S_Order) || (Nurb->T_Order != Surface.T_Order)) {goto _ExitError;}
+
+         if ((Ptr = Get(View, Nurb->S_KnotRes, sizeof(float))) == NULL) {goto _ExitError;}
+         memcpy(Nurb->S_Knots, Ptr, Nurb->S_KnotRes * sizeof(float));
+         if ((Ptr = Get(View, Nurb->T_KnotRes, sizeof(float))) == NULL) {goto _ExitError;}
+         memcpy(Nurb->T_Knots, Ptr, Nurb->T_KnotRes * sizeof(float));
+
+         if (Nurb->Points != NULL)
+            {
+            if ((Ptr = Get(View, Nurb->TotalCount, sizeof(PointRec))) == NULL) {goto _ExitError;}
+            for (I = 0; I < Nurb->TotalCount; I++) {Nurb->Points[I] = ((PointRec*)Ptr)[I];}
+            }
+         if (Nurb->Weights != NULL)
+            {
+            if ((Ptr = Get(View, Nurb->TotalCount, sizeof(float))) == NULL) {goto _ExitError;}
+            memcpy(Nurb->Weights, Ptr, Nurb->TotalCount * sizeof(float));
+            }
+         if (Nurb->Colors != NULL)
+            {
+            if ((Ptr = Get(View, Nurb->TotalCount, sizeof(ColorRec))) == NULL) {goto _ExitError;}
+            for (I = 0; I < Nurb->TotalCount; I++) {Nurb->Colors[I] = ((ColorRec*)Ptr)[I];}
+            }
+         if (Nurb->TexPoints != NULL)
+            {
+            if ((Ptr = Get(View, Nurb->TotalCount, sizeof(TexPointRec))) == NULL) {goto _ExitError;}
+            for (I = 0; I < Nurb->TotalCount; I++) {Nurb->TexPoints[I] = ((TexPointRec*)Ptr)[I];}
+            }
+
+         Nurb->KnotsModified();
+         Entity->NurbTolerance = Rec.NurbTolerance;
+         Entity->NurbStamp     = ((Rec.Attrib & SCENE_ENTITY_TESS) != 0) ? Nurb->Stamp : 0;
+         }
+
+      //-- The levels of detail --
+      if (((Rec.Attrib & SCENE_ENTITY_LOD) != 0) && !ReadEntity(View, Entity->LOD, Depth + 1)) {goto _ExitError;}
+
+      //-- The sub-Entities --
+      for (I = 0; I < Rec.SubCount; I++)
+         {
+         EntityRec* SubEntity;
+         if (!ReadEntity(View, SubEntity, Depth + 1)) {goto _ExitError;}
+         if (!LinkedList.Insert(Entity->EntityList, SubEntity)) {delete SubEntity; goto _ExitError;}
+         }
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      if (Entity != NULL) {delete Entity; Entity = NULL;}
+      return false;
+      }
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Constructor --------------------------------------------------------*/
+   SceneCacheClass(void)
+      {
+      Sources     = NULL;
+      SourceCount = 0;
+      SourceSize  = 0;
+      SourceError = false;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~SceneCacheClass(void)
+      {
+      ClearSources();
+      if (Sources != NULL) {delete[] Sources; Sources = NULL;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the 32 bit FNV-1a hash of Size bytes at Data. To hash data in
+      several blocks, pass the result of the previous block as Value.
+     -------------------------------------------------------------------------*/
+   static dword Hash(byte* Data, dword Size, dword Value = SCENE_HASH_BASIS)
+      {
+      for (dword I = 0; I < Size; I++) {Value = (Value ^ Data[I]) * 0x01000193;}
+      return Value;
+      }
+
+   /*-------------------------------------------------------------------------
+      Records a file that was imported by the script, so the cache is
+      invalidated if the file changes. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool AddSource(char* FileName)
+      {
+      if (FileName == NULL) {SourceError = true; return false;}
+
+      if (SourceCount >= SourceSize)
+         {
+         dword  NewSize    = (SourceSize > 0) ? (SourceSize << 1) : SCENE_MIN_SOURCES;
+         char** NewSources = new char*[NewSize];
+         if (NewSources == NULL) {printf("SceneCacheClass::AddSource( ): Memory allocation failed.\n"); SourceError = true; return false;}
+
+         if (SourceCount > 0) {memcpy(NewSources, Sources, SourceCount * sizeof(char*));}
+         if (Sources != NULL) {delete[] Sources;}
+         Sources    = NewSources;
+         SourceSize = NewSize;
+         }
+
+      Sources[SourceCount] = NULL;
+      if (!str_replace(Sources[SourceCount], FileName)) {printf("SceneCacheClass::AddSource( ): Memory allocation failed.\n"); SourceError = true; return false;}
+      SourceCount++;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Releases the recorded source files (the storage is kept).
+     -------------------------------------------------------------------------*/
+   void ClearSources(void)
+      {
+      for (dword I = 0; I < SourceCount; I++) {if (Sources[I] != NULL) {delete[] Sources[I];}}
+      SourceCount = 0;
+      SourceError = false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads the cached scene. The World must be empty. Returns false,
+      without modifying the Config or the World, if there's no cache, or if
+      the script or any of the imported files changed since it was saved.
+
+      ScriptHash : Hash( ) of the script contents.
+      ScriptSize : Size of the script contents.
+     -------------------------------------------------------------------------*/
+   bool Read(char* FileName, dword ScriptHash, dword ScriptSize, ConfigRec* Config, WorldRec* World)
+      {
+      if ((FileName == NULL) || (Config == NULL) || (World == NULL)) {return false;}
+
+      //Local data
+      FileViewClass  View;
+      SceneHeaderRec Header;
+      ConfigVideo    Video;
+      ConfigRender   Render;
+      ConfigWorld    WorldCfg;
+      ListRec*       Entities = NULL;
+      ListRec*       Lights   = NULL;
+      char*          ProfEqu  = NULL;
+      byte*          Ptr;
+      dword          I;
+
+
+      //-- A missing or stale cache is not an error --
+      if (!View.Open(FileName)) {return false;}
+
+      Ptr = Get(View, 1, sizeof(Header));
+      if (Ptr == NULL) {goto _ExitStale;}
+      memcpy(&Header, Ptr, sizeof(Header));
+
+      if ((memcmp(Header.ID, SCENE_CACHE_ID, sizeof(SCENE_CACHE_ID)) != 0) || (Header.Version != SCENE_VERSION) || (Header.Layout != Layout())) {goto _ExitStale;}
+      if ((Header.ScriptHash != ScriptHash) || (Header.ScriptSize != ScriptSize)) {goto _ExitStale;}
+
+      //-- The config --
+      if ((Ptr = Get(View, 1, sizeof(Video)))    == NULL) {goto _ExitError;}
+      Video = *(ConfigVideo*)Ptr;
+      if ((Ptr = Get(View, 1, sizeof(Render)))   == NULL) {goto _ExitError;}
+      Render = *(ConfigRender*)Ptr;
+      if ((Ptr = Get(View, 1, sizeof(WorldCfg))) == NULL) {goto _ExitError;}
+      WorldCfg = *(ConfigWorld*)Ptr;
+
+      if (Header.ProfEquLength > 0)
+         {
+         if ((ProfEqu = (char*)Get(View, Header.ProfEquLength, 1)) == NULL) {goto _ExitError;}
+         if (ProfEqu[Header.ProfEquLength-1] != 0) {goto _ExitError;}
+         }
+
+      //-- The imported files must be unchanged --
+      for (I = 0; I < Header.SourceCount; I++)
+         {
+         SceneSourceRec Source;
+         char*          Name;
+         dword          Size, Time;
+
+         if ((Ptr = Get(View, 1, sizeof(Source))) == NULL) {goto _ExitError;}
+         memcpy(&Source, Ptr, sizeof(Source));
+         if ((Source.NameLength == 0) || ((Name = (char*)Get(View, Source.NameLength, 1)) == NULL)) {goto _ExitError;}
+         if (Name[Source.NameLength-1] != 0) {goto _ExitError;}
+
+         if (!FileStamp(Name, Size, Time) || (Size != Source.Size) || (Time != Source.Time)) {goto _ExitStale;}
+         }
+
+
+      //-- The Entities and Lights are built aside, and they're only moved
+      //   to the World if the whole file is valid. They're stored in the
+      //   list order, so the local lists are reversed. --
+      for (I = 0; I < Header.EntityCount; I++)
+         {
+         EntityRec* Entity;
+         if (!ReadEntity(View, Entity, 0)) {goto _ExitError;}
+         if (!LinkedList.Insert(Entities, Entity)) {delete Entity; goto _ExitError;}
+         }
+
+      if ((Ptr = Get(View, Header.LightCount, sizeof(LightRec))) == NULL) {goto _ExitError;}
+      for (I = 0; I < Header.LightCount; I++)
+         {
+         LightRec* Light = new LightRec;
+         if (Light == NULL) {goto _ExitError;}
+         *Light = ((LightRec*)Ptr)[I];
+         if (!LinkedList.Insert(Lights, Light)) {delete Light; goto _ExitError;}
+         }
+
+
+      //-- Apply the config. The profile equation is re-allocated. --
+      Render.ProfEqu = Config->Render.ProfEqu;
+      Config->Video  = Video;
+      Config->Render = Render;
+      Config->World  = WorldCfg;
+
+      if (ProfEqu != NULL) {str_replace(Config->Render.ProfEqu, ProfEqu);}
+      else if (Config->Render.ProfEqu != NULL) {delete[] Config->Render.ProfEqu; Config->Render.ProfEqu = NULL;}
+
+      //-- Move the Lights and Entities to the World (this reverses the
+      //   lists again). The Lights go first, as inserting a Light marks 
+      //   all the Entities of the World for shading. --
+      while (Lights != NULL)
+         {
+         LightRec* Light = (LightRec*)LinkedList.Retrieve(Lights);
+         if (!World->Insert(Light)) {delete Light; World->Nuke(); goto _ExitError;}
+         }
+
+      while (Entities != NULL)
+         {
+         EntityRec* Entity = (EntityRec*)LinkedList.Retrieve(Entities);
+         if (!World->Insert(Entity)) {delete Entity; World->Nuke(); goto _ExitError;}
+         }
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("SceneCacheClass::Read( ): Scene cache \"%s\" is invalid, it will be rebuilt.\n", FileName);
+
+      _ExitStale:
+      while (Entities != NULL) {delete (EntityRec*)LinkedList.Retrieve(Entities);}
+      while (Lights   != NULL) {delete (LightRec*)LinkedList.Retrieve(Lights);}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Saves the scene, along with the source files recorded by AddSource( ).
+      Nothing is saved if a source file couldn't be recorded. Returns true
+      on success. Note that the Entities of the World are rebased in place
+      (see EntityRec::Rebase( )), so on return their world space geometry
+      is also their rest pose.
+
+      ScriptHash : Hash( ) of the script contents.
+      ScriptSize : Size of the script contents.
+     -------------------------------------------------------------------------*/
+   bool Save(char* FileName, dword ScriptHash, dword ScriptSize, ConfigRec* Config, WorldRec* World)
+      {
+      if ((FileName == NULL) || (Config == NULL) || (World == NULL) || SourceError) {return false;}
+
+      //Local data
+      FILE*          File = NULL;
+      SceneHeaderRec Header;
+      ListRec*       Node;
+      dword          I;
+
+      memset(&Header, 0, sizeof(Header));
+      memcpy(Header.ID, SCENE_CACHE_ID, sizeof(SCENE_CACHE_ID));
+      Header.Version       = SCENE_VERSION;
+      Header.Layout        = Layout();
+      Header.ScriptHash    = ScriptHash;
+      Header.ScriptSize    = ScriptSize;
+      Header.SourceCount   = SourceCount;
+      Header.ProfEquLength = (Config->Render.ProfEqu != NULL) ? strlen(Config->Render.ProfEqu) + 1 : 0;
+
+      for (Node = World->EntityList; Node != NULL; Node = Node->Next)
+         {
+         if (!((EntityRec*)Node->Data)->Rebase()) {printf("SceneCacheClass::Save( ): EntityRec::Rebase( ) failed.\n"); return false;}
+         Header.EntityCount++;
+         }
+      for (Node = World->LightList; Node != NULL; Node = Node->Next) {Header.LightCount++;}
+
+
+      //-- Write the file --
+      File = fopen(FileName, "wb");
+      if (File == NULL) {printf("SceneCacheClass::Save( ): Unable to create \"%s\".\n", FileName); return false;}
+
+      if (!Put(File, &Header, sizeof(Header))) {goto _ExitError;}
+      if (!Put(File, &Config->Video,  sizeof(ConfigVideo)))  {goto _ExitError;}
+      if (!Put(File, &Config->Render, sizeof(ConfigRender))) {goto _ExitError;}
+      if (!Put(File, &Config->World,  sizeof(ConfigWorld)))  {goto _ExitError;}
+      if (!Put(File, Config->Render.ProfEqu, Header.ProfEquLength)) {goto _ExitError;}
+
+      for (I = 0; I < SourceCount; I++)
+         {
+         SceneSourceRec Source;
+         memset(&Source, 0, sizeof(Source));
+         Source.NameLength = strlen(Sources[I]) + 1;
+
+         if (!FileStamp(Sources[I], Source.Size, Source.Time)) {printf("SceneCacheClass::Save( ): Source file \"%s\" not found.\n", Sources[I]); goto _ExitError;}
+         if (!Put(File, &Source, sizeof(Source)) || !Put(File, Sources[I], Source.NameLength)) {goto _ExitError;}
+         }
+
+      //The World lists are stored in the list order (see Read( ))
+      for (Node = World->EntityList; Node != NULL; Node = Node->Next)
+         {
+         if (!WriteEntity(File, (EntityRec*)Node->Data)) {goto _ExitError;}
+         }
+
+      for (Node = World->LightList; Node != NULL; Node = Node->Next)
+         {
+         if (fwrite(Node->Data, sizeof(LightRec), 1, File) != 1) {goto _ExitError;}
+         }
+      if (!PutPadding(File, Header.LightCount * sizeof(LightRec))) {goto _ExitError;}
+
+      if (fclose(File) != 0) {File = NULL; goto _ExitError;}
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("SceneCacheClass::Save( ): Failed to save \"%s\".\n", FileName);
+      if (File != NULL) {fclose(File);}
+      remove(FileName);
+      return false;
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*----------------------------------------------------------------------------
+  Global Declarations.
+  ----------------------------------------------------------------------------*/
+SceneCacheClass SceneCache;
+
+
+/*==== End of file ===========================================================*/
+#endif
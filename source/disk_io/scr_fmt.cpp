@@ -20,77 +20,161 @@
 #include "../_common/std_str.cpp"
 #include "../_common/list.cpp"
 #include "../math/primitive.cpp"
+#include "../math/profcurve.cpp"
 #include "../mem_data/cfg_data.cpp"
 #include "../mem_data/entity.cpp"
 #include "../mem_data/world.cpp"
 #include "../disk_io/cob_fmt.cpp"
+#include "../disk_io/scn_cache.cpp"
+#include "../disk_io/scr_token.cpp"
+#include "../system/jobs.cpp"
 
 
 /*---------------------------------------------------------------------------
-
-  ---------------------------------------------------------------------------*/
-#define SCR_SIZE_LIMIT  0x00100000           //1 MB limit
-
-
-/*---------------------------------------------------------------------------
-
+   Keyword IDs. The names are listed in SCR_Keywords[ ].
   ---------------------------------------------------------------------------*/
 //-- Video related keywords --
-#define SCR_VIDEO         "VIDEO"
-#define SCR_FULLSCREEN    "FULLSCREEN"
-#define SCR_RES           "RES"
-#define SCR_BITSPERPIXEL  "BITSPERPIXEL"
-#define SCR_REFRESH       "REFRESH"
+#define SCR_VIDEO             1
+#define SCR_FULLSCREEN        2
+#define SCR_RES               3
+#define SCR_BITSPERPIXEL      4
+#define SCR_REFRESH           5
 
 //-- Render related keywords --
-#define SCR_RENDER        "RENDER"
-#define SCR_CAMAPETURE    "CAMAPETURE"
-#define SCR_PROFEQU       "PROFEQU"
-#define SCR_PROFEQULIMX   "PROFEQULIMX"
-#define SCR_NULL          "NULL"
-#define SCR_CLEARFLAG     "CLEARFLAG"
-#define SCR_SHADOWFLAG    "SHADOWFLAG"
-#define SCR_REFRACTFLAG   "REFRACTFLAG"
-#define SCR_REFLECTFLAG   "REFLECTFLAG"
-#define SCR_HOTSPOTFLAG   "HOTSPOTFLAG"
-#define SCR_ANTIALIASFLAG "ANTIALIASFLAG"
-#define SCR_BACKGNDCOLOR  "BACKGNDCOLOR"
-#define SCR_MAXRAYDEPTH   "MAXRAYDEPTH"
-#define SCR_MAX_LOD       "MAX_LOD"
-#define SCR_SUBDIVTRESH   "SUBDIVTRESH"
-#define SCR_TABRES        "TABRES"
-#define SCR_CURRENTDEVICE "CURRENTDEVICE"
-#define SCR_AA_TRESHOLD   "AA_TRESHOLD"
-#define SCR_AA_SAMPLES    "AA_SAMPLES"
-#define SCR_AA_JITTER     "AA_JITTER"
-#define SCR_ADAPTDEPTHTRESH "ADAPTDEPTHTRESH"
-#define SCR_PCOMPFLAG     "PCOMPFLAG"
-#define SCR_POFFSET       "POFFSET"
+#define SCR_RENDER            6
+#define SCR_CAMAPETURE        7
+#define SCR_PROFEQU           8
+#define SCR_PROFEQULIMX       9
+#define SCR_NULL              10
+#define SCR_CLEARFLAG         11
+#define SCR_SHADOWFLAG        12
+#define SCR_REFRACTFLAG       13
+#define SCR_REFLECTFLAG       14
+#define SCR_HOTSPOTFLAG       15
+#define SCR_ANTIALIASFLAG     16
+#define SCR_BACKGNDCOLOR      17
+#define SCR_MAXRAYDEPTH       18
+#define SCR_MAX_LOD           19
+#define SCR_SUBDIVTRESH       20
+#define SCR_TABRES            21
+#define SCR_CURRENTDEVICE     22
+#define SCR_AA_TRESHOLD       23
+#define SCR_AA_SAMPLES        24
+#define SCR_AA_JITTER         25
+#define SCR_ADAPTDEPTHTRESH   26
+#define SCR_PCOMPFLAG         27
+#define SCR_POFFSET           28
+#define SCR_LOD_PIXELS        29
+#define SCR_NURB_PIXELS       30
+
 //-- World related keywords --
-#define SCR_WORLD         "WORLD"
-#define SCR_VORIGIN       "VORIGIN"
-#define SCR_VVELOCITY     "VVELOCITY"
-#define SCR_VROTATION     "VROTATION"
-#define SCR_VORIENTATION  "VORIENTATION"
+#define SCR_WORLD             31
+#define SCR_VORIGIN           32
+#define SCR_VVELOCITY         33
+#define SCR_VROTATION         34
+#define SCR_VORIENTATION      35
+#define SCR_WELDEPSILON       36
+#define SCR_LOD_LEVELS        37
+#define SCR_LOD_RATIO         38
 
 //-- Entity related keywords --
-#define SCR_ENTITY        "ENTITY"
-#define SCR_PLANE         "PLANE"
-#define SCR_CUBE          "CUBE"
+#define SCR_ENTITY            39
+#define SCR_PLANE             40
+#define SCR_CUBE              41
+#define SCR_NURB              42
+#define SCR_ORDER             43
+#define SCR_CTRLPTS           44
 
 //-- Light related keywords --
-#define SCR_LIGHT         "LIGHT"
-#define SCR_AMBCOLOR      "AMBCOLOR"
+#define SCR_LIGHT             45
+#define SCR_AMBCOLOR          46
 
 //-- Other common keywords --
-#define SCR_CLASS         "CLASS"
-#define SCR_GRIDRES       "GRIDRES"
-#define SCR_COLOR         "COLOR"
-#define SCR_COORD         "COORD"
-#define SCR_ORIENTATION   "ORIENTATION"
-#define SCR_SCALECONST    "SCALECONST"
-#define SCR_VELOCITY      "VELOCITY"
-#define SCR_ROTATION      "ROTATION"
+#define SCR_CLASS             47
+#define SCR_GRIDRES           48
+#define SCR_COLOR             49
+#define SCR_COORD             50
+#define SCR_ORIENTATION       51
+#define SCR_SCALECONST        52
+#define SCR_VELOCITY          53
+#define SCR_ROTATION          54
+
+#define SCR_MIN_ASSET_SLOTS   64                //Initial size of the Asset hash table
+
+
+/*---------------------------------------------------------------------------
+   Keyword names. The keywords are not case sensitive.
+  ---------------------------------------------------------------------------*/
+SCR_KeyRec SCR_Keywords[] = 
+   {
+   //-- Video related keywords --
+   {"VIDEO",           SCR_VIDEO},
+   {"FULLSCREEN",      SCR_FULLSCREEN},
+   {"RES",             SCR_RES},
+   {"BITSPERPIXEL",    SCR_BITSPERPIXEL},
+   {"REFRESH",         SCR_REFRESH},
+
+   //-- Render related keywords --
+   {"RENDER",          SCR_RENDER},
+   {"CAMAPETURE",      SCR_CAMAPETURE},
+   {"PROFEQU",         SCR_PROFEQU},
+   {"PROFEQULIMX",     SCR_PROFEQULIMX},
+   {"NULL",            SCR_NULL},
+   {"CLEARFLAG",       SCR_CLEARFLAG},
+   {"SHADOWFLAG",      SCR_SHADOWFLAG},
+   {"REFRACTFLAG",     SCR_REFRACTFLAG},
+   {"REFLECTFLAG",     SCR_REFLECTFLAG},
+   {"HOTSPOTFLAG",     SCR_HOTSPOTFLAG},
+   {"ANTIALIASFLAG",   SCR_ANTIALIASFLAG},
+   {"BACKGNDCOLOR",    SCR_BACKGNDCOLOR},
+   {"MAXRAYDEPTH",     SCR_MAXRAYDEPTH},
+   {"MAX_LOD",         SCR_MAX_LOD},
+   {"SUBDIVTRESH",     SCR_SUBDIVTRESH},
+   {"TABRES",          SCR_TABRES},
+   {"CURRENTDEVICE",   SCR_CURRENTDEVICE},
+   {"AA_TRESHOLD",     SCR_AA_TRESHOLD},
+   {"AA_SAMPLES",      SCR_AA_SAMPLES},
+   {"AA_JITTER",       SCR_AA_JITTER},
+   {"ADAPTDEPTHTRESH", SCR_ADAPTDEPTHTRESH},
+   {"PCOMPFLAG",       SCR_PCOMPFLAG},
+   {"POFFSET",         SCR_POFFSET},
+   {"LOD_PIXELS",      SCR_LOD_PIXELS},
+   {"NURB_PIXELS",     SCR_NURB_PIXELS},
+
+   //-- World related keywords --
+   {"WORLD",           SCR_WORLD},
+   {"VORIGIN",         SCR_VORIGIN},
+   {"VVELOCITY",       SCR_VVELOCITY},
+   {"VROTATION",       SCR_VROTATION},
+   {"VORIENTATION",    SCR_VORIENTATION},
+   {"WELDEPSILON",     SCR_WELDEPSILON},
+   {"LOD_LEVELS",      SCR_LOD_LEVELS},
+   {"LOD_RATIO",       SCR_LOD_RATIO},
+
+   //-- Entity related keywords --
+   {"ENTITY",          SCR_ENTITY},
+   {"PLANE",           SCR_PLANE},
+   {"CUBE",            SCR_CUBE},
+   {"NURB",            SCR_NURB},
+   {"ORDER",           SCR_ORDER},
+   {"CTRLPTS",         SCR_CTRLPTS},
+
+   //-- Light related keywords --
+   {"LIGHT",           SCR_LIGHT},
+   {"AMBCOLOR",        SCR_AMBCOLOR},
+
+   //-- Other common keywords --
+   {"CLASS",           SCR_CLASS},
+   {"GRIDRES",         SCR_GRIDRES},
+   {"COLOR",           SCR_COLOR},
+   {"COORD",           SCR_COORD},
+   {"ORIENTATION",     SCR_ORIENTATION},
+   {"SCALECONST",      SCR_SCALECONST},
+   {"VELOCITY",        SCR_VELOCITY},
+   {"ROTATION",        SCR_ROTATION}
+   };
+
+#define SCR_KEYWORD_COUNT  (sizeof(SCR_Keywords) / sizeof(SCR_KeyRec))
 
 
 
@@ -101,380 +185,463 @@ class SCR_Class
    {
    /*==== Private Declarations ===============================================*/
    private:
-   
+
+   /*---- Private Data -------------------------------------------------------*/
+
+   //An object file referenced by the script. The files are loaded after 
+   // the script is parsed, in parallel (see LoadAssets( )).
+   struct AssetRec
+      {
+      char*      FileName;                      //Object file name
+      float      WeldEpsilon;                   //World config at the time of the reference
+      dword      LOD_Levels;
+      float      LOD_Ratio;
+      dword      Users;                         //Number of Entities using the file
+      EntityRec* Entity;                        //The loaded Entity (NULL on fail)
+      dword      Hash;                          //Hash of the FileName
+      AssetRec*  Next;                          //Next Asset in the same AssetTable slot
+      };
+
+   //An Entity waiting to be inserted into the World. Entities made from 
+   // an object file are transformed once the file is loaded.
+   struct PendingRec
+      {
+      EntityRec* Entity;                        //The finished Entity, or NULL if it uses an Asset
+      AssetRec*  Asset;
+      PointRec   Coord;
+      PointRec   Orientation;
+      PointRec   ScaleConst;
+      PointRec   Velocity;
+      PointRec   Rotation;
+      };
+
+   SCR_TokenClass Token;                        //Script tokenizer
+   ListRec*   AssetList;                        //Object files referenced by the script
+   AssetRec** AssetTable;                       //Hash table of the Assets, by FileName
+   dword      AssetSlots;                       //Size of the AssetTable, a power of 2
+   dword      AssetCount;                       //Number of Assets
+   ListRec*   PendingList;                      //Entities in reverse script order
+
    /*-------------------------------------------------------------------------
-      Skips the comment field, including the newline characters, and returns 
-      the string pointer after the new line. Returns NULL on fail.
+      Doubles the size of the AssetTable, and redistributes the Assets.
+      Returns false on fail.
      -------------------------------------------------------------------------*/
-   inline char* SkipComments(char* StrPtr)
+   bool GrowAssetTable(void)
       {
-      if (StrPtr == NULL) {return NULL;}
+      dword      NewSlots = (AssetSlots > 0) ? (AssetSlots << 1) : SCR_MIN_ASSET_SLOTS;
+      AssetRec** NewTable = new AssetRec*[NewSlots];
+      if (NewTable == NULL) {return false;}
+      memset(NewTable, 0, NewSlots * sizeof(AssetRec*));
 
-      //Search for newline and skip past new line
-      if      ((StrPtr[0] == '/') && (StrPtr[1] == '/')) {return str_skip(StrPtr, "\n", false) + 1;}
-      else if ((StrPtr[0] == '/') && (StrPtr[1] == '*')) 
+      for (ListRec* AssetNode = AssetList; AssetNode != NULL; AssetNode = AssetNode->Next)
          {
-         StrPtr += 2;
-         while ((StrPtr[0] != '*') || (StrPtr[1] != '/')) 
-            {if (StrPtr[0] == 0) {return StrPtr;} StrPtr++;}
-         
-         return StrPtr + 2;
+         AssetRec* Asset = (AssetRec*)AssetNode->Data;
+         Asset->Next = NewTable[Asset->Hash & (NewSlots - 1)];
+         NewTable[Asset->Hash & (NewSlots - 1)] = Asset;
          }
-      
-      return StrPtr;
+
+      if (AssetTable != NULL) {delete[] AssetTable;}
+      AssetTable = NewTable;
+      AssetSlots = NewSlots;
+      return true;
       }
 
    /*-------------------------------------------------------------------------
-      Returns the pointer of the next symbol in the text that is not a space, 
-      tab, newline, or part of a comment field.
+      Returns the Asset for an object file, which is shared by all the 
+      Entities that load the same file with the same World config. The
+      Assets are hashed by the file name, so large scenes don't search
+      through all of them. Returns NULL on fail.
      -------------------------------------------------------------------------*/
-   inline char* FindSymbol(char* StrPtr)
+   AssetRec* FindAsset(char* FileName, ConfigRec* Config)
       {
-      if (StrPtr == NULL) {return NULL;}
+      AssetRec* Asset;
+      dword     Hash = SCR_TokenClass::HashStr(FileName);
 
-      char* LastStrPtr = NULL;
-      while (StrPtr != LastStrPtr)
+      if (AssetSlots > 0)
          {
-         LastStrPtr = StrPtr;
-         StrPtr     = str_skip(StrPtr, " \t\n", true);
-         StrPtr     = SkipComments(StrPtr);
+         for (Asset = AssetTable[Hash & (AssetSlots - 1)]; Asset != NULL; Asset = Asset->Next)
+            {
+            if ((Asset->Hash == Hash) && (stricmp(Asset->FileName, FileName) == 0) && (Asset->WeldEpsilon == Config->World.WeldEpsilon) &&
+                (Asset->LOD_Levels == Config->World.LOD_Levels) && (Asset->LOD_Ratio == Config->World.LOD_Ratio)) {return Asset;}
+            }
          }
-      if (StrPtr == NULL) {printf("SCR_Class::FindSymbol( ): StrPtr == NULL.\n"); return NULL;}
-      
-      return StrPtr;
-      }
 
-   /*-------------------------------------------------------------------------
-      Converts a float symbol to a float numerical value. Returns the pointer
-      immediately after the numerical value. Returns NULL on fail.
-     -------------------------------------------------------------------------*/
-   inline char* ReadFloat(char* StrPtr, float &Data)
-      {
-      if (StrPtr == NULL) {return NULL;}
+      //Keep the chains short
+      if ((AssetCount >= AssetSlots) && !GrowAssetTable()) {return NULL;}
 
-      StrPtr = FindSymbol(StrPtr);
-      if (StrPtr == NULL) {printf("SCR_Class::ReadFloat( ): StrPtr == NULL.\n"); return NULL;}
+      AssetRec* NewAsset = new AssetRec;
+      if (NewAsset == NULL) {return NULL;}
+
+      NewAsset->FileName    = NULL;
+      NewAsset->WeldEpsilon = Config->World.WeldEpsilon;
+      NewAsset->LOD_Levels  = Config->World.LOD_Levels;
+      NewAsset->LOD_Ratio   = Config->World.LOD_Ratio;
+      NewAsset->Users       = 0;
+      NewAsset->Entity      = NULL;
+      NewAsset->Hash        = Hash;
+
+      if (!str_replace(NewAsset->FileName, FileName) || !LinkedList.Insert(AssetList, NewAsset))
+         {
+         if (NewAsset->FileName != NULL) {delete[] NewAsset->FileName;}
+         delete NewAsset;
+         return NULL;
+         }
 
-      //Do conversion
-      Data = atof(StrPtr);
-      StrPtr = str_skip(StrPtr, "-+.0123456789eEdD", true);
+      NewAsset->Next = AssetTable[Hash & (AssetSlots - 1)];
+      AssetTable[Hash & (AssetSlots - 1)] = NewAsset;
+      AssetCount++;
 
-      return StrPtr;
+      return NewAsset;
       }
 
    /*-------------------------------------------------------------------------
-      Converts a integer symbol to a integer numerical value. Returns the 
-      pointer immediately after the numerical value. Returns NULL on fail.
+      Job function for LoadAssets( ). Loads the object file of an Asset, 
+      and builds the levels of detail. Data is the AssetRec. Each job has 
+      it's own COB reader, as the reader keeps the state of the file.
      -------------------------------------------------------------------------*/
-   inline char* ReadInt(char* StrPtr, int &Data)
+   static void LoadAssetJob(void* Data, dword, dword)
       {
-      if (StrPtr == NULL) {return NULL;}
+      AssetRec*  Asset = (AssetRec*)Data;
+      COB_Class  Reader;
+      EntityRec* Entity = NULL;
 
-      StrPtr = FindSymbol(StrPtr);
-      if (StrPtr == NULL) {printf("SCR_Class::ReadInt( ): StrPtr == NULL.\n"); return NULL;}
+      if (!Reader.Read(Asset->FileName, Entity, Asset->WeldEpsilon))
+         {printf("SCR_Class::LoadAssetJob( ): COB.Read( ) failed on \"%s\".\n", Asset->FileName); return;}
 
-      //Do conversion
-      Data = atoi(StrPtr);
-      StrPtr = str_skip(StrPtr, "-+0123456789", true);
+      if (!Entity->BuildLOD(Asset->LOD_Levels, Asset->LOD_Ratio))
+         {printf("SCR_Class::LoadAssetJob( ): Entity->BuildLOD( ) failed on \"%s\".\n", Asset->FileName); delete Entity; return;}
 
-      return StrPtr;
+      Asset->Entity = Entity;
       }
 
    /*-------------------------------------------------------------------------
-      Converts a boolean symbol to a boolean value. Returns the pointer 
-      immediately after the numerical value. Returns NULL on fail.
+      Loads all the Assets in parallel with the JobSystem. The files are 
+      independent, and each one is loaded only once. Returns false if any 
+      of them failed.
      -------------------------------------------------------------------------*/
-   inline char* ReadBool(char* StrPtr, bool &Data)
+   bool LoadAssets(void)
       {
-      if (StrPtr == NULL) {return NULL;}
+      ListRec* AssetNode;
+      JobRec*  Jobs = NULL;
+      dword    I;
+
+      if (AssetCount == 0) {return true;}
+
+      Jobs = new JobRec[AssetCount];
+      if (Jobs == NULL) {printf("SCR_Class::LoadAssets( ): Memory allocation failed.\n"); return false;}
+
+      for (I = 0, AssetNode = AssetList; AssetNode != NULL; AssetNode = AssetNode->Next, I++)
+         {
+         Jobs[I].Func  = LoadAssetJob;
+         Jobs[I].Data  = AssetNode->Data;
+         Jobs[I].Begin = 0;
+         Jobs[I].End   = 1;
+         }
 
-      StrPtr = FindSymbol(StrPtr);
-      if (StrPtr == NULL) {printf("SCR_Class::ReadBool( ): StrPtr == NULL.\n"); return NULL;}
+      JobSystem.Run(Jobs, AssetCount);
+      delete[] Jobs;
 
-      //Do conversion
-      if (atoi(StrPtr) != 0) {Data = true;} else {Data = false;}
-      StrPtr = str_skip(StrPtr, "-+0123456789", true);
+      for (AssetNode = AssetList; AssetNode != NULL; AssetNode = AssetNode->Next)
+         {
+         if (((AssetRec*)AssetNode->Data)->Entity == NULL) {return false;}
 
-      return StrPtr;
+         //The scene cache depends on the object file
+         SceneCache.AddSource(((AssetRec*)AssetNode->Data)->FileName);
+         }
+
+      return true;
       }
 
    /*-------------------------------------------------------------------------
-      Reads an embedded string between "". Returns the pointer immediately 
-      after the string value. Returns NULL on fail. The Data will return an 
-      allocated string if AllocStr is set. Otherwise, Data must point to an 
-      existing string of sufficient size.
+      Loads the Assets, and inserts the pending Entities into the World in
+      the script order. The last user of an Asset takes the loaded Entity, 
+      the others get a copy of it. Returns true on success.
      -------------------------------------------------------------------------*/
-   inline char* ReadSubStr(char* StrPtr, char* &Data, bool AllocStr)
+   bool InsertEntities(WorldRec* World)
       {
-      if (StrPtr == NULL) {return NULL;}
-      if (!AllocStr && (Data == NULL)) {return NULL;}
+      ListRec* PendingNode;
+      if (!LoadAssets()) {return false;}
 
-      StrPtr = FindSymbol(StrPtr);
-      if (StrPtr == NULL) {printf("SCR_Class::ReadBool( ): StrPtr == NULL.\n"); return NULL;}
+      //The list is in reverse order
+      for (PendingNode = PendingList; (PendingNode != NULL) && (PendingNode->Next != NULL); PendingNode = PendingNode->Next) {}
 
-      //Find opening "       
-      if (*StrPtr != '"') {printf("SCR_Class::SubStr( ): The symbol \" is expected in front of string constant.\n"); return NULL;}
-      StrPtr++;
+      for (; PendingNode != NULL; PendingNode = PendingNode->Prev)
+         {
+         #define Pending ((PendingRec*)PendingNode->Data)
+         EntityRec* Entity = Pending->Entity;
+         Pending->Entity = NULL;
 
-      //Find the length of the string
-      char* EndPtr = str_skip(StrPtr, "\n\"", false);
-      if (*EndPtr != '"') {printf("SCR_Class::SubStr( ): The symbol \" is expected at the end of string constant.\n"); return NULL;}
-      dword StrLength = EndPtr - StrPtr;
+         if (Entity == NULL)
+            {
+            AssetRec* Asset = Pending->Asset;
+            if (--Asset->Users > 0) {Entity = Asset->Entity->Clone();}
+            else {Entity = Asset->Entity; Asset->Entity = NULL;}
+            if (Entity == NULL) {printf("SCR_Class::InsertEntities( ): EntityRec::Clone( ) failed.\n"); return false;}
+
+            if (!Entity->Scale(&Pending->ScaleConst, &Entity->Centroid) || 
+                !Entity->Translate(&Pending->Coord) ||
+                !Entity->Rotate(&Pending->Orientation, &Entity->Centroid)) {delete Entity; return false;}
+
+            //Set the Entity's velocity and angular velocity
+            Entity->Velocity = Pending->Velocity;
+            Entity->Rotation = Pending->Rotation;
+            }
 
-      //Allocate string if required
-      if (AllocStr)
-         {
-         char* TempPtr = (char*)realloc(Data, StrLength + 1);
-         if (TempPtr == NULL) {return NULL;}
-         Data = TempPtr;
+         //Insert the entity into the world
+         if (!World->Insert(Entity))
+            {
+            printf("SCR_Class::InsertEntities( ): WorldRec::Insert( ) failed.\n"); 
+            delete Entity;
+            return false;
+            }
+         #undef Pending
          }
-      else {*Data = 0;}
-
-      //Copy the data      
-      strncpy(Data, StrPtr, StrLength);
-      Data[StrLength] = 0;
 
-      //Skip over the sub string and the closing "
-      return EndPtr + 1;
+      return true;
       }
 
    /*-------------------------------------------------------------------------
-      Reads a keyword, returns the value returned by fscanf( ). Returns EOF 
-      if end of file was reached or on fail.
+      Releases the pending Entities and the Assets that were not inserted
+      into the World.
      -------------------------------------------------------------------------*/
-   char* ReadKeyword(char* KeyWord, char* StrPtr)
+   void ReleaseEntities(void)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL)) {return NULL;}
+      while (PendingList != NULL)
+         {
+         PendingRec* Pending = (PendingRec*)LinkedList.Retrieve(PendingList);
+         if (Pending->Entity != NULL) {delete Pending->Entity;}
+         delete Pending;
+         }
 
-      StrPtr = FindSymbol(StrPtr);
-      if (StrPtr == NULL) {printf("SCR_Class::ReadKeyword( ): StrPtr == NULL.\n"); return NULL;}
-      
-      //Get the end pointer and the length of the keyword
-      char* EndPtr = str_skip(StrPtr, " \t\n/", false);
-      dword KeyWordLen = EndPtr - StrPtr;
-      //if (KeyWordLen == 0) {printf("SCR_Class::ReadKeyword( ): KeyWordLen == 0.\n"); return NULL;}
+      while (AssetList != NULL)
+         {
+         AssetRec* Asset = (AssetRec*)LinkedList.Retrieve(AssetList);
+         if (Asset->Entity   != NULL) {delete Asset->Entity;}
+         if (Asset->FileName != NULL) {delete[] Asset->FileName;}
+         delete Asset;
+         }
 
-      //Copy the keyword
-      strncpy(KeyWord, StrPtr, KeyWordLen);
-      KeyWord[KeyWordLen] = 0;
+      //The table is kept for the next script
+      if (AssetTable != NULL) {memset(AssetTable, 0, AssetSlots * sizeof(AssetRec*));}
+      AssetCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Read three floats into a point or a color. ReadAngles( ) converts the
+      values from degrees to radians. Return false on fail.
+     -------------------------------------------------------------------------*/
+   inline bool ReadPoint(PointRec &Data) {return Token.Float(Data.X) && Token.Float(Data.Y) && Token.Float(Data.Z);}
+   inline bool ReadColor(ColorRec &Data) {return Token.Float(Data.R) && Token.Float(Data.G) && Token.Float(Data.B);}
 
-      return EndPtr;
+   inline bool ReadAngles(PointRec &Data)
+      {
+      if (!ReadPoint(Data)) {return false;}
+      Data.X = deg2rad(Data.X);
+      Data.Y = deg2rad(Data.Y);
+      Data.Z = deg2rad(Data.Z);
+      return true;
       }
 
    /*-------------------------------------------------------------------------
-      Setup all the Video config data.
+      Setup all the Video config data. The section ends at the first 
+      keyword that doesn't belong to it. Returns false on fail.
      -------------------------------------------------------------------------*/
-   char* SetupVideoCfg(char* KeyWord, char* StrPtr, ConfigRec* Config)
+   bool SetupVideoCfg(ConfigRec* Config)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL) || (Config == NULL)) {return NULL;}
+      if (Config == NULL) {return false;}
 
       //-- Read local keywords --
+      bool Ok       = true;
       bool ExitLoop = false;
-      while (!ExitLoop && (*StrPtr != 0))
+      while (Ok && !ExitLoop)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::SetupVideoCfg( ): StrPtr == NULL.\n"); return NULL;}
-
-         //Read the full screen flag
-         if (stricmp(SCR_FULLSCREEN, KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Video.FullScreen);}
-
-         //Video resolution
-         else if (stricmp(SCR_RES, KeyWord) == 0) 
+         Token.Next();
+         switch (Token.Key)
             {
-            StrPtr = ReadInt(StrPtr, (int &)Config->Video.X_Res);
-            StrPtr = ReadInt(StrPtr, (int &)Config->Video.Y_Res);
-            }
+            //Read the full screen flag
+            case SCR_FULLSCREEN   : Ok = Token.Bool(Config->Video.FullScreen); break;
+
+            //Video resolution
+            case SCR_RES          : Ok = Token.Int((int &)Config->Video.X_Res) && Token.Int((int &)Config->Video.Y_Res); break;
 
-         //Bits per pixel
-         else if (stricmp(SCR_BITSPERPIXEL,  KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Video.BitsPerPixel);}
+            //Bits per pixel
+            case SCR_BITSPERPIXEL : Ok = Token.Int((int &)Config->Video.BitsPerPixel); break;
 
-         //Bits per refresh rate
-         else if (stricmp(SCR_REFRESH,       KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Video.RefreshRate);}
+            //Bits per refresh rate
+            case SCR_REFRESH      : Ok = Token.Int((int &)Config->Video.RefreshRate); break;
 
-         //Handle unknown keywords
-         else if (KeyWord[0] != 0) {StrPtr -= strlen(KeyWord); ExitLoop = true;}
+            //Handle unknown keywords
+            default : Token.Unget(); ExitLoop = true; break;
+            }
          }
 
-      return StrPtr;
+      return Ok && (Token.Type != SCR_TOKEN_ERROR);
       }
 
    /*-------------------------------------------------------------------------
-      Setup all the Render config data.
+      Setup all the Render config data. Returns false on fail.
      -------------------------------------------------------------------------*/
-   char* SetupRenderCfg(char* KeyWord, char* StrPtr, ConfigRec* Config)
+   bool SetupRenderCfg(ConfigRec* Config)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL) || (Config == NULL)) {return NULL;}
+      if (Config == NULL) {return false;}
 
       //-- Read local keywords --
+      bool Ok       = true;
       bool ExitLoop = false;
-      while (!ExitLoop && (*StrPtr != 0))
+      while (Ok && !ExitLoop)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::SetupRenderCfg( ): StrPtr == NULL.\n"); return NULL;}
-
-         //Camera apeture and field of view
-         if (stricmp(SCR_CAMAPETURE, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->Render.CamApeture.X);
-            StrPtr = ReadFloat(StrPtr, Config->Render.CamApeture.Y);
-            StrPtr = ReadFloat(StrPtr, Config->Render.CamApeture.Z);
-            }
-         
-         //Read the profile curve
-         else if (stricmp(SCR_PROFEQU,     KeyWord) == 0) 
+         Token.Next();
+         switch (Token.Key)
             {
-            StrPtr = ReadKeyword(KeyWord, StrPtr);
-            if (StrPtr == NULL) {printf("SCR_Class::SetupRenderCfg( ): StrPtr == NULL.\n"); return NULL;}
-            if (stricmp(SCR_NULL, KeyWord) == 0) {Config->Render.ProfEqu = NULL;}
-            else {StrPtr = ReadSubStr(StrPtr-strlen(KeyWord), Config->Render.ProfEqu, true);}
-            }
-         
-         //Read the profile curve X upper limit
-         else if (stricmp(SCR_PROFEQULIMX, KeyWord) == 0) {StrPtr = ReadFloat(StrPtr, Config->Render.ProfEquLimX);Config->Render.ProfEquLimX = fabs(Config->Render.ProfEquLimX);}  
-        
-         //Read the clear flag
-         else if (stricmp(SCR_CLEARFLAG,   KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.ClearFlag);}
-         
-         //Read the shadow flag
-         else if (stricmp(SCR_SHADOWFLAG,  KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.ShadowFlag);}
-         
-         //Read the refract flag
-         else if (stricmp(SCR_REFRACTFLAG, KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.RefractFlag);}
-         
-         //Read the reflect flag
-         else if (stricmp(SCR_REFLECTFLAG, KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.ReflectFlag);}
-         
-         //Read the hotspot flag
-         else if (stricmp(SCR_HOTSPOTFLAG, KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.HotspotFlag);}
-
-         //Read the anti-alias flag
-         else if (stricmp(SCR_ANTIALIASFLAG, KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.AntiAliasFlag);}
-
-         //Read the projector compensation flag
-         else if (stricmp(SCR_PCOMPFLAG,   KeyWord) == 0) {StrPtr = ReadBool(StrPtr, Config->Render.PCompFlag);}
-
-         //Read the projector offset
-         else if (stricmp(SCR_POFFSET,     KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->Render.POffset);
-            
-            //Must be always negative!
-            Config->Render.POffset = (Config->Render.POffset != 0.0f) ? -fabs(Config->Render.POffset) : -1.0f;
-            }
+            //Camera apeture and field of view
+            case SCR_CAMAPETURE : Ok = ReadPoint(Config->Render.CamApeture); break;
 
-         //Background color
-         else if (stricmp(SCR_BACKGNDCOLOR, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->Render.BackgndColor.R);
-            StrPtr = ReadFloat(StrPtr, Config->Render.BackgndColor.G);
-            StrPtr = ReadFloat(StrPtr, Config->Render.BackgndColor.B);
-            }
+            //Read the profile curve
+            case SCR_PROFEQU :
+               Token.Next();
+               if (Token.Key == SCR_NULL)
+                  {
+                  if (Config->Render.ProfEqu != NULL) {delete[] Config->Render.ProfEqu; Config->Render.ProfEqu = NULL;}
+                  }
+               else if ((Token.Type == SCR_TOKEN_STRING) || ((Token.Type == SCR_TOKEN_WORD) && ProfCurveLib.IsBuiltin(Token.Token)))
+                  {
+                  Ok = str_replace(Config->Render.ProfEqu, Token.Token);
+                  if (!Ok) {printf("SCR_Class::SetupRenderCfg( ): Memory allocation failed.\n");}
+                  }
+               else {Ok = Token.Expected("a profile curve equation");}
+               break;
+
+            //Read the profile curve X upper limit
+            case SCR_PROFEQULIMX :
+               Ok = Token.Float(Config->Render.ProfEquLimX);
+               Config->Render.ProfEquLimX = fabs(Config->Render.ProfEquLimX);
+               break;
+
+            //Read the clear flag
+            case SCR_CLEARFLAG     : Ok = Token.Bool(Config->Render.ClearFlag); break;
+
+            //Read the shadow flag
+            case SCR_SHADOWFLAG    : Ok = Token.Bool(Config->Render.ShadowFlag); break;
+
+            //Read the refract flag
+            case SCR_REFRACTFLAG   : Ok = Token.Bool(Config->Render.RefractFlag); break;
+
+            //Read the reflect flag
+            case SCR_REFLECTFLAG   : Ok = Token.Bool(Config->Render.ReflectFlag); break;
+
+            //Read the hotspot flag
+            case SCR_HOTSPOTFLAG   : Ok = Token.Bool(Config->Render.HotspotFlag); break;
+
+            //Read the anti-alias flag
+            case SCR_ANTIALIASFLAG : Ok = Token.Bool(Config->Render.AntiAliasFlag); break;
+
+            //Read the projector compensation flag
+            case SCR_PCOMPFLAG     : Ok = Token.Bool(Config->Render.PCompFlag); break;
+
+            //Read the projector offset
+            case SCR_POFFSET :
+               Ok = Token.Float(Config->Render.POffset);
+
+               //Must be always negative!
+               Config->Render.POffset = (Config->Render.POffset != 0.0f) ? -fabs(Config->Render.POffset) : -1.0f;
+               break;
 
-         //Read the AA_Samples
-         else if (stricmp(SCR_AA_SAMPLES, KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Render.AA_Samples);}
-         
-         //Read the AA_Jitter
-         else if (stricmp(SCR_AA_JITTER,  KeyWord) == 0) {StrPtr = ReadFloat(StrPtr, Config->Render.AA_Jitter);}
+            //Background color
+            case SCR_BACKGNDCOLOR    : Ok = ReadColor(Config->Render.BackgndColor); break;
 
-         //Read the AA_Treshold
-         else if (stricmp(SCR_AA_TRESHOLD, KeyWord) == 0) {StrPtr = ReadFloat(StrPtr, Config->Render.AA_Treshold);}
-         
-         //Read the maximum ray depth
-         else if (stricmp(SCR_MAXRAYDEPTH, KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Render.MaxRayDepth);}
+            //Read the AA_Samples
+            case SCR_AA_SAMPLES      : Ok = Token.Int((int &)Config->Render.AA_Samples); break;
 
-         //Read the adaptive depth treshold
-         else if (stricmp(SCR_ADAPTDEPTHTRESH, KeyWord) == 0) {StrPtr = ReadFloat(StrPtr, Config->Render.AdaptDepthTresh);}
-         
-         //Read the maximum LOD
-         else if (stricmp(SCR_MAX_LOD, KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Render.Max_LOD);}
+            //Read the AA_Jitter
+            case SCR_AA_JITTER       : Ok = Token.Float(Config->Render.AA_Jitter); break;
 
-         //Read the lookup table resolution
-         else if (stricmp(SCR_TABRES, KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Render.TabRes);}
+            //Read the AA_Treshold
+            case SCR_AA_TRESHOLD     : Ok = Token.Float(Config->Render.AA_Treshold); break;
 
-         //Read the maximum LOD
-         else if (stricmp(SCR_SUBDIVTRESH, KeyWord) == 0) {StrPtr = ReadFloat(StrPtr, Config->Render.SubdivTresh);}
+            //Read the maximum ray depth
+            case SCR_MAXRAYDEPTH     : Ok = Token.Int((int &)Config->Render.MaxRayDepth); break;
 
-         //Rendering mode
-         else if (stricmp(SCR_CURRENTDEVICE, KeyWord) == 0) {StrPtr = ReadInt(StrPtr, (int &)Config->Render.CurrentDevice);}
+            //Read the adaptive depth treshold
+            case SCR_ADAPTDEPTHTRESH : Ok = Token.Float(Config->Render.AdaptDepthTresh); break;
 
-         //Handle unknown keywords
-         else if (KeyWord[0] != 0) {StrPtr -= strlen(KeyWord); ExitLoop = true;}
+            //Read the maximum LOD
+            case SCR_MAX_LOD         : Ok = Token.Int((int &)Config->Render.Max_LOD); break;
+
+            //Read the lookup table resolution
+            case SCR_TABRES          : Ok = Token.Int((int &)Config->Render.TabRes); break;
+
+            //Read the maximum LOD
+            case SCR_SUBDIVTRESH     : Ok = Token.Float(Config->Render.SubdivTresh); break;
+
+            //Read the level of detail Polygon size
+            case SCR_LOD_PIXELS      : Ok = Token.Float(Config->Render.LOD_Pixels); break;
+
+            //Read the Nurb chord error
+            case SCR_NURB_PIXELS     : Ok = Token.Float(Config->Render.NURB_Pixels); break;
+
+            //Rendering mode
+            case SCR_CURRENTDEVICE   : Ok = Token.Int((int &)Config->Render.CurrentDevice); break;
+
+            //Handle unknown keywords
+            default : Token.Unget(); ExitLoop = true; break;
+            }
          }
 
-      return StrPtr;
+      return Ok && (Token.Type != SCR_TOKEN_ERROR);
       }
 
    /*-------------------------------------------------------------------------
-      Setup the World data.
+      Setup the World data. Returns false on fail.
      -------------------------------------------------------------------------*/
-   char* SetupWorld(char* KeyWord, char* StrPtr, ConfigRec* Config, WorldRec* World)
+   bool SetupWorld(ConfigRec* Config, WorldRec* World)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL) || (Config == NULL) || (World == NULL)) {return NULL;}
-     
+      if ((Config == NULL) || (World == NULL)) {return false;}
+
       //-- Read local keywords --
+      bool Ok       = true;
       bool ExitLoop = false;
-      while (!ExitLoop && (*StrPtr != 0))
+      while (Ok && !ExitLoop)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::SetupWorld( ): StrPtr == NULL.\n"); return NULL;}
-
-         //View origin
-         if (stricmp(SCR_VORIGIN, KeyWord) == 0) 
+         Token.Next();
+         switch (Token.Key)
             {
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrigin.X);
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrigin.Y);
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrigin.Z);
-            }
+            //View origin
+            case SCR_VORIGIN      : Ok = ReadPoint(Config->World.VOrigin); break;
 
-         //View velocity
-         else if (stricmp(SCR_VVELOCITY, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->World.VVelocity.X);
-            StrPtr = ReadFloat(StrPtr, Config->World.VVelocity.Y);
-            StrPtr = ReadFloat(StrPtr, Config->World.VVelocity.Z);
-            }
+            //View velocity
+            case SCR_VVELOCITY    : Ok = ReadPoint(Config->World.VVelocity); break;
 
-         //View rotation
-         else if (stricmp(SCR_VROTATION, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->World.VRotation.X);
-            StrPtr = ReadFloat(StrPtr, Config->World.VRotation.Y);
-            StrPtr = ReadFloat(StrPtr, Config->World.VRotation.Z);
-            Config->World.VRotation.X = deg2rad(Config->World.VRotation.X);
-            Config->World.VRotation.Y = deg2rad(Config->World.VRotation.Y);
-            Config->World.VRotation.Z = deg2rad(Config->World.VRotation.Z);
-            }
+            //View rotation
+            case SCR_VROTATION    : Ok = ReadAngles(Config->World.VRotation); break;
 
-         //View orientation
-         else if (stricmp(SCR_VORIENTATION, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrientation.X);
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrientation.Y);
-            StrPtr = ReadFloat(StrPtr, Config->World.VOrientation.Z);
-            Config->World.VOrientation.X = deg2rad(Config->World.VOrientation.X);
-            Config->World.VOrientation.Y = deg2rad(Config->World.VOrientation.Y);
-            Config->World.VOrientation.Z = deg2rad(Config->World.VOrientation.Z);
-            }
+            //View orientation
+            case SCR_VORIENTATION : Ok = ReadAngles(Config->World.VOrientation); break;
 
-         //Handle unknown keywords
-         else if (KeyWord[0] != 0) {StrPtr -= strlen(KeyWord); ExitLoop = true;}
+            //Vertex welding distance for the Entities that follow
+            case SCR_WELDEPSILON  : Ok = Token.Float(Config->World.WeldEpsilon); break;
+
+            //Levels of detail for the Entities that follow
+            case SCR_LOD_LEVELS   : Ok = Token.Int((int &)Config->World.LOD_Levels); break;
+            case SCR_LOD_RATIO    : Ok = Token.Float(Config->World.LOD_Ratio); break;
+
+            //Handle unknown keywords
+            default : Token.Unget(); ExitLoop = true; break;
+            }
          }
 
-      return StrPtr;
+      return Ok && (Token.Type != SCR_TOKEN_ERROR);
       }
 
    /*-------------------------------------------------------------------------
-      Setup an Entity.
+      Setup an Entity. Returns false on fail.
      -------------------------------------------------------------------------*/
-   char* SetupEntity(char* KeyWord, char* StrPtr, ConfigRec* Config, WorldRec* World)
+   bool SetupEntity(ConfigRec* Config, WorldRec* World)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL) || (Config == NULL) || (World == NULL)) {return NULL;}
-     
-      //Local data      
-      char  TempStr[0x100]; 
-      char* EntityClass = TempStr;
-      *EntityClass = 0;
-      
+      if ((Config == NULL) || (World == NULL)) {return false;}
+
+      //Local data
+      char         ClassFile[SCR_TOKEN_SIZE];   //Object file name, if EntityClass is SCR_CLASS
+      dword        EntityClass = SCR_KEY_NONE;  //SCR_PLANE, SCR_CUBE, SCR_NURB, or SCR_CLASS
       iTexPointRec GridRes     = 1;
       ColorRec     Color       = 1;
       PointRec     Coord       = 0;
@@ -482,213 +649,232 @@ class SCR_Class
       PointRec     ScaleConst  = 1;
       PointRec     Velocity    = 0;
       PointRec     Rotation    = 0;
+      iTexPointRec Order(4, 4, 0, 0);
+      NurbRec*     Nurb        = NULL;
 
       //-- Read local keywords --
+      bool Ok       = true;
       bool ExitLoop = false;
-      while (!ExitLoop && (*StrPtr != 0))
+      while (Ok && !ExitLoop)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::SetupEntity( ): StrPtr == NULL.\n"); return NULL;}
-
-         //Determine the entity class
-         if (stricmp(SCR_CLASS, KeyWord) == 0) 
-            {
-            //Read the object type or file name
-            StrPtr = ReadKeyword(KeyWord, StrPtr);
-            if (StrPtr == NULL) {printf("SCR_Class::SetupEntity( ): StrPtr == NULL.\n"); return NULL;}
-
-            //Determine the object type
-            if ((stricmp(SCR_PLANE, KeyWord) == 0) || (stricmp(SCR_CUBE, KeyWord) == 0))
-               {strcpy(EntityClass, KeyWord);}
-            else {StrPtr = ReadSubStr(StrPtr-strlen(KeyWord), EntityClass, false);}
-            }
-
-         //Diffuse color
-         else if (stricmp(SCR_COLOR, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Color.R);
-            StrPtr = ReadFloat(StrPtr, Color.G);
-            StrPtr = ReadFloat(StrPtr, Color.B);
-            }
-         
-         //Grid resolution
-         else if (stricmp(SCR_GRIDRES, KeyWord) == 0) 
+         Token.Next();
+         switch (Token.Key)
             {
-            StrPtr = ReadInt(StrPtr, GridRes.U);
-            StrPtr = ReadInt(StrPtr, GridRes.V);
-            }
-
-         //Position
-         else if (stricmp(SCR_COORD, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Coord.X);
-            StrPtr = ReadFloat(StrPtr, Coord.Y);
-            StrPtr = ReadFloat(StrPtr, Coord.Z);
-            }
-
-         //Orientation
-         else if (stricmp(SCR_ORIENTATION, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Orientation.X);
-            StrPtr = ReadFloat(StrPtr, Orientation.Y);
-            StrPtr = ReadFloat(StrPtr, Orientation.Z);
-            Orientation.X = deg2rad(Orientation.X);
-            Orientation.Y = deg2rad(Orientation.Y);
-            Orientation.Z = deg2rad(Orientation.Z);
-            }
-
-         //ScaleConst
-         else if (stricmp(SCR_SCALECONST, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, ScaleConst.X);
-            StrPtr = ReadFloat(StrPtr, ScaleConst.Y);
-            StrPtr = ReadFloat(StrPtr, ScaleConst.Z);
+            //Determine the entity class, which is an object type or a file name
+            case SCR_CLASS :
+               Token.Next();
+               if ((Token.Key == SCR_PLANE) || (Token.Key == SCR_CUBE) || (Token.Key == SCR_NURB)) {EntityClass = Token.Key;}
+               else if (Token.Type == SCR_TOKEN_STRING) {EntityClass = SCR_CLASS; strcpy(ClassFile, Token.Token);}
+               else {Ok = Token.Expected("an object type or a file name");}
+               break;
+
+            //Diffuse color
+            case SCR_COLOR : Ok = ReadColor(Color); break;
+
+            //Grid resolution
+            case SCR_GRIDRES : Ok = Token.Int(GridRes.U) && Token.Int(GridRes.V); break;
+
+            //Nurb order
+            case SCR_ORDER : Ok = Token.Int(Order.U) && Token.Int(Order.V); break;
+
+            //Nurb control points, GRIDRES must preceed this. Each point is 
+            // given as X, Y, Z and the weight.
+            case SCR_CTRLPTS :
+               if (Nurb != NULL) {delete Nurb;}
+               Nurb = new NurbRec(GridRes.U, GridRes.V, NURB_POINT | NURB_WEIGHT);
+               if ((Nurb == NULL) || ((Nurb->Flags & NURB_VALID) == NURB_NULL))
+                  {
+                  printf("SCR_Class::SetupEntity( ): Nurb allocation failed.\n"); 
+                  Ok = false;
+                  break;
+                  }
+
+               for (dword I = 0; Ok && (I < Nurb->TotalCount); I++)
+                  {
+                  Ok = Token.Float(Nurb->Points[I].X) && Token.Float(Nurb->Points[I].Y) &&
+                       Token.Float(Nurb->Points[I].Z) && Token.Float(Nurb->Weights[I]);
+                  }
+               break;
+
+            //Position
+            case SCR_COORD       : Ok = ReadPoint(Coord); break;
+
+            //Orientation
+            case SCR_ORIENTATION : Ok = ReadAngles(Orientation); break;
+
+            //ScaleConst
+            case SCR_SCALECONST  : Ok = ReadPoint(ScaleConst); break;
+
+            //Velocity
+            case SCR_VELOCITY    : Ok = ReadPoint(Velocity); break;
+
+            //Rotation
+            case SCR_ROTATION    : Ok = ReadAngles(Rotation); break;
+
+            //Handle unknown keywords
+            default : Token.Unget(); ExitLoop = true; break;
             }
+         }
 
-         //Velocity
-         else if (stricmp(SCR_VELOCITY, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Velocity.X);
-            StrPtr = ReadFloat(StrPtr, Velocity.Y);
-            StrPtr = ReadFloat(StrPtr, Velocity.Z);
-            }
+      if (!Ok || (Token.Type == SCR_TOKEN_ERROR)) {if (Nurb != NULL) {delete Nurb;} return false;}
 
-         //Rotation
-         else if (stricmp(SCR_ROTATION, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Rotation.X);
-            StrPtr = ReadFloat(StrPtr, Rotation.Y);
-            StrPtr = ReadFloat(StrPtr, Rotation.Z);
-            Rotation.X = deg2rad(Rotation.X);
-            Rotation.Y = deg2rad(Rotation.Y);
-            Rotation.Z = deg2rad(Rotation.Z);
-            }
+      //The control points are only used by Nurb Entities
+      if ((Nurb != NULL) && (EntityClass != SCR_NURB)) {delete Nurb; Nurb = NULL;}
 
-         //Handle unknown keywords
-         else if (KeyWord[0] != 0) {StrPtr -= strlen(KeyWord); ExitLoop = true;}
-         }
+      //-- Entity allocation. The Entity is inserted into the World once all 
+      //   the object files are loaded (see InsertEntities( )). --
+      EntityRec*  Entity  = NULL;
+      PendingRec* Pending = new PendingRec;
+      if (Pending == NULL) {printf("SCR_Class::SetupEntity( ): Memory allocation failed.\n"); if (Nurb != NULL) {delete Nurb;} return false;}
+      if (!LinkedList.Insert(PendingList, Pending)) {printf("SCR_Class::SetupEntity( ): Memory allocation failed.\n"); delete Pending; if (Nurb != NULL) {delete Nurb;} return false;}
 
+      Pending->Entity      = NULL;
+      Pending->Asset       = NULL;
+      Pending->Coord       = Coord;
+      Pending->Orientation = Orientation;
+      Pending->ScaleConst  = ScaleConst;
+      Pending->Velocity    = Velocity;
+      Pending->Rotation    = Rotation;
 
-      //-- Entity allocation --
-      EntityRec* Entity = NULL;
-      if (*EntityClass == 0) {printf("SCR_Class::SetupEntity( ): No entity class was defined.\n"); return NULL;}
-      else if (stricmp(SCR_PLANE, EntityClass) == 0) 
+      if (EntityClass == SCR_KEY_NONE) {printf("SCR_Class::SetupEntity( ): No entity class was defined.\n"); return false;}
+      else if (EntityClass == SCR_PLANE) 
          {
          Entity = Primitive.Plane(&GridRes, &ScaleConst, &Coord, &Color);
          if (Entity == NULL)
-            {printf("SCR_Class::SetupEntity( ): Primitive.Plane( ) failed.\n"); return NULL;}
+            {printf("SCR_Class::SetupEntity( ): Primitive.Plane( ) failed.\n"); return false;}
          }
-      else if (stricmp(SCR_CUBE, EntityClass) == 0) 
+      else if (EntityClass == SCR_CUBE) 
          {
          Entity = Primitive.Cube(&ScaleConst, &Coord, &Color);
          if (Entity == NULL)
-            {printf("SCR_Class::SetupEntity( ): Primitive.Cube( ) failed.\n"); return NULL;}
+            {printf("SCR_Class::SetupEntity( ): Primitive.Cube( ) failed.\n"); return false;}
          }                         
-      else
+      else if (EntityClass == SCR_NURB) 
          {
-         if (!COB.Read(EntityClass, Entity))
-            {printf("SCR_Class::SetupEntity( ): COB.Read( ) failed.\n"); return NULL;}
+         if (Nurb == NULL) {printf("SCR_Class::SetupEntity( ): No Nurb control points were defined.\n"); return false;}
+
+         MaterialRec Material;
+         Material.kDiff = Color;
+
+         //The Entity takes over the Nurb
+         Entity = new EntityRec;
+         if (Entity == NULL) {printf("SCR_Class::SetupEntity( ): Entity allocation failed.\n"); delete Nurb; return false;}
+         if (!Nurb->SetOrder(Order.U, Order.V) || !Entity->SetNurb(Nurb, &Material))
+            {
+            printf("SCR_Class::SetupEntity( ): Entity->SetNurb( ) failed.\n"); 
+            if (Entity->Nurb != Nurb) {delete Nurb;}
+            delete Entity; 
+            return false;
+            }
+         Nurb = NULL;
 
-         if (!Entity->Scale(&ScaleConst, &Entity->Centroid)) {if (Entity != NULL) {delete Entity;} return NULL;}
-         if (!Entity->Translate(&Coord)) {if (Entity != NULL) {delete Entity;} return NULL;}
+         if (!Entity->Scale(&ScaleConst, &Entity->Centroid)) {delete Entity; return false;}
+         if (!Entity->Translate(&Coord)) {delete Entity; return false;}
+         }
+      else
+         {
+         //The object file is loaded later, along with all the others
+         Pending->Asset = FindAsset(ClassFile, Config);
+         if (Pending->Asset == NULL) {printf("SCR_Class::SetupEntity( ): Memory allocation failed.\n"); return false;}
+         Pending->Asset->Users++;
+         return true;
          } 
 
       //Do the initial orientation
-      if (!Entity->Rotate(&Orientation, &Entity->Centroid)) {if (Entity != NULL) {delete Entity;} return NULL;}
+      if (!Entity->Rotate(&Orientation, &Entity->Centroid)) {if (Entity != NULL) {delete Entity;} return false;}
 
       //Set the Entity's velocity and angular velocity
       Entity->Velocity = Velocity;
       Entity->Rotation = Rotation;
 
-
-      //Insert the entity into the world
-      if (!LinkedList.Insert(World->EntityList, Entity))
-         {
-         printf("SCR_Class::SetupEntity( ): LinkedList.Insert( ) failed.\n"); 
-         if (Entity != NULL) {delete Entity;}
-         return NULL;
-         }
-      
-      return StrPtr;
+      Pending->Entity = Entity;
+      return true;
       }
 
    /*-------------------------------------------------------------------------
-      Setup a Light.
+      Setup a Light. Returns false on fail.
      -------------------------------------------------------------------------*/
-   char* SetupLight(char* KeyWord, char* StrPtr, ConfigRec* Config, WorldRec* World)
+   bool SetupLight(ConfigRec* Config, WorldRec* World)
       {
-      if ((KeyWord == NULL) || (StrPtr == NULL) || (Config == NULL) || (World == NULL)) {return NULL;}
-     
-      //Local data      
+      if ((Config == NULL) || (World == NULL)) {return false;}
+
+      //Local data
       ColorRec Color = 1;
       PointRec Coord = 0;
       bool     AllocLight = true;
 
 
       //-- Read local keywords --
+      bool Ok       = true;
       bool ExitLoop = false;
-      while (!ExitLoop && (*StrPtr != 0))
+      while (Ok && !ExitLoop)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::SetupLight( ): StrPtr == NULL.\n"); return NULL;}
-
-         //Setup the light color
-         if (stricmp(SCR_COLOR, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Color.R);
-            StrPtr = ReadFloat(StrPtr, Color.G);
-            StrPtr = ReadFloat(StrPtr, Color.B);
-            }
-         
-         //Setup the ambient light color
-         else if (stricmp(SCR_AMBCOLOR, KeyWord) == 0) 
-            {
-            StrPtr = ReadFloat(StrPtr, Config->World.AmbLight.R);
-            StrPtr = ReadFloat(StrPtr, Config->World.AmbLight.G);
-            StrPtr = ReadFloat(StrPtr, Config->World.AmbLight.B);
-            AllocLight = false;
-            }
-         
-         //Position
-         else if (stricmp(SCR_COORD, KeyWord) == 0) 
+         Token.Next();
+         switch (Token.Key)
             {
-            StrPtr = ReadFloat(StrPtr, Coord.X);
-            StrPtr = ReadFloat(StrPtr, Coord.Y);
-            StrPtr = ReadFloat(StrPtr, Coord.Z);
-            }
+            //Setup the light color
+            case SCR_COLOR    : Ok = ReadColor(Color); break;
+
+            //Setup the ambient light color
+            case SCR_AMBCOLOR : Ok = ReadColor(Config->World.AmbLight); AllocLight = false; break;
+
+            //Position
+            case SCR_COORD    : Ok = ReadPoint(Coord); break;
 
-         //Handle unknown keywords
-         else if (KeyWord[0] != 0) {StrPtr -= strlen(KeyWord); ExitLoop = true;}
+            //Handle unknown keywords
+            default : Token.Unget(); ExitLoop = true; break;
+            }
          }
 
+      if (!Ok || (Token.Type == SCR_TOKEN_ERROR)) {return false;}
+
 
       //-- Light allocation --
       if (AllocLight)
          {
          LightRec* Light = new LightRec;
-         if (Light == NULL) {printf("SCR_Class::SetupLight( ): Light allocation failed.\n"); return NULL;}
+         if (Light == NULL) {printf("SCR_Class::SetupLight( ): Light allocation failed.\n"); return false;}
 
          Light->Color = Color;
          Light->Coord = Coord;
 
          //Insert the Light into the world
-         if (!LinkedList.Insert(World->LightList, Light))
+         if (!World->Insert(Light))
             {
-            printf("SCR_Class::SetupLight( ): LinkedList.Insert( ) failed.\n"); 
+            printf("SCR_Class::SetupLight( ): WorldRec::Insert( ) failed.\n"); 
             if (Light != NULL) {delete Light;}
-            return NULL;
+            return false;
             }
          }
 
-      return StrPtr;
+      return true;
       }
 
 
    /*==== Public Declarations ================================================*/
    public:
 
+   /*---- Constructor --------------------------------------------------------*/
+   SCR_Class(void)
+      {
+      AssetList   = NULL;
+      AssetTable  = NULL;
+      AssetSlots  = 0;
+      AssetCount  = 0;
+      PendingList = NULL;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~SCR_Class(void)
+      {
+      ReleaseEntities();
+      if (AssetTable != NULL) {delete[] AssetTable; AssetTable = NULL;}
+      }
+
    /*-------------------------------------------------------------------------
-      Read is not supported.
+      Reads a script into the Config and the World. The script is streamed
+      through the tokenizer, so it can be of any length. Returns false on
+      fail.
      -------------------------------------------------------------------------*/
    bool Read(char* FileName, ConfigRec* Config, WorldRec* World)
       {
@@ -696,68 +882,75 @@ class SCR_Class
 
 
       //Local data
-      char  KeyWord[0x100];
-      int   ErrorCode = 0;
-      dword ScriptLen = 0;
-      dword ScriptRead;
-      char* ScriptStr = NULL;
-      char* StrPtr    = NULL;
+      char* CacheName  = NULL;
+      dword ScriptHash = 0;
+      dword ScriptSize = 0;
+      bool  UseCache;
+      bool  Ok;
 
 
       //-- Open the script file --
-      FILE* SCR_File = fopen(FileName, "rt");
-      if (SCR_File == NULL) {goto _ExitError;}
-
-      //Find the length of the entire script
-      fseek(SCR_File, 0, SEEK_END);
-      ScriptLen = ftell(SCR_File);
-      fseek(SCR_File, 0, SEEK_SET);
+      if (!Token.HasKeywords() && !Token.SetKeywords(SCR_Keywords, SCR_KEYWORD_COUNT)) {goto _ExitError;}
+      if (!Token.Open(FileName)) {goto _ExitError;}
 
-      //Filesize check
-      if (ScriptLen > SCR_SIZE_LIMIT) 
-         {printf("SCR_Class::Read( ): Script file \"%s\" is over the %u byte limit.\n", FileName, SCR_SIZE_LIMIT); goto _ExitError;}
 
-      //Allocate the string buffer
-      StrPtr = ScriptStr = new char[ScriptLen + 1];
-      if (ScriptStr == NULL) {printf("SCR_Class::Read( ): Script string allocation error.\n"); goto _ExitError;}
+      //-- Try the compiled scene cache. It replaces the whole scene, so 
+      //   it's only used if the World is empty. The cache is keyed on the
+      //   script contents, which are hashed a buffer at a time. --
+      UseCache = (World->EntityList == NULL) && (World->LightList == NULL);
+      if (UseCache)
+         {
+         CacheName = new char[strlen(FileName) + strlen(SCENE_CACHE_EXT) + 1];
+         if (CacheName == NULL) {UseCache = false;}
+         else {strcpy(CacheName, FileName); strcat(CacheName, SCENE_CACHE_EXT);}
+         }
 
-      //Read the file into the buffer
-      ScriptRead = fread(ScriptStr, 1, ScriptLen, SCR_File);
-      if ((ScriptRead != ScriptLen) && (feof(SCR_File) == 0))
-         {printf("SCR_Class::Read( ): File IO error.\n"); goto _ExitError;}
-
-      //Get rid of linefeed chars
-      while (StrPtr < ScriptStr + ScriptLen) {if (*StrPtr == 0x0D) {*StrPtr = ' ';} StrPtr++;}
-      StrPtr = ScriptStr;
-      ScriptStr[ScriptRead] = 0;
+      if (UseCache && !Token.Scan(ScriptHash, ScriptSize)) {goto _ExitError;}
+      if (UseCache && SceneCache.Read(CacheName, ScriptHash, ScriptSize, Config, World)) {goto _ExitNormal;}
+      SceneCache.ClearSources();
 
 
       //-- Read the script --
-      while (*StrPtr != 0)
+      while (Token.Next() != SCR_TOKEN_END)
          {
-         StrPtr = ReadKeyword(KeyWord, StrPtr);
-         if (StrPtr == NULL) {printf("SCR_Class::Read( ): StrPtr == NULL.\n"); goto _ExitError;}
-
-         if      (stricmp(SCR_RENDER, KeyWord) == 0) {StrPtr = SetupRenderCfg(KeyWord, StrPtr, Config);}
-         else if (stricmp(SCR_VIDEO,  KeyWord) == 0) {StrPtr = SetupVideoCfg(KeyWord, StrPtr, Config);}
-         else if (stricmp(SCR_WORLD,  KeyWord) == 0) {StrPtr = SetupWorld(KeyWord, StrPtr, Config, World);}
-         else if (stricmp(SCR_ENTITY, KeyWord) == 0) {StrPtr = SetupEntity(KeyWord, StrPtr, Config, World);}
-         else if (stricmp(SCR_LIGHT,  KeyWord) == 0) {StrPtr = SetupLight(KeyWord, StrPtr, Config, World);}
-         else if (KeyWord[0] != 0) {printf("SCR_Class::Read( ): Script file \"%s\", invalid symbol \"%s\".\n", FileName, KeyWord); goto _ExitError;}
-         
-         if (StrPtr == NULL) {printf("SCR_Class::Read( ): StrPtr == NULL.\n"); goto _ExitError;}
+         if (Token.Type == SCR_TOKEN_ERROR) {goto _ExitError;}
+
+         switch (Token.Key)
+            {
+            case SCR_RENDER : Ok = SetupRenderCfg(Config); break;
+            case SCR_VIDEO  : Ok = SetupVideoCfg(Config); break;
+            case SCR_WORLD  : Ok = SetupWorld(Config, World); break;
+            case SCR_ENTITY : Ok = SetupEntity(Config, World); break;
+            case SCR_LIGHT  : Ok = SetupLight(Config, World); break;
+            default : Token.Error("invalid symbol", Token.Token); goto _ExitError;
+            }
+
+         if (!Ok) {goto _ExitError;}
          }
 
+      //Load the object files, and insert the Entities
+      if (!InsertEntities(World)) {printf("SCR_Class::Read( ): Script file \"%s\", failed to set up the Entities.\n", FileName); goto _ExitError;}
+      ReleaseEntities();
+
+      //Save the scene cache for the next start up (the scene is still 
+      // valid if this fails)
+      if (UseCache && !SceneCache.Save(CacheName, ScriptHash, ScriptSize, Config, World))
+         {printf("SCR_Class::Read( ): Warning, the scene cache was not saved.\n");}
+
 
       //-- Normal exit --
-      if (SCR_File  != NULL) {fclose(SCR_File);}
-      if (ScriptStr != NULL) {delete[] ScriptStr;}
+      _ExitNormal:
+      SceneCache.ClearSources();
+      Token.Close();
+      if (CacheName != NULL) {delete[] CacheName;}
       return true;
 
       //-- Exit with error --
       _ExitError:
-      if (SCR_File  != NULL) {fclose(SCR_File);}
-      if (ScriptStr != NULL) {delete[] ScriptStr;}
+      ReleaseEntities();
+      SceneCache.ClearSources();
+      Token.Close();
+      if (CacheName != NULL) {delete[] CacheName;}
       return false;
       }
 
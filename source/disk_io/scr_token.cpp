@@ -0,0 +1,442 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                        Custom Script File Tokenizer                        */
+/*============================================================================*/
+
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __SCR_TOKEN_CPP__
+#define __SCR_TOKEN_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/std_str.cpp"
+#include "../disk_io/scn_cache.cpp"
+
+#include <ctype.h>
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define SCR_BUFFER_SIZE    0x00010000           //Size of the read buffer (64 KB)
+#define SCR_TOKEN_SIZE     0x00000400           //Maximum length of a token, including the 0
+#define SCR_KEY_SLOTS      512                  //Size of the keyword table, must be a power of 2
+#define SCR_KEY_SEEDS      0x00010000           //Number of hash seeds tried for the keyword table
+#define SCR_HASH_BASIS     0x811C9DC5           //Initial value of HashChar( )
+
+//Token types
+#define SCR_TOKEN_END      0                    //End of the script
+#define SCR_TOKEN_WORD     1                    //Keyword, number or any other symbol
+#define SCR_TOKEN_STRING   2                    //String constant, without the ""
+#define SCR_TOKEN_ERROR    3                    //Invalid token, the error was already reported
+
+#define SCR_KEY_NONE       0                    //The token is not a keyword
+
+
+/*---------------------------------------------------------------------------
+   Keyword record for SCR_TokenClass::SetKeywords( ).
+  ---------------------------------------------------------------------------*/
+struct SCR_KeyRec
+   {
+   char*     Name;                              //The keyword
+   dword     ID;                                //Keyword ID, must not be SCR_KEY_NONE
+   };
+
+
+/*---------------------------------------------------------------------------
+  The script tokenizer class. Reads the script through a fixed size
+  buffer, so a script can be of any length, and the memory use doesn't
+  depend on it. The tokens are separated by spaces, tabs, newlines and
+  comments (C and C++ style). The '/' character always ends a token.
+  String constants are enclosed in "", and they can't span several lines.
+
+  The keywords are found with a perfect hash: SetKeywords( ) searches for
+  a hash seed that places every keyword into a different slot of the
+  table, so each token is tested with a single compare. The hash is
+  computed while the token is read, and it ignores the case, like the
+  keywords themselves.
+
+  The line and column of the current token are kept for the error
+  messages.
+  ---------------------------------------------------------------------------*/
+class SCR_TokenClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   /*---- Private Data -------------------------------------------------------*/
+   FILE*       File;
+   char*       FileName;                        //Script name for the error messages
+   byte*       Buffer;                          //Read buffer
+   dword       BufPos;                          //Next character in the Buffer
+   dword       BufCount;                        //Number of characters in the Buffer
+   dword       CurLine;                         //Position of the next character
+   dword       CurColumn;
+   bool        Ungot;                           //Set if Next( ) returns the current token again
+
+   SCR_KeyRec* Keys;                            //Keyword list (NULL if not set)
+   dword       KeySeed;                         //Initial hash value of the keywords
+   word        KeySlots[SCR_KEY_SLOTS];         //Keys index + 1 in each slot, 0 if the slot is empty
+
+   /*-------------------------------------------------------------------------
+      Returns the next character without reading it, or EOF at the end of
+      the file. The buffer is refilled as needed.
+     -------------------------------------------------------------------------*/
+   inline int Peek(void)
+      {
+      if (BufPos >= BufCount)
+         {
+         BufPos   = 0;
+         BufCount = (dword)fread(Buffer, 1, SCR_BUFFER_SIZE, File);
+         if (BufCount == 0) {return EOF;}
+         }
+
+      return Buffer[BufPos];
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads the next character, or returns EOF at the end of the file.
+     -------------------------------------------------------------------------*/
+   inline int Get(void)
+      {
+      int C = Peek();
+      if (C == EOF) {return EOF;}
+
+      BufPos++;
+      if (C == '\n') {CurLine++; CurColumn = 1;} else {CurColumn++;}
+      return C;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the slot of a keyword hash in the KeySlots.
+     -------------------------------------------------------------------------*/
+   static inline dword KeySlot(dword Hash) {return (Hash ^ (Hash >> 16)) & (SCR_KEY_SLOTS - 1);}
+
+   /*-------------------------------------------------------------------------
+      Reports an invalid token, and returns SCR_TOKEN_ERROR.
+     -------------------------------------------------------------------------*/
+   dword Fail(char* Msg)
+      {
+      Error(Msg, NULL);
+      Key = SCR_KEY_NONE;
+      return Type = SCR_TOKEN_ERROR;
+      }
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   char      Token[SCR_TOKEN_SIZE];             //The current token
+   dword     Type;                              //Type of the current token (SCR_TOKEN_*)
+   dword     Key;                               //Keyword ID of the current token, or SCR_KEY_NONE
+   dword     Line;                              //Position of the current token
+   dword     Column;
+
+   /*---- Constructor --------------------------------------------------------*/
+   SCR_TokenClass(void)
+      {
+      File      = NULL;
+      FileName  = NULL;
+      Buffer    = NULL;
+      Keys      = NULL;
+      KeySeed   = SCR_HASH_BASIS;
+      Token[0]  = 0;
+      Rewind();
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~SCR_TokenClass(void)
+      {
+      Close();
+      if (Buffer != NULL) {delete[] Buffer; Buffer = NULL;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Hashes one character for the keywords, ignoring the case.
+     -------------------------------------------------------------------------*/
+   static inline dword HashChar(dword Value, int C) {return (Value ^ (dword)toupper((byte)C)) * 0x01000193;}
+
+   /*-------------------------------------------------------------------------
+      Returns the case insensitive hash of the string Str.
+     -------------------------------------------------------------------------*/
+   static inline dword HashStr(char* Str)
+      {
+      dword Value = SCR_HASH_BASIS;
+      while (*Str != 0) {Value = HashChar(Value, *Str++);}
+      return Value;
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets the keyword list, and builds the perfect hash table for it. The
+      List must stay valid while it's in use, and every keyword must be
+      unique. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool SetKeywords(SCR_KeyRec* List, dword Count)
+      {
+      Keys = NULL;
+      if ((List == NULL) || (Count == 0) || (Count >= SCR_KEY_SLOTS)) {return false;}
+
+      for (dword Seed = 0; Seed < SCR_KEY_SEEDS; Seed++)
+         {
+         KeySeed = SCR_HASH_BASIS + Seed * 0x9E3779B9;
+         memset(KeySlots, 0, sizeof(KeySlots));
+
+         dword I;
+         for (I = 0; I < Count; I++)
+            {
+            dword Hash = KeySeed;
+            for (char* Ptr = List[I].Name; *Ptr != 0; Ptr++) {Hash = HashChar(Hash, *Ptr);}
+
+            dword Slot = KeySlot(Hash);
+            if (KeySlots[Slot] != 0) {break;}
+            KeySlots[Slot] = (word)(I + 1);
+            }
+
+         if (I == Count) {Keys = List; return true;}
+         }
+
+      printf("SCR_TokenClass::SetKeywords( ): No perfect hash was found for the keywords.\n");
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if the keyword list was set.
+     -------------------------------------------------------------------------*/
+   inline bool HasKeywords(void) {return Keys != NULL;}
+
+   /*-------------------------------------------------------------------------
+      Opens a script. Name must stay valid until the script is closed.
+      Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Open(char* Name)
+      {
+      if (Name == NULL) {return false;}
+      Close();
+
+      if (Buffer == NULL)
+         {
+         Buffer = new byte[SCR_BUFFER_SIZE];
+         if (Buffer == NULL) {printf("SCR_TokenClass::Open( ): Memory allocation failed.\n"); return false;}
+         }
+
+      File = fopen(Name, "rb");
+      if (File == NULL) {return false;}
+
+      FileName = Name;
+      return Rewind();
+      }
+
+   /*-------------------------------------------------------------------------
+      Closes the script.
+     -------------------------------------------------------------------------*/
+   void Close(void)
+      {
+      if (File != NULL) {fclose(File); File = NULL;}
+      FileName = NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Restarts the script from the beginning. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Rewind(void)
+      {
+      BufPos    = 0;
+      BufCount  = 0;
+      CurLine   = 1;
+      CurColumn = 1;
+      Line      = 1;
+      Column    = 1;
+      Ungot     = false;
+      Type      = SCR_TOKEN_END;
+      Key       = SCR_KEY_NONE;
+
+      if (File == NULL) {return true;}
+      clearerr(File);
+      return fseek(File, 0, SEEK_SET) == 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Computes the SceneCacheClass::Hash( ) and the size of the whole
+      script, one buffer at a time, then rewinds the script. Returns false
+      on fail.
+     -------------------------------------------------------------------------*/
+   bool Scan(dword &Hash, dword &Size)
+      {
+      Hash = SCENE_HASH_BASIS;
+      Size = 0;
+      if ((File == NULL) || !Rewind()) {return false;}
+
+      dword Count;
+      while ((Count = (dword)fread(Buffer, 1, SCR_BUFFER_SIZE, File)) > 0)
+         {
+         Hash  = SceneCacheClass::Hash(Buffer, Count, Hash);
+         Size += Count;
+         }
+
+      if (ferror(File)) {printf("SCR_TokenClass::Scan( ): File IO error.\n"); return false;}
+      return Rewind();
+      }
+
+   /*-------------------------------------------------------------------------
+      Reads the next token, and returns its Type. The Key is set if the
+      token is a keyword. Errors are reported here, and SCR_TOKEN_ERROR is
+      returned.
+     -------------------------------------------------------------------------*/
+   dword Next(void)
+      {
+      if (Ungot) {Ungot = false; return Type;}
+
+      int   C;
+      dword Length = 0;
+      dword Hash   = KeySeed;
+
+      Token[0] = 0;
+      Key      = SCR_KEY_NONE;
+      if (File == NULL) {return Type = SCR_TOKEN_END;}
+
+      //-- Skip the spaces and comments --
+      for (;;)
+         {
+         Line   = CurLine;
+         Column = CurColumn;
+         C      = Get();
+
+         if ((C == ' ') || (C == '\t') || (C == '\n') || (C == '\r')) {continue;}
+         if ((C != '/') || ((Peek() != '/') && (Peek() != '*'))) {break;}
+
+         //Line comment
+         if (Get() == '/')
+            {
+            while ((Peek() != EOF) && (Peek() != '\n')) {Get();}
+            continue;
+            }
+
+         //Block comment
+         int Last = 0;
+         while (((C = Get()) != EOF) && ((Last != '*') || (C != '/'))) {Last = C;}
+         if (C == EOF) {return Fail("the comment is not closed with */");}
+         }
+
+      //-- End of the script --
+      if (C == EOF)
+         {
+         if (ferror(File)) {return Fail("file IO error");}
+         return Type = SCR_TOKEN_END;
+         }
+
+      //-- String constant --
+      if (C == '"')
+         {
+         while ((C = Get()) != '"')
+            {
+            if ((C == EOF) || (C == '\n')) {return Fail("the symbol \" is expected at the end of the string constant");}
+            if (Length >= SCR_TOKEN_SIZE - 1) {return Fail("the string constant is too long");}
+            Token[Length++] = (char)C;
+            }
+
+         Token[Length] = 0;
+         return Type = SCR_TOKEN_STRING;
+         }
+
+      //-- Keyword, number or any other symbol --
+      Token[Length++] = (char)C;
+      Hash = HashChar(Hash, C);
+
+      while (((C = Peek()) != EOF) && (C != ' ') && (C != '\t') && (C != '\n') && (C != '\r') && (C != '/'))
+         {
+         if (Length >= SCR_TOKEN_SIZE - 1) {return Fail("the symbol is too long");}
+         Token[Length++] = (char)Get();
+         Hash = HashChar(Hash, C);
+         }
+      Token[Length] = 0;
+
+      //Look up the keyword
+      if (Keys != NULL)
+         {
+         word Slot = KeySlots[KeySlot(Hash)];
+         if ((Slot != 0) && (stricmp(Keys[Slot - 1].Name, Token) == 0)) {Key = Keys[Slot - 1].ID;}
+         }
+
+      return Type = SCR_TOKEN_WORD;
+      }
+
+   /*-------------------------------------------------------------------------
+      The next call to Next( ) returns the current token again.
+     -------------------------------------------------------------------------*/
+   inline void Unget(void) {Ungot = true;}
+
+   /*-------------------------------------------------------------------------
+      Prints an error message with the position of the current token. The
+      Symbol is appended to the message, if it's not NULL.
+     -------------------------------------------------------------------------*/
+   void Error(char* Msg, char* Symbol)
+      {
+      if (Symbol != NULL) {printf("SCR_Class::Read( ): Script file \"%s\", line %u, column %u, %s \"%s\".\n", FileName, Line, Column, Msg, Symbol);}
+      else                {printf("SCR_Class::Read( ): Script file \"%s\", line %u, column %u, %s.\n", FileName, Line, Column, Msg);}
+      }
+
+   /*-------------------------------------------------------------------------
+      Reports that What was expected instead of the current token, unless
+      an error was already reported. Always returns false.
+     -------------------------------------------------------------------------*/
+   bool Expected(char* What)
+      {
+      if (Type == SCR_TOKEN_ERROR) {return false;}
+
+      if (Type == SCR_TOKEN_END) {printf("SCR_Class::Read( ): Script file \"%s\", %s is expected at the end of the file.\n", FileName, What);}
+      else {printf("SCR_Class::Read( ): Script file \"%s\", line %u, column %u, %s is expected instead of \"%s\".\n", FileName, Line, Column, What, Token);}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Read the next token as a float, integer, or boolean value (0 is
+      false, other integers are true). Return false on fail.
+     -------------------------------------------------------------------------*/
+   bool Float(float &Data)
+      {
+      char* EndPtr;
+      if (Next() != SCR_TOKEN_WORD) {return Expected("a number");}
+
+      double Value = strtod(Token, &EndPtr);
+      if ((EndPtr == Token) || (*EndPtr != 0)) {return Expected("a number");}
+
+      Data = (float)Value;
+      return true;
+      }
+
+   bool Int(int &Data)
+      {
+      char* EndPtr;
+      if (Next() != SCR_TOKEN_WORD) {return Expected("an integer");}
+
+      long Value = strtol(Token, &EndPtr, 10);
+      if ((EndPtr == Token) || (*EndPtr != 0)) {return Expected("an integer");}
+
+      Data = (int)Value;
+      return true;
+      }
+
+   bool Bool(bool &Data)
+      {
+      int Value;
+      if (!Int(Value)) {return false;}
+
+      Data = (Value != 0);
+      return true;
+      }
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -19,6 +19,7 @@
 #include "../_common/std_inc.h"
 #include "../bmp_edit/pixel.h"
 #include "../mem_data/bitmap.cpp"
+#include "../_common/fileview.cpp"
 
 
 /*----------------------------------------------------------------------------
@@ -48,9 +49,20 @@
 #define TGA_IMAGE_TRUE_RLE 0x0A                    //True color, RLE compression
 #define TGA_IMAGE_GREY_RLE 0x0B                    //Grey scale, RLE compression
 
+#define TGA_HEADER_SIZE    18                      //File header size in bytes
+#define TGA_RUN_MAX        0x80                    //Maximum number of pixels in a RLE packet
+
+//How the bitmap pixels are related to the TGA pixels:
+#define TGA_LAYOUT_CONVERT 0x00                    //Different formats, each pixel is converted.
+#define TGA_LAYOUT_SAME    0x01                    //Same memory layout, the pixels are copied.
+#define TGA_LAYOUT_SWAP    0x02                    //Red and blue swapped, for the 24 and 32 bit formats.
+
 
 /*---------------------------------------------------------------------------
-  The TGA file IO class.
+  The TGA file IO class. Files are decoded in bulk, straight from a file
+  view. The encoder converts and packs the entire frame into a memory
+  buffer, and writes the file with a single fwrite( ). The buffer is kept
+  between saves, since the recorder saves a frame on every update.
   ---------------------------------------------------------------------------*/
 class TGA_Class
    {
@@ -66,6 +78,9 @@ class TGA_Class
    Pixel_BGR_Class   Pixel_BGR;
    Pixel_BGRA_Class  Pixel_BGRA;
 
+   byte*             Buffer;                       //Encoding buffer
+   dword             BufferSize;                   //Allocated size of the encoding buffer
+
    /*-------------------------------------------------------------------------
      The TGA file header structure.
      -------------------------------------------------------------------------*/
@@ -91,14 +106,115 @@ class TGA_Class
    struct ReadLoopDataRec
       {
       byte* StartPtr;
-      byte* EndPtr;
       int   ScanLineIncr;
 
-      dword PixelStart; 
-      dword PixelEnd;
+      dword PixelStart;
       int   PixelIncr;
       };
-   
+
+
+   /*=========================================================================
+     Pixel conversion functions.
+     =========================================================================*/
+
+   /*-------------------------------------------------------------------------
+      Determines how the bitmap pixels are related to the TGA pixels, so that
+      the conversion can copy or swizzle the pixels, rather than converting
+      each one through the pixel classes.
+
+      BitmapType : Bitmap type (see BMP_TYPE_* in bitmap.cpp).
+      TGA_Pixel  : Class pointer for the TGA's pixel format.
+     -------------------------------------------------------------------------*/
+   dword PixelLayout(dword BitmapType, PixelClass* TGA_Pixel)
+      {
+      switch (BitmapType)
+         {
+         case BMP_TYPE_A    :
+         case BMP_TYPE_C    : if (TGA_Pixel == &Pixel_A)    {return TGA_LAYOUT_SAME;} break;
+         case BMP_TYPE_BGR  : if (TGA_Pixel == &Pixel_BGR)  {return TGA_LAYOUT_SAME;} break;
+         case BMP_TYPE_RGB  : if (TGA_Pixel == &Pixel_BGR)  {return TGA_LAYOUT_SWAP;} break;
+         case BMP_TYPE_RGBA : if (TGA_Pixel == &Pixel_BGRA) {return TGA_LAYOUT_SWAP;} break;
+         }
+
+      return TGA_LAYOUT_CONVERT;
+      }
+
+   /*-------------------------------------------------------------------------
+      Converts a row of pixels. The increments may be negative, for rows
+      stored right to left. Pixels with the same layout are copied with a
+      single memcpy( ) where possible, 32 bit pixels are swapped a dword at a
+      time, and only the other formats are converted through iColorRec.
+
+      Dest      : Destination of the first pixel.
+      DestIncr  : Destination pixel increment in bytes.
+      DestPixel : Class pointer for writing the destination pixel format.
+      Src       : Source of the first pixel.
+      SrcIncr   : Source pixel increment in bytes.
+      SrcPixel  : Class pointer for reading the source pixel format.
+      Count     : Number of pixels to convert.
+      Layout    : Pixel layout (see TGA_LAYOUT_* above).
+     -------------------------------------------------------------------------*/
+   void ConvertPixels(byte* Dest, int DestIncr, PixelClass* DestPixel, byte* Src, int SrcIncr, PixelClass* SrcPixel, dword Count, dword Layout)
+      {
+      dword Bytes = (SrcIncr < 0) ? (dword)-SrcIncr : (dword)SrcIncr;
+
+      switch (Layout)
+         {
+         case TGA_LAYOUT_SAME :  {
+                                 if ((DestIncr == SrcIncr) && (SrcIncr > 0)) {memcpy(Dest, Src, Count * Bytes); break;}
+                                 for (; Count > 0; Count--, Dest += DestIncr, Src += SrcIncr) {memcpy(Dest, Src, Bytes);}
+                                 break;
+                                 }
+
+         case TGA_LAYOUT_SWAP :  {
+                                 if (Bytes == 4)
+                                    {
+                                    for (; Count > 0; Count--, Dest += DestIncr, Src += SrcIncr)
+                                       {
+                                       dword Color = *(dword*)Src;
+                                       *(dword*)Dest = (Color & 0xFF00FF00) | ((Color >> 16) & 0x000000FF) | ((Color & 0x000000FF) << 16);
+                                       }
+                                    }
+                                 else
+                                    {
+                                    for (; Count > 0; Count--, Dest += DestIncr, Src += SrcIncr)
+                                       {
+                                       byte Color = Src[0];
+                                       Dest[0] = Src[2];
+                                       Dest[1] = Src[1];
+                                       Dest[2] = Color;
+                                       }
+                                    }
+                                 break;
+                                 }
+
+         default              :  {
+                                 iColorRec Color;
+                                 for (; Count > 0; Count--, Dest += DestIncr, Src += SrcIncr)
+                                    {
+                                    SrcPixel->Read(Src, &Color);
+                                    DestPixel->Write(Dest, &Color);
+                                    }
+                                 break;
+                                 }
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Copies the pixel at Dest to the next Count-1 pixels.
+
+      Dest  : Pixel to repeat.
+      Incr  : Pixel increment in bytes.
+      Count : Number of pixels in the run, including the first one.
+     -------------------------------------------------------------------------*/
+   inline void RepeatPixel(byte* Dest, int Incr, dword Count)
+      {
+      dword Bytes = (Incr < 0) ? (dword)-Incr : (dword)Incr;
+      if ((Bytes == 1) && (Count > 0)) {memset((Incr < 0) ? Dest - (Count - 1) : Dest, *Dest, Count); return;}
+
+      for (byte* Ptr = Dest + Incr; Count > 1; Count--, Ptr += Incr) {memcpy(Ptr, Dest, Bytes);}
+      }
+
 
    /*=========================================================================
      TGA file reading functions.
@@ -107,22 +223,22 @@ class TGA_Class
    /*-------------------------------------------------------------------------
       Reads the color table from the TGA file. It can handle color table formats
       such as 15, 16, 24 and 32 bits per colors. The function requires the bitmap
-      bits per pixel to be 8, that is the image must be a 256 color format. 
+      bits per pixel to be 8, that is the image must be a 256 color format.
       Returns true on success.
 
-      TGA_File   : File to read the color table.
+      View       : File view, positioned at the color table.
       Header     : TGA file header.
       ColorTable : Pointer to the 256, RGB format color table.
      -------------------------------------------------------------------------*/
-   bool ReadColorTable(FILE* TGA_File, FileHeaderRec* Header, byte* ColorTable)
+   bool ReadColorTable(FileViewClass* View, FileHeaderRec* Header, byte* ColorTable)
       {
-      if ((TGA_File == NULL) || (Header == NULL) || (ColorTable == NULL)) {return false;}
-   
+      if ((View == NULL) || (Header == NULL) || (ColorTable == NULL)) {return false;}
+
       //Seek for the color entry offset
-      fseek(TGA_File, Header->ColMapEntOffs, SEEK_CUR);
+      if (!View->Skip(Header->ColMapEntOffs)) {printf("TGA_Class::ReadColorTable( ): File read error.\n"); return false;}
 
       //Ensure that there are no more than 256 color entries
-      if (Header->ColMapEntCount > COLOR_TABLE_MAX_COUNT) 
+      if (Header->ColMapEntCount > COLOR_TABLE_MAX_COUNT)
          {printf("TGA_Class::ReadColorTable( ): Color table entry count is > COLOR_TABLE_MAX_COUNT.\n"); return false;}
 
       //-- Determine which pixel function to use --
@@ -138,62 +254,40 @@ class TGA_Class
          }
 
       //-- Read the color table --
-      byte* ColorTablePtr = ColorTable;
-      for (dword Incr = 0; Incr < Header->ColMapEntCount; Incr++)
-         {
-         //Read the colors into the temp buffer
-         byte ColorBuffer[16];
-         fread(&ColorBuffer, BytesPerCT, 1, TGA_File);
-         if (ferror(TGA_File) != 0) {printf("TGA_Class::ReadColorTable( ): File read error.\n"); return false;}
-
-         //Do the color conversion
-         iColorRec Color;
-         TGA_Pixel->Read(ColorBuffer, &Color);
-         Pixel_RGB.Write(ColorTablePtr, &Color);
+      byte* ColorBuffer = View->Take(Header->ColMapEntCount * BytesPerCT);
+      if (ColorBuffer == NULL) {printf("TGA_Class::ReadColorTable( ): File read error.\n"); return false;}
 
-         ColorTablePtr += 3;
-         }
+      ConvertPixels(ColorTable, 3, &Pixel_RGB, ColorBuffer, BytesPerCT, TGA_Pixel, Header->ColMapEntCount,
+                    (BytesPerCT == 3) ? TGA_LAYOUT_SWAP : TGA_LAYOUT_CONVERT);
 
       return true;
       }
 
    /*-------------------------------------------------------------------------
-      Reads an uncompressed bitmap from the TGA file.
-   
-      TGA_File          : TGA file to read from.
+      Reads an uncompressed bitmap from the TGA file. Each scanline is
+      converted straight from the file view.
+
+      View              : File view, positioned at the bitmap.
       Bitmap            : Target bitmap data.
       LoopData          : Various data used in the read loop.
       TGA_Pixel         : Class pointer for reading the TGA's pixel format.
       TGA_BytesPerPixel : The size of the TGA pixel format.
+      Layout            : Pixel layout (see TGA_LAYOUT_* above).
      -------------------------------------------------------------------------*/
-   bool ReadBitmap(FILE* TGA_File, BitmapRec* Bitmap, ReadLoopDataRec* LoopData, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel)
+   bool ReadBitmap(FileViewClass* View, BitmapRec* Bitmap, ReadLoopDataRec* LoopData, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel, dword Layout)
       {
-      if ((TGA_File == NULL) || (Bitmap == NULL) || 
+      if ((View == NULL) || (Bitmap == NULL) ||
           (LoopData == NULL) || (TGA_Pixel == NULL)) {return false;}
 
-      //Local stuff
-      iColorRec Color;
-      byte ColorBuffer[16];
-
       //-- Loop through every scanline --
       byte* ScanLinePtr = LoopData->StartPtr;
-      while (ScanLinePtr != LoopData->EndPtr)
+      for (dword V = 0; V < Bitmap->V_Res; V++)
          {
-         //Read every pixel in scanline
-         byte* PixelPtr = ScanLinePtr + LoopData->PixelStart;
-         while (PixelPtr != (ScanLinePtr + LoopData->PixelEnd))
-            {
-            //Read the colors into the temp buffer
-            fread(&ColorBuffer, TGA_BytesPerPixel, 1, TGA_File);
-            if (ferror(TGA_File) != 0) 
-               {printf("TGA_Class::ReadBitmap( ): File read error.\n"); return false;}
+         byte* Src = View->Take(Bitmap->U_Res * TGA_BytesPerPixel);
+         if (Src == NULL) {printf("TGA_Class::ReadBitmap( ): File read error.\n"); return false;}
 
-            //Do the color conversion
-            TGA_Pixel->Read(ColorBuffer, &Color);
-            Bitmap->Pixel->Write(PixelPtr, &Color);
-
-            PixelPtr += LoopData->PixelIncr;
-            }
+         ConvertPixels(ScanLinePtr + LoopData->PixelStart, LoopData->PixelIncr, Bitmap->Pixel,
+                       Src, TGA_BytesPerPixel, TGA_Pixel, Bitmap->U_Res, Layout);
 
          ScanLinePtr += LoopData->ScanLineIncr;
          }
@@ -202,75 +296,70 @@ class TGA_Class
       }
 
    /*-------------------------------------------------------------------------
-      Reads a RLE compressed bitmap from the TGA file.
-   
-      TGA_File          : TGA file to read from.
+      Reads a RLE compressed bitmap from the TGA file. Each packet is decoded
+      as a whole: raw packets are converted straight from the file view, and
+      repeat packets convert their color once, and then copy it. Packets may
+      run across scanlines, as allowed by the original TGA specification.
+
+      View              : File view, positioned at the bitmap.
       Bitmap            : Target bitmap data.
       LoopData          : Various data used in the read loop.
       TGA_Pixel         : Class pointer for reading the TGA's pixel format.
       TGA_BytesPerPixel : The size of the TGA pixel format.
+      Layout            : Pixel layout (see TGA_LAYOUT_* above).
      -------------------------------------------------------------------------*/
-   bool ReadBitmapRLE(FILE* TGA_File, BitmapRec* Bitmap, ReadLoopDataRec* LoopData, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel)
+   bool ReadBitmapRLE(FileViewClass* View, BitmapRec* Bitmap, ReadLoopDataRec* LoopData, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel, dword Layout)
       {
-      if ((TGA_File == NULL) || (Bitmap == NULL) || 
+      if ((View == NULL) || (Bitmap == NULL) ||
           (LoopData == NULL) || (TGA_Pixel == NULL)) {return false;}
 
       //Local stuff
-      bool Repeat;
-      byte RLE_Byte;
-      byte RepeatColor[16];
-      iColorRec Color;
+      bool  Repeat      = false;
+      dword Run         = 0;                     //Pixels left in the current packet
+      byte* RepeatColor = NULL;
 
       //-- Loop through every scanline --
       byte* ScanLinePtr = LoopData->StartPtr;
-      while (ScanLinePtr != LoopData->EndPtr)
+      for (dword V = 0; V < Bitmap->V_Res; V++)
          {
-         //Read every pixel in scanline
          byte* PixelPtr = ScanLinePtr + LoopData->PixelStart;
-         while (PixelPtr != (ScanLinePtr + LoopData->PixelEnd))
+         dword U        = 0;
+         while (U < Bitmap->U_Res)
             {
-            Repeat = false;                              //Assume no color repeat
-
-            fread(&RLE_Byte, 1, 1, TGA_File);            //Get RLE code
-            if (ferror(TGA_File) != 0) 
-               {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
-         
-            if (RLE_Byte & 0x80)                         //Is the repeat flag set?
+            //-- Fetch the next packet --
+            if (Run == 0)
                {
-               //Read the repeating color from file
-               fread(&RepeatColor, TGA_BytesPerPixel, 1, TGA_File);
-               if (ferror(TGA_File) != 0) 
-                  {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
-
-               //Do the color conversion
-               TGA_Pixel->Read(RepeatColor, &Color);
-               Repeat = !Repeat;                         //Set Repeat flag
+               byte* RLE_Byte = View->Take(1);
+               if (RLE_Byte == NULL) {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
+
+               Run    = ((dword)*RLE_Byte & 0x7F) + 1;
+               Repeat = (*RLE_Byte & 0x80) != 0;
+               if (Repeat)
+                  {
+                  RepeatColor = View->Take(TGA_BytesPerPixel);
+                  if (RepeatColor == NULL) {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
+                  }
                }
 
-            //-- Do the run as required, or until the scanline fills up --
-            dword Run = ((dword)RLE_Byte & 0x7F) + 1;
-            while ((Run > 0) && (PixelPtr != (ScanLinePtr + LoopData->PixelEnd)))
+            //-- Do the run, or the part of it that fits in this scanline --
+            dword Count = Bitmap->U_Res - U;
+            if (Count > Run) {Count = Run;}
+
+            if (Repeat)
                {
-               //Ensure that we don't write outside the allocated memory
-               if (PixelPtr == LoopData->EndPtr) {return false;}
-               
-               if (Repeat)                               //For repeats we copy the pixel colors
-                  {Bitmap->Pixel->Write(PixelPtr, &Color);} 
-               else                                      //Else we fetch colors from file
-                  {
-                  //Read the colors into the temp buffer
-                  fread(&RepeatColor, TGA_BytesPerPixel, 1, TGA_File);
-                  if (ferror(TGA_File) != 0) 
-                     {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
-
-                  //Do the color conversion
-                  TGA_Pixel->Read(RepeatColor, &Color);
-                  Bitmap->Pixel->Write(PixelPtr, &Color);
-                  } 
-
-               PixelPtr += LoopData->PixelIncr;          //Advance to the next pixel
-               Run--;
+               ConvertPixels(PixelPtr, LoopData->PixelIncr, Bitmap->Pixel, RepeatColor, TGA_BytesPerPixel, TGA_Pixel, 1, Layout);
+               RepeatPixel(PixelPtr, LoopData->PixelIncr, Count);
+               }
+            else
+               {
+               byte* Src = View->Take(Count * TGA_BytesPerPixel);
+               if (Src == NULL) {printf("TGA_Class::ReadBitmapRLE( ): File read error.\n"); return false;}
+               ConvertPixels(PixelPtr, LoopData->PixelIncr, Bitmap->Pixel, Src, TGA_BytesPerPixel, TGA_Pixel, Count, Layout);
                }
+
+            PixelPtr += (int)Count * LoopData->PixelIncr;
+            U        += Count;
+            Run      -= Count;
             }
 
          ScanLinePtr += LoopData->ScanLineIncr;
@@ -284,205 +373,194 @@ class TGA_Class
      TGA file saving functions.
      ============================================================================*/
 
+   /*-------------------------------------------------------------------------
+     Returns the number of leading bytes that are equal in the two arrays,
+     up to Max. The bytes are compared a dword at a time.
+     -------------------------------------------------------------------------*/
+   inline dword MatchBytes(byte* Ptr1, byte* Ptr2, dword Max)
+      {
+      dword Count = 0;
+      while (((Count + 4) <= Max) && (*(dword*)(Ptr1 + Count) == *(dword*)(Ptr2 + Count))) {Count += 4;}
+      while ((Count < Max) && (Ptr1[Count] == Ptr2[Count])) {Count++;}
+      return Count;
+      }
+
    /*-------------------------------------------------------------------------
      Compares two pixels. Returns true if equal.
      -------------------------------------------------------------------------*/
-   inline bool ComparePixel(byte* Pixel1, byte* Pixel2, int BytesPerPixel)
+   inline bool ComparePixel(byte* Pixel1, byte* Pixel2, dword BytesPerPixel)
       {
-      int Offs = 0;
-      while (Offs < BytesPerPixel)
+      switch (BytesPerPixel)
          {
-         if (Pixel1[Offs] != Pixel2[Offs]) {return false;}
-         Offs++;
+         case 1  : return *Pixel1 == *Pixel2;
+         case 2  : return *(word*)Pixel1 == *(word*)Pixel2;
+         case 3  : return (*(word*)Pixel1 == *(word*)Pixel2) && (Pixel1[2] == Pixel2[2]);
+         case 4  : return *(dword*)Pixel1 == *(dword*)Pixel2;
+         default : return memcmp(Pixel1, Pixel2, BytesPerPixel) == 0;
          }
-
-      return true;
       }
 
    /*-------------------------------------------------------------------------
-      This function determines the run-length of an image. It returns true if
-      the pixels are repeating, returns false if the pixels are 
-      non-repeating.
-
-      Bitmap      : Bitmap data to process.
-      Pixel       : Current pixel pointer.
-      FrameEndPtr : Pointer to the end of the frame.
-      RunCount    : Number of (non-)repetitions.
+      RLE compresses a scanline of TGA pixels, and returns the end of the
+      packed data. The packets don't run across scanlines. A run of
+      repeating pixels is found by comparing the scanline with itself,
+      shifted by one pixel, so the run length doesn't depend on the pixel
+      size. A raw packet ends just before the next pair of equal pixels.
+
+      Dest          : Buffer to store the packets.
+      ScanLine      : Scanline to compress.
+      Count         : Number of pixels in the scanline.
+      BytesPerPixel : The size of the TGA pixel format.
      -------------------------------------------------------------------------*/
-   inline bool FindRepeatingPixels(BitmapRec* Bitmap, byte* Pixel, byte* FrameEndPtr, int &RunCount)
+   byte* PackScanLine(byte* Dest, byte* ScanLine, dword Count, dword BytesPerPixel)
       {
-      bool RepeatFlag = false;
-
-      //Find the run length of the repeating pixel
-      RunCount = 0;
-      byte* NextPixel = Pixel + Bitmap->BytesPerPixel;
-            
-      while (ComparePixel(Pixel, NextPixel, Bitmap->BytesPerPixel) && 
-             (NextPixel <= FrameEndPtr) && (RunCount < 0x0000007F))
+      while (Count > 0)
          {
-         NextPixel += Bitmap->BytesPerPixel; 
-         RunCount++;
-         }
+         dword Max = (Count < TGA_RUN_MAX) ? Count : TGA_RUN_MAX;
+         dword Run = MatchBytes(ScanLine + BytesPerPixel, ScanLine, (Max - 1) * BytesPerPixel) / BytesPerPixel + 1;
 
-      //Find the number of non repeating pixels
-      if (RunCount == 0)
-         {
-         byte* PrevPixel = Pixel;
-         NextPixel       = Pixel + Bitmap->BytesPerPixel;
-         while (!ComparePixel(PrevPixel, NextPixel, Bitmap->BytesPerPixel) && 
-                (NextPixel <= FrameEndPtr) && (RunCount < 0x0000007F))
+         //-- Repeating pixels --
+         if (Run > 1)
             {
-            NextPixel += Bitmap->BytesPerPixel;
-            PrevPixel += Bitmap->BytesPerPixel;
-            RunCount++;
+            *Dest++ = (byte)(0x80 | (Run - 1));
+            memcpy(Dest, ScanLine, BytesPerPixel);
+            Dest += BytesPerPixel;
             }
 
-         //Compensate
-         RunCount--;
+         //-- Non-repeating pixels --
+         else
+            {
+            while ((Run < Max) && (((Run + 1) >= Count) ||
+                   !ComparePixel(ScanLine + Run * BytesPerPixel, ScanLine + (Run + 1) * BytesPerPixel, BytesPerPixel))) {Run++;}
+
+            *Dest++ = (byte)(Run - 1);
+            memcpy(Dest, ScanLine, Run * BytesPerPixel);
+            Dest += Run * BytesPerPixel;
+            }
+
+         ScanLine += Run * BytesPerPixel;
+         Count    -= Run;
          }
-      else {RepeatFlag = true;}
-      
-      return RepeatFlag;
+
+      return Dest;
       }
 
    /*-------------------------------------------------------------------------
-      Writes the color table to the TGA file. The function requires the bitmap
-      bits per pixel to be 8, that is the image must be a 256 color format. 
-      Returns true on success.
-
-      TGA_File   : File to read the color table.
-      Header     : TGA file header.
-      ColorTable : Pointer to the 256, RGB format color table.
+      Ensures that the encoding buffer has at least Size bytes. The buffer
+      only grows, and it's kept for the next save. Returns true on success.
      -------------------------------------------------------------------------*/
-   bool WriteColorTable(FILE* TGA_File, FileHeaderRec* Header, byte* ColorTable)
+   bool ReserveBuffer(dword Size)
       {
-      if ((TGA_File == NULL) || (Header == NULL) || (ColorTable == NULL)) {return false;}
-   
-      //Local variables
-      byte ColorBuffer[16];
-      iColorRec Color;
+      if (Size <= BufferSize) {return true;}
 
-      //-- Save the color table --
-      for (dword Entry = 0; Entry < COLOR_TABLE_MAX_COUNT; Entry++)
-         {
-         //Convert the RGB color to BGR type
-         Pixel_RGB.Read((ColorTable + Entry*3), &Color);
-         Pixel_BGR.Write(ColorBuffer, &Color);
-            
-         //Save color
-         fwrite(ColorBuffer, 3, 1, TGA_File);
-         if (ferror(TGA_File) != 0) 
-            {printf("TGA_Class::WriteColorTable( ): File write error.\n"); return false;}
-         }
+      if (Buffer != NULL) {delete[] Buffer;}
+      BufferSize = 0;
+
+      Buffer = new byte[Size];
+      if (Buffer == NULL) {printf("TGA_Class::ReserveBuffer( ): Memory allocation failed.\n"); return false;}
 
+      BufferSize = Size;
       return true;
       }
 
    /*-------------------------------------------------------------------------
-      Write an uncompressed bitmap to the TGA file.
-   
-      TGA_File          : TGA file to read from.
-      Bitmap            : Source bitmap data.
-      TGA_Pixel         : Class pointer for reading the TGA's pixel format.
-      TGA_BytesPerPixel : The size of the TGA pixel format.
+      Stores the file header in the buffer, and returns the end of it.
      -------------------------------------------------------------------------*/
-   bool WriteBitmap(FILE* TGA_File, BitmapRec* Bitmap, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel)
+   byte* WriteHeader(byte* Dest, FileHeaderRec* Header)
       {
-      if ((TGA_File == NULL) || (Bitmap == NULL) || (TGA_Pixel == NULL)) {return false;}
-
-      //Local stuff
-      iColorRec Color;
-      byte ColorBuffer[16];
+      Dest[0] = Header->ID_FieldSize;
+      Dest[1] = Header->ColMapType;
+      Dest[2] = Header->ImageType;
+      memcpy(&Dest[3],  &Header->ColMapEntOffs,  2);
+      memcpy(&Dest[5],  &Header->ColMapEntCount, 2);
+      Dest[7] = Header->ColMapEntSize;
+      memcpy(&Dest[8],  &Header->X_Origin,       2);
+      memcpy(&Dest[10], &Header->Y_Origin,       2);
+      memcpy(&Dest[12], &Header->X_Res,          2);
+      memcpy(&Dest[14], &Header->Y_Res,          2);
+      Dest[16] = Header->BitsPerPixel;
+      Dest[17] = Header->ImageDesc;
+
+      return Dest + TGA_HEADER_SIZE;
+      }
 
-      for (byte* PixelPtr = Bitmap->FramePtr; PixelPtr < (Bitmap->FramePtr + Bitmap->Size); PixelPtr += Bitmap->BytesPerPixel)
-         {
-         //Convert color type
-         Bitmap->Pixel->Read(PixelPtr, &Color);
-         TGA_Pixel->Write(ColorBuffer, &Color);
-            
-         //Save color
-         fwrite(ColorBuffer, TGA_BytesPerPixel, 1, TGA_File);
-         if (ferror(TGA_File) != 0) 
-            {printf("TGA_Class::WriteBitmap( ): File write error.\n"); return false;}
-         }
+   /*-------------------------------------------------------------------------
+      Stores the color table in the buffer, and returns the end of it. The
+      function requires the bitmap bits per pixel to be 8, that is the image
+      must be a 256 color format.
 
-      return true;
+      Dest       : Buffer to store the color table.
+      ColorTable : Pointer to the 256, RGB format color table.
+     -------------------------------------------------------------------------*/
+   byte* WriteColorTable(byte* Dest, byte* ColorTable)
+      {
+      ConvertPixels(Dest, 3, &Pixel_BGR, ColorTable, 3, &Pixel_RGB, COLOR_TABLE_MAX_COUNT, TGA_LAYOUT_SWAP);
+      return Dest + COLOR_TABLE_MAX_COUNT * 3;
       }
 
    /*-------------------------------------------------------------------------
-      Write a RLE compressed bitmap to the TGA file.
-   
-      TGA_File          : TGA file to read from.
+      Stores an uncompressed bitmap in the buffer, and returns the end of it.
+      The frame is converted with one call, so matching formats are copied
+      as a single block.
+
+      Dest              : Buffer to store the bitmap.
       Bitmap            : Source bitmap data.
-      TGA_Pixel         : Class pointer for reading the TGA's pixel format.
+      TGA_Pixel         : Class pointer for writing the TGA's pixel format.
       TGA_BytesPerPixel : The size of the TGA pixel format.
+      Layout            : Pixel layout (see TGA_LAYOUT_* above).
      -------------------------------------------------------------------------*/
-   bool WriteBitmapRLE(FILE* TGA_File, BitmapRec* Bitmap, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel)
+   byte* WriteBitmap(byte* Dest, BitmapRec* Bitmap, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel, dword Layout)
       {
-      if ((TGA_File == NULL) || (Bitmap == NULL) || (TGA_Pixel == NULL)) {return false;}
+      dword Count = Bitmap->U_Res * Bitmap->V_Res;
+      ConvertPixels(Dest, TGA_BytesPerPixel, TGA_Pixel, Bitmap->FramePtr, Bitmap->BytesPerPixel, Bitmap->Pixel, Count, Layout);
+      return Dest + Count * TGA_BytesPerPixel;
+      }
 
-      //Local stuff
-      iColorRec Color;
-      byte ColorBuffer[16];
-
-      //-- Go trough every pixel --
-      byte* Pixel       = Bitmap->FramePtr;
-      byte* FrameEndPtr = Bitmap->FramePtr + Bitmap->Size;
-      int U = 0;
-      while (Pixel < FrameEndPtr)
+   /*-------------------------------------------------------------------------
+      Stores a RLE compressed bitmap in the buffer, and returns the end of it.
+      Each scanline is converted to the TGA format first (unless the formats
+      are the same), and then packed.
+
+      Dest              : Buffer to store the bitmap.
+      ScanLine          : Buffer for one converted scanline.
+      Bitmap            : Source bitmap data.
+      TGA_Pixel         : Class pointer for writing the TGA's pixel format.
+      TGA_BytesPerPixel : The size of the TGA pixel format.
+      Layout            : Pixel layout (see TGA_LAYOUT_* above).
+     -------------------------------------------------------------------------*/
+   byte* WriteBitmapRLE(byte* Dest, byte* ScanLine, BitmapRec* Bitmap, PixelClass* TGA_Pixel, dword TGA_BytesPerPixel, dword Layout)
+      {
+      byte* ScanLinePtr = Bitmap->FramePtr;
+      for (dword V = 0; V < Bitmap->V_Res; V++)
          {
-         //Find repetitions/non-repetitions
-         int RunCount = 0;
-         bool RepeatFlag = FindRepeatingPixels(Bitmap, Pixel, FrameEndPtr, RunCount);
-
-         //Reset U on overflow
-         if (U >= (int)Bitmap->U_Res) {U = 0;}
-
-         //Calculate the remaining pixels in this scanline, and 
-         // truncate the run lenght if necessary.
-         int U_Rem = (int)Bitmap->U_Res - U - 1;
-         if (RunCount > U_Rem) {RunCount = U_Rem;}
-         U += (RunCount+1);
-
-         //Setup the RLE byte code
-         byte RLE_Code = (byte)RunCount;
-         if (RepeatFlag) 
-            {
-            RLE_Code |= 0x80;                            //Set repeat flag
-            Pixel += (RunCount * Bitmap->BytesPerPixel); //Advance to the second last postion of the run
-            RunCount = 0;                                //Don't write repeatedly
-            }
-            
-         //Save RLE byte code
-         fwrite(&RLE_Code, 1, 1, TGA_File);
-         if (ferror(TGA_File) != 0) 
-            {printf("TGA_Class::WriteBitmapRLE( ): File write error.\n"); return false;}
-
-         //Save the repeating/non-repeating pixels
-         while (RunCount >= 0)
+         byte* Src = ScanLinePtr;
+         if (Layout != TGA_LAYOUT_SAME)
             {
-            //Convert color type
-            Bitmap->Pixel->Read(Pixel, &Color);
-            TGA_Pixel->Write(ColorBuffer, &Color);
-               
-            //Save color
-            fwrite(ColorBuffer, TGA_BytesPerPixel, 1, TGA_File);
-            if (ferror(TGA_File) != 0) 
-               {printf("TGA_Class::WriteBitmapRLE( ): File write error.\n"); return false;}
-
-            //Advance to the next pixel
-            Pixel += Bitmap->BytesPerPixel;
-            RunCount--;
+            ConvertPixels(ScanLine, TGA_BytesPerPixel, TGA_Pixel, ScanLinePtr, Bitmap->BytesPerPixel, Bitmap->Pixel, Bitmap->U_Res, Layout);
+            Src = ScanLine;
             }
+
+         Dest = PackScanLine(Dest, Src, Bitmap->U_Res, TGA_BytesPerPixel);
+         ScanLinePtr += Bitmap->BytesPerLine;
          }
 
-      return true;
+      return Dest;
       }
 
 
    /*==== Public Declarations ================================================*/
    public:
 
+   /*---- Constructor --------------------------------------------------------*/
+   TGA_Class(void)
+      {
+      Buffer     = NULL;
+      BufferSize = 0;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~TGA_Class(void) {if (Buffer != NULL) {delete[] Buffer; Buffer = NULL;}}
+
    /*-------------------------------------------------------------------------
       Reads a TGA file. Returns true on success.
 
@@ -501,33 +579,37 @@ class TGA_Class
       ReadLoopDataRec LoopData;
       PixelClass*     TGA_Pixel = &Pixel_NULL;
       dword           TGA_BytesPerPixel;
+      dword           Layout;
       bool            RLE_Data  = false;
+      FileViewClass   View;
+      byte*           HeaderPtr;
 
       //-- Reset some of the data records in Bitmap --
       Bitmap->DeleteData();
  
       //-- Open the TGA file --
-      FILE* TGA_File = fopen(FileName, "rb");
-      if (TGA_File == NULL) {return false;}
+      if (!View.Open(FileName)) {return false;}
    
       //-- Read the file header --
-      fseek(TGA_File, 0, SEEK_SET);
-      fread(&Header.ID_FieldSize,   1, 1, TGA_File);
-      fread(&Header.ColMapType,     1, 1, TGA_File);
-      fread(&Header.ImageType,      1, 1, TGA_File);
-      fread(&Header.ColMapEntOffs,  2, 1, TGA_File);
-      fread(&Header.ColMapEntCount, 2, 1, TGA_File);
-      fread(&Header.ColMapEntSize,  1, 1, TGA_File);
-      fread(&Header.X_Origin,       2, 1, TGA_File);
-      fread(&Header.Y_Origin,       2, 1, TGA_File);
-      fread(&Header.X_Res,          2, 1, TGA_File);
-      fread(&Header.Y_Res,          2, 1, TGA_File);
-      fread(&Header.BitsPerPixel,   1, 1, TGA_File);
-      fread(&Header.ImageDesc,      1, 1, TGA_File);
-      if (ferror(TGA_File) != 0) 
+      HeaderPtr = View.Take(TGA_HEADER_SIZE);
+      if (HeaderPtr == NULL)
          {printf("TGA_Class::Read( ): File read error.\n"); goto _ReadTGA_ExitError;}
 
-      fseek(TGA_File, Header.ID_FieldSize, SEEK_CUR);
+      Header.ID_FieldSize   = HeaderPtr[0];
+      Header.ColMapType     = HeaderPtr[1];
+      Header.ImageType      = HeaderPtr[2];
+      Header.ColMapEntOffs  = FileViewClass::GetWord(&HeaderPtr[3]);
+      Header.ColMapEntCount = FileViewClass::GetWord(&HeaderPtr[5]);
+      Header.ColMapEntSize  = HeaderPtr[7];
+      Header.X_Origin       = FileViewClass::GetWord(&HeaderPtr[8]);
+      Header.Y_Origin       = FileViewClass::GetWord(&HeaderPtr[10]);
+      Header.X_Res          = FileViewClass::GetWord(&HeaderPtr[12]);
+      Header.Y_Res          = FileViewClass::GetWord(&HeaderPtr[14]);
+      Header.BitsPerPixel   = HeaderPtr[16];
+      Header.ImageDesc      = HeaderPtr[17];
+
+      if (!View.Skip(Header.ID_FieldSize))
+         {printf("TGA_Class::Read( ): File read error.\n"); goto _ReadTGA_ExitError;}
 
    
       //==== Setup bitmap flags and function pointers ====
@@ -598,14 +680,12 @@ class TGA_Class
       if (Header.ImageDesc & TGA_PIXEL_R2L_MASK)
          {
          LoopData.PixelStart   =  Bitmap->BytesPerLine - Bitmap->BytesPerPixel;
-         LoopData.PixelEnd     = -1;
          LoopData.PixelIncr    = -(int)Bitmap->BytesPerPixel;
          }
       //Row of pixels arranged left to right
       else
          {
          LoopData.PixelStart   =  0;
-         LoopData.PixelEnd     =  Bitmap->BytesPerLine;
          LoopData.PixelIncr    =  Bitmap->BytesPerPixel;
          }
 
@@ -613,14 +693,12 @@ class TGA_Class
       if (Header.ImageDesc & TGA_PIXEL_T2B_MASK)
          {
          LoopData.StartPtr     =  Bitmap->BitmapPtr;
-         LoopData.EndPtr       =  Bitmap->BitmapPtr + Bitmap->Size;
          LoopData.ScanLineIncr =  Bitmap->BytesPerLine;
          }
       //Scanlines are arranged bottom to top
       else
          {
          LoopData.StartPtr     =  Bitmap->BitmapPtr + Bitmap->Size - Bitmap->BytesPerLine;
-         LoopData.EndPtr       =  Bitmap->BitmapPtr - Bitmap->BytesPerLine;
          LoopData.ScanLineIncr = -(int)Bitmap->BytesPerLine;
          }
 
@@ -628,32 +706,33 @@ class TGA_Class
       //-- Read the color table when needed --
       if (Bitmap->Flags & BMP_COLOR_TABLE)
          {
-         if(!ReadColorTable(TGA_File, &Header, Bitmap->ColorTablePtr)) 
+         if(!ReadColorTable(&View, &Header, Bitmap->ColorTablePtr)) 
             {printf("TGA_Class::ReadColorTable( ) failed.\n"); goto _ReadTGA_ExitError;}
          }
 
 
       //-- Read the TGA bitmap --
+      Layout = PixelLayout(Bitmap->Flags & BMP_TYPE_MASK, TGA_Pixel);
       if (!RLE_Data)
          {
-         if(!ReadBitmap(TGA_File, Bitmap, &LoopData, TGA_Pixel, TGA_BytesPerPixel))
+         if(!ReadBitmap(&View, Bitmap, &LoopData, TGA_Pixel, TGA_BytesPerPixel, Layout))
             {printf("TGA_Class::ReadBitmap( ) failed.\n"); goto _ReadTGA_ExitError;}
          }
       else
          {
-         if(!ReadBitmapRLE(TGA_File, Bitmap, &LoopData, TGA_Pixel, TGA_BytesPerPixel))
+         if(!ReadBitmapRLE(&View, Bitmap, &LoopData, TGA_Pixel, TGA_BytesPerPixel, Layout))
             {printf("TGA_Class::ReadBitmapRLE( ) failed.\n"); goto _ReadTGA_ExitError;}
          }
 
 
       //-- Normal exit --
-      if (TGA_File != NULL) {fclose(TGA_File);}
+      View.Close();
       return true;
 
 
       //-- Exit on error --
       _ReadTGA_ExitError:
-      if (TGA_File != NULL) {fclose(TGA_File);}
+      View.Close();
       Bitmap->DeleteData();
       return false;
       }
@@ -677,13 +756,15 @@ class TGA_Class
       FileHeaderRec Header;
       PixelClass*   TGA_Pixel = &Pixel_NULL;
       dword         TGA_BytesPerPixel;
+      dword         Layout;
+      dword         LineSize;
+      dword         FileSize;
+      byte*         FileStart;
+      byte*         FilePtr;
+      FILE*         TGA_File  = NULL;
       char ID_Str[256];
 
 
-      //-- Open the TGA file --
-      FILE* TGA_File = fopen(FileName, "wb");
-      if (TGA_File == NULL) {return false;}
-   
       //-- Prepare file header data --
       ID_Str[0] = 0;
       strcat(ID_Str, "Generated by ");
@@ -772,55 +853,43 @@ class TGA_Class
          default            : printf("TGA_Class::Save( ): Data is an unknown image type.\n"); goto _SaveTGA_ExitError;
          }
    
-      //-- Write the file header --
-      fseek(TGA_File, 0, SEEK_SET);
-      fwrite(&Header.ID_FieldSize,   1, 1, TGA_File);
-      fwrite(&Header.ColMapType,     1, 1, TGA_File);
-      fwrite(&Header.ImageType,      1, 1, TGA_File);
-      fwrite(&Header.ColMapEntOffs,  2, 1, TGA_File);
-      fwrite(&Header.ColMapEntCount, 2, 1, TGA_File);
-      fwrite(&Header.ColMapEntSize,  1, 1, TGA_File);
-      fwrite(&Header.X_Origin,       2, 1, TGA_File);
-      fwrite(&Header.Y_Origin,       2, 1, TGA_File);
-      fwrite(&Header.X_Res,          2, 1, TGA_File);
-      fwrite(&Header.Y_Res,          2, 1, TGA_File);
-      fwrite(&Header.BitsPerPixel,   1, 1, TGA_File);
-      fwrite(&Header.ImageDesc,      1, 1, TGA_File);
-
-      if (ferror(TGA_File) != 0) 
-         {printf("TGA_Class::Save( ): File write error.\n"); goto _SaveTGA_ExitError;}
+      //-- Reserve the buffer for a scanline and the whole file. A RLE packet
+      //   is at least one pixel, so it's at most one byte larger than its pixels. --
+      Layout   = PixelLayout(Bitmap->Flags & BMP_TYPE_MASK, TGA_Pixel);
+      LineSize = Bitmap->U_Res * TGA_BytesPerPixel;
+      FileSize = TGA_HEADER_SIZE + Header.ID_FieldSize + LineSize * Bitmap->V_Res;
+      if (Bitmap->Flags & BMP_COLOR_TABLE) {FileSize += COLOR_TABLE_MAX_COUNT * 3;}
+      if (RLE_Compress) {FileSize += Bitmap->U_Res * Bitmap->V_Res;}
 
-      //-- Save the ID string --
-      if (Header.ID_FieldSize != 0)
-         {
-         fwrite(&ID_Str, Header.ID_FieldSize, 1, TGA_File);
-         if (ferror(TGA_File) != 0) 
-            {printf("TGA_Class::Save( ): File write error.\n"); goto _SaveTGA_ExitError;}
-         }
+      if (!ReserveBuffer(LineSize + FileSize))
+         {printf("TGA_Class::ReserveBuffer( ) failed.\n"); goto _SaveTGA_ExitError;}
 
-  
-      //-- Save the color table if needed --
-      if (Bitmap->Flags & BMP_COLOR_TABLE)
-         {
-         if (!WriteColorTable(TGA_File, &Header, Bitmap->ColorTablePtr))
-            {printf("TGA_Class::WriteColorTable( ) failed.\n"); goto _SaveTGA_ExitError;}
-         }
+      //-- Store the file header, ID string and color table --
+      FileStart = Buffer + LineSize;
+      FilePtr   = WriteHeader(FileStart, &Header);
 
+      memcpy(FilePtr, ID_Str, Header.ID_FieldSize);
+      FilePtr += Header.ID_FieldSize;
 
+      if (Bitmap->Flags & BMP_COLOR_TABLE) {FilePtr = WriteColorTable(FilePtr, Bitmap->ColorTablePtr);}
 
-      //-- Save the bitmap, no RLE compression --
-      if (!RLE_Compress) 
-         {
-         if (!WriteBitmap(TGA_File, Bitmap, TGA_Pixel, TGA_BytesPerPixel))
-            {printf("TGA_Class::WriteBitmap( ) failed.\n"); goto _SaveTGA_ExitError;}
-         }
-      else if (!WriteBitmapRLE(TGA_File, Bitmap, TGA_Pixel, TGA_BytesPerPixel))
-         {printf("TGA_Class::WriteBitmapRLE( ) failed.\n"); goto _SaveTGA_ExitError;}
+      //-- Store the bitmap --
+      if (!RLE_Compress) {FilePtr = WriteBitmap(FilePtr, Bitmap, TGA_Pixel, TGA_BytesPerPixel, Layout);}
+      else {FilePtr = WriteBitmapRLE(FilePtr, Buffer, Bitmap, TGA_Pixel, TGA_BytesPerPixel, Layout);}
+
+
+      //-- Write the whole file --
+      TGA_File = fopen(FileName, "wb");
+      if (TGA_File == NULL) {return false;}
+
+      if (fwrite(FileStart, FilePtr - FileStart, 1, TGA_File) != 1)
+         {printf("TGA_Class::Save( ): File write error.\n"); goto _SaveTGA_ExitError;}
 
+      if (fclose(TGA_File) != 0)
+         {printf("TGA_Class::Save( ): File write error.\n"); TGA_File = NULL; goto _SaveTGA_ExitError;}
 
 
       //-- Normal exit --
-      if (TGA_File != NULL) {fclose(TGA_File);}
       return true;
 
       //-- Exit on error --
@@ -0,0 +1,374 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                                                                            */
+/*                       YUV4MPEG2 Video Stream Output                        */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __Y4M_FMT_CPP__
+#define __Y4M_FMT_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../mem_data/bitmap.cpp"
+
+#if defined (WIN32) || defined (WIN32_NT)
+#  include <io.h>
+#  include <fcntl.h>
+#else
+#  include <unistd.h>
+#endif
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define Y4M_HEADER_SIZE       0x80              //Space reserved for the stream header
+#define Y4M_FRAME_HEADER      "FRAME\n"         //Frame header, precedes the planes of each frame
+#define Y4M_FRAME_HEADER_SIZE 6
+#define Y4M_FPS               30                //Default frame rate of the stream
+
+
+/*---------------------------------------------------------------------------
+  The Y4M class. Writes a sequence of frames into a single YUV4MPEG2 stream,
+  which can be piped directly into a video encoder. The frames are converted
+  to 8-bit Y'CbCr (ITU-R BT.601, studio range) with 4:2:0 chroma, where each
+  chroma sample is the average of a 2x2 pixel block. The conversion is done
+  in integer arithmetic, two scanlines at a time, and each frame is written
+  with a single fwrite( ).
+
+  Note that Pixel_YUV_Class isn't used here, because it stores 9.7 fixed
+  point values with different color difference scales.
+  ---------------------------------------------------------------------------*/
+class Y4M_Class
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   FILE* File;
+   bool  Console;                               //Stream is written to the standard output
+   int   StdOut;                                //Saved standard output handle, restored by Close( )
+   dword FPS;
+   dword U_Res;                                 //Resolution of the stream, set by the first frame
+   dword V_Res;
+   byte* Buffer;                                //Frame buffer: [frame header][Y][Cb][Cr][2 RGB scanlines]
+   dword BufferSize;
+
+   /*-------------------------------------------------------------------------
+      Makes sure the buffer holds at least Size bytes. The buffer is kept
+      between frames.
+     -------------------------------------------------------------------------*/
+   bool ReserveBuffer(dword Size)
+      {
+      if (Size <= BufferSize) {return true;}
+
+      if (Buffer != NULL) {delete[] Buffer; Buffer = NULL;}
+      BufferSize = 0;
+
+      Buffer = new byte[Size];
+      if (Buffer == NULL) {printf("Y4M_Class::ReserveBuffer( ): Failed to allocate memory.\n"); return false;}
+
+      BufferSize = Size;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns a pointer to scanline V of a bitmap in R, G, B byte order. RGB
+      bitmaps are used directly, other types are converted into Scratch.
+     -------------------------------------------------------------------------*/
+   static byte* GetScanLine(BitmapRec* Bitmap, dword V, byte* Scratch)
+      {
+      byte* Src = Bitmap->BitmapPtr + V * Bitmap->BytesPerLine;
+      byte* Dst = Scratch;
+      dword U;
+
+      switch (Bitmap->Flags & BMP_TYPE_MASK)
+         {
+         case BMP_TYPE_RGB  : return Src;
+
+         case BMP_TYPE_RGBA :
+            for (U = 0; U < Bitmap->U_Res; U++, Src += 4, Dst += 3)
+               {Dst[0] = Src[0]; Dst[1] = Src[1]; Dst[2] = Src[2];}
+            break;
+
+         case BMP_TYPE_BGR  :
+            for (U = 0; U < Bitmap->U_Res; U++, Src += 3, Dst += 3)
+               {Dst[0] = Src[2]; Dst[1] = Src[1]; Dst[2] = Src[0];}
+            break;
+
+         default :
+            {
+            iColorRec Color;
+            for (U = 0; U < Bitmap->U_Res; U++, Src += Bitmap->BytesPerPixel, Dst += 3)
+               {
+               Bitmap->Pixel->Read(Src, &Color);
+               Dst[0] = (byte)Color.R; Dst[1] = (byte)Color.G; Dst[2] = (byte)Color.B;
+               }
+            }
+         }
+
+      return Scratch;
+      }
+
+   /*-------------------------------------------------------------------------
+      Converts a pair of RGB scanlines to Y'CbCr. Writes two lines of luma,
+      and one line of each chroma plane. For odd widths the last column is
+      averaged with itself.
+     -------------------------------------------------------------------------*/
+   static void ConvertLinePair(byte* Y0, byte* Y1, byte* Cb, byte* Cr, byte* Line0, byte* Line1, dword Width)
+      {
+      for (dword U = 0; U < Width; U += 2)
+         {
+         dword Step = (U + 1 < Width) ? 3 : 0;
+         int   R0 = Line0[0], G0 = Line0[1], B0 = Line0[2];
+         int   R1 = Line0[Step], G1 = Line0[Step+1], B1 = Line0[Step+2];
+         int   R2 = Line1[0], G2 = Line1[1], B2 = Line1[2];
+         int   R3 = Line1[Step], G3 = Line1[Step+1], B3 = Line1[Step+2];
+
+         //Y = 16 + (66R + 129G + 25B) / 256
+         Y0[0] = (byte)(((66*R0 + 129*G0 + 25*B0 + 128) >> 8) + 16);
+         Y1[0] = (byte)(((66*R2 + 129*G2 + 25*B2 + 128) >> 8) + 16);
+         if (Step != 0)
+            {
+            Y0[1] = (byte)(((66*R1 + 129*G1 + 25*B1 + 128) >> 8) + 16);
+            Y1[1] = (byte)(((66*R3 + 129*G3 + 25*B3 + 128) >> 8) + 16);
+            }
+
+         //Chroma from the sum of the 2x2 block, so the division is by 4*256
+         int R = R0 + R1 + R2 + R3;
+         int G = G0 + G1 + G2 + G3;
+         int B = B0 + B1 + B2 + B3;
+         *Cb++ = (byte)(((-38*R -  74*G + 112*B + 512) >> 10) + 128);
+         *Cr++ = (byte)(((112*R -  94*G -  18*B + 512) >> 10) + 128);
+
+         Y0 += 2; Y1 += 2; Line0 += 6; Line1 += 6;
+         }
+      }
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   dword FrameCount;                            //Number of frames written to the stream
+
+   /*---- Constructor --------------------------------------------------------*/
+   Y4M_Class(void)
+      {
+      File       = NULL;
+      Console    = false;
+      StdOut     = -1;
+      FPS        = Y4M_FPS;
+      U_Res      = 0;
+      V_Res      = 0;
+      Buffer     = NULL;
+      BufferSize = 0;
+      FrameCount = 0;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~Y4M_Class(void)
+      {
+      Close();
+      if (Buffer != NULL) {delete[] Buffer; Buffer = NULL;}
+      BufferSize = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if a stream is open.
+     -------------------------------------------------------------------------*/
+   inline bool IsOpen(void) {return File != NULL;}
+
+   /*-------------------------------------------------------------------------
+      Opens a stream. The stream header is written with the first frame,
+      which also sets the resolution of the stream. Returns true if
+      successful.
+
+      FileName : File name with path to save, or "-" for the standard
+                 output. When streaming to the standard output, any further
+                 console messages are sent to the standard error instead,
+                 until the stream is closed.
+      Rate     : Frame rate in frames per second.
+     -------------------------------------------------------------------------*/
+   bool Open(char* FileName, dword Rate)
+      {
+      Close();
+      if ((FileName == NULL) || (Rate == 0)) {return false;}
+
+      FPS        = Rate;
+      U_Res      = 0;
+      V_Res      = 0;
+      FrameCount = 0;
+
+      if (strcmp(FileName, "-") == 0)
+         {
+         //Keep a binary handle to the standard output for the stream, and
+         //another one to restore it with, then point the standard output at
+         //the standard error
+         fflush(stdout);
+
+         //==== Win32 specific ====
+         #if defined (WIN32) || defined (WIN32_NT)
+            StdOut     = _dup(_fileno(stdout));
+            int Handle = _dup(_fileno(stdout));
+            if ((StdOut == -1) || (Handle == -1))
+               {
+               if (StdOut != -1) {_close(StdOut); StdOut = -1;}
+               if (Handle != -1) {_close(Handle);}
+               printf("Y4M_Class::Open( ): Failed to duplicate the standard output.\n");
+               return false;
+               }
+            _setmode(Handle, _O_BINARY);
+            File = _fdopen(Handle, "wb");
+            if (File == NULL) {_close(Handle); _close(StdOut); StdOut = -1;}
+            else {_dup2(_fileno(stderr), _fileno(stdout));}
+
+         //==== Other OS ====
+         #else
+            StdOut     = dup(fileno(stdout));
+            int Handle = dup(fileno(stdout));
+            if ((StdOut == -1) || (Handle == -1))
+               {
+               if (StdOut != -1) {close(StdOut); StdOut = -1;}
+               if (Handle != -1) {close(Handle);}
+               printf("Y4M_Class::Open( ): Failed to duplicate the standard output.\n");
+               return false;
+               }
+            File = fdopen(Handle, "wb");
+            if (File == NULL) {close(Handle); close(StdOut); StdOut = -1;}
+            else {dup2(fileno(stderr), fileno(stdout));}
+         #endif
+
+         Console = true;
+         }
+      else
+         {
+         File    = fopen(FileName, "wb");
+         Console = false;
+         }
+
+      if (File == NULL) {printf("Y4M_Class::Open( ): Failed to open \"%s\".\n", FileName); return false;}
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends a frame to the stream. All frames must have the same
+      resolution as the first. Returns true if successful.
+
+      Bitmap   : Frame to write, any bitmap type.
+     -------------------------------------------------------------------------*/
+   bool Write(BitmapRec* Bitmap)
+      {
+      if ((File == NULL) || (Bitmap == NULL) || (Bitmap->BitmapPtr == NULL) || (Bitmap->Pixel == NULL)) {return false;}
+      if ((Bitmap->U_Res == 0) || (Bitmap->V_Res == 0)) {return false;}
+
+      //-- The first frame sets the stream resolution --
+      if (FrameCount == 0)
+         {
+         U_Res = Bitmap->U_Res;
+         V_Res = Bitmap->V_Res;
+
+         char Header[Y4M_HEADER_SIZE];
+         int  Size = sprintf(Header, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", U_Res, V_Res, FPS);
+         if (fwrite(Header, Size, 1, File) != 1) {printf("Y4M_Class::Write( ): Failed to write the stream header.\n"); return false;}
+         }
+      else if ((Bitmap->U_Res != U_Res) || (Bitmap->V_Res != V_Res))
+         {printf("Y4M_Class::Write( ): Frame resolution %ux%u doesn't match the stream (%ux%u).\n", Bitmap->U_Res, Bitmap->V_Res, U_Res, V_Res); return false;}
+
+      //-- Build the frame in the buffer --
+      dword ChromaU    = (U_Res + 1) >> 1;
+      dword ChromaV    = (V_Res + 1) >> 1;
+      dword LumaSize   = U_Res * V_Res;
+      dword ChromaSize = ChromaU * ChromaV;
+      dword FrameSize  = Y4M_FRAME_HEADER_SIZE + LumaSize + 2*ChromaSize;
+      if (!ReserveBuffer(FrameSize + 2*U_Res*3)) {return false;}
+
+      memcpy(Buffer, Y4M_FRAME_HEADER, Y4M_FRAME_HEADER_SIZE);
+      byte* Y_Plane  = Buffer + Y4M_FRAME_HEADER_SIZE;
+      byte* Cb_Plane = Y_Plane + LumaSize;
+      byte* Cr_Plane = Cb_Plane + ChromaSize;
+      byte* Scratch0 = Buffer + FrameSize;
+      byte* Scratch1 = Scratch0 + U_Res*3;
+
+      //The last row of an odd height is paired with itself, so its chroma
+      //is averaged vertically over the same line, and the luma is written twice
+      for (dword V = 0; V < V_Res; V += 2)
+         {
+         dword V1    = (V + 1 < V_Res) ? V + 1 : V;
+         byte* Line0 = GetScanLine(Bitmap, V,  Scratch0);
+         byte* Line1 = GetScanLine(Bitmap, V1, Scratch1);
+
+         ConvertLinePair(Y_Plane + V*U_Res, Y_Plane + V1*U_Res, Cb_Plane, Cr_Plane, Line0, Line1, U_Res);
+         Cb_Plane += ChromaU;
+         Cr_Plane += ChromaU;
+         }
+
+      if (fwrite(Buffer, FrameSize, 1, File) != 1) {printf("Y4M_Class::Write( ): Failed to write frame %u.\n", FrameCount); return false;}
+      if (Console) {fflush(File);}
+
+      FrameCount++;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Writes the buffered data of the stream, but keeps it open for further
+      frames. Returns true if successful.
+     -------------------------------------------------------------------------*/
+   bool Flush(void)
+      {
+      if (File == NULL) {return true;}
+      if (fflush(File) != 0) {printf("Y4M_Class::Flush( ): Failed to write the stream.\n"); return false;}
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Closes the stream. If it was written to the standard output, the
+      console messages are sent to the standard output again. Returns false
+      if the remaining data couldn't be written.
+     -------------------------------------------------------------------------*/
+   bool Close(void)
+      {
+      if (File == NULL) {return true;}
+
+      bool Status = (fclose(File) == 0);
+      File    = NULL;
+      Console = false;
+
+      if (StdOut != -1)
+         {
+         fflush(stdout);
+
+         //==== Win32 specific ====
+         #if defined (WIN32) || defined (WIN32_NT)
+            _dup2(StdOut, _fileno(stdout));
+            _close(StdOut);
+
+         //==== Other OS ====
+         #else
+            dup2(StdOut, fileno(stdout));
+            close(StdOut);
+         #endif
+
+         StdOut = -1;
+         }
+
+      if (!Status) {printf("Y4M_Class::Close( ): Failed to close the stream.\n");}
+      return Status;
+      }
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*---------------------------------------------------------------------------
+  Global Declarations.
+  ---------------------------------------------------------------------------*/
+Y4M_Class Y4M;
+
+/*==== End of file ===========================================================*/
+#endif
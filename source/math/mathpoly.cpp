@@ -275,10 +275,10 @@ void inline Poly_Reflect(PointRec* R, PointRec* I, PolygonRec* Polygon)
   ----------------------------------------------------------------------------*/
 void inline Poly_Refract(PointRec* T, PointRec* I, PolygonRec* Polygon, bool Inside)
    {
-   if (Polygon->IdxRefr == 1.0f) {*T = *I; return;} //Don't compute for air
+   if (Polygon->Material->IdxRefr == 1.0f) {*T = *I; return;} //Don't compute for air
 
    PointRec N  = Polygon->GetNormal();
-   float    n  = Polygon->IdxRefr;     //Index of refraction ratio: n = n1/n2, assume IdxRefr/Air
+   float    n  = Polygon->Material->IdxRefr;     //Index of refraction ratio: n = n1/n2, assume IdxRefr/Air
    float    in = n;                    //Assume inverse of n = n (assume the ray is inside the object)
 
    //The ratio for n is different, depending if we're inside or outside
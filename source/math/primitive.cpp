@@ -115,14 +115,24 @@ class PrimitiveClass
       EntityRec* NewEntity = new EntityRec;
       if (NewEntity == NULL) {DeleteGridData(&Grid); return NULL;}
 
-
-      //Polygon colors
-      ColorRec kAmb(0.0f, 0.0f, 0.0f, 0.0f);
-      ColorRec kSpec(0.3f, 0.3f, 0.3f, 0.0f);
-      float    nSpec   = 75.0f;
-      float    Reflect = 0.0f;
-      float    Trans   = 0.0f;
-      float    IdxRefr = 1.0f;
+      //Reserve the Vertices (including the bounding volume) and Polygons
+      if (!NewEntity->Pool.Reserve(Grid.VCount + ENTITY_BV_COUNT, GridRes->U * GridRes->V * 2))
+         {DeleteGridData(&Grid); delete NewEntity; return NULL;}
+
+
+      //Polygon material, shared by all the Polygons
+      MaterialRec* Material = NewEntity->Pool.NewMaterial();
+      if (Material == NULL) {DeleteGridData(&Grid); delete NewEntity; return NULL;}
+
+      Material->kAmb    = ColorRec(0.0f, 0.0f, 0.0f, 0.0f);
+      Material->kDiff   = *kDiff;
+      Material->kSpec   = ColorRec(0.3f, 0.3f, 0.3f, 0.0f);
+      Material->nSpec   = 75.0f;
+      Material->Reflect = 0.0f;
+      Material->Trans   = 0.0f;
+      Material->Opacity = 1.0f;
+      Material->IdxRefr = 1.0f;
+      NewEntity->Pool.Default = Material;
   
 
       //Setup the counters
@@ -140,7 +150,7 @@ class PrimitiveClass
          for (Grid.Index.U = 0; Grid.Index.U <= GridRes->U; Grid.Index.U++)
             {
             //Allocate a new Vertex
-            VertexRec* Vertex = new VertexRec;
+            VertexRec* Vertex = NewEntity->Pool.NewVertex();
             if (Vertex == NULL) 
                {
                DeleteGridData(&Grid);
@@ -153,10 +163,9 @@ class PrimitiveClass
          
             //Insert the vertex into the Grid and VertexList of Entity
             Grid.Array[Grid.Index.V*Grid.VPerLine + Grid.Index.U] = Vertex;
-            if (!LinkedList.Insert(NewEntity->VertexList, Vertex))
+            if (!NewEntity->Pool.Insert(NewEntity->VertexList, Vertex))
                {
                DeleteGridData(&Grid);
-               delete Vertex;
                delete NewEntity; 
                return NULL;
                }
@@ -175,7 +184,7 @@ class PrimitiveClass
          for (Grid.Index.U = 0; Grid.Index.U < GridRes->U; Grid.Index.U++)
             {
             //-- Allocate a new Polygon1 --
-            PolygonRec* Polygon = new PolygonRec;
+            PolygonRec* Polygon = NewEntity->Pool.NewPolygon();
             if (Polygon == NULL)
                {
                DeleteGridData(&Grid);
@@ -188,30 +197,21 @@ class PrimitiveClass
             Polygon->Vertex[1] = Grid.Array[Grid.Index.V*Grid.VPerLine     + Grid.Index.U+1]; //Top rigt
             Polygon->Vertex[0] = Grid.Array[(Grid.Index.V+1)*Grid.VPerLine + Grid.Index.U];   //Bottom left
 
-            //Setup the color
-            Polygon->kAmb     = kAmb;
-            Polygon->kDiff    = *kDiff;
-            Polygon->kSpec    = kSpec;
-            Polygon->nSpec    = nSpec;
-            Polygon->Reflect  = Reflect;
-            Polygon->Trans    = Trans;
-            Polygon->Opacity  = 1.0f - Trans;
-            Polygon->IdxRefr  = IdxRefr;
+            //Setup the facets (the Material is the pool default)
             Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = true;
 
 
             //Insert the Polygon1 into the PolygonList of Entity
-            if (!LinkedList.Insert(NewEntity->PolygonList, Polygon)) 
+            if (!NewEntity->Pool.Insert(NewEntity->PolygonList, Polygon)) 
                {
                DeleteGridData(&Grid);
-               delete Polygon;
                delete NewEntity; 
                return NULL;
                }
 
 
             //-- Allocate a new Polygon2 --
-            Polygon = new PolygonRec;
+            Polygon = NewEntity->Pool.NewPolygon();
             if (Polygon == NULL)
                {
                DeleteGridData(&Grid);
@@ -224,22 +224,13 @@ class PrimitiveClass
             Polygon->Vertex[1] = Grid.Array[(Grid.Index.V+1)*Grid.VPerLine + Grid.Index.U+1]; //Bottom rigt
             Polygon->Vertex[0] = Grid.Array[(Grid.Index.V+1)*Grid.VPerLine + Grid.Index.U];   //Bottom left
 
-            //Setup the color
-            Polygon->kAmb     = kAmb;
-            Polygon->kDiff    = *kDiff;
-            Polygon->kSpec    = kSpec;
-            Polygon->nSpec    = nSpec;
-            Polygon->Reflect  = Reflect;
-            Polygon->Trans    = Trans;
-            Polygon->Opacity  = 1.0f - Trans;
-            Polygon->IdxRefr  = IdxRefr;
+            //Setup the facets (the Material is the pool default)
             Polygon->Facet[0] = Polygon->Facet[1] = Polygon->Facet[2] = true;
 
             //Insert the Polygon2 into the PolygonList of Entity
-            if (!LinkedList.Insert(NewEntity->PolygonList, Polygon))
+            if (!NewEntity->Pool.Insert(NewEntity->PolygonList, Polygon))
                {
                DeleteGridData(&Grid);
-               delete Polygon;
                delete NewEntity; 
                return NULL;
                }
@@ -250,6 +241,9 @@ class PrimitiveClass
       //-- If got here, the temp data can be safely deleted --
       DeleteGridData(&Grid);
 
+      //-- Setup the indexed mesh --
+      if (!NewEntity->BuildMesh()) {delete NewEntity; return NULL;}
+
       //-- Setup other attributes --
       PointRec Sum;
       if (!NewEntity->CalcNormals(false))    {delete NewEntity; return NULL;} //Set UseFacetFlags to false, coz we want vertex normals as well
@@ -302,14 +296,24 @@ class PrimitiveClass
       EntityRec* NewEntity = new EntityRec;
       if (NewEntity == NULL) {DeleteGridData(&Grid); return NULL;}
 
+      //Reserve the Vertices (including the bounding volume) and Polygons
+      if (!NewEntity->Pool.Reserve(8 + ENTITY_BV_COUNT, 12))
+         {DeleteGridData(&Grid); delete NewEntity; return NULL;}
+
       
-      //Polygon colors
-      ColorRec kAmb(0.0f, 0.0f, 0.0f, 0.0f);
-      ColorRec kSpec(0.7f, 0.7f, 0.7f, 0.0f);
-      float    nSpec   = 300.0f;
-      float    Reflect = 0.3f;
-      float    Trans   = 0.0f;
-      float    IdxRefr = 1.0f;
+      //Polygon material, shared by all the Polygons
+      MaterialRec* Material = NewEntity->Pool.NewMaterial();
+      if (Material == NULL) {DeleteGridData(&Grid); delete NewEntity; return NULL;}
+
+      Material->kAmb    = ColorRec(0.0f, 0.0f, 0.0f, 0.0f);
+      Material->kDiff   = *kDiff;
+      Material->kSpec   = ColorRec(0.7f, 0.7f, 0.7f, 0.0f);
+      Material->nSpec   = 300.0f;
+      Material->Reflect = 0.3f;
+      Material->Trans   = 0.0f;
+      Material->Opacity = 1.0f;
+      Material->IdxRefr = 1.0f;
+      NewEntity->Pool.Default = Material;
 
 
       //---- Create the vertices ----
@@ -317,7 +321,7 @@ class PrimitiveClass
       for (Incr = 0; Incr < 8; Incr++) 
          {
          //Allocate cube the Vertices
-         Grid.Array[Incr] = new VertexRec;
+         Grid.Array[Incr] = NewEntity->Pool.NewVertex();
          if (Grid.Array[Incr] == NULL) 
             {
             delete NewEntity; 
@@ -326,10 +330,9 @@ class PrimitiveClass
             }
 
          //Insert the Vertices in to the list
-         if (!LinkedList.Insert(NewEntity->VertexList, Grid.Array[Incr])) 
+         if (!NewEntity->Pool.Insert(NewEntity->VertexList, Grid.Array[Incr])) 
             {
             delete NewEntity; 
-            delete Grid.Array[Incr];
             DeleteGridData(&Grid);
             return NULL;
             }
@@ -357,31 +360,27 @@ class PrimitiveClass
          dword P0, P1, P2, P3;
 
          //Allocate Polygon A
-         PolygonRec* Polygon_A = new PolygonRec;
-         PolygonRec* Polygon_B = new PolygonRec;
+         PolygonRec* Polygon_A = NewEntity->Pool.NewPolygon();
+         PolygonRec* Polygon_B = NewEntity->Pool.NewPolygon();
          if ((Polygon_A == NULL) || (Polygon_B == NULL))
             {
             delete NewEntity; 
-            delete Polygon_A;
-            delete Polygon_B;
             DeleteGridData(&Grid);
             return NULL;
             }
          
          //Allocate and setup Polygon A
-         if (!LinkedList.Insert(NewEntity->PolygonList, Polygon_A)) 
+         if (!NewEntity->Pool.Insert(NewEntity->PolygonList, Polygon_A)) 
             {
             delete NewEntity; 
-            delete Polygon_A;
             DeleteGridData(&Grid);
             return NULL;
             }
 
          //Allocate and setup Polygon B
-         if (!LinkedList.Insert(NewEntity->PolygonList, Polygon_B)) 
+         if (!NewEntity->Pool.Insert(NewEntity->PolygonList, Polygon_B)) 
             {
             delete NewEntity; 
-            delete Polygon_B;
             DeleteGridData(&Grid);
             return NULL;
             }
@@ -403,16 +402,7 @@ class PrimitiveClass
          Polygon_B->Vertex[1] = Grid.Array[P2];
          Polygon_B->Vertex[2] = Grid.Array[P3];
 
-         //Set the Polygon color
-         Polygon_A->kAmb    = Polygon_B->kAmb    = kAmb;
-         Polygon_A->kDiff   = Polygon_B->kDiff   = *kDiff;
-         Polygon_A->kSpec   = Polygon_B->kSpec   = kSpec;
-         Polygon_A->nSpec   = Polygon_B->nSpec   = nSpec;
-         Polygon_A->Reflect = Polygon_B->Reflect = Reflect;
-         Polygon_A->Trans   = Polygon_B->Trans   = Trans;
-         Polygon_A->Opacity = Polygon_B->Opacity = 1.0f - Trans;
-         Polygon_A->IdxRefr = Polygon_B->IdxRefr = IdxRefr;
-        
+         //Set the facets (the Material is the pool default)
          Polygon_A->Facet[0] = Polygon_A->Facet[1] = Polygon_A->Facet[2] = true;
          Polygon_B->Facet[0] = Polygon_B->Facet[1] = Polygon_B->Facet[2] = true;
          }
@@ -420,6 +410,9 @@ class PrimitiveClass
       //-- If got here, the temp data can be safely deleted --
       DeleteGridData(&Grid);
 
+      //-- Setup the indexed mesh --
+      if (!NewEntity->BuildMesh()) {delete NewEntity; return NULL;}
+
       //-- Compute it's attributes --
       PointRec Sum;
       if (!NewEntity->CalcNormals(false))    {delete NewEntity; return NULL;} //Set UseFacetFlags to false, coz we want vertex normals as well
@@ -487,6 +480,9 @@ class PrimitiveClass
       if (!Surface->FindCentroid(0, &Sum)) {goto _ExitError;}
       Surface->Translate(&-Surface->Centroid);
 
+      //The Vertices are displaced directly below
+      if (!Surface->Rebase()) {goto _ExitError;}
+
 
 
       //---- Generate the curved surface by computing the Z displacement ----
@@ -517,27 +513,27 @@ class PrimitiveClass
 
          for (int I = 0; I < POLY_PT_COUNT; I++)
             {
-            Polygon->TexCoord[I].U = Polygon->Vertex[I]->Coord.X * XY_Ratio;
-            Polygon->TexCoord[I].V = Polygon->Vertex[I]->Coord.Y;
-            Polygon->TexCoord[I].W = Polygon->TexCoord[I].t = 0.0f;
+            Polygon->Cold->TexCoord[I].U = Polygon->Vertex[I]->Coord.X * XY_Ratio;
+            Polygon->Cold->TexCoord[I].V = Polygon->Vertex[I]->Coord.Y;
+            Polygon->Cold->TexCoord[I].W = Polygon->Cold->TexCoord[I].t = 0.0f;
             
             if (ProjComp)
                {
                float Z = Polygon->Vertex[I]->Coord.Z * Scale_inv;
                float t = (Z > d) ? fabs(d / (Z - d)) : 1.0f;
-               Polygon->TexCoord[I] = Polygon->TexCoord[I] * t;
+               Polygon->Cold->TexCoord[I] = Polygon->Cold->TexCoord[I] * t;
                }
             
-            //Polygon->TexCoord[I] = ((Polygon->TexCoord[I] + PlaneSize * 0.5f) * PlaneSize_half_inv);
-            Polygon->TexCoord[I] *= PlaneSize_half_inv;
-            Polygon->TexCoord[I] *= ProfEquLim;
+            //Polygon->Cold->TexCoord[I] = ((Polygon->Cold->TexCoord[I] + PlaneSize * 0.5f) * PlaneSize_half_inv);
+            Polygon->Cold->TexCoord[I] *= PlaneSize_half_inv;
+            Polygon->Cold->TexCoord[I] *= ProfEquLim;
 
-            if      (Polygon->TexCoord[I].U >  XY_Ratio) {Polygon->TexCoord[I].U =  XY_Ratio;}
-            else if (Polygon->TexCoord[I].U < -XY_Ratio) {Polygon->TexCoord[I].U = -XY_Ratio;}
-            if      (Polygon->TexCoord[I].V >  0.5f) {Polygon->TexCoord[I].V =  0.5f;}
-            else if (Polygon->TexCoord[I].V < -0.5f) {Polygon->TexCoord[I].V = -0.5f;}
+            if      (Polygon->Cold->TexCoord[I].U >  XY_Ratio) {Polygon->Cold->TexCoord[I].U =  XY_Ratio;}
+            else if (Polygon->Cold->TexCoord[I].U < -XY_Ratio) {Polygon->Cold->TexCoord[I].U = -XY_Ratio;}
+            if      (Polygon->Cold->TexCoord[I].V >  0.5f) {Polygon->Cold->TexCoord[I].V =  0.5f;}
+            else if (Polygon->Cold->TexCoord[I].V < -0.5f) {Polygon->Cold->TexCoord[I].V = -0.5f;}
 
-            Polygon->TexCoord[I] += 0.5f;
+            Polygon->Cold->TexCoord[I] += 0.5f;
             }
         
          //Advance to the next Polygon
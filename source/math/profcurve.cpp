@@ -0,0 +1,295 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                        Built-in Profile Curves                             */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __PROFCURVE_CPP__
+#define __PROFCURVE_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/std_3d.h"
+#include "../math/mathcnst.h"
+#include "../math/equsolver.cpp"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define PROFCURVE_BUILTIN     "builtin:"                 //Prefix for built-in profile curve names
+
+#define PROFCURVE_GENERIC     0x00                       //Profile curve is executed by the EquSolver
+#define PROFCURVE_PLANE       0x01                       //z = 1
+#define PROFCURVE_LINE        0x02                       //z = -r + 1
+#define PROFCURVE_PARABOLA    0x03                       //z = -r^2 + 1
+#define PROFCURVE_SPHERE      0x04                       //z = sqrt(1 - r^2)
+#define PROFCURVE_HYPERBOLA   0x05                       //z = -sqrt(4(1 + 1.5r^2)) + 3
+#define PROFCURVE_TANH        0x06                       //z = -tanh(r - 1)
+#define PROFCURVE_COUNT       0x07
+
+
+/*---------------------------------------------------------------------------
+   Profile curve functors. Each functor evaluates z = f(r), and optionally
+   solves the intersection with the vector z = m*(r - r_offs) in closed
+   form. Root( ) returns false if there is no closed form solution, or if
+   the solution is outside [0, Lim], in which case ProfCurve_Root( ) falls
+   back to the bisection method. The renderers are specialized on these
+   functors, so that the evaluation is inlined in the per-pixel loops.
+  ---------------------------------------------------------------------------*/
+
+//-- Generic profile curve, executed by the EquSolver --
+struct ProfCurve_Generic
+   {
+   byte* Code;
+
+   ProfCurve_Generic(byte* NewCode) {Code = NewCode;}
+   __forceinline bool Eval(float &z, float r) {return EquSolver.Execute(z, Code, r);}
+   __forceinline bool Root(float, float, float, float &) {return false;}
+   };
+
+//-- Plane: z = 1 --
+struct ProfCurve_Plane
+   {
+   __forceinline bool Eval(float &z, float) {z = 1.0f; return true;}
+   __forceinline bool Root(float m, float r_offs, float Lim, float &r)
+      {
+      if (m <= 0.0f) {return false;}
+      r = r_offs + 1.0f / m;
+      return (r >= 0.0f) && (r <= Lim);
+      }
+   };
+
+//-- Line: z = -r + 1 --
+struct ProfCurve_Line
+   {
+   __forceinline bool Eval(float &z, float r) {z = 1.0f - r; return true;}
+   __forceinline bool Root(float m, float r_offs, float Lim, float &r)
+      {
+      if (m == -1.0f) {return false;}
+      r = (1.0f + m*r_offs) / (1.0f + m);
+      return (r >= 0.0f) && (r <= Lim);
+      }
+   };
+
+//-- Parabola: z = -r^2 + 1, solves r^2 + m*r - (1 + m*r_offs) = 0 --
+struct ProfCurve_Parabola
+   {
+   __forceinline bool Eval(float &z, float r) {z = 1.0f - r*r; return true;}
+   __forceinline bool Root(float m, float r_offs, float Lim, float &r)
+      {
+      float Disc = m*m + 4.0f*(1.0f + m*r_offs);
+      if (Disc < 0.0f) {return false;}
+      r = (sqrt(Disc) - m) * 0.5f;
+      return (r >= 0.0f) && (r <= Lim);
+      }
+   };
+
+//-- Sphere: z = sqrt(1 - r^2), solves (1 + m^2)r^2 - 2m^2*r_offs*r + m^2*r_offs^2 - 1 = 0 --
+struct ProfCurve_Sphere
+   {
+   __forceinline bool Eval(float &z, float r)
+      {
+      float s = 1.0f - r*r;
+      if (s < 0.0f) {*(dword*)&z = *(dword*)&_NaN; return true;}
+      z = sqrt(s);
+      return true;
+      }
+   __forceinline bool Root(float m, float r_offs, float Lim, float &r)
+      {
+      float m2   = m*m;
+      float Disc = 1.0f + m2 - m2*r_offs*r_offs;
+      if (Disc < 0.0f) {return false;}
+      r = (m2*r_offs + sqrt(Disc)) / (1.0f + m2);
+
+      //Only the upper half of the circle is part of the curve
+      if (m*(r - r_offs) < 0.0f) {return false;}
+      return (r >= 0.0f) && (r <= Lim) && (r <= 1.0f);
+      }
+   };
+
+//-- Hyperbola: z = -sqrt(4(1 + 1.5r^2)) + 3. With a = 3 + m*r_offs,
+//   solves (m^2 - 6)r^2 - 2a*m*r + a^2 - 4 = 0, for (a - m*r) >= 0. --
+struct ProfCurve_Hyperbola
+   {
+   __forceinline bool Eval(float &z, float r) {z = 3.0f - sqrt(4.0f * (1.0f + 1.5f*r*r)); return true;}
+   __forceinline bool Root(float m, float r_offs, float Lim, float &r)
+      {
+      float a  = 3.0f + m*r_offs;
+      float qa = m*m - 6.0f;
+      float qb = -2.0f*a*m;
+      float qc = a*a - 4.0f;
+
+      //Degenerate (linear) case
+      if (fabs(qa) < 0.00001f)
+         {
+         if (qb == 0.0f) {return false;}
+         r = -qc / qb;
+         }
+      else
+         {
+         float Disc = qb*qb - 4.0f*qa*qc;
+         if (Disc < 0.0f) {return false;}
+         Disc = sqrt(Disc);
+
+         //Use the smallest non-negative root
+         float r1 = (-qb - Disc) / (2.0f*qa);
+         float r2 = (-qb + Disc) / (2.0f*qa);
+         if (r1 > r2) {float Temp = r1; r1 = r2; r2 = Temp;}
+         r = (r1 >= 0.0f) ? r1 : r2;
+         }
+
+      if ((a - m*r) < 0.0f) {return false;}
+      return (r >= 0.0f) && (r <= Lim);
+      }
+   };
+
+//-- Tanh: z = -tanh(r - 1). There is no closed form root, but the
+//   bisection still benefits from the inlined evaluation. --
+struct ProfCurve_Tanh
+   {
+   __forceinline bool Eval(float &z, float r) {z = -tanh(r - 1.0f); return true;}
+   __forceinline bool Root(float, float, float, float &) {return false;}
+   };
+
+
+/*---------------------------------------------------------------------------
+   Finds the root of the profile curve for the vector z = m*(r - r_offs).
+   See TransformClass::ProfCurve_FindRoot( ) for details on the bisection
+   method, which is used when the curve has no closed form solution.
+  ---------------------------------------------------------------------------*/
+template <class Curve> inline float ProfCurve_Root(Curve &C, float m, float r_offs, float ProfEquLim)
+   {
+   float r = ProfEquLim * 0.5f;                    //Estimated r intersection point (mid point of r1 and r2)
+   float z;
+
+   //Use the closed form solution only if the bisection would find the same
+   // root, which requires f(0) - m*(0 - r_offs) > 0.
+   C.Eval(z, 0.0f);
+   if ((z + m*r_offs > 0.0f) && C.Root(m, r_offs, ProfEquLim, r)) {return r;}
+
+   dword Iteration = 0;                            //Loop counter
+   float r1 = 0.0f;                                //r1 and r2 are the extreme profile curve range
+   float r2 = ProfEquLim;
+
+   //-- Find the root r, (accurate to 4 decimal places). If someting strange
+   //   happens, the loop stops after 100 iterations. --
+   while ((fabs(r1 - r2) * 0.5f > 0.00001f) && (Iteration < 100))
+      {
+      r = (r1 + r2) * 0.5f;                        //Find the mid point
+      C.Eval(z, r);
+
+      //If z is not a number, set z to float_MAX
+      if (*(dword*)&z == *(dword*)&_NaN) {z = float_MAX;}
+
+      z -= m*(r - r_offs);                         //Find it's z value
+      if (z > 0.0f) {r1 = r;} else {r2 = r;}       //Narrow the range accoding to the sign of z
+
+      Iteration++;
+      }
+
+   return r;
+   }
+
+
+/*---------------------------------------------------------------------------
+  The built-in profile curve library. Resolves built-in curve names, as
+  used by the PROFEQU keyword (eg. ProfEqu builtin:sphere).
+  ---------------------------------------------------------------------------*/
+class ProfCurveLibClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   struct CurveRec
+      {
+      char* Name;                                  //Name following the PROFCURVE_BUILTIN prefix
+      char* Equation;                              //Equivalent EquSolver equation
+      };
+
+   CurveRec Curves[PROFCURVE_COUNT];
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Constructor --------------------------------------------------------*/
+   ProfCurveLibClass(void)
+      {
+      Curves[PROFCURVE_GENERIC].Name       = "";
+      Curves[PROFCURVE_GENERIC].Equation   = NULL;
+      Curves[PROFCURVE_PLANE].Name         = "plane";
+      Curves[PROFCURVE_PLANE].Equation     = "1;";
+      Curves[PROFCURVE_LINE].Name          = "line";
+      Curves[PROFCURVE_LINE].Equation      = "-x + 1;";
+      Curves[PROFCURVE_PARABOLA].Name      = "parabola";
+      Curves[PROFCURVE_PARABOLA].Equation  = "-x*x + 1;";
+      Curves[PROFCURVE_SPHERE].Name        = "sphere";
+      Curves[PROFCURVE_SPHERE].Equation    = "sqrt(1 - x*x);";
+      Curves[PROFCURVE_HYPERBOLA].Name     = "hyperbola";
+      Curves[PROFCURVE_HYPERBOLA].Equation = "-sqrt(4.0 * (1 + 1.5*x^2)) + 3;";
+      Curves[PROFCURVE_TANH].Name          = "tanh";
+      Curves[PROFCURVE_TANH].Equation      = "-tanh(x-1);";
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if the profile curve string refers to a built-in curve.
+     ------------------------------------------------------------------------*/
+   inline bool IsBuiltin(char* ProfEqu)
+      {
+      if (ProfEqu == NULL) {return false;}
+      return (strnicmp(ProfEqu, PROFCURVE_BUILTIN, strlen(PROFCURVE_BUILTIN)) == 0);
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the curve ID of a profile curve string. ID is set to
+      PROFCURVE_GENERIC if the string is an ordinary equation. Returns false
+      if the string names an unknown built-in curve.
+
+      ProfEqu  : Profile curve equation or built-in curve name.
+      ID       : Returns the curve ID.
+     ------------------------------------------------------------------------*/
+   bool Find(char* ProfEqu, dword &ID)
+      {
+      ID = PROFCURVE_GENERIC;
+      if (!IsBuiltin(ProfEqu)) {return true;}
+
+      char* Name = ProfEqu + strlen(PROFCURVE_BUILTIN);
+      for (dword I = PROFCURVE_GENERIC + 1; I < PROFCURVE_COUNT; I++)
+         {
+         if (stricmp(Curves[I].Name, Name) == 0) {ID = I; return true;}
+         }
+
+      printf("ProfCurveLibClass::Find( ): Unknown built-in profile curve \"%s\".\n", ProfEqu);
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the equivalent EquSolver equation of a built-in curve, or NULL
+      for PROFCURVE_GENERIC. The equation is used wherever the compiled
+      profile curve code is still required (eg. surface mesh generation).
+     ------------------------------------------------------------------------*/
+   inline char* Equation(dword ID)
+      {
+      if (ID >= PROFCURVE_COUNT) {return NULL;}
+      return Curves[ID].Equation;
+      }
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*----------------------------------------------------------------------------
+  Global Declarations.
+  ----------------------------------------------------------------------------*/
+ProfCurveLibClass ProfCurveLib;
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -0,0 +1,519 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*               Quadric Error Metric Mesh Simplification                     */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __SIMPLIFY_CPP__
+#define __SIMPLIFY_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/std_3d.h"
+#include "../mem_data/vertex.cpp"
+#include "../mem_data/polygon.cpp"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define SIMPLIFY_NONE         0xFFFFFFFF                 //End of an adjacency list
+#define SIMPLIFY_BORDER       1000.0                     //Weight of the border and material seam planes
+#define SIMPLIFY_FLIP_COS     0.2f                       //Minimum cosine between the old and new Polygon normals
+#define SIMPLIFY_MIN_HEAP     256                        //Initial candidate heap size
+
+
+/*---------------------------------------------------------------------------
+  The mesh simplification class. Reduces an indexed triangle mesh with
+  edge collapses, in the order of the quadric error metric (Garland and
+  Heckbert). Borders and material seams are preserved with additional
+  constraint planes, and collapses that would flip a Polygon are rejected.
+  Reduce( ) can be called repeatedly with decreasing targets, so a chain of
+  levels is built from a single run. The source mesh is not modified.
+  ---------------------------------------------------------------------------*/
+class SimplifyClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   //-- Symmetric 4x4 matrix: A2, AB, AC, AD, B2, BC, BD, C2, CD, D2 --
+   struct QuadricRec
+      {
+      double Q[10];
+      };
+
+   //-- Edge collapse candidate: V1 is merged into V0 at Target --
+   struct CandidateRec
+      {
+      double   Cost;
+      dword    V0, V1;
+      dword    Stamp0, Stamp1;                      //Vertex stamps at the time the cost was computed
+      PointRec Target;
+      };
+
+   PointRec*      Coord;                           //Working Vertex coordinates
+   QuadricRec*    Quadric;                         //Accumulated quadric of each Vertex
+   dword*         Stamp;                           //Incremented every time a Vertex changes
+   bool*          Alive;                           //False for Vertices merged into another
+   dword*         AdjHead;                         //First adjacency node of each Vertex
+   dword*         AdjNext;                         //Next adjacency node (POLY_PT_COUNT nodes per Polygon)
+   dword*         AdjPoly;                         //Polygon of each adjacency node
+   dword*         Index;                           //Working Polygon indices
+   dword*         MatIndex;                        //Material of each Polygon
+   bool*          Removed;                         //Collapsed Polygons
+   CandidateRec*  Heap;                            //Binary min heap of the collapse candidates
+   dword          HeapCount;
+   dword          HeapSize;
+
+
+   /*-------------------------------------------------------------------------
+      Adds the plane N.p + D = 0 with weight W to a quadric.
+     ------------------------------------------------------------------------*/
+   inline void AddPlane(QuadricRec &R, PointRec &N, double D, double W)
+      {
+      double A = N.X, B = N.Y, C = N.Z;
+      R.Q[0] += W*A*A; R.Q[1] += W*A*B; R.Q[2] += W*A*C; R.Q[3] += W*A*D;
+      R.Q[4] += W*B*B; R.Q[5] += W*B*C; R.Q[6] += W*B*D;
+      R.Q[7] += W*C*C; R.Q[8] += W*C*D;
+      R.Q[9] += W*D*D;
+      }
+
+   /*-------------------------------------------------------------------------
+      Evaluates the quadric error at P.
+     ------------------------------------------------------------------------*/
+   inline double Error(QuadricRec &R, PointRec &P)
+      {
+      double X = P.X, Y = P.Y, Z = P.Z;
+      return R.Q[0]*X*X + 2.0*R.Q[1]*X*Y + 2.0*R.Q[2]*X*Z + 2.0*R.Q[3]*X +
+             R.Q[4]*Y*Y + 2.0*R.Q[5]*Y*Z + 2.0*R.Q[6]*Y +
+             R.Q[7]*Z*Z + 2.0*R.Q[8]*Z + R.Q[9];
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if Polygon P uses Vertex V.
+     ------------------------------------------------------------------------*/
+   inline bool HasVertex(dword P, dword V)
+      {
+      dword* I = &Index[P*POLY_PT_COUNT];
+      return (I[0] == V) || (I[1] == V) || (I[2] == V);
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if the edge [V0, V1] of Polygon P is on a border or on a
+      material seam, i.e. no other Polygon with the same Material shares it.
+     ------------------------------------------------------------------------*/
+   bool IsBorder(dword P, dword V0, dword V1)
+      {
+      for (dword Node = AdjHead[V0]; Node != SIMPLIFY_NONE; Node = AdjNext[Node])
+         {
+         dword Q = AdjPoly[Node];
+         if ((Q != P) && !Removed[Q] && HasVertex(Q, V1) && (MatIndex[Q] == MatIndex[P])) {return false;}
+         }
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if moving Vertex V to Target flips or degenerates any of
+      its Polygons, other than those shared with Vertex Other (which are
+      removed by the collapse).
+     ------------------------------------------------------------------------*/
+   bool Flips(dword V, dword Other, PointRec &Target)
+      {
+      for (dword Node = AdjHead[V]; Node != SIMPLIFY_NONE; Node = AdjNext[Node])
+         {
+         dword P = AdjPoly[Node];
+         if (Removed[P] || HasVertex(P, Other)) {continue;}
+
+         PointRec Old[POLY_PT_COUNT], New[POLY_PT_COUNT];
+         for (int I = 0; I < POLY_PT_COUNT; I++)
+            {
+            Old[I] = New[I] = Coord[Index[P*POLY_PT_COUNT + I]];
+            if (Index[P*POLY_PT_COUNT + I] == V) {New[I] = Target;}
+            }
+
+         PointRec OldN = (Old[1] - Old[0]).Cross(Old[2] - Old[0]);
+         PointRec NewN = (New[1] - New[0]).Cross(New[2] - New[0]);
+         float    OldMag = OldN.Mag();
+         float    NewMag = NewN.Mag();
+         if (OldMag == 0.0f) {continue;}
+         if (NewMag == 0.0f) {return true;}
+         if (OldN.Dot(NewN) < SIMPLIFY_FLIP_COS * OldMag * NewMag) {return true;}
+         }
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Computes the collapse of the edge [V0, V1], and inserts it into the
+      heap. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool Push(dword V0, dword V1)
+      {
+      QuadricRec R;
+      for (int I = 0; I < 10; I++) {R.Q[I] = Quadric[V0].Q[I] + Quadric[V1].Q[I];}
+
+      //-- The optimal position minimizes the error, so solve the 3x3 system
+      //   by Cramer's rule. Fall back to the end points and the midpoint if
+      //   the system is singular, or the solution is far from the edge. --
+      PointRec Mid = (Coord[V0] + Coord[V1]) * 0.5f;
+      PointRec Target;
+      double   Cost;
+
+      double C0 = R.Q[4]*R.Q[7] - R.Q[5]*R.Q[5];
+      double C1 = R.Q[5]*R.Q[2] - R.Q[1]*R.Q[7];
+      double C2 = R.Q[1]*R.Q[5] - R.Q[4]*R.Q[2];
+      double Det = R.Q[0]*C0 + R.Q[1]*C1 + R.Q[2]*C2;
+      bool   Solved = false;
+
+      if (fabs(Det) > 1.0e-12)
+         {
+         double Inv = -1.0 / Det;
+         double X = (R.Q[3]*C0 + R.Q[6]*C1 + R.Q[8]*C2) * Inv;
+         double Y = (R.Q[3]*C1 + R.Q[6]*(R.Q[0]*R.Q[7] - R.Q[2]*R.Q[2]) + R.Q[8]*(R.Q[2]*R.Q[1] - R.Q[0]*R.Q[5])) * Inv;
+         double Z = (R.Q[3]*C2 + R.Q[6]*(R.Q[1]*R.Q[2] - R.Q[0]*R.Q[5]) + R.Q[8]*(R.Q[0]*R.Q[4] - R.Q[1]*R.Q[1])) * Inv;
+
+         Target = PointRec((float)X, (float)Y, (float)Z, Coord[V0].t);
+         Solved = ((Target - Mid).MagSqr() <= (Coord[V1] - Coord[V0]).MagSqr());
+         }
+
+      if (Solved) {Cost = Error(R, Target);}
+      else
+         {
+         Target = Mid;
+         Cost   = Error(R, Mid);
+
+         double Cost0 = Error(R, Coord[V0]);
+         double Cost1 = Error(R, Coord[V1]);
+         if (Cost0 < Cost) {Cost = Cost0; Target = Coord[V0];}
+         if (Cost1 < Cost) {Cost = Cost1; Target = Coord[V1];}
+         }
+
+      //-- Grow the heap if necessary --
+      if (HeapCount >= HeapSize)
+         {
+         dword         NewSize = (HeapSize > 0) ? (HeapSize << 1) : SIMPLIFY_MIN_HEAP;
+         CandidateRec* NewHeap = new CandidateRec[NewSize];
+         if (NewHeap == NULL) {printf("SimplifyClass::Push( ): Memory allocation failed.\n"); return false;}
+
+         if (Heap != NULL)
+            {
+            for (dword I = 0; I < HeapCount; I++) {NewHeap[I] = Heap[I];}
+            delete[] Heap;
+            }
+         Heap     = NewHeap;
+         HeapSize = NewSize;
+         }
+
+      //-- Sift up --
+      dword Pos = HeapCount++;
+      while (Pos > 0)
+         {
+         dword Up = (Pos - 1) >> 1;
+         if (Heap[Up].Cost <= Cost) {break;}
+         Heap[Pos] = Heap[Up];
+         Pos       = Up;
+         }
+
+      Heap[Pos].Cost   = (Cost > 0.0) ? Cost : 0.0;
+      Heap[Pos].V0     = V0;
+      Heap[Pos].V1     = V1;
+      Heap[Pos].Stamp0 = Stamp[V0];
+      Heap[Pos].Stamp1 = Stamp[V1];
+      Heap[Pos].Target = Target;
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Removes the cheapest candidate from the heap.
+     ------------------------------------------------------------------------*/
+   CandidateRec Pop(void)
+      {
+      CandidateRec Top  = Heap[0];
+      CandidateRec Last = Heap[--HeapCount];
+
+      //-- Sift down --
+      dword Pos = 0;
+      for (;;)
+         {
+         dword Down = (Pos << 1) + 1;
+         if (Down >= HeapCount) {break;}
+         if ((Down + 1 < HeapCount) && (Heap[Down + 1].Cost < Heap[Down].Cost)) {Down++;}
+         if (Last.Cost <= Heap[Down].Cost) {break;}
+         Heap[Pos] = Heap[Down];
+         Pos       = Down;
+         }
+      if (HeapCount > 0) {Heap[Pos] = Last;}
+
+      return Top;
+      }
+
+   /*-------------------------------------------------------------------------
+      Merges Vertex V1 into V0 at Target, removes the Polygons shared by
+      both, and inserts the new candidates around V0. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool Collapse(dword V0, dword V1, PointRec &Target)
+      {
+      dword Node, Prev, I;
+
+      Coord[V0] = Target;
+      for (I = 0; I < 10; I++) {Quadric[V0].Q[I] += Quadric[V1].Q[I];}
+      Alive[V1] = false;
+      Stamp[V0]++;
+      Stamp[V1]++;
+      VertexCount--;
+
+      //-- Move the Polygons of V1 over to V0 --
+      dword Tail = SIMPLIFY_NONE;
+      for (Node = AdjHead[V1]; Node != SIMPLIFY_NONE; Node = AdjNext[Node])
+         {
+         dword P = AdjPoly[Node];
+         Tail = Node;
+         if (Removed[P]) {continue;}
+
+         if (HasVertex(P, V0)) {Removed[P] = true; PolygonCount--; continue;}
+         for (I = 0; I < POLY_PT_COUNT; I++) {if (Index[P*POLY_PT_COUNT + I] == V1) {Index[P*POLY_PT_COUNT + I] = V0;}}
+         }
+
+      if (Tail != SIMPLIFY_NONE)
+         {
+         AdjNext[Tail] = AdjHead[V0];
+         AdjHead[V0]   = AdjHead[V1];
+         AdjHead[V1]   = SIMPLIFY_NONE;
+         }
+
+      //-- Drop the removed Polygons from the list of V0, and insert the
+      //   candidates for the remaining edges --
+      Prev = SIMPLIFY_NONE;
+      for (Node = AdjHead[V0]; Node != SIMPLIFY_NONE; Node = AdjNext[Node])
+         {
+         dword P = AdjPoly[Node];
+         if (Removed[P])
+            {
+            if (Prev == SIMPLIFY_NONE) {AdjHead[V0] = AdjNext[Node];} else {AdjNext[Prev] = AdjNext[Node];}
+            continue;
+            }
+         Prev = Node;
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            dword V = Index[P*POLY_PT_COUNT + I];
+            if (V != V0) {if (!Push(V0, V)) {return false;}}
+            }
+         }
+
+      return true;
+      }
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   dword       VertexCount;                        //Number of remaining Vertices
+   dword       PolygonCount;                       //Number of remaining Polygons
+   dword       SourceVertexCount;                  //Number of Vertices in the source mesh
+   dword       SourcePolygonCount;                 //Number of Polygons in the source mesh
+
+   /*---- Constructor --------------------------------------------------------*/
+   SimplifyClass(void)
+      {
+      Coord    = NULL;
+      Quadric  = NULL;
+      Stamp    = NULL;
+      Alive    = NULL;
+      AdjHead  = NULL;
+      AdjNext  = NULL;
+      AdjPoly  = NULL;
+      Index    = NULL;
+      MatIndex = NULL;
+      Removed  = NULL;
+      Heap     = NULL;
+      HeapCount = 0;
+      HeapSize  = 0;
+
+      VertexCount        = 0;
+      PolygonCount       = 0;
+      SourceVertexCount  = 0;
+      SourcePolygonCount = 0;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~SimplifyClass(void) {Delete();}
+
+   /*-------------------------------------------------------------------------
+      Releases all memory.
+     ------------------------------------------------------------------------*/
+   void Delete(void)
+      {
+      if (Coord    != NULL) {delete[] Coord;    Coord    = NULL;}
+      if (Quadric  != NULL) {delete[] Quadric;  Quadric  = NULL;}
+      if (Stamp    != NULL) {delete[] Stamp;    Stamp    = NULL;}
+      if (Alive    != NULL) {delete[] Alive;    Alive    = NULL;}
+      if (AdjHead  != NULL) {delete[] AdjHead;  AdjHead  = NULL;}
+      if (AdjNext  != NULL) {delete[] AdjNext;  AdjNext  = NULL;}
+      if (AdjPoly  != NULL) {delete[] AdjPoly;  AdjPoly  = NULL;}
+      if (Index    != NULL) {delete[] Index;    Index    = NULL;}
+      if (MatIndex != NULL) {delete[] MatIndex; MatIndex = NULL;}
+      if (Removed  != NULL) {delete[] Removed;  Removed  = NULL;}
+      if (Heap     != NULL) {delete[] Heap;     Heap     = NULL;}
+      HeapCount = 0;
+      HeapSize  = 0;
+
+      VertexCount        = 0;
+      PolygonCount       = 0;
+      SourceVertexCount  = 0;
+      SourcePolygonCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets up the quadrics and the collapse candidates of an indexed mesh
+      (see EntityRec::BuildMesh( )). Returns false on fail.
+
+      VertexArray     : Source Vertices.
+      NewVertexCount  : Number of Vertices.
+      PolygonArray    : Source Polygons, only the MatIndex is used.
+      IndexArray      : Vertex indices of every Polygon.
+      NewPolygonCount : Number of Polygons.
+     ------------------------------------------------------------------------*/
+   bool Setup(VertexRec* VertexArray, dword NewVertexCount, PolygonRec* PolygonArray, dword* IndexArray, dword NewPolygonCount)
+      {
+      dword V, P, I;
+
+      Delete();
+      if ((VertexArray == NULL) || (PolygonArray == NULL) || (IndexArray == NULL)) {return false;}
+
+      Coord    = new PointRec[NewVertexCount];
+      Quadric  = new QuadricRec[NewVertexCount];
+      Stamp    = new dword[NewVertexCount];
+      Alive    = new bool[NewVertexCount];
+      AdjHead  = new dword[NewVertexCount];
+      AdjNext  = new dword[NewPolygonCount * POLY_PT_COUNT];
+      AdjPoly  = new dword[NewPolygonCount * POLY_PT_COUNT];
+      Index    = new dword[NewPolygonCount * POLY_PT_COUNT];
+      MatIndex = new dword[NewPolygonCount];
+      Removed  = new bool[NewPolygonCount];
+      if ((Coord == NULL) || (Quadric == NULL) || (Stamp == NULL) || (Alive == NULL) || (AdjHead == NULL) ||
+          (AdjNext == NULL) || (AdjPoly == NULL) || (Index == NULL) || (MatIndex == NULL) || (Removed == NULL))
+         {printf("SimplifyClass::Setup( ): Memory allocation failed.\n"); Delete(); return false;}
+
+      SourceVertexCount  = VertexCount  = NewVertexCount;
+      SourcePolygonCount = PolygonCount = NewPolygonCount;
+
+      for (V = 0; V < VertexCount; V++)
+         {
+         Coord[V]   = VertexArray[V].Coord;
+         Stamp[V]   = 0;
+         Alive[V]   = true;
+         AdjHead[V] = SIMPLIFY_NONE;
+         for (I = 0; I < 10; I++) {Quadric[V].Q[I] = 0.0;}
+         }
+
+      //-- Build the adjacency lists --
+      for (P = 0; P < PolygonCount; P++)
+         {
+         MatIndex[P] = PolygonArray[P].MatIndex;
+         Removed[P]  = false;
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            dword Node = P*POLY_PT_COUNT + I;
+            V = IndexArray[Node];
+            if (V >= VertexCount) {printf("SimplifyClass::Setup( ): Invalid Vertex index.\n"); Delete(); return false;}
+
+            Index[Node]   = V;
+            AdjPoly[Node] = P;
+            AdjNext[Node] = AdjHead[V];
+            AdjHead[V]    = Node;
+            }
+         }
+
+      //-- Accumulate the Polygon planes (weighted by area), and the border
+      //   planes perpendicular to the Polygons --
+      for (P = 0; P < PolygonCount; P++)
+         {
+         dword*   Poly = &Index[P*POLY_PT_COUNT];
+         PointRec N  = (Coord[Poly[1]] - Coord[Poly[0]]).Cross(Coord[Poly[2]] - Coord[Poly[0]]);
+         double   Area = N.Mag();
+         if (Area == 0.0) {continue;}
+         N = N.Unit();
+
+         double D = -N.Dot(Coord[Poly[0]]);
+         for (I = 0; I < POLY_PT_COUNT; I++) {AddPlane(Quadric[Poly[I]], N, D, Area * 0.5);}
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            dword V0 = Poly[I], V1 = Poly[(I + 1) % POLY_PT_COUNT];
+            if (!IsBorder(P, V0, V1)) {continue;}
+
+            PointRec E = Coord[V1] - Coord[V0];
+            PointRec B = E.Cross(N);
+            if (B.Mag() == 0.0f) {continue;}
+            B = B.Unit();
+
+            double BD = -B.Dot(Coord[V0]);
+            double W  = SIMPLIFY_BORDER * E.MagSqr();
+            AddPlane(Quadric[V0], B, BD, W);
+            AddPlane(Quadric[V1], B, BD, W);
+            }
+         }
+
+      //-- Insert the initial candidates. Interior edges are shared by two
+      //   Polygons, so they are only inserted from one side. --
+      for (P = 0; P < PolygonCount; P++)
+         {
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            dword V0 = Index[P*POLY_PT_COUNT + I];
+            dword V1 = Index[P*POLY_PT_COUNT + (I + 1) % POLY_PT_COUNT];
+            if (V0 == V1) {continue;}
+            if ((V0 < V1) || IsBorder(P, V0, V1)) {if (!Push(V0, V1)) {Delete(); return false;}}
+            }
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Collapses the cheapest edges until at most TargetCount Polygons
+      remain, or until no more edges can be collapsed. Returns false on
+      fail.
+     ------------------------------------------------------------------------*/
+   bool Reduce(dword TargetCount)
+      {
+      while ((PolygonCount > TargetCount) && (HeapCount > 0))
+         {
+         CandidateRec C = Pop();
+
+         //Skip the candidates that are out of date
+         if (!Alive[C.V0] || !Alive[C.V1]) {continue;}
+         if ((C.Stamp0 != Stamp[C.V0]) || (C.Stamp1 != Stamp[C.V1])) {continue;}
+
+         //Reject the collapses that fold the mesh over
+         if (Flips(C.V0, C.V1, C.Target) || Flips(C.V1, C.V0, C.Target)) {continue;}
+
+         if (!Collapse(C.V0, C.V1, C.Target)) {return false;}
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Access to the simplified mesh. Removed Vertices are not referenced by
+      the remaining Polygons.
+     ------------------------------------------------------------------------*/
+   inline bool      VertexAlive(dword V)          {return Alive[V];}
+   inline PointRec  VertexCoord(dword V)          {return Coord[V];}
+   inline bool      PolygonRemoved(dword P)       {return Removed[P];}
+   inline dword     PolygonVertex(dword P, int I) {return Index[P*POLY_PT_COUNT + I];}
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -0,0 +1,280 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                         4x4 Transformation Matrix                          */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __XFORMREC_CPP__
+#define __XFORMREC_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/std_3d.h"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define XFORM_ORTHO_TOL 0.001f                  //Largest axis cosine that is treated as rounding error
+
+
+/*---------------------------------------------------------------------------
+  The transformation matrix class. The matrix is stored in column major
+  order (same as OpenGL), the element at row R and column C is M[C*4 + R].
+  Transformations are concatenated, so that the most recent one is applied
+  last.
+  ---------------------------------------------------------------------------*/
+class XformRec
+   {
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   float M[16];
+
+   /*---- Constructor --------------------------------------------------------*/
+   XformRec(void) {Identity();}
+
+   /*-------------------------------------------------------------------------
+      Resets the matrix to identity.
+     ------------------------------------------------------------------------*/
+   void Identity(void)
+      {
+      for (int I = 0; I < 16; I++) {M[I] = 0.0f;}
+      M[0] = M[5] = M[10] = M[15] = 1.0f;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if the matrix is the identity.
+     ------------------------------------------------------------------------*/
+   bool IsIdentity(void)
+      {
+      for (int I = 0; I < 16; I++)
+         {
+         if (M[I] != (((I % 5) == 0) ? 1.0f : 0.0f)) {return false;}
+         }
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Concatenates T with *this, so that T is applied after the existing
+      transformation (*this = T * *this).
+     ------------------------------------------------------------------------*/
+   void Concat(const XformRec &T)
+      {
+      float R[16];
+      for (int C = 0; C < 4; C++)
+         {
+         for (int Row = 0; Row < 4; Row++)
+            {
+            R[C*4 + Row] = T.M[Row]      * M[C*4]     + T.M[4 + Row]  * M[C*4 + 1] +
+                           T.M[8 + Row]  * M[C*4 + 2] + T.M[12 + Row] * M[C*4 + 3];
+            }
+         }
+      for (int I = 0; I < 16; I++) {M[I] = R[I];}
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends a translation by V.
+     ------------------------------------------------------------------------*/
+   void Translate(const PointRec &V)
+      {
+      XformRec T;
+      T.M[12] = V.X;
+      T.M[13] = V.Y;
+      T.M[14] = V.Z;
+      Concat(T);
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends a scaling by S about the center point C.
+     ------------------------------------------------------------------------*/
+   void Scale(const PointRec &S, const PointRec &C)
+      {
+      XformRec T;
+      T.M[0]  = S.X;
+      T.M[5]  = S.Y;
+      T.M[10] = S.Z;
+      T.M[12] = C.X - C.X * S.X;
+      T.M[13] = C.Y - C.Y * S.Y;
+      T.M[14] = C.Z - C.Z * S.Z;
+      Concat(T);
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends a rotation by R (in radians) about the center point C. The
+      rotation order matches PointRec::Rotate( ), which rotates around the
+      X, Y, then Z axis.
+     ------------------------------------------------------------------------*/
+   void Rotate(const PointRec &R, const PointRec &C)
+      {
+      float cx = (float)cos(R.X), sx = (float)sin(R.X);
+      float cy = (float)cos(R.Y), sy = (float)sin(R.Y);
+      float cz = (float)cos(R.Z), sz = (float)sin(R.Z);
+
+      //Rz * Ry * Rx
+      XformRec T;
+      T.M[0]  =  cz*cy;  T.M[4] = cz*sy*sx - sz*cx;  T.M[8]  = cz*sy*cx + sz*sx;
+      T.M[1]  =  sz*cy;  T.M[5] = sz*sy*sx + cz*cx;  T.M[9]  = sz*sy*cx - cz*sx;
+      T.M[2]  = -sy;     T.M[6] = cy*sx;             T.M[10] = cy*cx;
+
+      //Rotate about C: p' = Rot(p - C) + C
+      T.M[12] = C.X - (T.M[0]*C.X + T.M[4]*C.Y + T.M[8]*C.Z);
+      T.M[13] = C.Y - (T.M[1]*C.X + T.M[5]*C.Y + T.M[9]*C.Z);
+      T.M[14] = C.Z - (T.M[2]*C.X + T.M[6]*C.Y + T.M[10]*C.Z);
+      Concat(T);
+      Orthonormalize();
+      }
+
+   /*-------------------------------------------------------------------------
+      Removes the rounding errors that accumulate in the upper 3x3 when many
+      rotations are concatenated (eg. one per frame). The axes are made
+      perpendicular again with the Gram-Schmidt process, and each keeps its
+      length, so a rotation combined with a scaling of the axes is preserved.
+      If the axes are further from perpendicular than rounding could explain
+      (eg. a non-uniform scaling after a rotation), the matrix is a genuine
+      shear, and it's left alone.
+     ------------------------------------------------------------------------*/
+   void Orthonormalize(void)
+      {
+      float A[3][3];                               //Unit axes (columns of the upper 3x3)
+      float Len[3];                                //Original axis lengths
+      float D;
+      int   I, J, K;
+
+      for (I = 0; I < 3; I++)
+         {
+         Len[I] = (float)sqrt(M[I*4]*M[I*4] + M[I*4 + 1]*M[I*4 + 1] + M[I*4 + 2]*M[I*4 + 2]);
+         if (Len[I] == 0.0f) {return;}
+         for (K = 0; K < 3; K++) {A[I][K] = M[I*4 + K] / Len[I];}
+         }
+
+      //Subtract the projections onto the previous axes, then re-normalize
+      for (I = 1; I < 3; I++)
+         {
+         for (J = 0; J < I; J++)
+            {
+            D = A[I][0]*A[J][0] + A[I][1]*A[J][1] + A[I][2]*A[J][2];
+            if (fabs(D) > XFORM_ORTHO_TOL) {return;}
+            for (K = 0; K < 3; K++) {A[I][K] -= A[J][K] * D;}
+            }
+
+         D = 1.0f / (float)sqrt(A[I][0]*A[I][0] + A[I][1]*A[I][1] + A[I][2]*A[I][2]);
+         for (K = 0; K < 3; K++) {A[I][K] *= D;}
+         }
+
+      for (I = 0; I < 3; I++)
+         {
+         for (K = 0; K < 3; K++) {M[I*4 + K] = A[I][K] * Len[I];}
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms the point P. The t component is preserved.
+     ------------------------------------------------------------------------*/
+   __forceinline PointRec Point(const PointRec &P)
+      {
+      return PointRec(M[0]*P.X + M[4]*P.Y + M[8]*P.Z  + M[12],
+                      M[1]*P.X + M[5]*P.Y + M[9]*P.Z  + M[13],
+                      M[2]*P.X + M[6]*P.Y + M[10]*P.Z + M[14], P.t);
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms the direction vector V (translation is ignored). The t
+      component is preserved.
+     ------------------------------------------------------------------------*/
+   __forceinline PointRec Vector(const PointRec &V)
+      {
+      return PointRec(M[0]*V.X + M[4]*V.Y + M[8]*V.Z,
+                      M[1]*V.X + M[5]*V.Y + M[9]*V.Z,
+                      M[2]*V.X + M[6]*V.Y + M[10]*V.Z, V.t);
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the largest scaling factor of the matrix (the length of the 
+      longest axis in the upper 3x3).
+     ------------------------------------------------------------------------*/
+   float MaxScale(void)
+      {
+      float Max = 0.0f;
+      for (int C = 0; C < 3; C++)
+         {
+         float L = M[C*4]*M[C*4] + M[C*4 + 1]*M[C*4 + 1] + M[C*4 + 2]*M[C*4 + 2];
+         if (L > Max) {Max = L;}
+         }
+      return (float)sqrt(Max);
+      }
+
+   /*-------------------------------------------------------------------------
+      Computes the inverse of the matrix in Inv. The bottom row is assumed 
+      to be 0, 0, 0, 1, which holds for all the transforms above. Returns 
+      false if the matrix is singular.
+     ------------------------------------------------------------------------*/
+   bool Inverse(XformRec &Inv)
+      {
+      float Det = M[0]*(M[5]*M[10] - M[6]*M[9]) + M[4]*(M[9]*M[2] - M[10]*M[1]) + M[8]*(M[1]*M[6] - M[2]*M[5]);
+      if (Det == 0.0f) {return false;}
+      Det = 1.0f / Det;
+
+      //The upper 3x3 is the transposed cofactor matrix over the determinant
+      Inv.Identity();
+      Inv.M[0]  = (M[5]*M[10] - M[6]*M[9])  * Det;
+      Inv.M[1]  = (M[9]*M[2]  - M[10]*M[1]) * Det;
+      Inv.M[2]  = (M[1]*M[6]  - M[2]*M[5])  * Det;
+      Inv.M[4]  = (M[6]*M[8]  - M[4]*M[10]) * Det;
+      Inv.M[5]  = (M[10]*M[0] - M[8]*M[2])  * Det;
+      Inv.M[6]  = (M[2]*M[4]  - M[0]*M[6])  * Det;
+      Inv.M[8]  = (M[4]*M[9]  - M[5]*M[8])  * Det;
+      Inv.M[9]  = (M[8]*M[1]  - M[9]*M[0])  * Det;
+      Inv.M[10] = (M[0]*M[5]  - M[1]*M[4])  * Det;
+
+      //The translation is undone after the inverse 3x3
+      Inv.M[12] = -(Inv.M[0]*M[12] + Inv.M[4]*M[13] + Inv.M[8]*M[14]);
+      Inv.M[13] = -(Inv.M[1]*M[12] + Inv.M[5]*M[13] + Inv.M[9]*M[14]);
+      Inv.M[14] = -(Inv.M[2]*M[12] + Inv.M[6]*M[13] + Inv.M[10]*M[14]);
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the matrix for transforming normals. This is the cofactor
+      matrix of the upper 3x3, which is the inverse transpose scaled by the
+      determinant. The sign of the determinant is compensated for, so the
+      normals only need to be normalized after Vector( ).
+     ------------------------------------------------------------------------*/
+   XformRec NormalXform(void)
+      {
+      XformRec N;
+      N.M[0]  = M[5]*M[10] - M[6]*M[9];
+      N.M[1]  = M[6]*M[8]  - M[4]*M[10];
+      N.M[2]  = M[4]*M[9]  - M[5]*M[8];
+      N.M[4]  = M[9]*M[2]  - M[10]*M[1];
+      N.M[5]  = M[10]*M[0] - M[8]*M[2];
+      N.M[6]  = M[8]*M[1]  - M[9]*M[0];
+      N.M[8]  = M[1]*M[6]  - M[2]*M[5];
+      N.M[9]  = M[2]*M[4]  - M[0]*M[6];
+      N.M[10] = M[0]*M[5]  - M[1]*M[4];
+
+      //Determinant of the upper 3x3
+      float Det = M[0]*N.M[0] + M[4]*N.M[4] + M[8]*N.M[8];
+      if (Det < 0.0f)
+         {
+         N.M[0] = -N.M[0]; N.M[1] = -N.M[1]; N.M[2]  = -N.M[2];
+         N.M[4] = -N.M[4]; N.M[5] = -N.M[5]; N.M[6]  = -N.M[6];
+         N.M[8] = -N.M[8]; N.M[9] = -N.M[9]; N.M[10] = -N.M[10];
+         }
+
+      return N;
+      }
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
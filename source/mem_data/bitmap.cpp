@@ -303,6 +303,25 @@ class BitmapRec
       *this = BitmapRec();
       }
 
+   /*-------------------------------------------------------------------------
+      Moves the data of the Source bitmap into *this bitmap, without copying
+      it. The existing data of *this bitmap is deleted, and the Source is
+      left empty.
+     -------------------------------------------------------------------------*/
+   void MoveFrom(BitmapRec* Source)
+      {
+      if ((Source == NULL) || (Source == this)) {return;}
+
+      DeleteData();
+      *this = *Source;
+
+      Source->Pixel         = NULL;
+      Source->BitmapPtr     = NULL;
+      Source->ColorTablePtr = NULL;
+      Source->FontTablePtr  = NULL;
+      Source->DeleteData();
+      }
+
    /*-------------------------------------------------------------------------
       Converts *this bitmap to an other type, specified by NewFlags. If the 
       MakeNew flag is set, the function duplicates *this bitmap, converts it, 
@@ -16,6 +16,7 @@
   ---------------------------------------------------------------------------*/
 #include "../_common/std_inc.h"
 #include "../math/pointrec.h"
+#include "../mem_data/entity.cpp"
 
 
 //-- Video Configuration --
@@ -53,6 +54,8 @@ struct ConfigRender
    float    AA_Jitter;
    float    AA_Treshold;
    float    AdaptDepthTresh;
+   float    LOD_Pixels;                      //Desired Polygon size in pixels for the level of detail selection (0 disables it)
+   float    NURB_Pixels;                     //Desired Nurb chord error in pixels (0 disables the re-tessellation)
    dword    CurrentDevice;                   //Specifies the current rendering device
    };
 
@@ -64,6 +67,9 @@ struct ConfigWorld
    PointRec VRotation;                       //View initial rotation
    PointRec VOrientation;                    //View orientation
    ColorRec AmbLight;
+   float    WeldEpsilon;                     //Vertex welding distance for loaded meshes (0 disables welding)
+   dword    LOD_Levels;                      //Number of levels of detail built for loaded meshes
+   float    LOD_Ratio;                       //Polygon reduction per level of detail
    };
 
 
@@ -113,6 +119,8 @@ class ConfigRec
       this->Render.AA_Jitter        = 0.0075f;
       this->Render.AA_Treshold      = 0.01f;
       this->Render.AdaptDepthTresh  = 0.2f;
+      this->Render.LOD_Pixels       = 4.0f;
+      this->Render.NURB_Pixels      = 0.5f;
 
       //-- Reset the World config structure --
       this->World.VOrigin           = 0.0f;
@@ -120,6 +128,9 @@ class ConfigRec
       this->World.VRotation         = 0.0f;
       this->World.VOrientation      = 0.0f;
       this->World.AmbLight          = 0.0f;
+      this->World.WeldEpsilon       = ENTITY_WELD_EPSILON;
+      this->World.LOD_Levels        = 3;
+      this->World.LOD_Ratio         = 0.5f;
       }
 
    /*---- Destructor ---------------------------------------------------------*/
@@ -17,8 +17,14 @@
 #include "../_common/std_inc.h"
 #include "../_common/std_3d.h"
 #include "../_common/list.cpp"
+#include "../_common/journal.cpp"
 #include "../mem_data/vertex.cpp"
+#include "../mem_data/polygon.cpp"
+#include "../mem_data/recpool.cpp"
+#include "../mem_data/nurb.cpp"
 #include "../math/mathcnst.h"
+#include "../math/xformrec.cpp"
+#include "../math/simplify.cpp"
 
 
 /*----------------------------------------------------------------------------
@@ -41,10 +47,27 @@
 
 //Other flags
 #define ENTITY_SHADE       0x00000100     //Flag to indicate that shading is required
+#define ENTITY_XFORM       0x00000200     //Flag to indicate that the world space geometry is out of date
+
+//Dirty flags (see MarkDirty( ))
+#define ENTITY_DIRTY_GEOMETRY 0x00000001  //The Vertices or Polygons were modified or replaced
+#define ENTITY_DIRTY_XFORM    0x00000002  //The transform was modified
+#define ENTITY_DIRTY_MATERIAL 0x00000004  //The Materials were modified
+#define ENTITY_DIRTY_LIGHT    0x00000008  //The lights were modified
+#define ENTITY_DIRTY_MASK     0x0000000F
 
 #define ENTITY_BV_COUNT    8              //Bounding volume vertex count
 #define ENTITY_BVFACE_COUNT 6              //Bounding volume face count
 
+#define ENTITY_WELD_EPSILON 0.0001f        //Default Vertex welding distance (see Weld( ))
+#define ENTITY_WELD_NONE   0xFFFFFFFF     //End of a Weld( ) hash bucket
+
+#define ENTITY_LOD_RATIO   0.5f           //Default Polygon reduction per level of detail (see BuildLOD( ))
+#define ENTITY_LOD_MIN     32             //Minimum number of Polygons in a level of detail
+
+#define ENTITY_NURB_TOLERANCE 0.001f      //Initial chord error of a Nurb surface, relative to it's size (see SetNurb( ))
+#define ENTITY_NURB_NEAR   0.01f          //Minimum view distance for the Nurb tessellation, relative to the bounding radius
+
 
 /*---------------------------------------------------------------------------
   The Entity class.
@@ -54,6 +77,325 @@ class EntityRec
    /*==== Private Declarations ===============================================*/
    private:
 
+   XformRec NormalXform;                  //Normal transform, set up by BeginMaterialize( )
+
+   /*-------------------------------------------------------------------------
+      Returns true if Vertex is part of the bounding volume.
+     -------------------------------------------------------------------------*/
+   inline bool IsBV(VertexRec* Vertex)
+      {
+      for (int I = 0; I < ENTITY_BV_COUNT; I++) {if (BV[I] == Vertex) {return true;}}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the number of Vertices in VertexArray, including the bounding 
+      volume (if it exists).
+     -------------------------------------------------------------------------*/
+   inline dword TotalVertexCount(void)
+      {
+      return VertexCount + ((BV[0] != NULL) ? ENTITY_BV_COUNT : 0);
+      }
+
+   /*-------------------------------------------------------------------------
+      Computes the Weld( ) hash value for a spatial cell.
+     -------------------------------------------------------------------------*/
+   inline dword WeldHash(int X, int Y, int Z)
+      {
+      return ((dword)X * 73856093) ^ ((dword)Y * 19349663) ^ ((dword)Z * 83492791);
+      }
+
+   /*-------------------------------------------------------------------------
+      Releases the rest pose, and resets the transform. The current world 
+      space geometry becomes the new rest pose the next time *this Entity 
+      is transformed. Sub-Entities are not processed.
+     -------------------------------------------------------------------------*/
+   void DropRestPose(void)
+      {
+      if (RestCoord != NULL) {delete[] RestCoord;}
+      RestCoord      = NULL;
+      RestNormal     = NULL;
+      RestPolyNormal = NULL;
+      RestCount      = 0;
+      Xform.Identity();
+      }
+
+   /*-------------------------------------------------------------------------
+      Stores the current geometry as the rest pose, unless it's already 
+      stored. Sub-Entities are not processed. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool SetRestPose(void)
+      {
+      dword Count = TotalVertexCount();
+      if ((RestCoord != NULL) && (RestCount == Count)) {return true;}
+
+      //The geometry changed size, so start from the world space geometry
+      MaterializeLocal();
+      DropRestPose();
+      if ((Count == 0) && (PolygonCount == 0)) {return true;}
+
+      //-- The Vertex coordinates, Vertex normals and Polygon normals are 
+      //   stored in a single block --
+      RestCoord = new PointRec[Count * 2 + PolygonCount];
+      if (RestCoord == NULL) {printf("EntityRec::SetRestPose( ): Memory allocation failed.\n"); return false;}
+      RestNormal     = RestCoord + Count;
+      RestPolyNormal = RestNormal + Count;
+      RestCount      = Count;
+
+      dword I;
+      for (I = 0; I < Count; I++)
+         {
+         RestCoord[I]  = VertexArray[I].Coord;
+         RestNormal[I] = VertexArray[I].Normal;
+         }
+      for (I = 0; I < PolygonCount; I++) {RestPolyNormal[I] = PolygonArray[I].Normal;}
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Computes the world space geometry from the rest pose and the 
+      accumulated transform, if it's out of date. Sub-Entities are not 
+      processed.
+     -------------------------------------------------------------------------*/
+   void MaterializeLocal(void)
+      {
+      if (!BeginMaterialize()) {return;}
+      MaterializeVertices(0, RestCount);
+      MaterializePolygons(0, PolygonCount);
+      }
+
+   /*-------------------------------------------------------------------------
+      Creates a level of detail from the current state of Simplify, which 
+      must be set up from the arrays of *this Entity. The Polygons keep 
+      their Materials, cold data and facet flags, and the normals are 
+      recomputed. Returns NULL on fail.
+     -------------------------------------------------------------------------*/
+   EntityRec* NewLOD(SimplifyClass &Simplify)
+      {
+      //Local variables
+      EntityRec*  Level     = new EntityRec;
+      VertexRec** NewVertex = new VertexRec*[VertexCount];
+      dword       P, V;
+      int         I;
+
+      if ((Level == NULL) || (NewVertex == NULL)) {goto _ExitError;}
+      for (V = 0; V < VertexCount; V++) {NewVertex[V] = NULL;}
+
+      Level->Flags    = Flags & ~ENTITY_XFORM;
+      Level->Centroid = Centroid;
+
+      //-- Copy the remaining Polygons, and the Vertices they use --
+      for (P = 0; P < PolygonCount; P++)
+         {
+         if (Simplify.PolygonRemoved(P)) {continue;}
+
+         PolygonRec* Polygon = Level->Pool.NewPolygon();
+         if ((Polygon == NULL) || !Level->Pool.Insert(Level->PolygonList, Polygon)) {goto _ExitError;}
+
+         PolyColdRec* Cold = Polygon->Cold;
+         *Polygon      = PolygonArray[P];
+         *Cold         = *PolygonArray[P].Cold;
+         Polygon->Cold = Cold;
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            V = Simplify.PolygonVertex(P, I);
+            if (NewVertex[V] == NULL)
+               {
+               NewVertex[V] = Level->Pool.NewVertex();
+               if ((NewVertex[V] == NULL) || !Level->Pool.Insert(Level->VertexList, NewVertex[V])) {goto _ExitError;}
+
+               *NewVertex[V]              = VertexArray[V];
+               NewVertex[V]->Coord        = Simplify.VertexCoord(V);
+               NewVertex[V]->PolyRefCount = 0;
+               }
+            Polygon->Vertex[I] = NewVertex[V];
+            }
+         }
+
+      delete[] NewVertex;
+      NewVertex = NULL;
+
+      //-- Set up the indexed mesh (this also copies the Materials) --
+      if (!Level->BuildMesh())       {goto _ExitError;}
+      if (!Level->CalcNormals(true)) {goto _ExitError;}
+
+      //-- Normal exit --
+      return Level;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::NewLOD( ): Failed to build the level of detail.\n");
+      if (NewVertex != NULL) {delete[] NewVertex;}
+      if (Level     != NULL) {delete Level;}
+      return NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Rounds the Nurb tessellation tolerance down to a power of 2, so that 
+      small changes of the view don't trigger a new tessellation.
+     -------------------------------------------------------------------------*/
+   inline float RoundTolerance(float Tolerance)
+      {
+      if (Tolerance <= 0.0f) {return 0.0f;}
+      int Exp;
+      frexp(Tolerance, &Exp);
+      return (float)ldexp(0.5, Exp);
+      }
+
+   /*-------------------------------------------------------------------------
+      Replaces the geometry of *this Entity with a tessellation of Nurb. The 
+      tessellation is built in the control point space, and the accumulated
+      transform is re-applied, so it follows the transforms of *this Entity.
+      All the Polygons use Material, and the Vertex normals are evaluated
+      from the surface. Sub-Entities are not affected. Returns true on 
+      success.
+     -------------------------------------------------------------------------*/
+   bool BuildNurb(float Tolerance, MaterialRec Material)
+      {
+      //Local variables
+      float*       S_Param   = NULL;
+      float*       T_Param   = NULL;
+      dword        S_Count   = 0;
+      dword        T_Count   = 0;
+      VertexRec*   *Grid     = NULL;
+      PointRec*    Normal    = NULL;
+      TexPointRec* TexPoint  = NULL;
+      ListRec*     Children  = EntityList;
+      MaterialRec* NewMaterial;
+      XformRec     OldXform;
+      bool         Moved;
+      dword        I, S, T;
+
+      //The tessellation replaces the rest pose, the world space geometry 
+      // is the rest pose transformed by OldXform
+      MaterializeLocal();
+      OldXform = Xform;
+      Moved    = !Xform.IsIdentity();
+
+      if (!Nurb->Tessellate(Tolerance, S_Param, S_Count, T_Param, T_Count)) {goto _ExitError;}
+
+      Grid     = new VertexRec*[S_Count * T_Count];
+      Normal   = new PointRec[S_Count * T_Count];
+      TexPoint = new TexPointRec[S_Count * T_Count];
+      if ((Grid == NULL) || (Normal == NULL) || (TexPoint == NULL)) {goto _ExitError;}
+
+
+      //-- Release the old geometry --
+      EntityList = NULL;
+      DropRestPose();
+      DropLOD();
+      Pool.Free();
+      if (IndexArray != NULL) {delete[] IndexArray; IndexArray = NULL;}
+      for (I = 0; I < ENTITY_BV_COUNT; I++) {BV[I] = NULL;}
+
+      VertexList    = NULL;
+      PolygonList   = NULL;
+      VertexArray   = NULL;
+      BV_Room       = false;
+      VertexCount   = 0;
+      PolygonArray  = NULL;
+      PolygonCount  = 0;
+      MaterialArray = NULL;
+      MaterialCount = 0;
+
+      if (!Pool.Reserve(S_Count * T_Count + ENTITY_BV_COUNT, (S_Count-1) * (T_Count-1) * 2)) {goto _ExitError;}
+
+      NewMaterial = Pool.NewMaterial();
+      if (NewMaterial == NULL) {goto _ExitError;}
+      *NewMaterial = Material;
+      Pool.Default = NewMaterial;
+
+
+      //-- Evaluate the Vertices. They are inserted in reverse, so the list 
+      //   (and the Vertex array) is in grid order. --
+      for (I = S_Count * T_Count; I > 0; I--)
+         {
+         S = (I-1) % S_Count;
+         T = (I-1) / S_Count;
+
+         Grid[I-1] = Pool.NewVertex();
+         if ((Grid[I-1] == NULL) || !Pool.Insert(VertexList, Grid[I-1])) {goto _ExitError;}
+         if (!Nurb->Eval(S_Param[S], T_Param[T], Grid[I-1]->Coord, Normal[I-1])) {goto _ExitError;}
+         TexPoint[I-1] = Nurb->EvalTexPoint(S_Param[S], T_Param[T]);
+         }
+
+
+      //-- Triangulate the grid. The winding matches the direction of the 
+      //   surface normals. Degenerate Polygons (eg. at collapsed edges) 
+      //   are skipped. --
+      for (T = 0; T+1 < T_Count; T++)
+         {
+         for (S = 0; S+1 < S_Count; S++)
+            {
+            dword TL = T*S_Count + S;
+            dword Corner[2][POLY_PT_COUNT] = {{TL, TL+1, TL+S_Count}, {TL+1, TL+S_Count+1, TL+S_Count}};
+
+            for (dword P = 0; P < 2; P++)
+               {
+               PointRec Edge0 = Grid[Corner[P][1]]->Coord - Grid[Corner[P][0]]->Coord;
+               PointRec Edge1 = Grid[Corner[P][2]]->Coord - Grid[Corner[P][0]]->Coord;
+               if (Edge0.Cross(Edge1).MagSqr() == 0.0f) {continue;}
+
+               PolygonRec* Polygon = Pool.NewPolygon();
+               if ((Polygon == NULL) || !Pool.Insert(PolygonList, Polygon)) {goto _ExitError;}
+
+               for (dword V = 0; V < POLY_PT_COUNT; V++)
+                  {
+                  Polygon->Vertex[V]         = Grid[Corner[P][V]];
+                  Polygon->Cold->TexCoord[V] = TexPoint[Corner[P][V]];
+                  }
+               }
+            }
+         }
+
+
+      //-- Set up the indexed mesh, and use the surface normals where they
+      //   are defined --
+      if (!BuildMesh())         {goto _ExitError;}
+      if (!CalcNormals(false))  {goto _ExitError;}
+      for (I = 0; I < VertexCount; I++)
+         {
+         if (Normal[I].MagSqr() != 0.0f) {VertexArray[I].Normal = Normal[I];}
+         }
+      if (!FindBoundingBox(false)) {goto _ExitError;}
+      EntityList = Children;
+
+      //-- Re-apply the transform --
+      if (Moved)
+         {
+         if (!SetRestPose()) {goto _ExitError;}
+         Xform  = OldXform;
+         Flags |= ENTITY_XFORM;
+         MaterializeLocal();
+         }
+
+      MarkDirty(ENTITY_DIRTY_GEOMETRY);
+      NurbStamp     = Nurb->Stamp;
+      NurbTolerance = Tolerance;
+
+      delete[] S_Param;
+      delete[] T_Param;
+      delete[] Grid;
+      delete[] Normal;
+      delete[] TexPoint;
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::BuildNurb( ): Failed to tessellate the surface.\n");
+      EntityList = Children;
+      if (S_Param  != NULL) {delete[] S_Param;}
+      if (T_Param  != NULL) {delete[] T_Param;}
+      if (Grid     != NULL) {delete[] Grid;}
+      if (Normal   != NULL) {delete[] Normal;}
+      if (TexPoint != NULL) {delete[] TexPoint;}
+      return false;
+      }
+
 
    /*==== Public Declarations ================================================*/
    public:
@@ -65,9 +407,49 @@ class EntityRec
    PointRec   Velocity;                   //The velociy of the entity
    PointRec   Rotation;                   //The rotational angles
    VertexRec* BV[ENTITY_BV_COUNT];        //Bounding volume vertex pointers
-   ListRec*   VertexList;                 //List of vertices for the entity
-   ListRec*   PolygonList;                //List of polygons for the entity
+   ListRec*   VertexList;                 //List of vertices for the entity (allocated from Pool)
+   ListRec*   PolygonList;                //List of polygons for the entity (allocated from Pool)
    ListRec*   EntityList;                 //Lisy of sub-entities
+   RecPoolClass Pool;                     //Storage for the Vertices, Polygons and their list nodes
+
+   //-- Indexed mesh (see BuildMesh( )). The Vertex and Polygon lists point
+   //   into these arrays. --
+   VertexRec*  VertexArray;               //Contiguous Vertices, followed by ENTITY_BV_COUNT bounding volume Vertices if BV_Room is set
+   bool        BV_Room;                   //Space for the bounding volume is reserved after VertexArray
+   dword       VertexCount;               //Number of Vertices, excluding the bounding volume
+   PolygonRec* PolygonArray;              //Contiguous Polygons
+   dword       PolygonCount;              //Number of Polygons
+   dword*      IndexArray;                //Vertex indices of every Polygon (POLY_PT_COUNT per Polygon)
+   MaterialRec* MaterialArray;            //Material table, the Polygons refer to it with MatIndex
+   dword       MaterialCount;             //Number of Materials
+
+   //-- Rest pose (see Materialize( )). The world space geometry is the rest
+   //   pose transformed by Xform. --
+   XformRec    Xform;                     //Accumulated transform since the rest pose was stored
+   PointRec*   RestCoord;                 //Rest pose Vertex coordinates (including the bounding volume)
+   PointRec*   RestNormal;                //Rest pose Vertex normals
+   PointRec*   RestPolyNormal;            //Rest pose Polygon normals
+   dword       RestCount;                 //Number of Vertices in the rest pose
+
+   //-- Levels of detail (see BuildLOD( )). Each level is a simplified copy
+   //   of *this Entity without sub-Entities or a bounding volume. --
+   EntityRec*  LOD;                       //Next coarser level (NULL if there is none)
+   EntityRec*  Detail;                    //Level selected for rendering by SelectLOD( ), *this by default
+
+   //-- Parametric surface (see SetNurb( )). The geometry of *this Entity 
+   //   is a tessellation of the surface. --
+   NurbRec*    Nurb;                      //Surface control data (NULL if there is none)
+   dword       NurbStamp;                 //NurbRec::Stamp at the time of the last tessellation
+   float       NurbTolerance;             //Chord error of the last tessellation (in control point units)
+
+   float*     TessData;                   //Cached tessellation (renderer specific): R, G, B, X, Y, Z per point
+   dword      TessCount;                  //Number of points in TessData
+   dword      TessSize;                   //Allocated number of points in TessData
+   dword      TessStamp;                  //Renderer stamp at the time TessData was built (0 is invalid)
+
+   //-- Change tracking (see MarkDirty( )) --
+   dword         Dirty;                   //ENTITY_DIRTY_* flags, the changes since the journal was cleared
+   JournalClass* Journal;                 //Change journal of the World (NULL if not in a World)
 
 
    /*---- Constructor --------------------------------------------------------*/
@@ -84,6 +466,35 @@ class EntityRec
       VertexList  = NULL;
       PolygonList = NULL;
       EntityList  = NULL;
+
+      VertexArray  = NULL;
+      BV_Room      = false;
+      VertexCount  = 0;
+      PolygonArray = NULL;
+      PolygonCount = 0;
+      IndexArray   = NULL;
+      MaterialArray = NULL;
+      MaterialCount = 0;
+
+      RestCoord      = NULL;
+      RestNormal     = NULL;
+      RestPolyNormal = NULL;
+      RestCount      = 0;
+
+      LOD         = NULL;
+      Detail      = this;
+
+      Nurb          = NULL;
+      NurbStamp     = 0;
+      NurbTolerance = 0.0f;
+
+      TessData    = NULL;
+      TessCount   = 0;
+      TessSize    = 0;
+      TessStamp   = 0;
+
+      Dirty       = ENTITY_NULL;
+      Journal     = NULL;
       
       for (int I = 0; I < ENTITY_BV_COUNT; I++) {BV[I] = NULL;}
       }
@@ -91,13 +502,618 @@ class EntityRec
    /*---- Destructor ---------------------------------------------------------*/
    ~EntityRec(void) 
       {
-      //Deallocate all the sub-Entitites (this will recursively call the 
-      // destructor, ~EntityRec( )).
-      while (EntityList != NULL) {delete (EntityRec*)LinkedList.Retrieve(EntityList);}
+      //Deallocate all the sub-Entitites (this will recursively call the 
+      // destructor, ~EntityRec( )).
+      while (EntityList != NULL) {delete (EntityRec*)LinkedList.Retrieve(EntityList);}
+
+      //The Vertex and Polygon lists are released all at once with the pool
+      VertexList   = NULL;
+      PolygonList  = NULL;
+      VertexArray  = NULL;
+      PolygonArray = NULL;
+      MaterialArray = NULL;
+      Pool.Free();
+
+      if (IndexArray != NULL) {delete[] IndexArray; IndexArray = NULL;}
+      DropRestPose();
+      DropLOD();
+      if (Nurb != NULL) {delete Nurb; Nurb = NULL;}
+
+      if (TessData != NULL) {free(TessData); TessData = NULL;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Welds the Vertices of *this Entity that are closer than Epsilon to 
+      each other, so that the Polygons share them, and the normals are 
+      smoothed correctly. The Vertices are sorted into a spatial hash with 
+      cells of Epsilon in size, so only the neighbouring cells are searched.
+      Polygons that become degenerate are removed. This operates on the 
+      lists, and must be called before BuildMesh( ), CalcNormals( ) and 
+      SetFacet( ). Sub-Entities are not processed. Returns true on success.
+
+      Epsilon  : Welding distance. Welding is disabled if Epsilon <= 0.
+     -------------------------------------------------------------------------*/
+   bool Weld(float Epsilon)
+      {
+      //Local variables
+      ListRec*     VertexNode;
+      ListRec*     PolygonNode;
+      VertexRec*   *Vertices = NULL;       //Vertices in list order
+      dword*       WeldTo    = NULL;       //Index of the Vertex each Vertex is welded to
+      dword*       Head      = NULL;       //First Vertex in each hash bucket
+      dword*       Next      = NULL;       //Next Vertex in the same hash bucket
+      dword        Count     = 0;
+      dword        Indexed   = 0;          //Number of Vertices with their index in PolyRefCount
+      dword        TableSize = 1;
+      dword        I, J;
+      int          K;
+
+      if (Epsilon <= 0.0f) {return true;}
+      float Scale    = 1.0f / Epsilon;
+      float Epsilon2 = Epsilon * Epsilon;
+
+      //-- Count the Vertices (excluding the bounding volume) --
+      for (VertexNode = VertexList; VertexNode != NULL; VertexNode = VertexNode->Next)
+         {
+         if (VertexNode->Data == NULL) {goto _ExitError;}
+         if (!IsBV((VertexRec*)VertexNode->Data)) {Count++;}
+         }
+      if (Count < 2) {return true;}
+
+      while (TableSize < Count * 2) {TableSize <<= 1;}
+
+      Vertices = new VertexRec*[Count];
+      WeldTo   = new dword[Count];
+      Head     = new dword[TableSize];
+      Next     = new dword[Count];
+      if ((Vertices == NULL) || (WeldTo == NULL) || (Head == NULL) || (Next == NULL)) {goto _ExitError;}
+
+      for (I = 0; I < TableSize; I++) {Head[I] = ENTITY_WELD_NONE;}
+
+      //-- The PolyRefCount of the Vertices is used to store their index --
+      for (VertexNode = VertexList; VertexNode != NULL; VertexNode = VertexNode->Next)
+         {
+         #define Vertex ((VertexRec*)VertexNode->Data)
+         if (IsBV(Vertex)) {continue;}
+
+         Vertices[Indexed]    = Vertex;
+         Vertex->PolyRefCount = Indexed;
+         Indexed++;
+         #undef Vertex
+         }
+
+
+      //---- Find the Vertex to weld to. Only the Vertices that are kept are
+      //     inserted into the hash table. ----
+      for (I = 0; I < Count; I++)
+         {
+         PointRec &Coord = Vertices[I]->Coord;
+         int       CX    = (int)floor(Coord.X * Scale);
+         int       CY    = (int)floor(Coord.Y * Scale);
+         int       CZ    = (int)floor(Coord.Z * Scale);
+
+         //Search the neighbouring cells
+         WeldTo[I] = I;
+         for (K = 0; (K < 27) && (WeldTo[I] == I); K++)
+            {
+            dword H = WeldHash(CX + K % 3 - 1, CY + (K / 3) % 3 - 1, CZ + K / 9 - 1) & (TableSize - 1);
+            for (J = Head[H]; J != ENTITY_WELD_NONE; J = Next[J])
+               {
+               PointRec D = Vertices[J]->Coord - Coord;
+               if (D.X*D.X + D.Y*D.Y + D.Z*D.Z <= Epsilon2) {WeldTo[I] = J; break;}
+               }
+            }
+
+         //Keep the Vertex
+         if (WeldTo[I] == I)
+            {
+            dword H = WeldHash(CX, CY, CZ) & (TableSize - 1);
+            Next[I] = Head[H];
+            Head[H] = I;
+            }
+         }
+
+
+      //---- Redirect the Polygons, and remove the degenerate ones ----
+      PolygonNode = PolygonList;
+      while (PolygonNode != NULL)
+         {
+         #define Polygon ((PolygonRec*)PolygonNode->Data)
+         if (Polygon == NULL) {goto _ExitError;}
+
+         for (K = 0; K < POLY_PT_COUNT; K++)
+            {
+            VertexRec* Vertex = Polygon->Vertex[K];
+            if ((Vertex == NULL) || (Vertex->PolyRefCount >= Count) || (Vertices[Vertex->PolyRefCount] != Vertex)) {goto _ExitError;}
+            Polygon->Vertex[K] = Vertices[WeldTo[Vertex->PolyRefCount]];
+            }
+
+         PointRec Cross = (Polygon->Vertex[1]->Coord - Polygon->Vertex[0]->Coord).Cross(Polygon->Vertex[2]->Coord - Polygon->Vertex[0]->Coord);
+         bool     Degenerate = (Polygon->Vertex[0] == Polygon->Vertex[1]) || 
+                               (Polygon->Vertex[1] == Polygon->Vertex[2]) || 
+                               (Polygon->Vertex[2] == Polygon->Vertex[0]) ||
+                               ((Cross.X == 0.0f) && (Cross.Y == 0.0f) && (Cross.Z == 0.0f));
+
+         ListRec* OldNode = PolygonNode;
+         PolygonNode = PolygonNode->Next;
+         if (Degenerate) {Pool.Unlink(PolygonList, OldNode);}
+         #undef Polygon
+         }
+
+
+      //---- Remove the welded Vertices from the list ----
+      VertexNode = VertexList;
+      while (VertexNode != NULL)
+         {
+         VertexRec* Vertex  = (VertexRec*)VertexNode->Data;
+         ListRec*   OldNode = VertexNode;
+         VertexNode = VertexNode->Next;
+         if (!IsBV(Vertex) && (WeldTo[Vertex->PolyRefCount] != Vertex->PolyRefCount)) {Pool.Unlink(VertexList, OldNode);}
+         }
+
+      for (I = 0; I < Count; I++) {Vertices[I]->PolyRefCount = 0;}
+
+
+      //-- Normal exit --
+      delete[] Vertices;
+      delete[] WeldTo;
+      delete[] Head;
+      delete[] Next;
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::Weld( ): Failed to weld the Vertices.\n");
+      if (Vertices != NULL)
+         {
+         for (I = 0; I < Indexed; I++) {Vertices[I]->PolyRefCount = 0;}
+         delete[] Vertices;
+         }
+      if (WeldTo != NULL) {delete[] WeldTo;}
+      if (Head   != NULL) {delete[] Head;}
+      if (Next   != NULL) {delete[] Next;}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Builds the indexed mesh of *this Entity from the Vertex and Polygon
+      lists. The Vertices and Polygons are copied into contiguous arrays,
+      the Polygons are redirected to the new Vertices, and the IndexArray
+      is set up. Identical Materials are merged into the MaterialArray, and
+      the cold data of the Polygons are stored in a separate array. Space
+      for the bounding volume is reserved at the end of the VertexArray.
+      The lists are rebuilt to point into the arrays, so any code walking
+      the lists still works.
+
+      This must be called once the lists are set up, as all the other 
+      geometry functions operate on the arrays. Sub-Entities are not 
+      processed. Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool BuildMesh(void)
+      {
+      //Local variables
+      RecPoolClass NewPool;
+      ListRec*     VertexNode;
+      ListRec*     PolygonNode;
+      ListRec*     NewVertexList    = NULL;
+      ListRec*     NewPolygonList   = NULL;
+      VertexRec*   NewVertexArray   = NULL;
+      PolygonRec*  NewPolygonArray  = NULL;
+      MaterialRec* NewMaterialArray = NULL;
+      MaterialRec* *UniqueMaterial  = NULL;
+      MaterialRec* LastMaterial     = NULL;
+      dword*       NewIndexArray    = NULL;
+      dword        NewVertexCount   = 0;
+      dword        NewPolygonCount  = 0;
+      dword        NewMaterialCount = 0;
+      dword        I, J;
+
+
+      //The arrays are rebuilt, so the rest pose and the levels of detail 
+      // are no longer valid
+      MaterializeLocal();
+      DropRestPose();
+      DropLOD();
+
+      //-- Count the Vertices (excluding the bounding volume) and Polygons --
+      for (VertexNode = VertexList; VertexNode != NULL; VertexNode = VertexNode->Next)
+         {
+         if (VertexNode->Data == NULL) {return false;}
+         if (!IsBV((VertexRec*)VertexNode->Data)) {NewVertexCount++;}
+         }
+
+      for (PolygonNode = PolygonList; PolygonNode != NULL; PolygonNode = PolygonNode->Next)
+         {
+         if (PolygonNode->Data == NULL) {return false;}
+         NewPolygonCount++;
+         }
+
+
+      //-- Find the unique Materials. The MatIndex of each Polygon is set to 
+      //   the index of its Material in the new table. --
+      if (NewPolygonCount > 0)
+         {
+         UniqueMaterial = new MaterialRec*[NewPolygonCount];
+         if (UniqueMaterial == NULL) {goto _ExitError;}
+         }
+
+      J = 0;
+      for (PolygonNode = PolygonList; PolygonNode != NULL; PolygonNode = PolygonNode->Next)
+         {
+         #define Polygon ((PolygonRec*)PolygonNode->Data)
+         if ((Polygon->Material == NULL) || (Polygon->Cold == NULL)) {goto _ExitError;}
+
+         //Neighbouring Polygons usually share the same Material
+         if (Polygon->Material != LastMaterial)
+            {
+            LastMaterial = Polygon->Material;
+            for (J = 0; J < NewMaterialCount; J++)
+               {
+               if ((UniqueMaterial[J] == LastMaterial) || UniqueMaterial[J]->Equal(LastMaterial)) {break;}
+               }
+            if (J == NewMaterialCount) {UniqueMaterial[NewMaterialCount++] = LastMaterial;}
+            }
+
+         Polygon->MatIndex = J;
+         #undef Polygon
+         }
+
+
+      //-- Allocate the arrays, each in a single pool block --
+      if (!NewPool.Reserve(NewVertexCount + ENTITY_BV_COUNT, NewPolygonCount)) {goto _ExitError;}
+      if (!NewPool.Materials.Reserve(NewMaterialCount)) {goto _ExitError;}
+
+      for (I = 0; I < NewMaterialCount; I++)
+         {
+         MaterialRec* NewMaterial = NewPool.NewMaterial();
+         if (NewMaterial == NULL) {goto _ExitError;}
+         if (I == 0) {NewMaterialArray = NewMaterial;}
+         *NewMaterial = *UniqueMaterial[I];
+         }
+
+      //The first Material becomes the default for new Polygons
+      if (NewMaterialCount > 0) {NewPool.Default = NewMaterialArray;}
+
+      for (I = 0; I < NewVertexCount + ENTITY_BV_COUNT; I++)
+         {
+         VertexRec* NewVertex = NewPool.NewVertex();
+         if (NewVertex == NULL) {goto _ExitError;}
+         if (I == 0) {NewVertexArray = NewVertex;}
+         }
+
+      for (I = 0; I < NewPolygonCount; I++)
+         {
+         PolygonRec* NewPolygon = NewPool.NewPolygon();
+         if (NewPolygon == NULL) {goto _ExitError;}
+         if (I == 0) {NewPolygonArray = NewPolygon;}
+         }
+
+      if (NewPolygonCount > 0)
+         {
+         NewIndexArray = new dword[NewPolygonCount * POLY_PT_COUNT];
+         if (NewIndexArray == NULL) {goto _ExitError;}
+         }
+
+
+      //-- Copy the Vertices. The PolyRefCount of the old Vertices is used 
+      //   to store the new array index. --
+      I = 0;
+      for (VertexNode = VertexList; VertexNode != NULL; VertexNode = VertexNode->Next)
+         {
+         #define Vertex ((VertexRec*)VertexNode->Data)
+         if (IsBV(Vertex)) {continue;}
+
+         NewVertexArray[I]    = *Vertex;
+         Vertex->PolyRefCount = I;
+         I++;
+         #undef Vertex
+         }
+
+      //-- Copy the Polygons, and set up the indices --
+      J = 0;
+      for (PolygonNode = PolygonList; PolygonNode != NULL; PolygonNode = PolygonNode->Next)
+         {
+         #define Polygon ((PolygonRec*)PolygonNode->Data)
+         PolyColdRec* NewCold = NewPolygonArray[J].Cold;
+         *NewCold = *Polygon->Cold;
+
+         NewPolygonArray[J]          = *Polygon;
+         NewPolygonArray[J].Cold     = NewCold;
+         NewPolygonArray[J].Material = &NewMaterialArray[Polygon->MatIndex];
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            //The Polygon Vertices must be in the Vertex list of *this Entity
+            if ((Polygon->Vertex[I] == NULL) || IsBV(Polygon->Vertex[I])) {goto _ExitError;}
+            dword Index = Polygon->Vertex[I]->PolyRefCount;
+            if (Index >= NewVertexCount) {goto _ExitError;}
+
+            NewIndexArray[J*POLY_PT_COUNT + I] = Index;
+            NewPolygonArray[J].Vertex[I]       = &NewVertexArray[Index];
+            }
+
+         J++;
+         #undef Polygon
+         }
+
+      //-- Copy the bounding volume --
+      for (I = 0; I < ENTITY_BV_COUNT; I++)
+         {
+         if (BV[I] != NULL) {NewVertexArray[NewVertexCount + I] = *BV[I];}
+         }
+
+
+      //-- Rebuild the lists in the array order --
+      for (I = ENTITY_BV_COUNT; I > 0; I--)
+         {
+         if (BV[I-1] == NULL) {continue;}
+         if (!NewPool.Insert(NewVertexList, &NewVertexArray[NewVertexCount + I-1])) {goto _ExitError;}
+         }
+
+      for (I = NewVertexCount; I > 0; I--)
+         {
+         if (!NewPool.Insert(NewVertexList, &NewVertexArray[I-1])) {goto _ExitError;}
+         }
+
+      for (I = NewPolygonCount; I > 0; I--)
+         {
+         if (!NewPool.Insert(NewPolygonList, &NewPolygonArray[I-1])) {goto _ExitError;}
+         }
+
+
+      //-- Replace the old data --
+      Pool.Free();
+      Pool.Merge(NewPool);
+      if (IndexArray != NULL) {delete[] IndexArray;}
+
+      for (I = 0; I < ENTITY_BV_COUNT; I++)
+         {
+         if (BV[I] != NULL) {BV[I] = &NewVertexArray[NewVertexCount + I];}
+         }
+
+      VertexList   = NewVertexList;
+      PolygonList  = NewPolygonList;
+      VertexArray  = NewVertexArray;
+      BV_Room      = true;
+      VertexCount  = NewVertexCount;
+      PolygonArray = NewPolygonArray;
+      PolygonCount = NewPolygonCount;
+      IndexArray   = NewIndexArray;
+      MaterialArray = NewMaterialArray;
+      MaterialCount = NewMaterialCount;
+
+      if (UniqueMaterial != NULL) {delete[] UniqueMaterial;}
+      MarkDirty(ENTITY_DIRTY_GEOMETRY);
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::BuildMesh( ): Failed to build the mesh.\n");
+      if (NewIndexArray  != NULL) {delete[] NewIndexArray;}
+      if (UniqueMaterial != NULL) {delete[] UniqueMaterial;}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Replaces the geometry of *this Entity with an indexed mesh that was 
+      stored from the arrays of another Entity (eg. by the scene cache). The
+      records are copied into the pool in bulk, and their pointers are 
+      rebuilt from the IndexArray and the MatIndex of the Polygons, so the 
+      result is the same as after BuildMesh( ). Sub-Entities are not 
+      affected. Returns true on success.
+
+      Vertices  : NewVertexCount Vertices, followed by ENTITY_BV_COUNT 
+                  bounding volume Vertices if HasBV is set. Otherwise no
+                  space is reserved for the bounding volume, and
+                  FindBoundingBox( ) rebuilds the mesh first.
+      Polygons  : NewPolygonCount Polygons, their cold data in Colds, and 
+                  their Vertex indices in Indices (POLY_PT_COUNT each).
+      Materials : The material table.
+     -------------------------------------------------------------------------*/
+   bool SetMesh(VertexRec* Vertices, dword NewVertexCount, bool HasBV, PolygonRec* Polygons, PolyColdRec* Colds, dword* Indices, dword NewPolygonCount, MaterialRec* Materials, dword NewMaterialCount)
+      {
+      //Local variables
+      RecPoolClass NewPool;
+      ListRec*     NewVertexList    = NULL;
+      ListRec*     NewPolygonList   = NULL;
+      VertexRec*   NewVertexArray   = NULL;
+      PolygonRec*  NewPolygonArray  = NULL;
+      MaterialRec* NewMaterialArray = NULL;
+      dword*       NewIndexArray    = NULL;
+      dword        BV_Count         = HasBV ? ENTITY_BV_COUNT : 0;
+      dword        I, J;
+
+      if ((NewVertexCount > 0) && (Vertices == NULL)) {return false;}
+      if ((NewPolygonCount > 0) && ((Polygons == NULL) || (Colds == NULL) || (Indices == NULL) || (Materials == NULL))) {return false;}
+      if ((NewMaterialCount > 0) && (Materials == NULL)) {return false;}
+
+
+      //-- Allocate the arrays, each in a single pool block --
+      if (!NewPool.Reserve(NewVertexCount + BV_Count, NewPolygonCount)) {goto _ExitError;}
+      if (!NewPool.Materials.Reserve(NewMaterialCount)) {goto _ExitError;}
+
+      for (I = 0; I < NewMaterialCount; I++)
+         {
+         MaterialRec* NewMaterial = NewPool.NewMaterial();
+         if (NewMaterial == NULL) {goto _ExitError;}
+         if (I == 0) {NewMaterialArray = NewMaterial;}
+         }
+      if (NewMaterialCount > 0) 
+         {
+         for (I = 0; I < NewMaterialCount; I++) {NewMaterialArray[I] = Materials[I];}
+         NewPool.Default = NewMaterialArray;
+         }
+
+      for (I = 0; I < NewVertexCount + BV_Count; I++)
+         {
+         VertexRec* NewVertex = NewPool.NewVertex();
+         if (NewVertex == NULL) {goto _ExitError;}
+         if (I == 0) {NewVertexArray = NewVertex;}
+         }
+      for (I = 0; I < NewVertexCount + BV_Count; I++) {NewVertexArray[I] = Vertices[I];}
+
+      for (I = 0; I < NewPolygonCount; I++)
+         {
+         PolygonRec* NewPolygon = NewPool.NewPolygon();
+         if (NewPolygon == NULL) {goto _ExitError;}
+         if (I == 0) {NewPolygonArray = NewPolygon;}
+         }
+
+      if (NewPolygonCount > 0)
+         {
+         NewIndexArray = new dword[NewPolygonCount * POLY_PT_COUNT];
+         if (NewIndexArray == NULL) {goto _ExitError;}
+         memcpy(NewIndexArray, Indices, NewPolygonCount * POLY_PT_COUNT * sizeof(dword));
+         }
+
+
+      //-- Copy the Polygons, and redirect them to the new records --
+      for (J = 0; J < NewPolygonCount; J++)
+         {
+         PolyColdRec* NewCold = NewPolygonArray[J].Cold;
+         *NewCold = Colds[J];
+
+         NewPolygonArray[J]      = Polygons[J];
+         NewPolygonArray[J].Cold = NewCold;
+
+         if (NewPolygonArray[J].MatIndex >= NewMaterialCount) {goto _ExitError;}
+         NewPolygonArray[J].Material = &NewMaterialArray[NewPolygonArray[J].MatIndex];
+
+         for (I = 0; I < POLY_PT_COUNT; I++)
+            {
+            dword Index = NewIndexArray[J*POLY_PT_COUNT + I];
+            if (Index >= NewVertexCount) {goto _ExitError;}
+            NewPolygonArray[J].Vertex[I] = &NewVertexArray[Index];
+            }
+         }
+
+
+      //-- Rebuild the lists in the array order --
+      for (I = NewVertexCount + BV_Count; I > 0; I--)
+         {
+         if (!NewPool.Insert(NewVertexList, &NewVertexArray[I-1])) {goto _ExitError;}
+         }
+
+      for (I = NewPolygonCount; I > 0; I--)
+         {
+         if (!NewPool.Insert(NewPolygonList, &NewPolygonArray[I-1])) {goto _ExitError;}
+         }
+
+
+      //-- Replace the old data --
+      DropRestPose();
+      DropLOD();
+      Pool.Free();
+      Pool.Merge(NewPool);
+      if (IndexArray != NULL) {delete[] IndexArray;}
+
+      for (I = 0; I < ENTITY_BV_COUNT; I++) 
+         {
+         BV[I] = HasBV ? &NewVertexArray[NewVertexCount + I] : NULL;
+         }
+
+      VertexList    = NewVertexList;
+      PolygonList   = NewPolygonList;
+      VertexArray   = NewVertexArray;
+      BV_Room       = HasBV;
+      VertexCount   = NewVertexCount;
+      PolygonArray  = NewPolygonArray;
+      PolygonCount  = NewPolygonCount;
+      IndexArray    = NewIndexArray;
+      MaterialArray = NewMaterialArray;
+      MaterialCount = NewMaterialCount;
+
+      Flags &= ~ENTITY_XFORM;
+      MarkDirty(ENTITY_DIRTY_GEOMETRY);
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::SetMesh( ): Failed to set up the mesh.\n");
+      if (NewIndexArray != NULL) {delete[] NewIndexArray;}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns a copy of *this Entity, along with it's levels of detail and 
+      sub-Entities. The copy is made from the world space geometry, and it 
+      has no rest pose. Entities with a Nurb surface can't be copied. 
+      Returns NULL on fail.
+     -------------------------------------------------------------------------*/
+   EntityRec* Clone(void)
+      {
+      //Local variables
+      EntityRec*   NewEntity = NULL;
+      EntityRec*   SubEntity;
+      PolyColdRec* Colds     = NULL;
+      ListRec*     EntityNode;
+      dword        I;
+
+      if (Nurb != NULL) {return NULL;}
+      MaterializeLocal();
+
+      NewEntity = new EntityRec;
+      if (NewEntity == NULL) {goto _ExitError;}
+
+      //The cold data isn't guaranteed to be contiguous
+      if (PolygonCount > 0)
+         {
+         Colds = new PolyColdRec[PolygonCount];
+         if (Colds == NULL) {goto _ExitError;}
+         for (I = 0; I < PolygonCount; I++) {Colds[I] = *PolygonArray[I].Cold;}
+         }
+
+      if (!NewEntity->SetMesh(VertexArray, VertexCount, BV[0] != NULL, PolygonArray, Colds, IndexArray, PolygonCount, MaterialArray, MaterialCount)) {goto _ExitError;}
+      if (Colds != NULL) {delete[] Colds; Colds = NULL;}
+
+      NewEntity->Flags      = (Flags & ~ENTITY_XFORM) | (NewEntity->Flags & ENTITY_SHADE);
+      NewEntity->Centroid   = Centroid;
+      NewEntity->ScaleConst = ScaleConst;
+      NewEntity->Velocity   = Velocity;
+      NewEntity->Rotation   = Rotation;
+
+      //-- The levels of detail --
+      if ((LOD != NULL) && ((NewEntity->LOD = LOD->Clone()) == NULL)) {goto _ExitError;}
+
+      //-- The sub-Entities, from the tail to keep the list order --
+      for (EntityNode = EntityList; (EntityNode != NULL) && (EntityNode->Next != NULL); EntityNode = EntityNode->Next) {}
+      for (; EntityNode != NULL; EntityNode = EntityNode->Prev)
+         {
+         SubEntity = ((EntityRec*)EntityNode->Data)->Clone();
+         if (SubEntity == NULL) {goto _ExitError;}
+         if (!LinkedList.Insert(NewEntity->EntityList, SubEntity)) {delete SubEntity; goto _ExitError;}
+         }
+
+      //-- Normal exit --
+      return NewEntity;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("EntityRec::Clone( ): Failed to copy the Entity.\n");
+      if (Colds     != NULL) {delete[] Colds;}
+      if (NewEntity != NULL) {delete NewEntity;}
+      return NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Adds the pool allocation statistics of *this Entity and it's 
+      sub-Entities to Stat.
+     -------------------------------------------------------------------------*/
+   void PoolStats(RecPoolStatRec &Stat)
+      {
+      Pool.AddStats(Stat);
+      if (LOD != NULL) {LOD->PoolStats(Stat);}
 
-      //Nuke all the lists
-      LinkedList.Nuke(VertexList);
-      LinkedList.Nuke(PolygonList);
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (EntityNode->Data != NULL) {((EntityRec*)EntityNode->Data)->PoolStats(Stat);}
+         EntityNode = EntityNode->Next;
+         }
       }
 
    /*-------------------------------------------------------------------------
@@ -110,52 +1126,49 @@ class EntityRec
      -------------------------------------------------------------------------*/
    bool CalcNormals(bool UseFacetFlags)
       {
-      //---- Find normals for all Polygons ----
-      ListRec* PolygonNode = PolygonList;
-      while (PolygonNode != NULL)
-         {
-         #define Polygon ((PolygonRec*)PolygonNode->Data)
-         if (Polygon == NULL) {return false;}
+      dword P, I;
 
-         //Ensure that no Vertex pointers in Polygon is NULL
-         if ((Polygon->Vertex[0] == NULL) || 
-             (Polygon->Vertex[1] == NULL) || 
-             (Polygon->Vertex[2] == NULL)) {return false;}
+      //The normals are recomputed in world space, which becomes the new rest pose
+      MaterializeLocal();
+      DropRestPose();
 
+      //---- Find normals for all Polygons ----
+      for (P = 0; P < PolygonCount; P++)
+         {
+         PolygonRec* Polygon = &PolygonArray[P];
+         VertexRec*  V0      = &VertexArray[IndexArray[P*POLY_PT_COUNT]];
+         VertexRec*  V1      = &VertexArray[IndexArray[P*POLY_PT_COUNT + 1]];
+         VertexRec*  V2      = &VertexArray[IndexArray[P*POLY_PT_COUNT + 2]];
 
          //Compute the normal for this Polygon
-         Polygon->Edge[0] = Polygon->Vertex[1]->Coord - Polygon->Vertex[0]->Coord;
-         Polygon->Edge[1] = Polygon->Vertex[2]->Coord - Polygon->Vertex[0]->Coord;
-         Polygon->Edge[2] = Polygon->Vertex[2]->Coord - Polygon->Vertex[1]->Coord;
+         Polygon->Edge[0] = V1->Coord - V0->Coord;
+         Polygon->Edge[1] = V2->Coord - V0->Coord;
+         Polygon->Edge[2] = V2->Coord - V1->Coord;
          Polygon->Normal  = (Polygon->Edge[0].Cross(Polygon->Edge[1])).Unit();
 
 
          //Add this polygon normal to it's vertertex normals
-         for (int I = 0; I < POLY_PT_COUNT; I++)
+         for (I = 0; I < POLY_PT_COUNT; I++)
             {
             //Take Facet flags into consideration if necessary
             if (!(UseFacetFlags && Polygon->Facet[I]))
                {
+               VertexRec* Vertex = &VertexArray[IndexArray[P*POLY_PT_COUNT + I]];
+
                //Initialize if 0, else add if not 0
-               if (Polygon->Vertex[I]->PolyRefCount == 0) {Polygon->Vertex[I]->Normal = Polygon->Normal;}
-               else {Polygon->Vertex[I]->Normal += Polygon->Normal;}
+               if (Vertex->PolyRefCount == 0) {Vertex->Normal = Polygon->Normal;}
+               else {Vertex->Normal += Polygon->Normal;}
          
-               Polygon->Vertex[I]->PolyRefCount++;
+               Vertex->PolyRefCount++;
                }
             }
-
-         //Advance to the next Polygon
-         PolygonNode = PolygonNode->Next;
-         #undef Polygon
          }
 
 
       //---- Find normals for all Vertices ----
-      ListRec* VertexNode  = VertexList;
-      while (VertexNode != NULL)
+      for (I = 0; I < VertexCount; I++)
          {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
+         VertexRec* Vertex = &VertexArray[I];
 
          //Vertex normal is the average of all Polygon normals that share this Vertex
          if (Vertex->PolyRefCount != 0) 
@@ -165,11 +1178,8 @@ class EntityRec
             }
 
          Vertex->PolyRefCount = 0;  //Reset polygon reference count
-         
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
          }
+      MarkDirty(ENTITY_DIRTY_GEOMETRY);
 
 
       //---- Find normals for all sub-Entities ----
@@ -200,24 +1210,18 @@ class EntityRec
          CalcNormalFlag = false;             //We can clear this, as CalcNormals() computes normals recursively
          }
 
+      MaterializeLocal();
+
       //---- Find normals for all Polygons ----
-      ListRec* PolygonNode = PolygonList;
-      while (PolygonNode != NULL)
+      for (dword P = 0; P < PolygonCount; P++)
          {
-         #define Polygon ((PolygonRec*)PolygonNode->Data)
-         if (Polygon == NULL) {return false;}
-
-         //Ensure that no Vertex pointers in Polygon is NULL
-         if ((Polygon->Vertex[0] == NULL) || 
-             (Polygon->Vertex[1] == NULL) || 
-             (Polygon->Vertex[2] == NULL)) {return false;}
-
+         PolygonRec* Polygon = &PolygonArray[P];
 
          //Process facet flags for current Polygon
          for (int I = 0; I < POLY_PT_COUNT; I++)
             {
             //Get the angle between Polygon normal and vertex normal
-            float Angle = Polygon->Normal.AngleDot(Polygon->Vertex[I]->Normal);
+            float Angle = Polygon->Normal.AngleDot(VertexArray[IndexArray[P*POLY_PT_COUNT + I]].Normal);
             if (Angle > FacetAngle) {Polygon->Facet[I] = true;}
             else {Polygon->Facet[I] = false;}
             /**/
@@ -235,11 +1239,6 @@ class EntityRec
             else {Polygon->Facet[I] = true;}
             /**/
             }
-
-
-         //Advance to the next Polygon
-         PolygonNode = PolygonNode->Next;
-         #undef Polygon
          }
 
 
@@ -264,39 +1263,21 @@ class EntityRec
    bool MinMax(PointRec* Min, PointRec* Max)
       {
       if ((Min == NULL) || (Max == NULL)) {return false;}
+      MaterializeLocal();
 
-      //---- Find the minimum and maximum in the current vertex list ----
-      ListRec* VertexNode = VertexList;
-      while (VertexNode != NULL)
+      //---- Find the minimum and maximum in the current Vertex array. The 
+      //     bounding volume is stored after VertexCount, so it's excluded. ----
+      for (dword I = 0; I < VertexCount; I++)
          {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
-
-         //See if the current Vertex is part of the bounding volume. If it is,
-         // the Vertex will be excluded from the comparison tests later on.
-         int  I         = 0;
-         bool BV_Vertex = false;
-         while ((I < ENTITY_BV_COUNT) && !BV_Vertex)
-            {
-            if (BV[I] == Vertex) {BV_Vertex = true;}
-            I++;
-            }
-
-         //If the vertex is not part of the bounding volume, do comparison tests.
-         if (!BV_Vertex)
-            {
-            if (Vertex->Coord.X < Min->X) {Min->X = Vertex->Coord.X;}
-            if (Vertex->Coord.Y < Min->Y) {Min->Y = Vertex->Coord.Y;}
-            if (Vertex->Coord.Z < Min->Z) {Min->Z = Vertex->Coord.Z;}
+         PointRec &Coord = VertexArray[I].Coord;
 
-            if (Vertex->Coord.X > Max->X) {Max->X = Vertex->Coord.X;}
-            if (Vertex->Coord.Y > Max->Y) {Max->Y = Vertex->Coord.Y;}
-            if (Vertex->Coord.Z > Max->Z) {Max->Z = Vertex->Coord.Z;}
-            }
+         if (Coord.X < Min->X) {Min->X = Coord.X;}
+         if (Coord.Y < Min->Y) {Min->Y = Coord.Y;}
+         if (Coord.Z < Min->Z) {Min->Z = Coord.Z;}
 
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
+         if (Coord.X > Max->X) {Max->X = Coord.X;}
+         if (Coord.Y > Max->Y) {Max->Y = Coord.Y;}
+         if (Coord.Z > Max->Z) {Max->Z = Coord.Z;}
          }
 
 
@@ -345,6 +1326,10 @@ class EntityRec
          }
 
       
+      //The bounding volume is set up in world space, which becomes the new rest pose
+      MaterializeLocal();
+      DropRestPose();
+
       //-- Find the extreme dimensions --
       PointRec Min = float_MAX;
       PointRec Max = float_MIN;
@@ -354,13 +1339,13 @@ class EntityRec
       //-- Setup the bouding volume for the Entity --
       for (int I = 0; I < ENTITY_BV_COUNT; I++)
          {
-         //Create and insert a bouding vertex
+         //Insert a bouding vertex, from the space reserved in the Vertex array
          if (BV[I] == NULL)
             {
-            BV[I] = new VertexRec;
-            if (BV[I] == NULL) {return false;}
-            if (!LinkedList.Insert(VertexList, BV[I])) 
-               {delete BV[I]; BV[I] = NULL; return false;}
+            if (VertexArray == NULL) {return false;}
+            if (!BV_Room && !BuildMesh()) {return false;}
+            BV[I] = &VertexArray[VertexCount + I];
+            if (!Pool.Insert(VertexList, BV[I])) {BV[I] = NULL; return false;}
             }
 
          //---- Setup the volume coordinates ----
@@ -423,19 +1408,12 @@ class EntityRec
          EntityNode = EntityNode->Next;
          }
 
-      //-- Find contribute to the local centroid from the local Vertex list --
-      ListRec* VertexNode = VertexList;
-      while (VertexNode != NULL)
+      //-- Find contribute to the local centroid from the local Vertex array --
+      MaterializeLocal();
+      for (dword I = 0; I < VertexCount; I++)
          {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
-
          //Add Vertex coordinate to the local centroid
-         Centroid += Vertex->Coord; Centroid.t += 1.0f;
-
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
+         Centroid += VertexArray[I].Coord; Centroid.t += 1.0f;
          }
 
       //-- Setup the Entity's centroid --
@@ -451,8 +1429,409 @@ class EntityRec
       }
 
    /*-------------------------------------------------------------------------
-      Scales the entire *this Entity, along with it's sub-Entities. Returns 
-      true on success.
+      Builds a chain of coarser levels of detail for *this Entity and it's 
+      sub-Entities with quadric error edge collapses (see SimplifyClass). 
+      Each level has Ratio times the Polygons of the previous one. The 
+      chain ends early if the mesh can't be reduced any further, or if a 
+      level would have less than ENTITY_LOD_MIN Polygons. The levels follow
+      the transforms of *this Entity. This must be called after BuildMesh( )
+      and SetFacet( ). Returns true on success.
+
+      Levels   : Maximum number of levels. If 0, no levels are built.
+      Ratio    : Polygon reduction per level, between 0 and 1.
+     -------------------------------------------------------------------------*/
+   bool BuildLOD(dword Levels, float Ratio)
+      {
+      DropLOD();
+
+      if ((Levels > 0) && (Ratio > 0.0f) && (Ratio < 1.0f) && (PolygonCount > 0))
+         {
+         SimplifyClass Simplify;
+         EntityRec**   Tail   = &LOD;
+         dword         Count  = PolygonCount;
+         float         Target = (float)PolygonCount;
+
+         //The levels are built from the world space geometry
+         MaterializeLocal();
+         if (!Simplify.Setup(VertexArray, VertexCount, PolygonArray, IndexArray, PolygonCount)) {return false;}
+
+         for (dword L = 0; L < Levels; L++)
+            {
+            Target *= Ratio;
+            if (Target < (float)ENTITY_LOD_MIN) {break;}
+            if (!Simplify.Reduce((dword)Target)) {DropLOD(); return false;}
+
+            //Stop if the collapses achieved less than half of the reduction
+            if (Simplify.PolygonCount > (Count + (dword)Target) / 2) {break;}
+
+            *Tail = NewLOD(Simplify);
+            if (*Tail == NULL) {DropLOD(); return false;}
+            Count = (*Tail)->PolygonCount;
+            Tail  = &(*Tail)->LOD;
+            }
+         }
+
+      //---- Build the levels for all the sub-Entities ----
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (!((EntityRec*)EntityNode->Data)->BuildLOD(Levels, Ratio)) {return false;}
+         EntityNode = EntityNode->Next;
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Releases the levels of detail. Sub-Entities are not processed.
+     -------------------------------------------------------------------------*/
+   void DropLOD(void)
+      {
+      if (LOD != NULL) {delete LOD; LOD = NULL;}
+      Detail = this;
+      }
+
+   /*-------------------------------------------------------------------------
+      Makes NewNurb the surface of *this Entity, and replaces the geometry 
+      with a tessellation of it. *this Entity takes over NewNurb, and 
+      deletes it on destruction. The initial chord error is 
+      ENTITY_NURB_TOLERANCE times the size of the control mesh, later 
+      SelectLOD( ) adjusts it to the view. The centroid is recomputed. 
+      Returns true on success.
+
+      NewNurb  : The surface, it must have control points.
+      Material : Material of the surface. If NULL, the default Material is 
+                 used.
+     -------------------------------------------------------------------------*/
+   bool SetNurb(NurbRec* NewNurb, MaterialRec* Material)
+      {
+      if ((NewNurb == NULL) || ((NewNurb->Flags & NURB_POINT) == NURB_NULL)) {return false;}
+      if ((Nurb != NULL) && (Nurb != NewNurb)) {delete Nurb;}
+      Nurb = NewNurb;
+
+      //-- Size of the control mesh --
+      PointRec Min = float_MAX;
+      PointRec Max = float_MIN;
+      for (dword I = 0; I < Nurb->TotalCount; I++)
+         {
+         PointRec &Point = Nurb->Points[I];
+         if (Point.X < Min.X) {Min.X = Point.X;}
+         if (Point.Y < Min.Y) {Min.Y = Point.Y;}
+         if (Point.Z < Min.Z) {Min.Z = Point.Z;}
+         if (Point.X > Max.X) {Max.X = Point.X;}
+         if (Point.Y > Max.Y) {Max.Y = Point.Y;}
+         if (Point.Z > Max.Z) {Max.Z = Point.Z;}
+         }
+      Min.t = Max.t = 0.0f;
+
+      MaterialRec Default;
+      if (!BuildNurb(RoundTolerance((Max - Min).Mag() * ENTITY_NURB_TOLERANCE), (Material != NULL) ? *Material : Default)) {return false;}
+
+      PointRec Sum;
+      return FindCentroid(0, &Sum);
+      }
+
+   /*-------------------------------------------------------------------------
+      Re-tessellates the Nurb surface of *this Entity, if the control data 
+      was modified, or if the tolerance changed. The tessellation is cached
+      otherwise. Sub-Entities are not processed. Returns true on success.
+
+      Tolerance : Maximum chord error, in control point units.
+     -------------------------------------------------------------------------*/
+   bool Tessellate(float Tolerance)
+      {
+      if (Nurb == NULL) {return true;}
+
+      Tolerance = RoundTolerance(Tolerance);
+      if ((NurbStamp == Nurb->Stamp) && (NurbTolerance == Tolerance)) {return true;}
+
+      MaterialRec Material;
+      if (MaterialCount > 0) {Material = MaterialArray[0];}
+      return BuildNurb(Tolerance, Material);
+      }
+
+   /*-------------------------------------------------------------------------
+      Intersects a ray with the Nurb surface of *this Entity directly, 
+      rather than with it's tessellation (see NurbRec::Intersect( )). The 
+      ray is transformed into the control point space with the inverse of 
+      Xform. The direction isn't normalized, so the ray parameter is the 
+      same in both spaces. Sub-Entities are not processed. Returns true if 
+      an intersection was found closer than t.
+
+      O       : Origin of the ray.
+      D       : Direction of the ray.
+      t       : On entry, the ray parameter of the closest intersection so
+                far. The parameter of the new intersection is returned here.
+      Surface : If not NULL, it's set up for shading the intersection: the
+                normal and texture coordinate are evaluated from the 
+                surface, and the Material is the Material of *this Entity.
+                Surface->Cold must be valid.
+     -------------------------------------------------------------------------*/
+   bool IntersectNurb(PointRec* O, PointRec* D, float &t, PolygonRec* Surface)
+      {
+      if ((Nurb == NULL) || (MaterialCount == 0)) {return false;}
+
+      XformRec Inv;
+      if (!Xform.Inverse(Inv)) {return false;}
+
+      PointRec LocalO = Inv.Point(*O);
+      PointRec LocalD = Inv.Vector(*D);
+      float    S, T;
+      if (!Nurb->Intersect(&LocalO, &LocalD, 0.00001f, t, S, T)) {return false;}
+      if (Surface == NULL) {return true;}
+
+      //-- Shading data. All the corners are faceted, so the normal isn't 
+      //   interpolated. --
+      PointRec Point, Normal;
+      Nurb->Eval(S, T, Point, Normal);
+      if (Normal.MagSqr() == 0.0f) {Normal = PointRec(-LocalD.X, -LocalD.Y, -LocalD.Z, 0.0f);}
+
+      Surface->Normal   = Xform.NormalXform().Vector(Normal).Unit();
+      Surface->Material = &MaterialArray[0];
+      for (dword I = 0; I < POLY_PT_COUNT; I++)
+         {
+         Surface->Facet[I]    = true;
+         Surface->BaryCent[I] = (I == 0) ? 1.0f : 0.0f;
+         }
+      Surface->Cold->TexCoord[0] = Nurb->EvalTexPoint(S, T);
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Selects the level of detail of *this Entity and it's sub-Entities for
+      rendering. The bounding volume is projected from Origin, and the 
+      coarsest level is selected that still has enough Polygons to cover 
+      the projection with Polygons of PolyPixels in size. The selected 
+      level is stored in Detail, and it's world space geometry is brought
+      up to date. If the Entity has a Nurb surface, it's re-tessellated 
+      when the chord error no longer matches ChordPixels at the nearest 
+      point of the bounding volume. The bounding volume must be up to date
+      (see Materialize( )).
+
+      Origin      : The view origin.
+      PixelScale  : Number of pixels per radian at the view center.
+      PolyPixels  : Desired Polygon size in pixels. If 0, the full detail 
+                    is always selected.
+      ChordPixels : Desired Nurb chord error in pixels. If 0, the surfaces
+                    are not re-tessellated.
+     -------------------------------------------------------------------------*/
+   void SelectLOD(PointRec* Origin, float PixelScale, float PolyPixels, float ChordPixels)
+      {
+      EntityRec* Level = this;
+
+      if ((BV[0] != NULL) && (Origin != NULL))
+         {
+         //BV[0] and BV[6] are the opposite corners of the bounding volume
+         PointRec Center = (BV[0]->Coord + BV[6]->Coord) * 0.5f;
+         float    Radius = (BV[0]->Coord - BV[6]->Coord).Mag() * 0.5f;
+         float    Dist   = (Center - *Origin).Mag();
+
+         //-- The chord error is converted to the control point space --
+         if ((Nurb != NULL) && (ChordPixels > 0.0f) && (PixelScale > 0.0f))
+            {
+            float Near  = Dist - Radius;
+            float Scale = Xform.MaxScale();
+            if (Near  < Radius * ENTITY_NURB_NEAR) {Near = Radius * ENTITY_NURB_NEAR;}
+            if (Scale <= 0.0f) {Scale = 1.0f;}
+            Tessellate(ChordPixels * Near / (PixelScale * Scale));
+            }
+
+         if ((LOD != NULL) && (PolyPixels > 0.0f) && (Dist > Radius))
+            {
+            //Projected diameter in Polygons, and the number of Polygons in that area
+            float Size   = 2.0f * (float)asin(Radius / Dist) * PixelScale / PolyPixels;
+            float Budget = Size * Size;
+            while ((Level->LOD != NULL) && ((float)Level->LOD->PolygonCount >= Budget)) {Level = Level->LOD;}
+            }
+         }
+
+      //-- A newly selected level must be shaded, otherwise it follows the
+      //   shade flag of *this Entity --
+      if (Level != Detail) {Level->Flags |= ENTITY_SHADE;}
+      else if (Level != this) {Level->Flags = (Level->Flags & ~ENTITY_SHADE) | (Flags & ENTITY_SHADE);}
+
+      Detail = Level;
+      if (Level != this) {Level->MaterializeLocal();}
+
+      //---- Select the levels for all the sub-Entities ----
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         ((EntityRec*)EntityNode->Data)->SelectLOD(Origin, PixelScale, PolyPixels, ChordPixels);
+         EntityNode = EntityNode->Next;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Prepares *this Entity for MaterializeVertices( ) and 
+      MaterializePolygons( ), and clears the ENTITY_XFORM flag. Returns false
+      if the world space geometry is already up to date. Sub-Entities are 
+      not processed.
+     -------------------------------------------------------------------------*/
+   bool BeginMaterialize(void)
+      {
+      if (!(Flags & ENTITY_XFORM)) {return false;}
+      Flags &= ~ENTITY_XFORM;
+      if (RestCoord == NULL) {return false;}
+
+      NormalXform = Xform.NormalXform();
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms the rest pose Vertices in the range [Begin, End). Ranges 
+      may be processed in parallel.
+     -------------------------------------------------------------------------*/
+   void MaterializeVertices(dword Begin, dword End)
+      {
+      for (dword I = Begin; I < End; I++)
+         {
+         VertexArray[I].Coord  = Xform.Point(RestCoord[I]);
+         VertexArray[I].Normal = NormalXform.Vector(RestNormal[I]).Unit();
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms the Polygon normals, and re-calculates the edges in the 
+      range [Begin, End). All the Vertices must be transformed first. Ranges
+      may be processed in parallel.
+     -------------------------------------------------------------------------*/
+   void MaterializePolygons(dword Begin, dword End)
+      {
+      for (dword I = Begin; I < End; I++)
+         {
+         PolygonRec* Polygon = &PolygonArray[I];
+         VertexRec*  V0      = &VertexArray[IndexArray[I*POLY_PT_COUNT]];
+         VertexRec*  V1      = &VertexArray[IndexArray[I*POLY_PT_COUNT + 1]];
+         VertexRec*  V2      = &VertexArray[IndexArray[I*POLY_PT_COUNT + 2]];
+
+         Polygon->Normal  = NormalXform.Vector(RestPolyNormal[I]).Unit();
+         Polygon->Edge[0] = V1->Coord - V0->Coord;
+         Polygon->Edge[1] = V2->Coord - V0->Coord;
+         Polygon->Edge[2] = V2->Coord - V1->Coord;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Job functions for the JobSystem. Data is the EntityRec.
+     -------------------------------------------------------------------------*/
+   static void MaterializeVertexJob(void* Data, dword Begin, dword End)  {((EntityRec*)Data)->MaterializeVertices(Begin, End);}
+   static void MaterializePolygonJob(void* Data, dword Begin, dword End) {((EntityRec*)Data)->MaterializePolygons(Begin, End);}
+
+   /*-------------------------------------------------------------------------
+      Records a change of *this Entity. The first change since the journal 
+      was cleared adds *this Entity to the journal, the rest are only 
+      accumulated in Dirty. Any change requires shading, so the shade flag
+      is set as well. Sub-Entities are not processed.
+
+      Mask : ENTITY_DIRTY_* flags.
+     -------------------------------------------------------------------------*/
+   void MarkDirty(dword Mask)
+      {
+      if ((Dirty == ENTITY_NULL) && (Journal != NULL)) {Journal->Record(this);}
+      Dirty |= Mask;
+      Flags |= ENTITY_SHADE;
+      }
+
+   /*-------------------------------------------------------------------------
+      Clears the changes once they've been consumed (see 
+      WorldRec::Commit( )). Sub-Entities are not processed.
+     -------------------------------------------------------------------------*/
+   inline void ClearDirty(void)
+      {
+      Dirty  = ENTITY_NULL;
+      Flags &= ~ENTITY_SHADE;
+      }
+
+   /*-------------------------------------------------------------------------
+      Attaches *this Entity and it's sub-Entities to the change journal of 
+      a World. Changes made before attaching are recorded now.
+     -------------------------------------------------------------------------*/
+   void SetJournal(JournalClass* NewJournal)
+      {
+      Journal = NewJournal;
+      if ((Dirty != ENTITY_NULL) && (Journal != NULL)) {Journal->Record(this);}
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         ((EntityRec*)EntityNode->Data)->SetJournal(NewJournal);
+         EntityNode = EntityNode->Next;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Marks *this Entity and it's sub-Entities with Mask (see MarkDirty( )).
+     -------------------------------------------------------------------------*/
+   void MarkDirtyAll(dword Mask)
+      {
+      MarkDirty(Mask);
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         ((EntityRec*)EntityNode->Data)->MarkDirtyAll(Mask);
+         EntityNode = EntityNode->Next;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Brings the world space geometry of *this Entity and it's sub-Entities
+      up to date. Scale( ), Translate( ) and Rotate( ) only accumulate the
+      transform, so this must be called before the Vertex coordinates, the
+      normals or the edges are accessed directly (eg. by the renderers). 
+      Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Materialize(void)
+      {
+      MaterializeLocal();
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (!((EntityRec*)EntityNode->Data)->Materialize()) {return false;}
+         EntityNode = EntityNode->Next;
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Same as Materialize( ), but the world space geometry also becomes the 
+      new rest pose. This must be called before the Vertices are modified 
+      directly, otherwise the changes are lost on the next transform. 
+      Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Rebase(void)
+      {
+      //The surface is moved to the world space as well (the tessellation 
+      // already matches it)
+      if (Nurb != NULL) 
+         {
+         bool Cached = (NurbStamp == Nurb->Stamp);
+         Nurb->Transform(Xform);
+         if (Cached) {NurbStamp = Nurb->Stamp;}
+         }
+
+      MaterializeLocal();
+      DropRestPose();
+      if ((LOD != NULL) && !LOD->Rebase()) {return false;}
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (!((EntityRec*)EntityNode->Data)->Rebase()) {return false;}
+         EntityNode = EntityNode->Next;
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Scales the entire *this Entity, along with it's sub-Entities. The 
+      scaling is added to the accumulated transform, the Vertices are 
+      updated by Materialize( ). Returns true on success.
    
       ScaleParam : X, Y, Z scaling parameters.
       CentPt     : The scaling is done about this center point (usually the 
@@ -462,26 +1841,15 @@ class EntityRec
       {
       if ((ScaleParam == NULL) || (CentPt == NULL)) {return false;}
 
-      //Compute the inverse of scaling parameter to fix the normal
-      PointRec ScaleParamInv = PointRec(1.0f, 1.0f, 1.0f, 1.0f) / *ScaleParam;
-
-      //Set the shade flag
-      Flags |= ENTITY_SHADE;
-
-      //---- Translate the vertices ----
-      ListRec* VertexNode = VertexList;
-      while (VertexNode != NULL)
-         {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
+      //---- Scale the vertices ----
+      if (!SetRestPose()) {return false;}
 
-         Vertex->Coord  = (Vertex->Coord - *CentPt) * *ScaleParam + *CentPt;
-         Vertex->Normal = (Vertex->Normal * ScaleParamInv).Unit();
+      //Set the shade flag (after the rest pose, which clears ENTITY_XFORM)
+      Flags |= ENTITY_XFORM;
+      MarkDirty(ENTITY_DIRTY_XFORM);
 
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
-         }
+      Xform.Scale(*ScaleParam, *CentPt);
+      if ((LOD != NULL) && !LOD->Scale(ScaleParam, CentPt)) {return false;}
 
       //-- Also scale the centroid for the base Entity's children --
       if (&Centroid != CentPt) 
@@ -501,8 +1869,9 @@ class EntityRec
       }
 
    /*-------------------------------------------------------------------------
-      Translates the entire *this Entity, along with it's sub-Entities. 
-      Returns true on success.
+      Translates the entire *this Entity, along with it's sub-Entities. The
+      translation is added to the accumulated transform, the Vertices are 
+      updated by Materialize( ). Returns true on success.
    
       TransVector : X, Y, Z translation parameters.
      -------------------------------------------------------------------------*/
@@ -510,22 +1879,15 @@ class EntityRec
       {
       if (TransVector == NULL) {return false;}
 
-      //Set the shade flag
-      Flags |= ENTITY_SHADE;
-
       //---- Translate the vertices ----
-      ListRec* VertexNode = VertexList;
-      while (VertexNode != NULL)
-         {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
+      if (!SetRestPose()) {return false;}
 
-         Vertex->Coord += *TransVector;
+      //Set the shade flag (after the rest pose, which clears ENTITY_XFORM)
+      Flags |= ENTITY_XFORM;
+      MarkDirty(ENTITY_DIRTY_XFORM);
 
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
-         }
+      Xform.Translate(*TransVector);
+      if ((LOD != NULL) && !LOD->Translate(TransVector)) {return false;}
 
       //-- Translate the centroid as well --
       Centroid += *TransVector;
@@ -542,8 +1904,9 @@ class EntityRec
       }
 
    /*-------------------------------------------------------------------------
-      Rotates the entire Entity and it's sub-Entities around a point. Returns 
-      true on success.
+      Rotates the entire Entity and it's sub-Entities around a point. The 
+      rotation is added to the accumulated transform, the Vertices are 
+      updated by Materialize( ). Returns true on success.
 
       RotateAngle : X, Y, Z rotation parameters (in radians). NOTE: If the
                     RotateAngle pointer is the same as &this->Rotation, the 
@@ -555,42 +1918,15 @@ class EntityRec
       {
       if ((RotateAngle == NULL) || (CentPt == NULL)) {return false;}
 
-      //Set the shade flag
-      Flags |= ENTITY_SHADE;
-
-      //---- Rotate the vertices ----
-      ListRec* VertexNode = VertexList;
-      while (VertexNode != NULL)
-         {
-         #define Vertex ((VertexRec*)VertexNode->Data)
-         if (Vertex == NULL) {return false;}
-
-         Vertex->Coord  = Vertex->Coord.Rotate(*RotateAngle, *CentPt);
-         Vertex->Normal = Vertex->Normal.Rotate(*RotateAngle);
-
-         //Advance to the next Vertex
-         VertexNode = VertexNode->Next;
-         #undef Vertex
-         }
+      //---- Rotate the vertices, Polygon normals and edges ----
+      if (!SetRestPose()) {return false;}
 
-      //---- Rotate the Polygon normals and re-calculate edges ----
-      ListRec* PolygonNode = PolygonList;
-      while (PolygonNode != NULL)
-         {
-         #define Polygon ((PolygonRec*)PolygonNode->Data)
-         if (Polygon == NULL) {return false;}
-
-         Polygon->Normal = Polygon->Normal.Rotate(*RotateAngle);
+      //Set the shade flag (after the rest pose, which clears ENTITY_XFORM)
+      Flags |= ENTITY_XFORM;
+      MarkDirty(ENTITY_DIRTY_XFORM);
 
-         //Its cheaper to re-calculate the edges
-         Polygon->Edge[0] = Polygon->Vertex[1]->Coord - Polygon->Vertex[0]->Coord;
-         Polygon->Edge[1] = Polygon->Vertex[2]->Coord - Polygon->Vertex[0]->Coord;
-         Polygon->Edge[2] = Polygon->Vertex[2]->Coord - Polygon->Vertex[1]->Coord;
-
-         //Advance to the next Polygon
-         PolygonNode = PolygonNode->Next;
-         #undef Polygon
-         }
+      Xform.Rotate(*RotateAngle, *CentPt);
+      if ((LOD != NULL) && !LOD->Rotate(RotateAngle, CentPt)) {return false;}
 
       //-- Also rotate the centroid, scaling constant, velocity, and the 
       //   angular velocity for the base Entity's children --
@@ -19,6 +19,7 @@
 #include "../math/colorrec.h"
 #include "../math/pointrec.h"
 #include "../math/texpointrec.h"
+#include "../math/xformrec.cpp"
 
 
 /*---------------------------------------------------------------------------
@@ -29,14 +30,600 @@
 #define NURB_COLOR         0x01000000                       //Flag to indicate that color data is present
 #define NURB_TEXTURE       0x02000000                       //Flag to indicate that texture point data is present
 #define NURB_POINT         0x04000000                       //Flag to indicate that control point data is present
+#define NURB_WEIGHT        0x08000000                       //Flag to indicate that control point weights are present (rational surface)
 #define NURB_VALID         0x80000000                       //Flag indicating that the nurb has a vaild data stucture
 
+#define NURB_MAX_ORDER     8                                //Maximum order in the S and T direction
+#define NURB_CACHE_SIZE    256                              //Number of cached basis function evaluations per direction (power of 2)
+#define NURB_TESS_SAMPLES  8                                //Number of flatness samples per knot span (see Tessellate( ))
+#define NURB_TESS_MAX      64                               //Maximum number of tessellation steps per knot span
+#define NURB_HIT_SPLIT     2                                //Number of Bezier sub-patches per knot span in each direction (see Intersect( ))
+#define NURB_HIT_ITER      8                                //Maximum number of Newton iterations per sub-patch
+#define NURB_HIT_EPS       0.00002f                         //Intersection tolerance, relative to the size of the coordinates
+#define NURB_HIT_STACK     64                               //Size of the hierarchy traversal stack
+
+
+/*---------------------------------------------------------------------------
+  Basis function cache entry. Holds the non-zero basis functions and their
+  first derivatives for a single parameter value.
+  ---------------------------------------------------------------------------*/
+struct NurbBasisRec
+   {
+   float        Param;                          //Parameter value
+   dword        Span;                           //Knot span index
+   dword        Stamp;                          //Knot stamp at the time of the evaluation (0 is invalid)
+   float        N[NURB_MAX_ORDER];              //Basis functions N[Span-Order+1] to N[Span]
+   float        dN[NURB_MAX_ORDER];             //First derivatives of the above
+   };
+
+
+/*---------------------------------------------------------------------------
+  Bounding hierarchy node for ray intersection. The nodes are stored in 
+  depth first order, so the left child of a node directly follows it. The
+  leaves are the Bezier sub-patches of the surface.
+  ---------------------------------------------------------------------------*/
+struct NurbNodeRec
+   {
+   float        Min[3];                         //Bounding box of the sub-patches
+   float        Max[3];
+   float        S0, S1;                         //Parameter range of the sub-patches
+   float        T0, T1;
+   dword        Right;                          //Index of the right child (0 for leaves)
+   };
+
 
 /*---------------------------------------------------------------------------
   The Nurb class.
   ---------------------------------------------------------------------------*/
 class NurbRec
    {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   /*---- Private Data -------------------------------------------------------*/
+   PointRec*     Homog;                         //Control points in homogeneous form: X*w, Y*w, Z*w, w
+   dword         HomogStamp;                    //Stamp at the time Homog was set up
+   NurbBasisRec* S_Cache;                       //Basis function caches for the S and T direction
+   NurbBasisRec* T_Cache;
+   NurbNodeRec*  Tree;                          //Bounding hierarchy for Intersect( )
+   dword         TreeStamp;                     //Stamp at the time Tree was built
+   float         TreeScale;                     //Size of the coordinates in Tree, for the intersection tolerance
+
+   /*-------------------------------------------------------------------------
+      Sets up a clamped, uniform knot vector. The first and last Order knots
+      are 0 and 1 respectively, and the interior knots are evenly spaced.
+     ------------------------------------------------------------------------*/
+   void SetupKnots(float* Knots, dword Res, dword Order)
+      {
+      dword I;
+      dword Inner = Res - Order;
+
+      for (I = 0; I < Order; I++) {Knots[I] = 0.0f; Knots[Res + I] = 1.0f;}
+      for (I = 1; I <= Inner; I++) {Knots[Order + I-1] = (float)I / (float)(Inner + 1);}
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the knot span that contains the parameter U, such that 
+      Knots[Span] <= U < Knots[Span+1]. The span is clamped to the valid 
+      range [Order-1, Res-1].
+     ------------------------------------------------------------------------*/
+   dword FindSpan(float* Knots, dword Res, dword Order, float U)
+      {
+      if (U >= Knots[Res]) {return Res-1;}
+      if (U <= Knots[Order-1]) {return Order-1;}
+
+      //Binary search
+      dword Low  = Order-1;
+      dword High = Res;
+      dword Mid  = (Low + High) >> 1;
+      while ((U < Knots[Mid]) || (U >= Knots[Mid+1]))
+         {
+         if (U < Knots[Mid]) {High = Mid;} else {Low = Mid;}
+         Mid = (Low + High) >> 1;
+         }
+
+      return Mid;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the basis functions and their derivatives for the parameter U
+      with the Cox-de Boor recursion. The results are cached, so evaluating
+      a grid of points only computes the basis functions once per row and 
+      column.
+     ------------------------------------------------------------------------*/
+   NurbBasisRec* Basis(NurbBasisRec* Cache, float* Knots, dword Res, dword Order, float U)
+      {
+      dword         Hash  = *(dword*)&U;
+      NurbBasisRec* Entry = &Cache[((Hash * 2654435761UL) >> 16) & (NURB_CACHE_SIZE-1)];
+      if ((Entry->Stamp == KnotStamp) && (Entry->Param == U)) {return Entry;}
+
+      //Local variables
+      float ndu[NURB_MAX_ORDER][NURB_MAX_ORDER];   //Basis functions (upper triangle) and knot differences (lower triangle)
+      float Left[NURB_MAX_ORDER];
+      float Right[NURB_MAX_ORDER];
+      dword Span = FindSpan(Knots, Res, Order, U);
+      dword p    = Order-1;
+      dword J, R;
+
+      //-- Basis functions, see "The NURBS Book", A2.2 and A2.3 --
+      ndu[0][0] = 1.0f;
+      for (J = 1; J <= p; J++)
+         {
+         Left[J]  = U - Knots[Span+1-J];
+         Right[J] = Knots[Span+J] - U;
+
+         float Saved = 0.0f;
+         for (R = 0; R < J; R++)
+            {
+            ndu[J][R]  = Right[R+1] + Left[J-R];
+            float Temp = ndu[R][J-1] / ndu[J][R];
+            ndu[R][J]  = Saved + Right[R+1] * Temp;
+            Saved      = Left[J-R] * Temp;
+            }
+         ndu[J][J] = Saved;
+         }
+
+      for (J = 0; J <= p; J++) {Entry->N[J] = ndu[J][p];}
+
+      //-- First derivatives --
+      for (R = 0; R <= p; R++)
+         {
+         float d = 0.0f;
+         if (R >= 1) {d += ndu[R-1][p-1] / ndu[p][R-1];}
+         if (R <  p) {d -= ndu[R][p-1]   / ndu[p][R];}
+         Entry->dN[R] = (float)p * d;
+         }
+
+      Entry->Param = U;
+      Entry->Span  = Span;
+      Entry->Stamp = KnotStamp;
+      return Entry;
+      }
+
+   /*-------------------------------------------------------------------------
+      Allocates the basis caches, and sets up the homogeneous control points
+      if the control data was modified. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool Prepare(void)
+      {
+      if (((Flags & NURB_VALID) == NURB_NULL) || ((Flags & NURB_POINT) == NURB_NULL)) {return false;}
+
+      if (S_Cache == NULL)
+         {
+         S_Cache = new NurbBasisRec[NURB_CACHE_SIZE * 2];
+         if (S_Cache == NULL) {printf("NurbRec::Prepare( ): Memory allocation failed.\n"); return false;}
+         T_Cache = S_Cache + NURB_CACHE_SIZE;
+         for (dword I = 0; I < NURB_CACHE_SIZE * 2; I++) {S_Cache[I].Stamp = 0;}
+         }
+
+      if (Homog == NULL)
+         {
+         Homog = new PointRec[TotalCount];
+         if (Homog == NULL) {printf("NurbRec::Prepare( ): Memory allocation failed.\n"); return false;}
+         HomogStamp = 0;
+         }
+
+      if (HomogStamp != Stamp)
+         {
+         for (dword I = 0; I < TotalCount; I++)
+            {
+            float w  = (Weights != NULL) ? Weights[I] : 1.0f;
+            Homog[I] = PointRec(Points[I].X * w, Points[I].Y * w, Points[I].Z * w, w);
+            }
+         HomogStamp = Stamp;
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Estimates the number of steps needed in each knot span of one 
+      direction, so that the chord error stays below Tolerance. The surface
+      is sampled NURB_TESS_SAMPLES times in each span, along lines at the 
+      knots and span midpoints of the other direction. The second 
+      differences bound the curvature, and the chord error of a step H is
+      about |P''| H^2 / 8. Returns the parameter values in a new array, 
+      which must be deleted by the caller, or NULL on fail.
+     ------------------------------------------------------------------------*/
+   float* Params(bool S_Dir, float Tolerance, dword &Count)
+      {
+      //Local variables
+      float* Knots      = S_Dir ? S_Knots : T_Knots;
+      dword  Res        = S_Dir ? S_Res   : T_Res;
+      dword  Order      = S_Dir ? S_Order : T_Order;
+      float* Cross      = S_Dir ? T_Knots : S_Knots;
+      dword  CrossRes   = S_Dir ? T_Res   : S_Res;
+      dword  CrossOrder = S_Dir ? T_Order : S_Order;
+      dword* Steps      = new dword[Res];
+      float* Param      = NULL;
+      dword  I, J, K;
+
+      Count = 1;
+      if (Steps == NULL) {printf("NurbRec::Params( ): Memory allocation failed.\n"); return NULL;}
+
+      //-- Find the number of steps in each span --
+      for (I = Order-1; I < Res; I++)
+         {
+         Steps[I] = 0;
+         if (Knots[I+1] <= Knots[I]) {continue;}
+
+         float D = 0.0f;
+         float h = (Knots[I+1] - Knots[I]) / (float)NURB_TESS_SAMPLES;
+
+         for (J = CrossOrder-1; J < CrossRes; J++)
+            {
+            if (Cross[J+1] <= Cross[J]) {continue;}
+
+            //Sample at the start of the cross span and it's midpoint (the 
+            // last span also gets it's end)
+            for (dword L = 0; L < 3; L++)
+               {
+               float    V = (L == 0) ? Cross[J] : ((L == 1) ? (Cross[J] + Cross[J+1]) * 0.5f : Cross[J+1]);
+               PointRec P[NURB_TESS_SAMPLES+1], Normal;
+               if ((L == 2) && (J+1 < CrossRes)) {continue;}
+
+               for (K = 0; K <= NURB_TESS_SAMPLES; K++)
+                  {
+                  float U = Knots[I] + h * (float)K;
+                  if (S_Dir) {Eval(U, V, P[K], Normal);} else {Eval(V, U, P[K], Normal);}
+                  }
+
+               for (K = 1; K < NURB_TESS_SAMPLES; K++)
+                  {
+                  float M = (P[K-1] - P[K] * 2.0f + P[K+1]).Mag();
+                  if (M > D) {D = M;}
+                  }
+               }
+            }
+
+         //Steps = NURB_TESS_SAMPLES * sqrt(D / (8 * Tolerance))
+         float n = (Tolerance > 0.0f) ? (float)NURB_TESS_SAMPLES * (float)sqrt(D / (8.0f * Tolerance)) : (float)NURB_TESS_MAX;
+         Steps[I] = (n < 1.0f) ? 1 : ((n >= (float)NURB_TESS_MAX) ? NURB_TESS_MAX : (dword)ceil(n));
+         Count   += Steps[I];
+         }
+
+      //-- Set up the parameters --
+      Param = new float[Count];
+      if (Param == NULL) {printf("NurbRec::Params( ): Memory allocation failed.\n"); delete[] Steps; return NULL;}
+
+      K = 0;
+      for (I = Order-1; I < Res; I++)
+         {
+         for (J = 0; J < Steps[I]; J++) {Param[K++] = Knots[I] + (Knots[I+1] - Knots[I]) * (float)J / (float)Steps[I];}
+         }
+      Param[K] = Knots[Res];
+
+      delete[] Steps;
+      return Param;
+      }
+
+   /*-------------------------------------------------------------------------
+      Inserts the knot U once into a line of homogeneous control points, see
+      "The NURBS Book", A5.1. Knots and Line must have room for one more 
+      entry. The knot is not inserted if it's multiplicity is already 
+      Order-1. Count is the number of points in Line, it's updated on 
+      return.
+     ------------------------------------------------------------------------*/
+   void InsertKnot(float* Knots, dword &Count, dword Order, PointRec* Line, float U)
+      {
+      dword p    = Order-1;
+      dword Span = FindSpan(Knots, Count, Order, U);
+      dword Mult = 0;
+      dword I, K;
+
+      while ((Mult < p) && (Knots[Span - Mult] == U)) {Mult++;}
+      if (Mult >= p) {return;}
+
+      //Shift the unaffected points, then blend the affected ones backwards,
+      // so Line[I-1] is still the old point
+      for (I = Count; I > Span - Mult; I--) {Line[I] = Line[I-1];}
+      for (I = Span - Mult; I > Span - p; I--)
+         {
+         float  a = (U - Knots[I]) / (Knots[I+p] - Knots[I]);
+         float* P = (float*)&Line[I];
+         float* Q = (float*)&Line[I-1];
+         for (K = 0; K < 4; K++) {P[K] = P[K] * a + Q[K] * (1.0f - a);}
+         }
+
+      for (I = Count + Order; I > Span+1; I--) {Knots[I] = Knots[I-1];}
+      Knots[Span+1] = U;
+      Count++;
+      }
+
+   /*-------------------------------------------------------------------------
+      Splits a line of homogeneous control points into Bezier segments by 
+      knot insertion. Each knot span is split into NURB_HIT_SPLIT equal 
+      segments, and segment I is defined by Line[I*(Order-1)] to 
+      Line[(I+1)*(Order-1)]. The knot vector must be clamped. Returns the 
+      number of points.
+
+      Knots  : Knot vector of the line (not modified).
+      Line   : The control points, they're replaced by the Bezier points.
+               It must have room for LineSize( ) points.
+      Work   : Work space for LineSize( ) + Order knots.
+      Param  : The parameter values at the segment ends are returned here.
+     ------------------------------------------------------------------------*/
+   dword Decompose(float* Knots, dword Res, dword Order, PointRec* Line, float* Work, float* Param)
+      {
+      dword Count = Res;
+      dword N     = 0;
+      dword I, J, K;
+
+      for (I = 0; I < Res + Order; I++) {Work[I] = Knots[I];}
+
+      for (I = Order-1; I < Res; I++)
+         {
+         if (Knots[I+1] <= Knots[I]) {continue;}
+         for (J = 0; J < NURB_HIT_SPLIT; J++)
+            {
+            float U = Knots[I] + (Knots[I+1] - Knots[I]) * (float)J / (float)NURB_HIT_SPLIT;
+            if (N > 0) {for (K = 1; K < Order; K++) {InsertKnot(Work, Count, Order, Line, U);}}
+            Param[N++] = U;
+            }
+         }
+      Param[N] = Knots[Res];
+
+      return Count;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the number of points in a line after Decompose( ).
+     ------------------------------------------------------------------------*/
+   inline dword LineSize(dword Res, dword Order)
+      {
+      return Res + (Res - Order + 1) * NURB_HIT_SPLIT * (Order-1);
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets up the hierarchy node Tree[Next] for the sub-patches in the range
+      [S0, S1) x [T0, T1), by splitting the range in half along the longer
+      side. Next is advanced past the nodes of the sub-tree.
+     ------------------------------------------------------------------------*/
+   void BuildNode(NurbNodeRec* Leaf, dword Stride, dword S0, dword S1, dword T0, dword T1, dword &Next)
+      {
+      NurbNodeRec* Node = &Tree[Next++];
+      if ((S1 - S0 == 1) && (T1 - T0 == 1)) {*Node = Leaf[T0*Stride + S0]; Node->Right = 0; return;}
+
+      if (S1 - S0 >= T1 - T0)
+         {
+         dword M = (S0 + S1) >> 1;
+         BuildNode(Leaf, Stride, S0, M, T0, T1, Next);
+         Node->Right = Next;
+         BuildNode(Leaf, Stride, M, S1, T0, T1, Next);
+         }
+      else
+         {
+         dword M = (T0 + T1) >> 1;
+         BuildNode(Leaf, Stride, S0, S1, T0, M, Next);
+         Node->Right = Next;
+         BuildNode(Leaf, Stride, S0, S1, M, T1, Next);
+         }
+
+      //The node bounds both children
+      NurbNodeRec* L = Node + 1;
+      NurbNodeRec* R = &Tree[Node->Right];
+      for (dword K = 0; K < 3; K++)
+         {
+         Node->Min[K] = (L->Min[K] < R->Min[K]) ? L->Min[K] : R->Min[K];
+         Node->Max[K] = (L->Max[K] > R->Max[K]) ? L->Max[K] : R->Max[K];
+         }
+      Node->S0 = L->S0;
+      Node->S1 = (L->S1 > R->S1) ? L->S1 : R->S1;
+      Node->T0 = L->T0;
+      Node->T1 = (L->T1 > R->T1) ? L->T1 : R->T1;
+      }
+
+   /*-------------------------------------------------------------------------
+      Builds the bounding hierarchy for Intersect( ), if the control data was
+      modified. The surface is split into Bezier sub-patches by knot 
+      insertion, and each leaf is bounded by the control points of it's 
+      sub-patch (convex hull property, the weights must be positive). Only 
+      the hierarchy is kept, so the memory used is proportional to the 
+      number of knot spans. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool BuildTree(void)
+      {
+      if (!Prepare()) {return false;}
+      if ((Tree != NULL) && (TreeStamp == Stamp)) {return true;}
+      if (Tree != NULL) {delete[] Tree; Tree = NULL;}
+
+      //Local variables
+      dword        S_Size  = LineSize(S_Res, S_Order);
+      dword        T_Size  = LineSize(T_Res, T_Order);
+      dword        Size    = (S_Size > T_Size) ? S_Size : T_Size;
+      PointRec*    Grid    = new PointRec[S_Size * T_Size];
+      PointRec*    Line    = new PointRec[T_Size];
+      float*       Work    = new float[Size + NURB_MAX_ORDER];
+      float*       S_Param = new float[Size];
+      float*       T_Param = new float[Size];
+      NurbNodeRec* Leaf    = NULL;
+      dword        S_Count = 0;
+      dword        T_Count = 0;
+      dword        S_Leaves, T_Leaves, Next;
+      dword        I, J, K, L;
+
+      if ((Grid == NULL) || (Line == NULL) || (Work == NULL) || (S_Param == NULL) || (T_Param == NULL)) {goto _ExitError;}
+
+      //-- Split the rows in the S direction, then the columns in the T 
+      //   direction --
+      for (J = 0; J < T_Res; J++)
+         {
+         PointRec* Row = &Grid[J * S_Size];
+         for (I = 0; I < S_Res; I++) {Row[I] = Homog[LinOffs(I, J)];}
+         S_Count = Decompose(S_Knots, S_Res, S_Order, Row, Work, S_Param);
+         }
+
+      for (I = 0; I < S_Count; I++)
+         {
+         for (J = 0; J < T_Res; J++) {Line[J] = Grid[J * S_Size + I];}
+         T_Count = Decompose(T_Knots, T_Res, T_Order, Line, Work, T_Param);
+         for (J = 0; J < T_Count; J++) {Grid[J * S_Size + I] = Line[J];}
+         }
+
+      S_Leaves = (S_Count-1) / (S_Order-1);
+      T_Leaves = (T_Count-1) / (T_Order-1);
+      if ((S_Leaves == 0) || (T_Leaves == 0)) {goto _ExitError;}
+
+      Leaf = new NurbNodeRec[S_Leaves * T_Leaves];
+      Tree = new NurbNodeRec[S_Leaves * T_Leaves * 2 - 1];
+      if ((Leaf == NULL) || (Tree == NULL)) {goto _ExitError;}
+
+
+      //-- Bound the sub-patches --
+      TreeScale = 0.0f;
+      for (J = 0; J < T_Leaves; J++)
+         {
+         for (I = 0; I < S_Leaves; I++)
+            {
+            NurbNodeRec* Node = &Leaf[J * S_Leaves + I];
+            for (K = 0; K < 3; K++) {Node->Min[K] = float_MAX; Node->Max[K] = -float_MAX;}
+
+            for (L = 0; L < T_Order * S_Order; L++)
+               {
+               float* P = (float*)&Grid[(J * (T_Order-1) + L / S_Order) * S_Size + I * (S_Order-1) + L % S_Order];
+               if (P[3] <= 0.0f) {goto _ExitError;}
+
+               for (K = 0; K < 3; K++)
+                  {
+                  float C = P[K] / P[3];
+                  if (C < Node->Min[K]) {Node->Min[K] = C;}
+                  if (C > Node->Max[K]) {Node->Max[K] = C;}
+                  if (fabs(C) > TreeScale) {TreeScale = (float)fabs(C);}
+                  }
+               }
+
+            Node->S0 = S_Param[I]; Node->S1 = S_Param[I+1];
+            Node->T0 = T_Param[J]; Node->T1 = T_Param[J+1];
+            }
+         }
+
+      Next = 0;
+      BuildNode(Leaf, S_Leaves, 0, S_Leaves, 0, T_Leaves, Next);
+      TreeStamp = Stamp;
+
+      delete[] Grid;
+      delete[] Line;
+      delete[] Work;
+      delete[] S_Param;
+      delete[] T_Param;
+      delete[] Leaf;
+
+      //-- Normal exit --
+      return true;
+
+      //-- Exit with error --
+      _ExitError:
+      printf("NurbRec::BuildTree( ): Failed to split the surface (memory allocation failed, or the weights are not positive).\n");
+      if (Grid    != NULL) {delete[] Grid;}
+      if (Line    != NULL) {delete[] Line;}
+      if (Work    != NULL) {delete[] Work;}
+      if (S_Param != NULL) {delete[] S_Param;}
+      if (T_Param != NULL) {delete[] T_Param;}
+      if (Leaf    != NULL) {delete[] Leaf;}
+      if (Tree    != NULL) {delete[] Tree; Tree = NULL;}
+      return false;
+      }
+
+   /*-------------------------------------------------------------------------
+      Solves S(u, v) = O + D*h for (u, v, h) with Newton's method, starting
+      from the center of the sub-patch Node. The parameters are clamped to
+      the domain, so a root found outside of the sub-patch is still a valid
+      intersection. Returns true if the iteration converged to an 
+      intersection in the range (t_min, t), and updates t, S and T.
+     ------------------------------------------------------------------------*/
+   bool Refine(NurbNodeRec* Node, PointRec* O, PointRec* D, float Eps, float t_min, float &t, float &S, float &T)
+      {
+      //Local variables
+      float    S_Min = S_Knots[S_Order-1];
+      float    S_Max = S_Knots[S_Res];
+      float    T_Min = T_Knots[T_Order-1];
+      float    T_Max = T_Knots[T_Res];
+      float    u     = (Node->S0 + Node->S1) * 0.5f;
+      float    v     = (Node->T0 + Node->T1) * 0.5f;
+      float    h;
+      PointRec P, Ps, Pt;
+
+      if (!EvalDeriv(u, v, P, Ps, Pt)) {return false;}
+      h = (P - *O).Dot(*D) / D->Dot(*D);
+
+      for (dword I = 0; ; I++)
+         {
+         //Residual
+         PointRec F(P.X - O->X - D->X * h, P.Y - O->Y - D->Y * h, P.Z - O->Z - D->Z * h, 0.0f);
+         if (F.MagSqr() <= Eps * Eps) {break;}
+         if (I >= NURB_HIT_ITER) {return false;}
+
+         //Solve [Ps Pt -D] * [du dv dh] = -F with Cramer's rule
+         PointRec PtxD = Pt.Cross(*D);
+         float    Det  = Ps.Dot(PtxD);
+         if (Det == 0.0f) {return false;}
+         Det = 1.0f / Det;
+
+         u -= F.Dot(PtxD) * Det;
+         v -= Ps.Dot(F.Cross(*D)) * Det;
+         h += Ps.Dot(Pt.Cross(F)) * Det;
+
+         u = (u < S_Min) ? S_Min : ((u > S_Max) ? S_Max : u);
+         v = (v < T_Min) ? T_Min : ((v > T_Max) ? T_Max : v);
+         if (!EvalDeriv(u, v, P, Ps, Pt)) {return false;}
+         }
+
+      if ((h <= t_min) || (h >= t)) {return false;}
+      t = h;
+      S = u;
+      T = v;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Evaluates the surface point and it's partial derivatives at the 
+      parameters S, T. Each row of control points is blended in the S 
+      direction first, then the rows are blended in the T direction. The 
+      four homogeneous components are blended in fixed length loops, so the
+      compiler can keep them in registers (or vectorize them). Returns false
+      on fail.
+     ------------------------------------------------------------------------*/
+   bool EvalDeriv(float S, float T, PointRec &Point, PointRec &Ps, PointRec &Pt)
+      {
+      if (!Prepare()) {return false;}
+
+      NurbBasisRec* Bs  = Basis(S_Cache, S_Knots, S_Res, S_Order, S);
+      NurbBasisRec* Bt  = Basis(T_Cache, T_Knots, T_Res, T_Order, T);
+      PointRec*     Row = &Homog[LinOffs(Bs->Span - (S_Order-1), Bt->Span - (T_Order-1))];
+      float         A[4]  = {0.0f, 0.0f, 0.0f, 0.0f};  //Homogeneous point
+      float         As[4] = {0.0f, 0.0f, 0.0f, 0.0f};  //Partial derivatives in S and T
+      float         At[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      dword         I, J, K;
+
+      for (J = 0; J < T_Order; J++, Row += S_Res)
+         {
+         float R[4]  = {0.0f, 0.0f, 0.0f, 0.0f};
+         float Rs[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+         for (I = 0; I < S_Order; I++)
+            {
+            float* C = (float*)&Row[I];
+            for (K = 0; K < 4; K++) {R[K] += C[K] * Bs->N[I]; Rs[K] += C[K] * Bs->dN[I];}
+            }
+
+         for (K = 0; K < 4; K++)
+            {
+            A[K]  += R[K]  * Bt->N[J];
+            As[K] += Rs[K] * Bt->N[J];
+            At[K] += R[K]  * Bt->dN[J];
+            }
+         }
+
+      if (A[3] == 0.0f) {return false;}
+
+      //-- Project the point and the derivatives (quotient rule) --
+      float w = 1.0f / A[3];
+      Point   = PointRec(A[0] * w, A[1] * w, A[2] * w, 0.0f);
+      Ps      = PointRec((As[0] - Point.X * As[3]) * w, (As[1] - Point.Y * As[3]) * w, (As[2] - Point.Z * As[3]) * w, 0.0f);
+      Pt      = PointRec((At[0] - Point.X * At[3]) * w, (At[1] - Point.Y * At[3]) * w, (At[2] - Point.Z * At[3]) * w, 0.0f);
+      return true;
+      }
+
+
    /*==== Public Declarations ================================================*/
    public:
    
@@ -62,11 +649,16 @@ class NurbRec
    ColorRec*    Colors;                         //Colors for each control point
    TexPointRec* TexPoints;                      //Texture points
    PointRec*    Points;                         //The control points
+   float*       Weights;                        //Control point weights (NULL if the surface is not rational)
+
+   dword        Stamp;                          //Changed whenever the control data is modified (see Modified( ))
+   dword        KnotStamp;                      //Changed whenever the knots or the orders are modified
 
 
    /*---- Constructor --------------------------------------------------------*/
    NurbRec(void)
       {
+      Flags          = NURB_NULL;
       S_Res          = NURB_NULL;
       T_Res          = 0;
       S_Order        = 0;
@@ -86,6 +678,17 @@ class NurbRec
       Colors         = NULL;
       Points         = NULL;
       TexPoints      = NULL;
+      Weights        = NULL;
+
+      Stamp          = 1;
+      KnotStamp      = 1;
+      Homog          = NULL;
+      HomogStamp     = 0;
+      S_Cache        = NULL;
+      T_Cache        = NULL;
+      Tree           = NULL;
+      TreeStamp      = 0;
+      TreeScale      = 0.0f;
       }
 
    /*-------------------------------------------------------------------------
@@ -113,8 +716,8 @@ class NurbRec
       Flags          = NURB_NULL;
       S_Res          = S_Res_New;
       T_Res          = T_Res_New;
-      S_Order        = S_Res;
-      T_Order        = T_Res;
+      S_Order        = (S_Res < NURB_MAX_ORDER) ? S_Res : NURB_MAX_ORDER;
+      T_Order        = (T_Res < NURB_MAX_ORDER) ? T_Res : NURB_MAX_ORDER;
       S_KnotRes      = S_Res + S_Order;
       T_KnotRes      = T_Res + T_Order;
       FloatsPerEntry = 4;
@@ -122,6 +725,17 @@ class NurbRec
       TotalCount     = S_Res * T_Res;
       Colors         = NULL;
       Points         = NULL;
+      TexPoints      = NULL;
+      Weights        = NULL;
+      Stamp          = 1;
+      KnotStamp      = 1;
+      Homog          = NULL;
+      HomogStamp     = 0;
+      S_Cache        = NULL;
+      T_Cache        = NULL;
+      Tree           = NULL;
+      TreeStamp      = 0;
+      TreeScale      = 0.0f;
       S_Res_m1       = S_Res-1;
       T_Res_m1       = T_Res-1;
       S_ResInv       = 1.0f / (float)(S_Res_m1);
@@ -159,12 +773,20 @@ class NurbRec
          for (I = 0; I < TotalCount; I++) {Points[I] = 0.0f;}
          }
 
+      //Allocate the weights if requested
+      if ((NewFlags & NURB_WEIGHT) != NURB_NULL) 
+         {
+         Weights = new float[TotalCount];
+         if (Weights == NULL) {StatusFlag = false;}
+         for (I = 0; I < TotalCount; I++) {Weights[I] = 1.0f;}
+         }
+
       //Error checking
       if (!StatusFlag) {this->~NurbRec(); return;}
 
       //Setup the knots
-      for (I = 0; I < (S_KnotRes >> 1); I++) {S_Knots[I] = 0.0f; S_Knots[I + (S_KnotRes >> 1)] = 1.0f;}
-      for (I = 0; I < (T_KnotRes >> 1); I++) {T_Knots[I] = 0.0f; T_Knots[I + (T_KnotRes >> 1)] = 1.0f;}
+      SetupKnots(S_Knots, S_Res, S_Order);
+      SetupKnots(T_Knots, T_Res, T_Order);
 
       //Setup the flags and indicate a valid data structure
       Flags |= (NewFlags & NURB_ATTRIB_MASK) | NURB_VALID;
@@ -178,6 +800,218 @@ class NurbRec
       if (Colors      != NULL) {delete[] Colors;      Colors      = NULL;}
       if (TexPoints   != NULL) {delete[] TexPoints;   TexPoints   = NULL;}
       if (Points      != NULL) {delete[] Points;      Points      = NULL;}
+      if (Weights     != NULL) {delete[] Weights;     Weights     = NULL;}
+      if (Homog       != NULL) {delete[] Homog;       Homog       = NULL;}
+      if (S_Cache     != NULL) {delete[] S_Cache;     S_Cache     = NULL; T_Cache = NULL;}
+      if (Tree        != NULL) {delete[] Tree;        Tree        = NULL;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Must be called after the control points, weights, colors or texture 
+      points are modified, so that the cached data (including any 
+      tessellation of *this Nurb) is updated.
+     ------------------------------------------------------------------------*/
+   inline void Modified(void)
+      {
+      Stamp++;
+      if (Stamp == 0) {Stamp = 1;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Same as Modified( ), but must be called after the knots are modified
+      directly.
+     ------------------------------------------------------------------------*/
+   inline void KnotsModified(void)
+      {
+      KnotStamp++;
+      if (KnotStamp == 0) {KnotStamp = 1;}
+      Modified();
+      }
+
+   /*-------------------------------------------------------------------------
+      Changes the order in the S and T direction, and sets up clamped, 
+      uniform knot vectors. The orders are clamped to the range 
+      [2, min(Res, NURB_MAX_ORDER)]. Returns true on success.
+     ------------------------------------------------------------------------*/
+   bool SetOrder(dword S_Order_New, dword T_Order_New)
+      {
+      if ((Flags & NURB_VALID) == NURB_NULL) {return false;}
+
+      if (S_Order_New < 2) {S_Order_New = 2;}
+      if (T_Order_New < 2) {T_Order_New = 2;}
+      if (S_Order_New > S_Res) {S_Order_New = S_Res;}
+      if (T_Order_New > T_Res) {T_Order_New = T_Res;}
+      if (S_Order_New > NURB_MAX_ORDER) {S_Order_New = NURB_MAX_ORDER;}
+      if (T_Order_New > NURB_MAX_ORDER) {T_Order_New = NURB_MAX_ORDER;}
+
+      float* S_Knots_New = new float[S_Res + S_Order_New];
+      float* T_Knots_New = new float[T_Res + T_Order_New];
+      if ((S_Knots_New == NULL) || (T_Knots_New == NULL))
+         {
+         printf("NurbRec::SetOrder( ): Memory allocation failed.\n");
+         if (S_Knots_New != NULL) {delete[] S_Knots_New;}
+         if (T_Knots_New != NULL) {delete[] T_Knots_New;}
+         return false;
+         }
+
+      delete[] S_Knots;
+      delete[] T_Knots;
+      S_Knots   = S_Knots_New;
+      T_Knots   = T_Knots_New;
+      S_Order   = S_Order_New;
+      T_Order   = T_Order_New;
+      S_KnotRes = S_Res + S_Order;
+      T_KnotRes = T_Res + T_Order;
+
+      SetupKnots(S_Knots, S_Res, S_Order);
+      SetupKnots(T_Knots, T_Res, T_Order);
+      KnotsModified();
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Evaluates the surface point and normal at the parameters S, T. The 
+      normal is the cross product of the partial derivatives, and it's zero
+      at degenerate points (eg. collapsed edges). Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool Eval(float S, float T, PointRec &Point, PointRec &Normal)
+      {
+      PointRec Ps, Pt;
+      if (!EvalDeriv(S, T, Point, Ps, Pt)) {return false;}
+
+      Normal   = Ps.Cross(Pt).Unit();
+      Normal.t = 0.0f;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Evaluates the texture point at the parameters S, T. The texture points
+      are blended with the polynomial basis functions (the weights are 
+      ignored). If there are no texture points, S and T are returned.
+     ------------------------------------------------------------------------*/
+   TexPointRec EvalTexPoint(float S, float T)
+      {
+      TexPointRec TexPoint = 0.0f;
+      if ((TexPoints == NULL) || ((Flags & NURB_TEXTURE) == NURB_NULL) || !Prepare()) {TexPoint.U = S; TexPoint.V = T; return TexPoint;}
+
+      NurbBasisRec* Bs   = Basis(S_Cache, S_Knots, S_Res, S_Order, S);
+      NurbBasisRec* Bt   = Basis(T_Cache, T_Knots, T_Res, T_Order, T);
+      dword         Offs = LinOffs(Bs->Span - (S_Order-1), Bt->Span - (T_Order-1));
+
+      for (dword J = 0; J < T_Order; J++, Offs += S_Res)
+         {
+         for (dword I = 0; I < S_Order; I++) {TexPoint += TexPoints[Offs + I] * (Bs->N[I] * Bt->N[J]);}
+         }
+
+      return TexPoint;
+      }
+
+   /*-------------------------------------------------------------------------
+      Chooses the tessellation parameters in the S and T direction, so that
+      the chord error of the tessellated surface stays below Tolerance. The
+      number of steps is chosen for each knot span separately, but it's the 
+      same along the whole surface, so the tessellation has no cracks. The 
+      arrays must be deleted by the caller. Returns true on success.
+
+      Tolerance : Maximum chord error, in control point units.
+      S_Param,
+      T_Param   : The parameter values are returned here.
+      S_Count,
+      T_Count   : Number of parameter values in each direction.
+     ------------------------------------------------------------------------*/
+   bool Tessellate(float Tolerance, float* &S_Param, dword &S_Count, float* &T_Param, dword &T_Count)
+      {
+      S_Param = T_Param = NULL;
+      if (!Prepare()) {return false;}
+
+      S_Param = Params(true, Tolerance, S_Count);
+      if (S_Param == NULL) {return false;}
+      T_Param = Params(false, Tolerance, T_Count);
+      if (T_Param == NULL) {delete[] S_Param; S_Param = NULL; return false;}
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the closest intersection of a ray and the surface directly, 
+      without tessellating it. The ray is tested against a bounding 
+      hierarchy of Bezier sub-patches, and the intersection with each leaf 
+      that's hit is refined with Newton's method, starting from the center
+      of the sub-patch. The hierarchy is rebuilt when the control data is 
+      modified. Returns true if an intersection was found closer than t.
+
+      O      : Origin of the ray, in control point space.
+      D      : Direction of the ray (need not be a unit vector).
+      t_min  : Intersections at or below t_min are ignored. Intersections
+               at the origin (within the tolerance) are ignored as well, 
+               so the origin may lie on the surface.
+      t      : On entry, the ray parameter of the closest intersection so 
+               far. The parameter of the new intersection is returned here.
+      S, T   : The surface parameters of the intersection are returned here.
+     ------------------------------------------------------------------------*/
+   bool Intersect(PointRec* O, PointRec* D, float t_min, float &t, float &S, float &T)
+      {
+      if (!BuildTree()) {return false;}
+
+      //Local variables
+      dword Stack[NURB_HIT_STACK];
+      dword Top    = 0;
+      bool  Hit    = false;
+      float Orig[3] = {O->X, O->Y, O->Z};
+      float Inv[3];
+      float DMag   = D->Mag();
+      float Eps    = (TreeScale + O->Mag()) * NURB_HIT_EPS;
+      dword K;
+
+      if (DMag == 0.0f) {return false;}
+      if (t_min < 4.0f * Eps / DMag) {t_min = 4.0f * Eps / DMag;}
+
+      Inv[0] = (D->X != 0.0f) ? 1.0f / D->X : float_MAX;
+      Inv[1] = (D->Y != 0.0f) ? 1.0f / D->Y : float_MAX;
+      Inv[2] = (D->Z != 0.0f) ? 1.0f / D->Z : float_MAX;
+
+      Stack[Top++] = 0;
+      while (Top > 0)
+         {
+         NurbNodeRec* Node = &Tree[Stack[--Top]];
+
+         //-- Slab test with the bounding box, the box must overlap with 
+         //   the range (t_min, t) --
+         float t0 = t_min;
+         float t1 = t;
+         for (K = 0; K < 3; K++)
+            {
+            float a = (Node->Min[K] - Orig[K]) * Inv[K];
+            float b = (Node->Max[K] - Orig[K]) * Inv[K];
+            if (a > b) {float Temp = a; a = b; b = Temp;}
+            if (a > t0) {t0 = a;}
+            if (b < t1) {t1 = b;}
+            }
+         if (t0 > t1) {continue;}
+
+         //-- Descend, or refine the intersection at a leaf --
+         if (Node->Right != 0)
+            {
+            if (Top + 2 > NURB_HIT_STACK) {continue;}
+            Stack[Top++] = Node->Right;
+            Stack[Top++] = (dword)(Node - Tree) + 1;
+            }
+         else {Hit |= Refine(Node, O, D, Eps, t_min, t, S, T);}
+         }
+
+      return Hit;
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms the control points. NURBS are invariant under affine 
+      transforms, so this is the same as transforming the surface.
+     ------------------------------------------------------------------------*/
+   void Transform(XformRec &Xform)
+      {
+      if ((Points == NULL) || ((Flags & NURB_POINT) == NURB_NULL)) {return;}
+      for (dword I = 0; I < TotalCount; I++) {Points[I] = Xform.Point(Points[I]);}
+      Modified();
       }
 
    /*-------------------------------------------------------------------------
@@ -228,6 +1062,8 @@ class NurbRec
             *(DataPtr+S_Res_m1) = *(DataPtr-1)     + d_Right;
             }
          }
+
+      Modified();
       }
 
    /*-------------------------------------------------------------------------
@@ -264,6 +1100,8 @@ class NurbRec
             *(DataPtr+S_Res_m1) = *(DataPtr-1)     + d_Right;
             }
          }
+
+      Modified();
       }
 
    /*-------------------------------------------------------------------------
@@ -300,6 +1138,8 @@ class NurbRec
             *(DataPtr+S_Res_m1) = *(DataPtr-1)     + d_Right;
             }
          }
+
+      Modified();
       }
 
    /*==== End Class =============================================================*/
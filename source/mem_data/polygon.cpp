@@ -35,16 +35,15 @@
 
 
 /*---------------------------------------------------------------------------
-  The Polygon class.
+  The Material class. Materials are shared by all the Polygons that use 
+  them, see EntityRec::BuildMesh( ).
   ---------------------------------------------------------------------------*/
-class PolygonRec
+class MaterialRec
    {
    /*==== Public Declarations ================================================*/
    public:
    
    /*---- Public Data --------------------------------------------------------*/
-   dword       Flags;                           //Polygon flags
-   
    ColorRec    kAmb;                            //RGB ambient color
    ColorRec    kDiff;                           //RGB diffuse color
    ColorRec    kSpec;                           //RGB specular color
@@ -53,24 +52,10 @@ class PolygonRec
    float       Trans;                           //Transperacy
    float       Opacity;                         //Opacity = 1 - Transperacy
    float       IdxRefr;                         //Index of refraction
-   
-   PointRec    Normal;                          //Polygon normal
-   float       BaryCent[POLY_PT_COUNT];         //Barycentric coordinates of an intersection (used of intersection testing only)
-   bool        Facet[POLY_PT_COUNT];            //Flags indicate which corners needs facet shading
-   ColorRec    Shade[POLY_PT_COUNT];            //Shading colors for each corner
-   VertexRec*  Vertex[POLY_PT_COUNT];           //Polygon's vertices in the vertex list
-   PointRec    Edge[POLY_PT_COUNT];             //Polygon edge vectors: Edge[0] = Vertex[1]-Vertex[0], Edge[1] = Vertex[2]-Vertex[0], Edge[2] = Vertex[2]-Vertex[1]
-   TexPointRec TexCoord[POLY_PT_COUNT];         //Texture coordinates
-   TexPointRec ShadMapCoord[POLY_PT_COUNT];     //Shadow map coordinates
-
-   BitmapRec*  Texture;                         //Pointer to the texture
-   BitmapRec*  ShadowMap;                       //Pointer to the shadow map
-
 
    /*---- Constructor --------------------------------------------------------*/
-   PolygonRec(void)
+   MaterialRec(void)
       {
-      Flags     = POLYGON_NULL;
       kAmb      = 0.0f;
       kDiff     = 1.0f;
       kSpec     = 0.0f;
@@ -79,20 +64,97 @@ class PolygonRec
       Trans     = 0.0f;
       Opacity   = 1.0f - Trans;
       IdxRefr   = 1.0f;
-      Normal    = 0.0f;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if *this Material is identical to Material.
+     ------------------------------------------------------------------------*/
+   inline bool Equal(MaterialRec* Material)
+      {
+      return (kAmb.R  == Material->kAmb.R)  && (kAmb.G  == Material->kAmb.G)  && (kAmb.B  == Material->kAmb.B)  &&
+             (kDiff.R == Material->kDiff.R) && (kDiff.G == Material->kDiff.G) && (kDiff.B == Material->kDiff.B) &&
+             (kSpec.R == Material->kSpec.R) && (kSpec.G == Material->kSpec.G) && (kSpec.B == Material->kSpec.B) &&
+             (nSpec   == Material->nSpec)   && (Reflect == Material->Reflect) && (Trans   == Material->Trans)   &&
+             (Opacity == Material->Opacity) && (IdxRefr == Material->IdxRefr);
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*---------------------------------------------------------------------------
+  Polygon data that is rarely accessed during the intersection tests and
+  the transformations (cold data). It's stored separately, so that the
+  PolygonRec stays small.
+  ---------------------------------------------------------------------------*/
+class PolyColdRec
+   {
+   /*==== Public Declarations ================================================*/
+   public:
+   
+   /*---- Public Data --------------------------------------------------------*/
+   ColorRec    Shade[POLY_PT_COUNT];            //Shading colors for each corner
+   TexPointRec TexCoord[POLY_PT_COUNT];         //Texture coordinates
+   TexPointRec ShadMapCoord[POLY_PT_COUNT];     //Shadow map coordinates
 
+   BitmapRec*  Texture;                         //Pointer to the texture
+   BitmapRec*  ShadowMap;                       //Pointer to the shadow map
+
+   /*---- Constructor --------------------------------------------------------*/
+   PolyColdRec(void)
+      {
       Texture   = NULL;
       ShadowMap = NULL;
    
+      for (int I = 0; I < POLY_PT_COUNT; I++) 
+         {             
+         Shade[I]          = 1.0f;
+         TexCoord[I]       = 0.0f;
+         ShadMapCoord[I]   = 0.0f;
+         }
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*---------------------------------------------------------------------------
+  The Polygon class. The Material and Cold pointers are set up by the pool 
+  that allocates the Polygon (see RecPoolClass::NewPolygon( )).
+  ---------------------------------------------------------------------------*/
+class PolygonRec
+   {
+   /*==== Public Declarations ================================================*/
+   public:
+   
+   /*---- Public Data --------------------------------------------------------*/
+   dword        Flags;                          //Polygon flags
+   dword        MatIndex;                       //Index of the Material in the Entity's material table
+   MaterialRec* Material;                       //Shared material
+   PolyColdRec* Cold;                           //Cold data (shading colors, texture coordinates)
+   
+   PointRec     Normal;                         //Polygon normal
+   float        BaryCent[POLY_PT_COUNT];        //Barycentric coordinates of an intersection (used of intersection testing only)
+   bool         Facet[POLY_PT_COUNT];           //Flags indicate which corners needs facet shading
+   VertexRec*   Vertex[POLY_PT_COUNT];          //Polygon's vertices in the vertex list
+   PointRec     Edge[POLY_PT_COUNT];            //Polygon edge vectors: Edge[0] = Vertex[1]-Vertex[0], Edge[1] = Vertex[2]-Vertex[0], Edge[2] = Vertex[2]-Vertex[1]
+
+
+   /*---- Constructor --------------------------------------------------------*/
+   PolygonRec(void)
+      {
+      Flags     = POLYGON_NULL;
+      MatIndex  = 0;
+      Material  = NULL;
+      Cold      = NULL;
+      Normal    = 0.0f;
+   
       for (int I = 0; I < POLY_PT_COUNT; I++) 
          {             
          BaryCent[I]       = 0.0f;
          Facet[I]          = false;
-         Shade[I]          = 1.0f;
          Vertex[I]         = NULL;
          Edge[I]           = 0.0f;
-         TexCoord[I]       = 0.0f;
-         ShadMapCoord[I]   = 0.0f;
          }
       }
 
@@ -122,9 +184,9 @@ class PolygonRec
      ------------------------------------------------------------------------*/
    inline TexPointRec GetTexCoord(void)
       {
-      TexPointRec AvgTexCoord = TexCoord[0] * BaryCent[0];
+      TexPointRec AvgTexCoord = Cold->TexCoord[0] * BaryCent[0];
       for (int I = 1; I < POLY_PT_COUNT; I++) 
-         {AvgTexCoord += (TexCoord[I] * BaryCent[I]);}
+         {AvgTexCoord += (Cold->TexCoord[I] * BaryCent[I]);}
       return AvgTexCoord;
       }
 
@@ -134,9 +196,9 @@ class PolygonRec
      ------------------------------------------------------------------------*/
    inline TexPointRec GetShadMapCoord(void)
       {
-      TexPointRec AvgShadMapCoord = ShadMapCoord[0] * BaryCent[0];
+      TexPointRec AvgShadMapCoord = Cold->ShadMapCoord[0] * BaryCent[0];
       for (int I = 1; I < POLY_PT_COUNT; I++) 
-         {AvgShadMapCoord += (ShadMapCoord[I] * BaryCent[I]);}
+         {AvgShadMapCoord += (Cold->ShadMapCoord[I] * BaryCent[I]);}
       return AvgShadMapCoord;
       }
 
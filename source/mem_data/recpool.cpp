@@ -0,0 +1,182 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                   Vertex, Polygon and List Node Pool                       */
+/*============================================================================*/
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __RECPOOL_CPP__
+#define __RECPOOL_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/list.cpp"
+#include "../_common/arena.cpp"
+#include "../mem_data/vertex.cpp"
+#include "../mem_data/polygon.cpp"
+
+
+/*---------------------------------------------------------------------------
+  Pool allocation statistics.
+  ---------------------------------------------------------------------------*/
+struct RecPoolStatRec
+   {
+   dword Vertices;                              //Number of allocated Vertices
+   dword Polygons;                              //Number of allocated Polygons
+   dword Materials;                             //Number of allocated Materials
+   dword Nodes;                                 //Number of allocated list nodes
+   dword Blocks;                                //Number of memory blocks
+   dword Bytes;                                 //Total memory used by the blocks
+   };
+
+
+/*---------------------------------------------------------------------------
+  The record pool class. Every Entity owns a pool, which holds its Vertices,
+  Polygons (including their cold data), Materials, and the nodes of its
+  Vertex and Polygon lists. The records are allocated in large blocks, and
+  they are released all at once when the Entity is destroyed.
+  ---------------------------------------------------------------------------*/
+class RecPoolClass
+   {
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Public Data --------------------------------------------------------*/
+   ArenaClass<VertexRec>   Vertices;
+   ArenaClass<PolygonRec>  Polygons;
+   ArenaClass<PolyColdRec> Colds;
+   ArenaClass<MaterialRec> Materials;
+   ArenaClass<ListRec>     Nodes;
+
+   MaterialRec*            Default;             //Default Material (allocated on demand)
+
+   /*---- Constructor --------------------------------------------------------*/
+   RecPoolClass(void) {Default = NULL;}
+
+   /*-------------------------------------------------------------------------
+      Releases all the records in the pool.
+     -------------------------------------------------------------------------*/
+   void Free(void)
+      {
+      Vertices.Free();
+      Polygons.Free();
+      Colds.Free();
+      Materials.Free();
+      Nodes.Free();
+      Default = NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Reserves space for a known number of Vertices and Polygons, including
+      their list nodes. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool Reserve(dword VertexCount, dword PolygonCount)
+      {
+      return Vertices.Reserve(VertexCount) &&
+             Polygons.Reserve(PolygonCount) &&
+             Colds.Reserve(PolygonCount) &&
+             Nodes.Reserve(VertexCount + PolygonCount);
+      }
+
+   /*-------------------------------------------------------------------------
+      Allocates a Vertex or a Material. Returns NULL on fail.
+     -------------------------------------------------------------------------*/
+   inline VertexRec*   NewVertex(void)   {return Vertices.New();}
+   inline MaterialRec* NewMaterial(void) {return Materials.New();}
+
+   /*-------------------------------------------------------------------------
+      Allocates a Polygon along with its cold data. The Polygon uses the 
+      default Material until another one is assigned. Returns NULL on fail.
+     -------------------------------------------------------------------------*/
+   PolygonRec* NewPolygon(void)
+      {
+      if (Default == NULL) 
+         {
+         Default = Materials.New();
+         if (Default == NULL) {return NULL;}
+         }
+
+      PolygonRec*  Polygon = Polygons.New();
+      PolyColdRec* Cold    = Colds.New();
+      if ((Polygon == NULL) || (Cold == NULL)) {return NULL;}
+
+      Polygon->Material = Default;
+      Polygon->Cold     = Cold;
+      return Polygon;
+      }
+
+   /*-------------------------------------------------------------------------
+      Same as LinkedListClass::Insert( ), but the list node is allocated from
+      the pool. Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Insert(ListRec* &List, void* NewData)
+      {
+      if (NewData == NULL) {return false;}
+
+      ListRec* NewEntry = Nodes.New();
+      if (NewEntry == NULL) {return false;}
+
+      NewEntry->Prev = NULL;
+      NewEntry->Next = List;
+      NewEntry->Data = NewData;
+
+      if (List != NULL) {List->Prev = NewEntry;}
+      List = NewEntry;
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Removes the node OldEntry from List. Unlike LinkedListClass::Retrieve( ),
+      the node is not deleted, as it belongs to the pool.
+     -------------------------------------------------------------------------*/
+   void Unlink(ListRec* &List, ListRec* OldEntry)
+      {
+      if (OldEntry == NULL) {return;}
+
+      if (OldEntry->Next != NULL) {OldEntry->Next->Prev = OldEntry->Prev;}
+      if (OldEntry->Prev != NULL) {OldEntry->Prev->Next = OldEntry->Next;}
+      if (List == OldEntry) {List = OldEntry->Next;}
+
+      OldEntry->Prev = OldEntry->Next = NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Takes over all the records of OldPool. OldPool becomes empty on return.
+     -------------------------------------------------------------------------*/
+   void Merge(RecPoolClass &OldPool)
+      {
+      Vertices.Merge(OldPool.Vertices);
+      Polygons.Merge(OldPool.Polygons);
+      Colds.Merge(OldPool.Colds);
+      Materials.Merge(OldPool.Materials);
+      Nodes.Merge(OldPool.Nodes);
+
+      if (Default == NULL) {Default = OldPool.Default;}
+      OldPool.Default = NULL;
+      }
+
+   /*-------------------------------------------------------------------------
+      Adds the allocation statistics of *this pool to Stat.
+     -------------------------------------------------------------------------*/
+   void AddStats(RecPoolStatRec &Stat)
+      {
+      Stat.Vertices  += Vertices.Count;
+      Stat.Polygons  += Polygons.Count;
+      Stat.Materials += Materials.Count;
+      Stat.Nodes     += Nodes.Count;
+      Stat.Blocks    += Vertices.BlockCount + Polygons.BlockCount + Colds.BlockCount + Materials.BlockCount + Nodes.BlockCount;
+      Stat.Bytes     += Vertices.Bytes() + Polygons.Bytes() + Colds.Bytes() + Materials.Bytes() + Nodes.Bytes();
+      }
+
+   /*==== End Class =============================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -17,9 +17,17 @@
 #include "../_common/std_inc.h"
 #include "../_common/std_3d.h"
 #include "../_common/list.cpp"
+#include "../_common/journal.cpp"
 #include "../math/colorrec.h"
 #include "../mem_data/entity.cpp"
 #include "../mem_data/light.cpp"
+#include "../system/jobs.cpp"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define WORLD_JOB_RANGE    4096                 //Number of Vertices or Polygons per job
 
 
 /*---------------------------------------------------------------------------
@@ -27,6 +35,129 @@
   ---------------------------------------------------------------------------*/
 class WorldRec
    {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   JobRec*  VertexJobs;                         //Materialize( ) job lists, kept between frames
+   JobRec*  PolygonJobs;
+   dword    JobCount;
+   dword    JobSize;                            //Allocated number of jobs in each list
+
+   /*-------------------------------------------------------------------------
+      Ensures that both job lists can hold Size jobs. Returns false on fail.
+     -------------------------------------------------------------------------*/
+   bool ReserveJobs(dword Size)
+      {
+      if (Size <= JobSize) {return true;}
+
+      dword NewSize = (JobSize > 0) ? JobSize : 64;
+      while (NewSize < Size) {NewSize <<= 1;}
+
+      JobRec* NewVertexJobs  = new JobRec[NewSize];
+      JobRec* NewPolygonJobs = new JobRec[NewSize];
+      if ((NewVertexJobs == NULL) || (NewPolygonJobs == NULL))
+         {
+         printf("WorldRec::ReserveJobs( ): Memory allocation failed.\n");
+         if (NewVertexJobs  != NULL) {delete[] NewVertexJobs;}
+         if (NewPolygonJobs != NULL) {delete[] NewPolygonJobs;}
+         return false;
+         }
+
+      if (JobCount > 0)
+         {
+         memcpy(NewVertexJobs,  VertexJobs,  JobCount * sizeof(JobRec));
+         memcpy(NewPolygonJobs, PolygonJobs, JobCount * sizeof(JobRec));
+         }
+      if (VertexJobs  != NULL) {delete[] VertexJobs;}
+      if (PolygonJobs != NULL) {delete[] PolygonJobs;}
+
+      VertexJobs  = NewVertexJobs;
+      PolygonJobs = NewPolygonJobs;
+      JobSize     = NewSize;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets up a job for the range [Begin, Begin + WORLD_JOB_RANGE), clamped 
+      to Count.
+     -------------------------------------------------------------------------*/
+   inline void SetJob(JobRec &Job, JobFuncPtr Func, void* Data, dword Begin, dword Count)
+      {
+      dword End = Begin + WORLD_JOB_RANGE;
+
+      Job.Func  = Func;
+      Job.Data  = Data;
+      Job.Begin = (Begin < Count) ? Begin : Count;
+      Job.End   = (End   < Count) ? End   : Count;
+      }
+
+   /*-------------------------------------------------------------------------
+      Splits the Vertices and Polygons of Entity into ranges of 
+      WORLD_JOB_RANGE, and adds them to the job lists, if the Entity is out
+      of date. Polygon ranges are paired with Vertex ranges, so both lists 
+      have JobCount entries (empty ranges are allowed). Returns false on 
+      fail.
+     -------------------------------------------------------------------------*/
+   bool GatherJobs(EntityRec* Entity)
+      {
+      if (!Entity->BeginMaterialize()) {return true;}
+
+      dword Count = (Entity->RestCount > Entity->PolygonCount) ? Entity->RestCount : Entity->PolygonCount;
+      if (!ReserveJobs(JobCount + Count / WORLD_JOB_RANGE + 1)) {return false;}
+
+      for (dword Begin = 0; Begin < Count; Begin += WORLD_JOB_RANGE, JobCount++)
+         {
+         SetJob(VertexJobs[JobCount],  EntityRec::MaterializeVertexJob,  Entity, Begin, Entity->RestCount);
+         SetJob(PolygonJobs[JobCount], EntityRec::MaterializePolygonJob, Entity, Begin, Entity->PolygonCount);
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Same as above, but every Entity in the (sub)Entity list is processed.
+      This is only used if the journal overflowed.
+     -------------------------------------------------------------------------*/
+   bool GatherJobs(ListRec* SubEntityList)
+      {
+      ListRec* EntityNode = SubEntityList;
+      while (EntityNode != NULL)
+         {
+         #define Entity ((EntityRec*)EntityNode->Data)
+         if (Entity == NULL) {return false;}
+
+         if (!GatherJobs(Entity->EntityList)) {return false;}
+         if (!GatherJobs(Entity)) {return false;}
+
+         EntityNode = EntityNode->Next;
+         #undef Entity
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Clears the changes of every Entity in the (sub)Entity list. This is 
+      only used if the journal overflowed.
+     -------------------------------------------------------------------------*/
+   void ClearDirty(ListRec* SubEntityList)
+      {
+      ListRec* EntityNode = SubEntityList;
+      while (EntityNode != NULL)
+         {
+         #define Entity ((EntityRec*)EntityNode->Data)
+         if (Entity != NULL) 
+            {
+            ClearDirty(Entity->EntityList);
+            Entity->ClearDirty();
+            }
+
+         EntityNode = EntityNode->Next;
+         #undef Entity
+         }
+      }
+
+
    /*==== Public Declarations ================================================*/
    public:
    
@@ -39,6 +170,12 @@ class WorldRec
    ListRec* EntityList;                         //List of entities in the world
    ListRec* LightList;                          //List of lisghts in the world
    ColorRec AmbLight;                           //The world's ambient light level (subject to chage)
+
+   //-- Change journal. Every Entity (and sub-Entity) that was modified 
+   //   since the last Commit( ) is recorded once, the kind of change is 
+   //   in EntityRec::Dirty. The renderers and caches consume it every 
+   //   frame, so a static scene requires no processing. --
+   JournalClass Journal;
    
    /*---- Constructor --------------------------------------------------------*/
    WorldRec(void) 
@@ -51,12 +188,20 @@ class WorldRec
       VVelocity      = 0.0f;
       VOrientation   = 0.0f;
       VRotation      = 0.0f;
+
+      VertexJobs     = NULL;
+      PolygonJobs    = NULL;
+      JobCount       = 0;
+      JobSize        = 0;
       }
 
    /*---- Destructor ---------------------------------------------------------*/
    ~WorldRec(void) 
       {
       Nuke();
+
+      if (VertexJobs  != NULL) {delete[] VertexJobs;}
+      if (PolygonJobs != NULL) {delete[] PolygonJobs;}
       }
 
    /*-------------------------------------------------------------------------
@@ -70,13 +215,136 @@ class WorldRec
 
       //Delete all the Lights
       while (LightList != NULL)  {delete (LightRec*)LinkedList.Retrieve(LightList);}
+
+      //The journal refers to the deleted Entities
+      Journal.Clear();
+      }
+
+   /*-------------------------------------------------------------------------
+      Inserts an Entity (along with it's sub-Entities) into the world, and
+      records it in the change journal. Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Insert(EntityRec* Entity)
+      {
+      if (Entity == NULL) {return false;}
+      if (!LinkedList.Insert(EntityList, Entity)) {return false;}
+
+      Entity->SetJournal(&Journal);
+      Entity->MarkDirtyAll(ENTITY_DIRTY_GEOMETRY);
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Inserts a Light into the world. Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Insert(LightRec* Light)
+      {
+      if (Light == NULL) {return false;}
+      if (!LinkedList.Insert(LightList, Light)) {return false;}
+
+      LightsModified();
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Must be called after the Lights or the ambient light are modified, so
+      that all the Entities are shaded again.
+     -------------------------------------------------------------------------*/
+   void LightsModified(void)
+      {
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (EntityNode->Data != NULL) {((EntityRec*)EntityNode->Data)->MarkDirtyAll(ENTITY_DIRTY_LIGHT);}
+         EntityNode = EntityNode->Next;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Clears the change journal, and the changes of the recorded Entities.
+      This must be called once the changes of the frame were consumed by 
+      the renderer (and any other consumer).
+     -------------------------------------------------------------------------*/
+   void Commit(void)
+      {
+      if (Journal.Overflow) {ClearDirty(EntityList);}
+      else
+         {
+         for (dword I = 0; I < Journal.Count; I++) {((EntityRec*)Journal.Entry(I))->ClearDirty();}
+         }
+
+      Journal.Clear();
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the pool allocation statistics of all the Entities.
+     -------------------------------------------------------------------------*/
+   RecPoolStatRec PoolStats(void)
+      {
+      RecPoolStatRec Stat;
+      Stat.Vertices = Stat.Polygons = Stat.Materials = Stat.Nodes = Stat.Blocks = Stat.Bytes = 0;
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (EntityNode->Data != NULL) {((EntityRec*)EntityNode->Data)->PoolStats(Stat);}
+         EntityNode = EntityNode->Next;
+         }
+
+      return Stat;
+      }
+
+   /*-------------------------------------------------------------------------
+      Brings the world space geometry of all the Entities up to date. See 
+      EntityRec::Materialize( ). Only the Entities in the change journal 
+      are visited. The Entities, and large Vertex and Polygon ranges within
+      them, are processed in parallel by the JobSystem. All the Vertices 
+      are transformed before the Polygons, as the edges depend on them. 
+      Returns true on success.
+     -------------------------------------------------------------------------*/
+   bool Materialize(void)
+      {
+      bool Status = true;
+
+      JobCount = 0;
+      if (Journal.Overflow) {Status = GatherJobs(EntityList);}
+      else
+         {
+         for (dword I = 0; (I < Journal.Count) && Status; I++) {Status = GatherJobs((EntityRec*)Journal.Entry(I));}
+         }
+      if (!Status) {printf("WorldRec::Materialize( ): Failed to set up the jobs.\n"); return false;}
+
+      JobSystem.Run(VertexJobs, JobCount);
+      JobSystem.Run(PolygonJobs, JobCount);
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Selects the level of detail of all the Entities for rendering from 
+      the view origin, and re-tessellates the Nurb surfaces if necessary. 
+      See EntityRec::SelectLOD( ). This must be called after Materialize( ).
+
+      PixelScale  : Number of pixels per radian at the view center.
+      PolyPixels  : Desired Polygon size in pixels (0 selects full detail).
+      ChordPixels : Desired Nurb chord error in pixels (0 keeps the current
+                    tessellation).
+     -------------------------------------------------------------------------*/
+   void SelectLOD(float PixelScale, float PolyPixels, float ChordPixels)
+      {
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         if (EntityNode->Data != NULL) {((EntityRec*)EntityNode->Data)->SelectLOD(&VOrigin, PixelScale, PolyPixels, ChordPixels);}
+         EntityNode = EntityNode->Next;
+         }
       }
 
    /*-------------------------------------------------------------------------
       This function performs an automated batch processing on a list of 
       Entitites. The processing include rotation, translation, etc. This 
-      function should be called once at every main loop. Returns true on 
-      success.
+      function should be called once at every main loop. The transforms are 
+      only accumulated, the geometry is updated by Materialize( ). Returns 
+      true on success.
    
       SubEntityList : List of Entities. Can be NULL for empty lists.
      -------------------------------------------------------------------------*/
@@ -89,12 +357,8 @@ class WorldRec
          #define Entity ((EntityRec*)EntityNode->Data)
          if (Entity == NULL) {return false;}
 
-         //Reset the shade flag
-         Entity->Flags &= ~ENTITY_SHADE;
-
-
-         //-- Batch process all the sub-Entities first. This will set
-         //   the shade flags correctly. --
+         //-- Batch process all the sub-Entities first. The transforms 
+         //   record the changes in the journal. --
          if (!BatchProcess(Entity->EntityList)) {return false;}
 
 
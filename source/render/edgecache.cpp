@@ -0,0 +1,229 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*                      Shared Edge Midpoint Cache                            */
+/*============================================================================*/
+
+
+/*---------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ---------------------------------------------------------------------------*/
+#ifndef __EDGECACHE_CPP__
+#define __EDGECACHE_CPP__
+
+
+/*---------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ---------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../_common/std_3d.h"
+#include "../mem_data/vertex.cpp"
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define EDGECACHE_BLOCK       1024                       //Number of midpoint vertices per pool block
+#define EDGECACHE_MIN_SIZE    4096                       //Initial hash table size (must be a power of 2)
+
+
+/*---------------------------------------------------------------------------
+  The edge cache class. Stores the midpoint vertex of each subdivided edge,
+  keyed on the two end point vertices, so that polygons sharing an edge
+  also share the same midpoint. The cache is reset every frame.
+  ---------------------------------------------------------------------------*/
+class EdgeCacheClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   struct EdgeRec
+      {
+      VertexRec*  A;                               //Edge end points (A < B)
+      VertexRec*  B;
+      VertexRec*  Mid;                             //Midpoint vertex
+      };
+
+   struct BlockRec
+      {
+      VertexRec   Vertex[EDGECACHE_BLOCK];
+      BlockRec*   Next;
+      };
+
+   EdgeRec*    Table;                              //Open addressing hash table
+   dword       TableSize;                          //Number of table entries (power of 2)
+   dword       TableMask;                          //TableSize - 1
+   BlockRec*   BlockList;                          //Midpoint vertex pool
+   BlockRec*   Block;                              //Current pool block
+   dword       BlockUsed;                          //Number of vertices used in the current block
+
+
+   /*-------------------------------------------------------------------------
+      Computes the hash value for an edge.
+     ------------------------------------------------------------------------*/
+   __forceinline dword Hash(VertexRec* A, VertexRec* B)
+      {
+      dword H = (dword)((size_t)A >> 4) * 0x9E3779B1;
+      return (H ^ ((dword)((size_t)B >> 4) * 0x85EBCA77)) & TableMask;
+      }
+
+   /*-------------------------------------------------------------------------
+      Allocates a vertex from the pool. Returns NULL on fail.
+     ------------------------------------------------------------------------*/
+   VertexRec* NewVertex(void)
+      {
+      if ((Block == NULL) || (BlockUsed >= EDGECACHE_BLOCK))
+         {
+         //Reuse the next block from previous frames, or allocate a new one
+         BlockRec* NextBlock = (Block != NULL) ? Block->Next : BlockList;
+         if (NextBlock == NULL)
+            {
+            NextBlock = new BlockRec;
+            if (NextBlock == NULL) {printf("EdgeCacheClass::NewVertex( ): Memory allocation failed.\n"); return NULL;}
+            NextBlock->Next = NULL;
+
+            if (Block != NULL) {Block->Next = NextBlock;} else {BlockList = NextBlock;}
+            }
+
+         Block     = NextBlock;
+         BlockUsed = 0;
+         }
+
+      return &Block->Vertex[BlockUsed++];
+      }
+
+   /*-------------------------------------------------------------------------
+      Doubles the hash table size, and reinserts all the entries. Returns
+      false on fail.
+     ------------------------------------------------------------------------*/
+   bool Grow(void)
+      {
+      EdgeRec* OldTable = Table;
+      dword    OldSize  = TableSize;
+
+      TableSize = (TableSize > 0) ? (TableSize << 1) : EDGECACHE_MIN_SIZE;
+      TableMask = TableSize - 1;
+      Table     = new EdgeRec[TableSize];
+      if (Table == NULL)
+         {
+         printf("EdgeCacheClass::Grow( ): Memory allocation failed.\n");
+         Table = OldTable; TableSize = OldSize; TableMask = OldSize - 1;
+         return false;
+         }
+
+      dword I;
+      for (I = 0; I < TableSize; I++) {Table[I].A = NULL;}
+
+      for (I = 0; I < OldSize; I++)
+         {
+         if (OldTable[I].A == NULL) {continue;}
+         dword H = Hash(OldTable[I].A, OldTable[I].B);
+         while (Table[H].A != NULL) {H = (H + 1) & TableMask;}
+         Table[H] = OldTable[I];
+         }
+
+      if (OldTable != NULL) {delete[] OldTable;}
+      return true;
+      }
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   dword       Count;                              //Number of cached midpoints
+
+   /*---- Constructor --------------------------------------------------------*/
+   EdgeCacheClass(void)
+      {
+      Table     = NULL;
+      TableSize = 0;
+      TableMask = 0;
+      BlockList = NULL;
+      Block     = NULL;
+      BlockUsed = 0;
+      Count     = 0;
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~EdgeCacheClass(void) {Delete();}
+
+   /*-------------------------------------------------------------------------
+      Releases all memory used by the cache.
+     ------------------------------------------------------------------------*/
+   void Delete(void)
+      {
+      if (Table != NULL) {delete[] Table; Table = NULL;}
+      while (BlockList != NULL)
+         {
+         BlockRec* Next = BlockList->Next;
+         delete BlockList;
+         BlockList = Next;
+         }
+
+      TableSize = 0;
+      TableMask = 0;
+      Block     = NULL;
+      BlockUsed = 0;
+      Count     = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Empties the cache. The memory is kept for the next frame.
+     ------------------------------------------------------------------------*/
+   void Reset(void)
+      {
+      if (Count > 0)
+         {
+         for (dword I = 0; I < TableSize; I++) {Table[I].A = NULL;}
+         }
+
+      Block     = NULL;
+      BlockUsed = 0;
+      Count     = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the midpoint vertex of the edge [A, B]. If the edge is not in
+      the cache, a new midpoint vertex is created with TransFlag cleared,
+      and New is set. The caller is responsible for setting up new
+      vertices. Returns NULL on fail.
+     ------------------------------------------------------------------------*/
+   VertexRec* Midpoint(VertexRec* A, VertexRec* B, bool &New)
+      {
+      New = false;
+      if ((A == NULL) || (B == NULL)) {return NULL;}
+      if (A > B) {VertexRec* Temp = A; A = B; B = Temp;}
+
+      //Keep the load factor below 0.5
+      if ((Count + 1) * 2 > TableSize) {if (!Grow()) {return NULL;}}
+
+      //Search the table
+      dword H = Hash(A, B);
+      while (Table[H].A != NULL)
+         {
+         if ((Table[H].A == A) && (Table[H].B == B)) {return Table[H].Mid;}
+         H = (H + 1) & TableMask;
+         }
+
+      //Insert a new midpoint
+      VertexRec* Mid = NewVertex();
+      if (Mid == NULL) {return NULL;}
+
+      Mid->TransFlag = false;
+      Mid->Visisble  = false;
+
+      Table[H].A   = A;
+      Table[H].B   = B;
+      Table[H].Mid = Mid;
+      Count++;
+      New = true;
+
+      return Mid;
+      }
+
+   /*==== End of Class =======================================================*/
+   };
+
+
+/*==== End of file ===========================================================*/
+#endif
@@ -18,6 +18,7 @@
 #include "../_common/std_inc.h"
 #include "../mem_data/world.cpp"
 #include "../video_io/video.cpp"
+#include "../math/profcurve.cpp"
 
 
 /*---------------------------------------------------------------------------
@@ -44,6 +45,7 @@ class RenderClass
    char*    ProfEqu;                         //Original profile curve equation
    byte*    ProfCode;                        //Compiled version of the profile curve equation
    float    ProfEquLimR;
+   dword    ProfCurveID;                     //Built-in profile curve ID, or PROFCURVE_GENERIC
    
    bool     ClearFlag;                       //If set true, the frame buffer is cleared with BackgndColor after refresh
    bool     ShadowFlag;                      //If set true, shadows are generated
@@ -60,6 +62,8 @@ class RenderClass
    dword    MaxRayDepth;                     //Maximum ray-tracing depth
    float    AdaptDepthTresh;
    dword    Max_LOD;                         //Maximum polygon sub-div recursions
+   float    LOD_Pixels;                      //Desired Polygon size in pixels for the Entity level of detail selection
+   float    NURB_Pixels;                     //Desired Nurb chord error in pixels (not used by the ray tracer)
    dword    TabRes;
    float    SubdivTresh;
    dword    AA_Samples;
@@ -76,6 +80,7 @@ class RenderClass
       ProfEqu           = NULL;
       ProfCode          = NULL;
       ProfEquLimR       = 30.0f;
+      ProfCurveID       = PROFCURVE_GENERIC;
 
       ClearFlag         = false;
       ShadowFlag        = false;
@@ -92,6 +97,8 @@ class RenderClass
       MaxRayDepth       = 4;
       AdaptDepthTresh   = 0.2f;
       Max_LOD           = 3;
+      LOD_Pixels        = 4.0f;
+      NURB_Pixels       = 0.5f;
       TabRes            = 20;
       SubdivTresh       = 0.2f;
       AA_Samples        = 8;
@@ -114,6 +121,16 @@ class RenderClass
    virtual bool ShutDown  (void) = NULL;
    virtual bool DrawScene (ListRec* EntityList, ListRec* LightList, WorldRec* World) = NULL;
 
+   /*-------------------------------------------------------------------------
+      Hands out the finished frame, if the renderer keeps one in memory, so
+      that it doesn't have to be read back from the video device. If Detach
+      is set, the frame buffer is moved into the Bitmap and the renderer
+      continues with a fresh buffer, otherwise the Bitmap receives a copy.
+      Returns false if no frame is available, in which case the caller
+      should use Video->CaptureFrame( ) instead.
+     -------------------------------------------------------------------------*/
+   virtual bool CaptureFrame(BitmapRec*, bool) {return false;}
+
    /*==== End of Class =======================================================*/
    };
 
@@ -21,6 +21,7 @@
 #include "../render/render.cpp"
 #include "../render/shade.cpp"
 #include "../render/transform.cpp"
+#include "../render/edgecache.cpp"
 #include "../video_io/video.cpp"
 #include "../mem_data/vertex.cpp"
 #include "../mem_data/polygon.cpp"
@@ -28,6 +29,13 @@
 #include "../mem_data/world.cpp"
 
 
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define RENDER_TESS_TRESH     0.0001f                    //Change in the view matrix that invalidates the tessellation cache
+#define RENDER_TESS_FLOATS    6                          //Floats per tessellation cache point (R, G, B, X, Y, Z)
+
+
 /*---------------------------------------------------------------------------
   The OpenGL rendering class.
   ---------------------------------------------------------------------------*/
@@ -40,6 +48,37 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
    float        ProjMatrix[16];
    int          ViewPortMatrix[4];
 
+   //-- Subdivision mesh point. The vertex may be shared, the shade is local 
+   //   to the polygon. --
+   struct MeshPtRec
+      {
+      VertexRec*   Vertex;
+      ColorRec     Shade;
+      };
+
+   EdgeCacheClass EdgeCache;                     //Shared edge midpoints for the current frame
+
+   //-- Tessellation cache state. The cache of an Entity is valid if its 
+   //   TessStamp matches, and the Entity has not moved. --
+   dword        TessStamp;                       //Current cache stamp
+   EntityRec*   TessEntity;                      //Entity receiving the tessellation
+   float        TessModelView[16];               //View matrix used for the cache
+   float        TessSubdivTresh;                 //Subdivision settings used for the cache
+   dword        TessMax_LOD;
+   bool         TessPCompFlag;
+   float        TessPOffset;
+
+   //-- Batch transformation buffers (structure of arrays) --
+   dword        BatchSize;                       //Allocated number of entries
+   dword        BatchCount;                      //Number of entries in use
+   VertexRec**  BatchVertex;                     //Source vertex of each entry
+   float*       BatchX;                          //Vertex coordinates
+   float*       BatchY;
+   float*       BatchZ;
+   float*       BatchT;
+   float*       BatchW;                          //Scratch array
+   byte*        BatchVisible;                    //Visibility flags
+
 
    /*-------------------------------------------------------------------------
       Render the vertex normal of a Polygon.
@@ -81,7 +120,7 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
 
       for (int I = 0; I < POLY_PT_COUNT; I++)
          {
-         glColor3fv((GLfloat*)&Polygon->Shade[I]);
+         glColor3fv((GLfloat*)&Polygon->Cold->Shade[I]);
          glVertex3fv((GLfloat*)&Polygon->Vertex[I]->Coord);   
          }
 
@@ -103,7 +142,7 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       
       for (int I = 0; I < POLY_PT_COUNT; I++)
          {
-         glColor3fv((GLfloat*)&Polygon->Shade[I]);
+         glColor3fv((GLfloat*)&Polygon->Cold->Shade[I]);
          glVertex3fv((GLfloat*)&Polygon->Vertex[I]->Coord);   
          }
 
@@ -143,100 +182,400 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       }
 
    /*-------------------------------------------------------------------------
-      Recursivaley subdivide the polygon.
+      Returns the number of pixels per radian at the view center for the 
+      level of detail selection. The profile curve mapping is evaluated at
+      r = 0.
+     ------------------------------------------------------------------------*/
+   float LODScale(void)
+      {
+      float z = 1.0f;
+      if ((ProfCode != NULL) && !EquSolver.Execute(z, ProfCode, 0.0f)) {z = 1.0f;}
+      return (float)fabs(z * CamApeture.Y / CamApeture.Z) * 0.5f * (float)Video->Y_Res;
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns true if the tessellation cache of an Entity can be replayed.
+     ------------------------------------------------------------------------*/
+   inline bool TessCached(EntityRec* Entity)
+      {
+      return (Entity->TessStamp == TessStamp) && ((Entity->Flags & ENTITY_SHADE) == ENTITY_NULL);
+      }
+
+   /*-------------------------------------------------------------------------
+      Invalidates all tessellation caches if the view or the subdivision 
+      settings have changed. Small view changes (below RENDER_TESS_TRESH) 
+      are ignored, so the cached tessellation is reused.
+     ------------------------------------------------------------------------*/
+   void TessCheck(void)
+      {
+      bool Changed = (TessSubdivTresh != SubdivTresh) || (TessMax_LOD != Max_LOD) || 
+                     (TessPCompFlag   != PCompFlag)   || (TessPOffset != POffset);
+
+      for (int I = 0; (I < 16) && !Changed; I++)
+         {
+         if (fabs(ModelViewMatrix[I] - TessModelView[I]) > RENDER_TESS_TRESH) {Changed = true;}
+         }
+
+      if (!Changed) {return;}
+
+      for (int J = 0; J < 16; J++) {TessModelView[J] = ModelViewMatrix[J];}
+      TessSubdivTresh = SubdivTresh;
+      TessMax_LOD     = Max_LOD;
+      TessPCompFlag   = PCompFlag;
+      TessPOffset     = POffset;
+      TessInvalidate();
+      }
+
+   /*-------------------------------------------------------------------------
+      Invalidates the tessellation cache of every Entity.
+     ------------------------------------------------------------------------*/
+   inline void TessInvalidate(void)
+      {
+      TessStamp++;
+      if (TessStamp == 0) {TessStamp = 1;}
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends a transformed triangle to the tessellation cache of TessEntity.
+      Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool TessAppend(MeshPtRec* Mesh)
+      {
+      if (TessEntity == NULL) {return false;}
+
+      //Grow the cache if necessary
+      if (TessEntity->TessCount + POLY_PT_COUNT > TessEntity->TessSize)
+         {
+         dword  NewSize = (TessEntity->TessSize > 0) ? (TessEntity->TessSize << 1) : (POLY_PT_COUNT * 64);
+         float* TempPtr = (float*)realloc(TessEntity->TessData, NewSize * RENDER_TESS_FLOATS * sizeof(float));
+         if (TempPtr == NULL) {printf("RenderOpenGLClass::TessAppend( ): Memory allocation failed.\n"); return false;}
+         TessEntity->TessData = TempPtr;
+         TessEntity->TessSize = NewSize;
+         }
+
+      float* DataPtr = &TessEntity->TessData[TessEntity->TessCount * RENDER_TESS_FLOATS];
+      for (int I = 0; I < POLY_PT_COUNT; I++)
+         {
+         DataPtr[0] = Mesh[I].Shade.R;
+         DataPtr[1] = Mesh[I].Shade.G;
+         DataPtr[2] = Mesh[I].Shade.B;
+         DataPtr[3] = Mesh[I].Vertex->tCoord.X;
+         DataPtr[4] = Mesh[I].Vertex->tCoord.Y;
+         DataPtr[5] = Mesh[I].Vertex->tCoord.Z;
+         DataPtr   += RENDER_TESS_FLOATS;
+         }
+
+      TessEntity->TessCount += POLY_PT_COUNT;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Renders the tessellation cache of an Entity as a vertex array.
+     ------------------------------------------------------------------------*/
+   void TessRender(EntityRec* Entity)
+      {
+      if ((Entity->TessData == NULL) || (Entity->TessCount == 0)) {return;}
+
+      if (WireFrame) {glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);}
+
+      glInterleavedArrays(GL_C3F_V3F, 0, Entity->TessData);
+      glDrawArrays(GL_TRIANGLES, 0, (GLsizei)Entity->TessCount);
+      glDisableClientState(GL_COLOR_ARRAY);
+      glDisableClientState(GL_VERTEX_ARRAY);
+
+      if (WireFrame) {glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);}
+
+      SystemFlags.AccumPolys += Entity->TessCount / POLY_PT_COUNT;
+      }
+
+   /*-------------------------------------------------------------------------
+      Ensures that the batch buffers can hold at least Size entries. Returns 
+      false on fail.
+     ------------------------------------------------------------------------*/
+   bool BatchAllocate(dword Size)
+      {
+      if (Size <= BatchSize) {return true;}
+
+      VertexRec** TempVertex  = (VertexRec**)realloc(BatchVertex,  Size*sizeof(VertexRec*));
+      if (TempVertex  != NULL) {BatchVertex  = TempVertex;}
+      float*      TempX       = (float*)realloc(BatchX,            Size*sizeof(float));
+      if (TempX       != NULL) {BatchX       = TempX;}
+      float*      TempY       = (float*)realloc(BatchY,            Size*sizeof(float));
+      if (TempY       != NULL) {BatchY       = TempY;}
+      float*      TempZ       = (float*)realloc(BatchZ,            Size*sizeof(float));
+      if (TempZ       != NULL) {BatchZ       = TempZ;}
+      float*      TempT       = (float*)realloc(BatchT,            Size*sizeof(float));
+      if (TempT       != NULL) {BatchT       = TempT;}
+      float*      TempW       = (float*)realloc(BatchW,            Size*sizeof(float));
+      if (TempW       != NULL) {BatchW       = TempW;}
+      byte*       TempVisible = (byte*)realloc(BatchVisible,       Size*sizeof(byte));
+      if (TempVisible != NULL) {BatchVisible = TempVisible;}
+
+      if ((TempVertex == NULL) || (TempX == NULL) || (TempY == NULL) || (TempZ == NULL) || 
+          (TempT == NULL) || (TempW == NULL) || (TempVisible == NULL)) 
+         {printf("RenderOpenGLClass::BatchAllocate( ): Memory allocation failed.\n"); return false;}
+
+      BatchSize = Size;
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Releases the batch buffers.
+     ------------------------------------------------------------------------*/
+   void BatchDelete(void)
+      {
+      if (BatchVertex  != NULL) {free(BatchVertex);  BatchVertex  = NULL;}
+      if (BatchX       != NULL) {free(BatchX);       BatchX       = NULL;}
+      if (BatchY       != NULL) {free(BatchY);       BatchY       = NULL;}
+      if (BatchZ       != NULL) {free(BatchZ);       BatchZ       = NULL;}
+      if (BatchT       != NULL) {free(BatchT);       BatchT       = NULL;}
+      if (BatchW       != NULL) {free(BatchW);       BatchW       = NULL;}
+      if (BatchVisible != NULL) {free(BatchVisible); BatchVisible = NULL;}
+      BatchSize  = 0;
+      BatchCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Recursively counts the vertices in an Entity list.
+     ------------------------------------------------------------------------*/
+   dword BatchCountVertices(ListRec* EntityList)
+      {
+      dword Count = 0;
+
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         #define Entity ((EntityRec*)EntityNode->Data)
+         if (Entity != NULL)
+            {
+            //Skip Entities with a valid tessellation cache
+            ListRec* VertexNode = TessCached(Entity->Detail) ? NULL : Entity->Detail->VertexList;
+            while (VertexNode != NULL) {Count++; VertexNode = VertexNode->Next;}
+
+            Count += BatchCountVertices(Entity->EntityList);
+            }
+
+         EntityNode = EntityNode->Next;
+         #undef Entity
+         }
+
+      return Count;
+      }
+
+   /*-------------------------------------------------------------------------
+      Recursively gathers the vertex coordinates of an Entity list into the
+      batch buffers. Entities with a valid tessellation cache are skipped.
+     ------------------------------------------------------------------------*/
+   void BatchGather(ListRec* EntityList)
+      {
+      ListRec* EntityNode = EntityList;
+      while (EntityNode != NULL)
+         {
+         #define Entity ((EntityRec*)EntityNode->Data)
+         if (Entity != NULL)
+            {
+            ListRec* VertexNode = TessCached(Entity->Detail) ? NULL : Entity->Detail->VertexList;
+            while ((VertexNode != NULL) && (BatchCount < BatchSize))
+               {
+               #define Vertex ((VertexRec*)VertexNode->Data)
+               BatchVertex[BatchCount] = Vertex;
+               BatchX[BatchCount]      = Vertex->Coord.X;
+               BatchY[BatchCount]      = Vertex->Coord.Y;
+               BatchZ[BatchCount]      = Vertex->Coord.Z;
+               BatchCount++;
+               VertexNode = VertexNode->Next;
+               #undef Vertex
+               }
+
+            BatchGather(Entity->EntityList);
+            }
+
+         EntityNode = EntityNode->Next;
+         #undef Entity
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Transforms every vertex of an Entity list in one pass, before any of 
+      the polygons are rendered. The vertices are gathered into dense 
+      arrays, transformed, and the results are stored in tCoord and 
+      Visisble, with TransFlag set. DivideRecurse( ) then only needs to 
+      transform the new midpoints. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool TransformVertices(ListRec* EntityList)
+      {
+      //-- Gather the vertices --
+      if (!BatchAllocate(BatchCountVertices(EntityList))) {return false;}
+      BatchCount = 0;
+      BatchGather(EntityList);
+
+      //-- Translate/rotate by using the model view matrix --
+      #define MV ModelViewMatrix
+      dword I;
+      for (I = 0; I < BatchCount; I++)
+         {
+         float X = BatchX[I];
+         float Y = BatchY[I];
+         float Z = BatchZ[I];
+         BatchX[I] = X*MV[0] + Y*MV[4] + Z*MV[8]  + MV[12];
+         BatchY[I] = X*MV[1] + Y*MV[5] + Z*MV[9]  + MV[13];
+         BatchZ[I] = X*MV[2] + Y*MV[6] + Z*MV[10] + MV[14];
+         }
+      #undef MV
+
+      //-- Profile curve transformation --
+      ProfCurve_TransformBatch(BatchX, BatchY, BatchZ, BatchT, BatchW, BatchVisible, BatchCount, PCompFlag, POffset);
+
+      //-- Store the results --
+      for (I = 0; I < BatchCount; I++)
+         {
+         #define Vertex (BatchVertex[I])
+         Vertex->tCoord.X  = BatchX[I];
+         Vertex->tCoord.Y  = BatchY[I];
+         Vertex->tCoord.Z  = BatchZ[I];
+         Vertex->tCoord.t  = BatchT[I];
+         Vertex->Visisble  = (BatchVisible[I] != 0);
+         Vertex->TransFlag = true;
+         #undef Vertex
+         }
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Finds the shared midpoint of the edge [A, B], transforming it if it's 
+      new. Returns NULL on fail.
+     ------------------------------------------------------------------------*/
+   inline VertexRec* Midpoint(VertexRec* A, VertexRec* B)
+      {
+      bool       New;
+      VertexRec* Mid = EdgeCache.Midpoint(A, B, New);
+      if (Mid == NULL) {return NULL;}
+
+      if (New)
+         {
+         Mid->Coord     = (A->Coord + B->Coord) * 0.5f;
+         Mid->Visisble  = Transform(Mid->tCoord, Mid->Coord);
+         Mid->TransFlag = true;
+         }
+
+      return Mid;
+      }
+
+   /*-------------------------------------------------------------------------
+      Sets up a sub-triangle and subdivides it further.
      ------------------------------------------------------------------------*/
-   void DivideRecurse(VertexRec* *BaseMesh, dword LOD)
+   inline bool DivideChild(MeshPtRec &P0, MeshPtRec &P1, MeshPtRec &P2, dword LOD0, dword LOD1, dword LOD2)
       {
+      MeshPtRec Mesh[POLY_PT_COUNT];
+      dword     EdgeLOD[POLY_PT_COUNT];
+
+      Mesh[0] = P0; EdgeLOD[0] = LOD0;
+      Mesh[1] = P1; EdgeLOD[1] = LOD1;
+      Mesh[2] = P2; EdgeLOD[2] = LOD2;
+
+      return DivideRecurse(Mesh, EdgeLOD);
+      }
+
+   /*-------------------------------------------------------------------------
+      Recursivaley subdivide the polygon. Edge I runs from Mesh[I] to 
+      Mesh[I+1], and EdgeLOD[I] is the number of times it was halved. 
+      
+      Whether an edge is split only depends on the edge itself, and the 
+      midpoints are shared through the EdgeCache. So polygons that share an 
+      edge always split it the same way, and the tessellation is free of 
+      cracks. Depending on how many edges are split, the polygon is divided 
+      into 2, 3 or 4 sub-triangles. Internal edges start at one level above
+      the deepest edge of the polygon.
+
+      The resulting triangles are stored in the tessellation cache of 
+      TessEntity. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool DivideRecurse(MeshPtRec* Mesh, dword* EdgeLOD)
+      {
+      int I;
+
       //-- Transform the vertex data --
       dword CullCount = 0;
-      for (int I = 0; I < POLY_PT_COUNT; I++)
+      for (I = 0; I < POLY_PT_COUNT; I++)
          {
+         #define Vertex (Mesh[I].Vertex)
          //Do the point transformation for fresh points
-         if (!BaseMesh[I]->TransFlag)
-            {BaseMesh[I]->Visisble = Transform(BaseMesh[I]->tCoord, BaseMesh[I]->Coord);}
+         if (!Vertex->TransFlag)
+            {
+            Vertex->Visisble  = Transform(Vertex->tCoord, Vertex->Coord);
+            Vertex->TransFlag = true;
+            }
         
-         if (!BaseMesh[I]->Visisble) {CullCount++;}
+         if (!Vertex->Visisble) {CullCount++;}
+         #undef Vertex
          }
 
       //Exit if all the points are invisible
-      if (CullCount >= POLY_PT_COUNT) {return;}
+      if (CullCount >= POLY_PT_COUNT) {return true;}
 
-      //-- Calculate the magnitude squared for the edges, 
-      //   and set the subdivision flag if necessary --
-      bool DoSubdivJob = false;
+      //-- Calculate the magnitude squared for each edge, and 
+      //   determine which edges need to be split --
+      bool  Split[POLY_PT_COUNT];
+      int   SplitCount = 0;
+      dword InnerLOD   = 0;
       for (I = 0; I < POLY_PT_COUNT; I++)
          {
          int I_Next = (I < POLY_PT_COUNT-1) ? (I+1) : 0;
-         float MagSqr = sqr(BaseMesh[I_Next]->tCoord.X - BaseMesh[I]->tCoord.X) + 
-                        sqr(BaseMesh[I_Next]->tCoord.Y - BaseMesh[I]->tCoord.Y);
-         if (MagSqr > SubdivTresh) {DoSubdivJob = true; break;}
+         float MagSqr = sqr(Mesh[I_Next].Vertex->tCoord.X - Mesh[I].Vertex->tCoord.X) + 
+                        sqr(Mesh[I_Next].Vertex->tCoord.Y - Mesh[I].Vertex->tCoord.Y);
+         Split[I] = (MagSqr > SubdivTresh) && (EdgeLOD[I] < Max_LOD);
+         if (Split[I]) {SplitCount++;}
+         if (EdgeLOD[I] + 1 > InnerLOD) {InnerLOD = EdgeLOD[I] + 1;}
          }
 
+      //-- Find the shared midpoints of the split edges --
+      MeshPtRec Mid[POLY_PT_COUNT];
+      for (I = 0; (I < POLY_PT_COUNT) && (SplitCount > 0); I++)
+         {
+         if (!Split[I]) {continue;}
 
-      //-- Do some final perspective compesation --
-//      for (I = 0; I < POLY_PT_COUNT; I++) {BaseMesh[I]->tCoord = Compensate(BaseMesh[I]->tCoord);}
+         int I_Next = (I < POLY_PT_COUNT-1) ? (I+1) : 0;
+         Mid[I].Vertex = Midpoint(Mesh[I].Vertex, Mesh[I_Next].Vertex);
+         Mid[I].Shade  = (Mesh[I].Shade + Mesh[I_Next].Shade) * 0.5f;
 
+         //If the cache fails, render the polygon as is
+         if (Mid[I].Vertex == NULL) {SplitCount = 0;}
+         }
 
       //-- Divide further if required --
-      if (DoSubdivJob && (LOD < Max_LOD))
+      if (SplitCount == 3)
          {
-         VertexRec  NewMeshData[POLY_PT_COUNT];
-         VertexRec* NewMesh[POLY_PT_COUNT];
-         
-         for (int I = 0; I < POLY_PT_COUNT; I++)
-            {
-            //Find midpoint data
-            int I_Next = (I < POLY_PT_COUNT-1) ? (I+1) : 0;
-            NewMeshData[I].Coord     = (BaseMesh[I]->Coord  + BaseMesh[I_Next]->Coord)  * 0.5f;
-            NewMeshData[I].Shade     = (BaseMesh[I]->Shade  + BaseMesh[I_Next]->Shade)  * 0.5f;
-            NewMeshData[I].TransFlag = false;
-            NewMeshData[I].Visisble  = true;
-
-//if (LOD == 0) NewMeshData[I].Shade = 1;
-//else NewMeshData[I].Shade = 0;
-            }
-
-         //Wire mesh A
-         NewMesh[0] = BaseMesh[0];
-         NewMesh[1] = &NewMeshData[0];
-         NewMesh[2] = &NewMeshData[2];
-         DivideRecurse(NewMesh, LOD+1);
-
-         //Wire mesh B
-         NewMesh[0] = &NewMeshData[0];
-         NewMesh[1] = BaseMesh[1];
-         NewMesh[2] = &NewMeshData[1];
-         DivideRecurse(NewMesh, LOD+1);
-
-         //Wire mesh C
-         NewMesh[0] = &NewMeshData[2];
-         NewMesh[1] = &NewMeshData[1];
-         NewMesh[2] = BaseMesh[2];
-         DivideRecurse(NewMesh, LOD+1);
-
-         //Wire mesh D
-         NewMesh[0] = &NewMeshData[0];
-         NewMesh[1] = &NewMeshData[1];
-         NewMesh[2] = &NewMeshData[2];
-         DivideRecurse(NewMesh, LOD+1);
+         return DivideChild(Mesh[0], Mid[0],  Mid[2],  EdgeLOD[0]+1, InnerLOD,     EdgeLOD[2]+1) &&
+                DivideChild(Mid[0],  Mesh[1], Mid[1],  EdgeLOD[0]+1, EdgeLOD[1]+1, InnerLOD)     &&
+                DivideChild(Mid[2],  Mid[1],  Mesh[2], InnerLOD,     EdgeLOD[1]+1, EdgeLOD[2]+1) &&
+                DivideChild(Mid[0],  Mid[1],  Mid[2],  InnerLOD,     InnerLOD,     InnerLOD);
          }
 
-      //Do the rendering
-      else
+      else if (SplitCount == 2)
          {
-         if (WireFrame) {glBegin(GL_LINE_LOOP);}
-         else           {glBegin(GL_TRIANGLES);}
+         //Find the first of the two split edges, (I, J) are split, K is not
+         for (I = 0; I < POLY_PT_COUNT; I++) {if (Split[I] && Split[(I+1) % POLY_PT_COUNT]) {break;}}
+         int J = (I+1) % POLY_PT_COUNT;
+         int K = (I+2) % POLY_PT_COUNT;
+
+         return DivideChild(Mid[I],  Mesh[J], Mid[J],  EdgeLOD[I]+1, EdgeLOD[J]+1, InnerLOD) &&
+                DivideChild(Mesh[I], Mid[I],  Mid[J],  EdgeLOD[I]+1, InnerLOD,     InnerLOD) &&
+                DivideChild(Mesh[I], Mid[J],  Mesh[K], InnerLOD,     EdgeLOD[J]+1, EdgeLOD[K]);
+         }
 
-         SystemFlags.AccumPolys++;
+      else if (SplitCount == 1)
+         {
+         for (I = 0; I < POLY_PT_COUNT; I++) {if (Split[I]) {break;}}
+         int J = (I+1) % POLY_PT_COUNT;
+         int K = (I+2) % POLY_PT_COUNT;
 
-         for (int I = 0; I < POLY_PT_COUNT; I++)
-            {
-            glColor3fv((GLfloat*)&BaseMesh[I]->Shade);
-            glVertex3fv((GLfloat*)&BaseMesh[I]->tCoord);
-            }
-        
-         glEnd(); 
+         return DivideChild(Mesh[I], Mid[I],  Mesh[K], EdgeLOD[I]+1, InnerLOD,   EdgeLOD[K]) &&
+                DivideChild(Mid[I],  Mesh[J], Mesh[K], EdgeLOD[I]+1, EdgeLOD[J], InnerLOD);
          }
+
+      //Store the triangle for rendering
+      return TessAppend(Mesh);
       }
 
    /*-------------------------------------------------------------------------
@@ -250,23 +589,20 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       //---- Do some point transformations if the profile curve is defined ----
       if (ProfCode != NULL)
          {
-         VertexRec  BaseMeshData[POLY_PT_COUNT];
-         VertexRec* BaseMesh[POLY_PT_COUNT];
-         int        I;
+         MeshPtRec BaseMesh[POLY_PT_COUNT];
+         dword     EdgeLOD[POLY_PT_COUNT];
+         int       I;
       
-         //-- Setup the initial polygon vertex data --
+         //-- Setup the initial polygon vertex data. The vertices are shared 
+         //   with the neighbouring polygons, the shade is not. --
          for (I = 0; I < POLY_PT_COUNT; I++)
             {
-            BaseMeshData[I].Coord     = Polygon->Vertex[I]->Coord;
-            BaseMeshData[I].Shade     = Polygon->Shade[I];
-            BaseMeshData[I].TransFlag = false;
-            BaseMeshData[I].Visisble  = true;
-            BaseMesh[I]               = &BaseMeshData[I];
+            BaseMesh[I].Vertex = Polygon->Vertex[I];
+            BaseMesh[I].Shade  = Polygon->Cold->Shade[I];
+            EdgeLOD[I]         = 0;
             }
 
-         DivideRecurse(BaseMesh, 0);
-
-         return true;
+         return DivideRecurse(BaseMesh, EdgeLOD);
          }
 
 
@@ -296,12 +632,15 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
          #define Entity ((EntityRec*)EntityNode->Data)
          if (Entity == NULL) {return false;}
 
+         //The geometry comes from the selected level of detail
+         EntityRec* Level = Entity->Detail;
+
          //Determine the if shading is required
-         bool ShadeFlag = ((Entity->Flags & ENTITY_SHADE) != ENTITY_NULL);
+         bool ShadeFlag = ((Level->Flags & ENTITY_SHADE) != ENTITY_NULL);
          if (ShadeFlag)
             {
             //Process every vertex
-            ListRec* VertexNode = Entity->VertexList;
+            ListRec* VertexNode = Level->VertexList;
             while (VertexNode != NULL)
                {
                //Find the diffuse light color for this vertex
@@ -310,8 +649,17 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
                }
             }
 
+         //-- In panoramic mode, static Entities replay their tessellation 
+         //   cache, otherwise the cache is rebuilt while rendering. --
+         bool CacheFlag = (ProfCode != NULL) && TessCached(Level);
+         if (ProfCode != NULL) 
+            {
+            TessEntity = CacheFlag ? NULL : Level;
+            if (!CacheFlag) {Level->TessCount = 0; Level->TessStamp = 0;}
+            }
+
          //Render each Polygon in the Entity
-         ListRec* PolygonNode = Entity->PolygonList;
+         ListRec* PolygonNode = CacheFlag ? NULL : Level->PolygonList;
          while (PolygonNode != NULL)
             {
             //Find the rendering color for this Polygon
@@ -322,9 +670,9 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
             /*//Shade flag debug
             else
                {
-               ((PolygonRec*)PolygonNode->Data)->Shade[0] = 
-               ((PolygonRec*)PolygonNode->Data)->Shade[1] = 
-               ((PolygonRec*)PolygonNode->Data)->Shade[2] = 1.0f;
+               ((PolygonRec*)PolygonNode->Data)->Cold->Shade[0] = 
+               ((PolygonRec*)PolygonNode->Data)->Cold->Shade[1] = 
+               ((PolygonRec*)PolygonNode->Data)->Cold->Shade[2] = 1.0f;
                }/**/
 
             //Render the Polygon
@@ -332,6 +680,13 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
             PolygonNode = PolygonNode->Next;
             }
 
+         //Validate and render the tessellation cache
+         if (ProfCode != NULL)
+            {
+            if (!CacheFlag) {Level->TessStamp = TessStamp; TessEntity = NULL;}
+            TessRender(Level);
+            }
+
          //Recursively render the sub-Entities
          if (!RenderShadeEntity(Entity->EntityList, LightList, World)) {return false;}
 
@@ -349,10 +704,29 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
    public:
    
    /*---- Constructor --------------------------------------------------------*/
-   RenderOpenGLClass(void) {}
+   RenderOpenGLClass(void) 
+      {
+      BatchSize    = 0;
+      BatchCount   = 0;
+      BatchVertex  = NULL;
+      BatchX       = NULL;
+      BatchY       = NULL;
+      BatchZ       = NULL;
+      BatchT       = NULL;
+      BatchW       = NULL;
+      BatchVisible = NULL;
+
+      TessStamp       = 1;
+      TessEntity      = NULL;
+      TessSubdivTresh = 0.0f;
+      TessMax_LOD     = 0;
+      TessPCompFlag   = false;
+      TessPOffset     = 0.0f;
+      for (int I = 0; I < 16; I++) {TessModelView[I] = 0.0f;}
+      }
 
    /*---- Destructor ---------------------------------------------------------*/
-   ~RenderOpenGLClass(void) {}
+   ~RenderOpenGLClass(void) {BatchDelete();}
 
    /*-------------------------------------------------------------------------
       Setup the renderer.
@@ -367,6 +741,11 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       if ((Video->CurrentDevice != VIDEO_OPENGL) || !Video->ModeValid) {return false;}
 
 
+      //Resolve built-in profile curves. The equivalent equation is still 
+      // compiled, since the rest of the system relies on ProfCode.
+      if (!ProfCurveLib.Find(ProfCurve, ProfCurveID)) {return false;}
+      if (ProfCurveID != PROFCURVE_GENERIC) {ProfCurve = ProfCurveLib.Equation(ProfCurveID);}
+
       //Compile the profile curve equation
       if (ProfCurve != NULL)
          {
@@ -377,10 +756,13 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
          ProfEquLimR = ProfEquLim;
 
          //Setup the transformation table
-         if (!InitTable(Video, ProfCode, ProfEquLim, NewTabRes))
+         if (!InitTable(Video, ProfCode, ProfEquLim, NewTabRes, ProfCurveID))
             {printf("RenderOpenGLClass::Initialize( ): TransformClass::InitTable( ) failed.\n"); return false;}
          }
 
+      //The profile curve may have changed, so invalidate the tessellation caches
+      TessInvalidate();
+
       //Setup other data members
       CamApeture.X = Video->XY_Ratio / CamApeture.X;
       CamApeture.Y = 1.0f / CamApeture.Y;
@@ -397,6 +779,8 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       {
       if (ProfEqu  != NULL) {delete[] ProfEqu;  ProfEqu  = NULL;}
       if (ProfCode != NULL) {delete[] ProfCode; ProfCode = NULL;}
+      BatchDelete();
+      EdgeCache.Delete();
 
       //Indicate that rendering is not allowed
       RenderValid = false;
@@ -421,6 +805,10 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
       //If the display area is minimized, don't do any rendering
       if (Video->Minimized) {return true;}
 
+      //Bring the world space geometry up to date, and select the levels of detail
+      if ((World == NULL) || !World->Materialize()) {return false;}
+      World->SelectLOD(LODScale(), LOD_Pixels, NURB_Pixels);
+
       //Lock the renderer
       if (!Video->Lock()) {return false;}
 
@@ -472,6 +860,12 @@ class RenderOpenGLClass : public RenderClass, private ShadeClass, private Transf
          glGetIntegerv(GL_VIEWPORT, (GLint*)&ViewPortMatrix);
          glMatrixMode(GL_MODELVIEW); 
          glPopMatrix();
+
+         //Transform all the vertices before rendering, except those with 
+         // a valid tessellation cache
+         TessCheck();
+         if (!TransformVertices(EntityList)) {return false;}
+         EdgeCache.Reset();
          }
 
       //-- Shade and render the Entity list --
@@ -26,6 +26,7 @@
 #include "../math/mathpoly.cpp"
 #include "../math/equsolver.cpp"
 #include "../system/systimer.cpp"
+#include "../disk_io/ppm_fmt.cpp"
 
 
 
@@ -45,6 +46,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
    int       gl_ColorFmt;                       //OpenGL specific flags
    float*    ColorScan;
    float*    LastColorScan;
+   ColorRec* HDR_Frame;                         //Float colors of the rendered image, before quantization
 
 
    /*-------------------------------------------------------------------------
@@ -131,8 +133,11 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
                     tests, as the origin of the ray lies on that surface. It can
                     be left to NULL if no surface exclusion is required.
       EntityList  : The list of Entities and sub-Entities to test.
+      NurbSurface : Nurb surfaces are intersected directly, and the 
+                    intersection is set up in this Polygon for shading. The 
+                    Polygon is returned in Surface in that case.
      ------------------------------------------------------------------------*/
-   bool IntersectScene(PointRec* I, PointRec* Origin, PointRec* Ray, PolygonRec* &Surface, PolygonRec* ExclSurface, ListRec* EntityList)
+   bool IntersectScene(PointRec* I, PointRec* Origin, PointRec* Ray, PolygonRec* &Surface, PolygonRec* ExclSurface, ListRec* EntityList, PolygonRec* NurbSurface)
       {
       bool        IFlag = false;                      //Intersect flag
       PointRec    NewI;                               //New intersection point
@@ -144,13 +149,29 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
          #define Entity ((EntityRec*)EntityNode->Data)
          if (Entity == NULL) {return false;}
 
+         //---- Nurb surfaces are intersected directly, rather than their
+         //     tessellation. The surface may bulge slightly out of the 
+         //     tessellated bounding volume, so it's tested regardless. ----
+         if (Entity->Nurb != NULL)
+            {
+            float t = I->t;
+            if (Entity->IntersectNurb(Origin, Ray, t, NurbSurface))
+               {
+               *I      = *Origin + *Ray * t;
+               I->t    = t;
+               Surface = NurbSurface;
+               IFlag   = true;
+               }
+            }
+
          //---- Do bounding volume test. If the ray intersects this Entity's
          //     bounding volume, it's polygons and subEntities will 
          //     be tested. ----
          if (EntityIntersect(Origin, Ray, Entity))
             {
-            //-- Test for intersection in each Polygon in the Entity --
-            ListRec* PolygonNode = Entity->PolygonList;
+            //-- Test for intersection in each Polygon in the selected level 
+            //   of detail --
+            ListRec* PolygonNode = (Entity->Nurb == NULL) ? Entity->Detail->PolygonList : NULL;
             while (PolygonNode != NULL)
                {
                #define Polygon ((PolygonRec*)PolygonNode->Data)
@@ -179,7 +200,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
             //   intersection flag accordingly. --
             if (Entity->EntityList != NULL)
                {
-               IFlag |= IntersectScene(I, Origin, Ray, Surface, ExclSurface, Entity->EntityList);
+               IFlag |= IntersectScene(I, Origin, Ray, Surface, ExclSurface, Entity->EntityList, NurbSurface);
                }
             }                                      //END if BV_Intersect()...
 
@@ -209,10 +230,13 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       //Do intersection test with every Entity in the world
       PointRec I;                                     //Intersection point 
       PolygonRec* Surface;                            //Surface that had the intersection
+      PolygonRec  NurbSurface;                        //Surface of a Nurb intersection (one per recursion level)
+      PolyColdRec NurbCold;
       I.t = float_MAX;                                //t must be set to extreme maximum!
+      NurbSurface.Cold = &NurbCold;
 
       //Return becomes blackground color if no intersection occured
-      if (!IntersectScene(&I, Origin, Ray, Surface, ExclSurface, Loc_EntityList))
+      if (!IntersectScene(&I, Origin, Ray, Surface, ExclSurface, Loc_EntityList, &NurbSurface))
          {*LocalColor = BackgndColor; return;} 
 
 
@@ -222,8 +246,8 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
 
 
       //Compute the attenuation factor
-      if ((Surface->Reflect != 0.0f) && ReflectFlag) {Attenuation *= Surface->Reflect;}
-      if (Surface->Trans != 0.0f) {Attenuation *= Surface->Trans;}
+      if ((Surface->Material->Reflect != 0.0f) && ReflectFlag) {Attenuation *= Surface->Material->Reflect;}
+      if (Surface->Material->Trans != 0.0f) {Attenuation *= Surface->Material->Trans;}
 
                        
       //Don't recurse at maximum depth, or under the attenuation threshold
@@ -239,7 +263,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       else
          {
          //-- Ray trace the reflected ray --
-         if ((Surface->Reflect != 0.0f) && ReflectFlag) //Trace only if reflection component is not 0 and the flag is set
+         if ((Surface->Material->Reflect != 0.0f) && ReflectFlag) //Trace only if reflection component is not 0 and the flag is set
             {
             PointRec R;
             Poly_Reflect(&R, Ray, Surface);        //Find the reflection
@@ -247,7 +271,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
             }
 
          //-- Ray trace the refracted ray --
-         if (Surface->Trans != 0.0f)               //Trace only for transparent surfaces
+         if (Surface->Material->Trans != 0.0f)               //Trace only for transparent surfaces
             {
             if (RefractFlag)                       //Do refraction if requested
                {
@@ -264,15 +288,15 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
 
       //======== Combine final colors ========
       //-- Combine transperacy when needed --
-      if (Surface->Trans != 0.0f)
+      if (Surface->Material->Trans != 0.0f)
          {
-         *LocalColor = *LocalColor * Surface->Opacity + RefractColor * Surface->Trans;
+         *LocalColor = *LocalColor * Surface->Material->Opacity + RefractColor * Surface->Material->Trans;
          }
    
       //-- Combine reflection when needed --
-      if ((Surface->Reflect != 0.0f) && ReflectFlag)
+      if ((Surface->Material->Reflect != 0.0f) && ReflectFlag)
          {
-         *LocalColor = *LocalColor * (1.0f - Surface->Reflect) + ReflectColor * Surface->Reflect;
+         *LocalColor = *LocalColor * (1.0f - Surface->Material->Reflect) + ReflectColor * Surface->Material->Reflect;
          }
       }
 
@@ -289,6 +313,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       gl_ColorFmt    = 0;
       ColorScan      = NULL;
       LastColorScan  = NULL;
+      HDR_Frame      = NULL;
       }
 
    /*---- Destructor ---------------------------------------------------------*/
@@ -297,6 +322,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       Frame.DeleteData();
       if (ColorScan     != NULL) {delete[] ColorScan;     ColorScan     = NULL;}
       if (LastColorScan != NULL) {delete[] LastColorScan; LastColorScan = NULL;}
+      if (HDR_Frame     != NULL) {delete[] HDR_Frame;     HDR_Frame     = NULL;}
       }
 
    /*-------------------------------------------------------------------------
@@ -337,7 +363,17 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       LastColorScan = new float[Frame.U_Res];
       if ((ColorScan == NULL) || (LastColorScan == NULL)) {return false;}
 
+      //Allocate the float frame for HDR output
+      if (HDR_Frame != NULL) {delete[] HDR_Frame;}
+      HDR_Frame = new ColorRec[Frame.U_Res * Frame.V_Res];
+      if (HDR_Frame == NULL) {return false;}
+
       
+      //-- Resolve built-in profile curves. The equivalent equation is still 
+      //   compiled, since the rest of the system relies on ProfCode. --
+      if (!ProfCurveLib.Find(ProfCurve, ProfCurveID)) {return false;}
+      if (ProfCurveID != PROFCURVE_GENERIC) {ProfCurve = ProfCurveLib.Equation(ProfCurveID);}
+
       //-- Compile the profile curve equation --
       if (ProfCurve != NULL)
          {
@@ -376,6 +412,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
    bool ShutDown(void) 
       {
       Frame.DeleteData();
+      if (HDR_Frame != NULL) {delete[] HDR_Frame; HDR_Frame = NULL;}
       if (ProfEqu  != NULL) {delete[] ProfEqu;  ProfEqu  = NULL;}
       if (ProfCode != NULL) {delete[] ProfCode; ProfCode = NULL;}
 
@@ -403,6 +440,9 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
       //If the display area is minimized, don't do any rendering
       if (Video->Minimized) {return true;}
 
+      //Bring the world space geometry up to date
+      if ((World == NULL) || !World->Materialize()) {return false;}
+
       //Lock the renderer
       if (!Video->Lock()) {return false;}
 
@@ -464,7 +504,64 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
 
 
       //-- Render the entire scene --
-      byte*  PixelPtr = Frame.FramePtr;
+      bool Status;
+      switch (ProfCurveID)
+         {
+         case PROFCURVE_PLANE     : {ProfCurve_Plane     Curve;           Status = TraceFrame(Curve);} break;
+         case PROFCURVE_LINE      : {ProfCurve_Line      Curve;           Status = TraceFrame(Curve);} break;
+         case PROFCURVE_PARABOLA  : {ProfCurve_Parabola  Curve;           Status = TraceFrame(Curve);} break;
+         case PROFCURVE_SPHERE    : {ProfCurve_Sphere    Curve;           Status = TraceFrame(Curve);} break;
+         case PROFCURVE_HYPERBOLA : {ProfCurve_Hyperbola Curve;           Status = TraceFrame(Curve);} break;
+         case PROFCURVE_TANH      : {ProfCurve_Tanh      Curve;           Status = TraceFrame(Curve);} break;
+         default                  : {ProfCurve_Generic   Curve(ProfCode); Status = TraceFrame(Curve);} break;
+         }
+      if (!Status) {return false;}
+
+
+      //---- Do a final re-display. ----
+      int U_Start = ((int)Video->X_Res - (int)Frame.U_Res) >> 1;
+      int V_Start = ((int)Video->Y_Res - (int)Frame.V_Res) >> 1;
+      if (U_Start < 0) {U_Start = 0;}
+      if (V_Start < 0) {V_Start = 0;}
+
+      byte* ScanLinePtr = Frame.FramePtr;
+      for (int V = V_Start; V < (V_Start + (int)Frame.V_Res); V++)
+         {
+         glRasterPos2i((GLint)U_Start, (GLint)V);
+         glDrawPixels((GLint)Frame.U_Res, (GLint)1, (GLenum)gl_ColorFmt, GL_UNSIGNED_BYTE, ScanLinePtr);
+         ScanLinePtr += Frame.BytesPerLine;
+         }
+
+      //Restore the matrices
+      glPopMatrix();
+      glMatrixMode(GL_PROJECTION);
+      glPopMatrix();
+
+      RenderDone = true;
+
+      //Unlock the renderer
+      if (!Video->UnLock()) {return false;}
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Ray traces the entire frame. The loop is specialized on the profile 
+      curve functor C (see profcurve.cpp), so the profile curve evaluation 
+      is inlined for the built-in curves. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   template <class Curve> bool TraceFrame(Curve &C)
+      {
+      byte*     PixelPtr = Frame.FramePtr;
+      ColorRec* HDR_Ptr  = HDR_Frame;
+
+      //-- Select the levels of detail. The number of pixels per radian at
+      //   the view center is found from the profile curve mapping. Nurb
+      //   surfaces are intersected directly, so they're not 
+      //   re-tessellated. --
+      float z;
+      if (!C.Eval(z, 0.0f)) {return false;}
+      Loc_World->SelectLOD((float)fabs(z * CamApeture.Z / CamApeture.Y), LOD_Pixels, 0.0f);
 
       //Setup the timer functions
       SystemTimer.TS_DiffStart();
@@ -498,19 +595,19 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
                   {
                   //Find the root for the projector vector
                   float r_inv = (r != 0.0f) ? (1.0 / r) : 1.0f;
-                  float r_new = ProfCurve_FindRoot(fabs(POffset*r_inv), r, ProfCode, ProfEquLimR);
+                  float r_new = ProfCurve_Root(C, fabs(POffset*r_inv), r, ProfEquLimR);
                   
                   //Compensate the initial ray
                   float t = r_new * r_inv;
                   Ray.X *= t;
                   Ray.Y *= t;
-                  if (!EquSolver.Execute(Ray.Z, ProfCode, r_new)) {return false;}
+                  if (!C.Eval(Ray.Z, r_new)) {return false;}
                   Ray.Z *= CamApeture.Z;
                   }
                else
                   {
                   //Find the Z value according to the profile curve
-                  if (!EquSolver.Execute(Ray.Z, ProfCode, r)) {return false;}
+                  if (!C.Eval(Ray.Z, r)) {return false;}
                   Ray.Z *= CamApeture.Z;
                   }
 
@@ -549,6 +646,9 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
                      }
                   }
 
+               //Keep the float colors for HDR output
+               *HDR_Ptr = Color;
+
                //Convert float colors to integers (range 0 - 255)
                iColor = iColorRec((int)(Color.R * 255.0f), 
                                   (int)(Color.G * 255.0f), 
@@ -561,7 +661,8 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
             //---- Radius is outside the function bounds ----
             else
                {
-               iColor = 0;
+               *HDR_Ptr = 0.0f;
+               iColor   = 0;
                }
 
 
@@ -582,6 +683,7 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
             //Advance to the next pixel
             ColorScanPtr++;
             LastColorScanPtr++;
+            HDR_Ptr++;
             PixelPtr += Frame.BytesPerPixel;
             }
 
@@ -597,31 +699,49 @@ class RenderRayClass : public RenderClass, private ShadeClass, private Transform
          LastColorScan  = TempPtr;
          }
 
+      return true;
+      }
 
-      //---- Do a final re-display. ----
-      int U_Start = ((int)Video->X_Res - (int)Frame.U_Res) >> 1;
-      int V_Start = ((int)Video->Y_Res - (int)Frame.V_Res) >> 1;
-      if (U_Start < 0) {U_Start = 0;}
-      if (V_Start < 0) {V_Start = 0;}
+   /*-------------------------------------------------------------------------
+      Saves the float colors of the last rendered frame to a PFM file, before
+      they were clamped and quantized. Returns false on fail.
+     ------------------------------------------------------------------------*/
+   bool SaveHDR(char* FileName)
+      {
+      if (!RenderValid || (HDR_Frame == NULL)) {return false;}
+      return PPM.SavePFM(FileName, HDR_Frame, Frame.U_Res, Frame.V_Res);
+      }
 
-      byte* ScanLinePtr = Frame.FramePtr;
-      for (V = V_Start; V < (V_Start + (int)Frame.V_Res); V++)
+   /*-------------------------------------------------------------------------
+      Hands out the last rendered frame (see RenderClass::CaptureFrame( )).
+      When detached, the renderer allocates a new frame buffer of the same
+      type, and RenderDone is cleared, since the new buffer holds no image.
+      TraceFrame( ) writes every pixel, so the new buffer isn't cleared.
+     ------------------------------------------------------------------------*/
+   bool CaptureFrame(BitmapRec* Bitmap, bool Detach)
+      {
+      if (!RenderValid || !RenderDone || (Bitmap == NULL) || (Frame.BitmapPtr == NULL)) {return false;}
+
+      //Allocate a bitmap matching the frame. When detached, this becomes the
+      //new frame buffer, so the renderer keeps its frame if this fails.
+      BitmapRec Fresh;
+      Fresh.Flags      = Frame.Flags;
+      Fresh.U_Res      = Frame.U_Res;
+      Fresh.V_Res      = Frame.V_Res;
+      Fresh.FrameCount = 1;
+      if (!Fresh.AllocateData()) {return false;}
+
+      if (!Detach)
          {
-         glRasterPos2i((GLint)U_Start, (GLint)V);
-         glDrawPixels((GLint)Frame.U_Res, (GLint)1, (GLenum)gl_ColorFmt, GL_UNSIGNED_BYTE, ScanLinePtr);
-         ScanLinePtr += Frame.BytesPerLine;
+         memcpy(Fresh.BitmapPtr, Frame.BitmapPtr, Frame.Size);
+         Bitmap->MoveFrom(&Fresh);
+         return true;
          }
 
-      //Restore the matrices
-      glPopMatrix();
-      glMatrixMode(GL_PROJECTION);
-      glPopMatrix();
-
-      RenderDone = true;
-
-      //Unlock the renderer
-      if (!Video->UnLock()) {return false;}
+      Bitmap->MoveFrom(&Frame);
+      Frame.MoveFrom(&Fresh);
 
+      RenderDone = false;
       return true;
       }
 
@@ -82,7 +82,7 @@ class ShadeClass
          LightList        : List of lights
 
       Output:
-         Polygon->Shade[] : Light intensity, diffuse and ambient rendering color.
+         Polygon->Cold->Shade[] : Light intensity, diffuse and ambient rendering color.
      ------------------------------------------------------------------------*/
    inline bool ShadeGouraud(PolygonRec* Polygon, ListRec* LightList)
       {
@@ -103,12 +103,12 @@ class ShadeClass
             if (!ShadeGouraud(&Vertex, LightList)) {return false;}
 
             //Compute the final (faceted) diffuse rendering color
-            Polygon->Shade[I] = Polygon->kDiff * Vertex.Shade + Polygon->kAmb * World.AmbLight;
+            Polygon->Cold->Shade[I] = Polygon->Material->kDiff * Vertex.Shade + Polygon->Material->kAmb * World.AmbLight;
             }
          else
             {
             //Compute the final (non-faceted) diffuse rendering color
-            Polygon->Shade[I] = Polygon->kDiff * Polygon->Vertex[I]->Shade + Polygon->kAmb * World.AmbLight;
+            Polygon->Cold->Shade[I] = Polygon->Material->kDiff * Polygon->Vertex[I]->Shade + Polygon->Material->kAmb * World.AmbLight;
             }
          }
       
@@ -164,7 +164,7 @@ class ShadeClass
             PointRec H = ((L + V) * 0.5f).Unit();           //Find halfway unit vector between light and view vectors
             float SpecAng = N.Dot(H);                       //Find the dot product between the N and H
             if (SpecAng < 0.0f) {SpecAng = 0.0f;}           //Don't want negative colors
-            SpecAng = (float)pow(SpecAng, Surface->nSpec);  //Compute specular size
+            SpecAng = (float)pow(SpecAng, Surface->Material->nSpec);  //Compute specular size
 
             //Contribute this light if either diffuse or specular angles are > 0.0
             if ((SpecAng > 0.0f) || (Ang > 0.0f))
@@ -180,11 +180,11 @@ class ShadeClass
                   TransColor = ((Light->Color - TransColor)*t + TransColor)*t;
 
                   //Multiply with coeffs add the contributing light color
-                  LightColor += (TransColor * (Surface->kDiff * Ang + Surface->kSpec * SpecAng));
+                  LightColor += (TransColor * (Surface->Material->kDiff * Ang + Surface->Material->kSpec * SpecAng));
                   }
 
                //No transparent shadows, nultiply with coeffs add the contributing light color
-               else {LightColor += (Light->Color * (Surface->kDiff * Ang + Surface->kSpec * SpecAng));}
+               else {LightColor += (Light->Color * (Surface->Material->kDiff * Ang + Surface->Material->kSpec * SpecAng));}
                }
             }
 
@@ -194,7 +194,7 @@ class ShadeClass
          }
 
       //-- Add the ambient component to the obtained light color --
-      *LocalColor = LightColor + Surface->kAmb * World.AmbLight;
+      *LocalColor = LightColor + Surface->Material->kAmb * World.AmbLight;
       
       return true;
       }
@@ -225,8 +225,24 @@ class ShadeClass
          #define Entity ((EntityRec*)EntityNode->Data)
          if (Entity == NULL) {return false;}
 
-         //---- Test for intersection in each Polygon in the Entity ----
-         ListRec* PolygonNode = Entity->PolygonList;
+         //---- Nurb surfaces are tested directly (see 
+         //     EntityRec::IntersectNurb( )) ----
+         if (Entity->Nurb != NULL)
+            {
+            float t = Length;
+            if (Entity->IntersectNurb(O, D, t, NULL))
+               {
+               MaterialRec* Material = &Entity->MaterialArray[0];
+               if (Material->Trans == 0.0f) {return true;}
+
+               *TransColor += ColorRec(Material->kDiff.R, Material->kDiff.G, Material->kDiff.B, Material->Trans);
+               TC_Count++;
+               }
+            }
+
+         //---- Test for intersection in each Polygon in the selected level 
+         //     of detail ----
+         ListRec* PolygonNode = (Entity->Nurb == NULL) ? Entity->Detail->PolygonList : NULL;
          while (PolygonNode != NULL)
             {
             #define Polygon ((PolygonRec*)PolygonNode->Data)
@@ -243,15 +259,15 @@ class ShadeClass
                   if (I.t < Length) 
                      {
                      //If the polygon is not transparent, exit.
-                     if (Polygon->Trans == 0.0f) {return true;}
+                     if (Polygon->Material->Trans == 0.0f) {return true;}
                      
                      //For transparent polygons, we simply accumulate the shadow colors.
                      else 
                         {
-                        *TransColor += ColorRec(Polygon->kDiff.R, 
-                                                Polygon->kDiff.G, 
-                                                Polygon->kDiff.B, 
-                                                Polygon->Trans);
+                        *TransColor += ColorRec(Polygon->Material->kDiff.R, 
+                                                Polygon->Material->kDiff.G, 
+                                                Polygon->Material->kDiff.B, 
+                                                Polygon->Material->Trans);
                         TC_Count++;
                         }
                      }
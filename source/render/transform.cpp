@@ -18,10 +18,21 @@
 #include "../_common/std_inc.h"
 #include "../_common/std_3d.h"
 #include "../math/equsolver.cpp"
+#include "../math/profcurve.cpp"
 #include "../video_io/video.cpp"
 
 
 //#define TRANSFORM_SLOW
+//#define TRANSFORM_CUBIC
+
+
+/*---------------------------------------------------------------------------
+   Definitions.
+  ---------------------------------------------------------------------------*/
+#define TRANSFORM_TAB_SEED       16                      //Number of uniform segments the table is seeded with
+#define TRANSFORM_TAB_DEPTH      16                      //Maximum subdivision depth of a seed segment
+#define TRANSFORM_TAB_MAX        8192                    //Maximum number of table entries
+#define TRANSFORM_R_EXTREME      100.0f                  //r value used for view vectors that miss the profile curve
 
 
 /*---------------------------------------------------------------------------
@@ -32,24 +43,169 @@ class TransformClass
    /*==== Public Declarations ================================================*/
    private:
 
-   struct DegRec
+   //Each entry is keyed on u = m / (1 + |m|), where m is the view vector 
+   // gradient. This maps m = [-inf, inf] onto u = [-1, 1] without an atan( ).
+   struct TabRec
       {
-      float R;
-      float Z;
+      float U;                                     //Table key
+      float R;                                     //r intersection
+      float Z;                                     //z intersection
+      float dR;                                    //dR/du and dZ/du, used for cubic interpolation
+      float dZ;
       };
 
-   DegRec*  DegTable;                              //Fast lookup table for profile curve transformation
-   int      DegRes;
-   float    DegResInv;
-   int      ArrayShift;
-   int      ArraySize;                             //Number of table entries.
+   TabRec*  ProfTable;                             //Adaptive lookup table for profile curve transformation
+   int      TabSize;                               //Number of table entries
+   int*     TabIndex;                              //Uniform index into ProfTable, used to find the segment of u
+   int      TabIndexSize;                          //Number of index entries
+   float    TabIndexScale;                         //TabIndexSize * 0.5f
+   float    TabTol;                                //Maximum interpolation error allowed in the table
    float    z_max;                                 //Z value at f(r_max)
    float    r_max;                                 //r_max clipper
+   float    m_max;                                 //Tangent gradient at r_max
    float    v_m_lim;                               //View vector gradient limit at r_max
+   byte*    LocalProfCode;                         //Profile curve code (used by TRANSFORM_SLOW)
+
+   
+   /*-------------------------------------------------------------------------
+      Computes the r and z intersection of the view vector, which is given by
+      the table key u. See InitTable( ) for details. C is the profile curve 
+      functor (see profcurve.cpp).
+     ------------------------------------------------------------------------*/
+   template <class Curve> void Tab_Eval(Curve &C, float u, float &R, float &Z)
+      {
+      //Forward and backward view vectors (both with and infinite gradient)
+      if (u >=  1.0f) {R = 0.0f; Z =  1.0f; return;}
+      if (u <= -1.0f) {R = TRANSFORM_R_EXTREME; Z = -1.0f; return;}
+
+      float m = u / (1.0f - fabs(u));
+
+      //Compute the r and z intercept for the interval [0, r_max]
+      if (m >= v_m_lim)
+         {
+         R = ProfCurve_Root(C, m, 0.0f, r_max);
+         C.Eval(Z, R);
+         }
+
+      //Compute the r and z intercept for the interval [r_max, inf]
+      else 
+         {
+         float dm = (m_max - m);
+         R = (dm < 0.0) ? ((m_max*r_max - z_max) / dm) : TRANSFORM_R_EXTREME;
+         Z = m * R;
+         }
+      }
+
+   /*-------------------------------------------------------------------------
+      Appends an entry to the end of the table. The table grows in blocks,
+      so the final size doesn't need to be known in advance.
+     ------------------------------------------------------------------------*/
+   bool Tab_Append(int &Capacity, float u, float R, float Z)
+      {
+      if (TabSize >= Capacity)
+         {
+         Capacity = (Capacity > 0) ? (Capacity << 1) : 256;
+         TabRec* TempPtr = (TabRec*)realloc(ProfTable, Capacity*sizeof(TabRec));
+         if (TempPtr == NULL) {return false;}
+         ProfTable = TempPtr;
+         }
+
+      ProfTable[TabSize].U  = u;
+      ProfTable[TabSize].R  = R;
+      ProfTable[TabSize].Z  = Z;
+      ProfTable[TabSize].dR = 0.0f;
+      ProfTable[TabSize].dZ = 0.0f;
+      TabSize++;
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Recursively splits the segment [u1, u2] until linear interpolation 
+      between the end points is within TabTol of the profile curve. Entries
+      are appended in increasing u order, excluding the end point u2. 
+      Segments that are entirely outside r_max are only checked against 
+      the clipper, since they are never visible.
+     ------------------------------------------------------------------------*/
+   template <class Curve> bool Tab_Subdivide(Curve &C, int &Capacity, float u1, float R1, float Z1, float u2, float R2, float Z2, dword Depth)
+      {
+      float u = (u1 + u2) * 0.5f;
+      float R, Z;
+      Tab_Eval(C, u, R, Z);
+
+      bool Split = false;
+      if ((Depth < TRANSFORM_TAB_DEPTH) && (TabSize < TRANSFORM_TAB_MAX - 2))
+         {
+         if ((R1 < r_max) || (R2 < r_max) || (R < r_max))
+            {
+            Split = (fabs(R - (R1 + R2) * 0.5f) > TabTol) || (fabs(Z - (Z1 + Z2) * 0.5f) > TabTol);
+            }
+         }
+
+      if (!Split) {return Tab_Append(Capacity, u1, R1, Z1);}
+
+      if (!Tab_Subdivide(C, Capacity, u1, R1, Z1, u, R, Z, Depth + 1)) {return false;}
+      return Tab_Subdivide(C, Capacity, u, R, Z, u2, R2, Z2, Depth + 1);
+      }
+
+   /*-------------------------------------------------------------------------
+      Builds the table from the seed segments.
+     ------------------------------------------------------------------------*/
+   template <class Curve> bool Tab_Build(Curve &C)
+      {
+      int   Capacity = 0;
+      float u1, R1, Z1, u2, R2, Z2;
+      TabSize = 0;
+
+      u1 = -1.0f;
+      Tab_Eval(C, u1, R1, Z1);
+      for (int I = 1; I <= TRANSFORM_TAB_SEED; I++)
+         {
+         u2 = -1.0f + 2.0f * (float)I / (float)TRANSFORM_TAB_SEED;
+         Tab_Eval(C, u2, R2, Z2);
+         if (!Tab_Subdivide(C, Capacity, u1, R1, Z1, u2, R2, Z2, 0)) {return false;}
+         u1 = u2; R1 = R2; Z1 = Z2;
+         }
+
+      return Tab_Append(Capacity, u1, R1, Z1);
+      }
 
-   #if defined (TRANSFORM_SLOW)
-   byte*    LocalProfCode;
-   #endif
+   /*-------------------------------------------------------------------------
+      Finds the table segment of u and interpolates the r and z intersection
+      from its end points.
+     ------------------------------------------------------------------------*/
+   __forceinline void Tab_Lookup(float u, float &R, float &Z)
+      {
+      //Locate the segment via the uniform index, then step forward 
+      // through any extra entries that fall in the same index bucket.
+      int I = (int)((u + 1.0f) * TabIndexScale);
+      if (I < 0) {I = 0;} else if (I >= TabIndexSize) {I = TabIndexSize - 1;}
+      
+      I = TabIndex[I];
+      while ((I < TabSize - 2) && (ProfTable[I + 1].U <= u)) {I++;}
+
+      TabRec* P1 = &ProfTable[I];
+      TabRec* P2 = &ProfTable[I + 1];
+      float   h  = P2->U - P1->U;
+      float   t  = (u - P1->U) / h;
+      if (t < 0.0f) {t = 0.0f;} else if (t > 1.0f) {t = 1.0f;}
+
+      #if defined (TRANSFORM_CUBIC)
+         //Cubic Hermite interpolation
+         float t2  = t*t;
+         float t3  = t2*t;
+         float h00 =  2.0f*t3 - 3.0f*t2 + 1.0f;
+         float h10 = (t3 - 2.0f*t2 + t) * h;
+         float h01 = -2.0f*t3 + 3.0f*t2;
+         float h11 = (t3 - t2) * h;
+         R = h00*P1->R + h10*P1->dR + h01*P2->R + h11*P2->dR;
+         Z = h00*P1->Z + h10*P1->dZ + h01*P2->Z + h11*P2->dZ;
+      #else
+         //Linear interpolation
+         R = P1->R + (P2->R - P1->R) * t;
+         Z = P1->Z + (P2->Z - P1->Z) * t;
+      #endif
+      }
 
 
    /*==== Public Declarations ================================================*/
@@ -58,24 +214,24 @@ class TransformClass
    /*---- Constructor --------------------------------------------------------*/
    TransformClass(void)
       {
-      DegTable   = NULL;
-      DegRes     = 0;
-      DegResInv  = 0.0f;
-      ArrayShift = 0;
-      ArraySize  = 0;
-      z_max      = 1.0f;
-      r_max      = 1.0f;
-      v_m_lim    = 1.0f;
-
-      #if defined (TRANSFORM_SLOW)
+      ProfTable     = NULL;
+      TabSize       = 0;
+      TabIndex      = NULL;
+      TabIndexSize  = 0;
+      TabIndexScale = 0.0f;
+      TabTol        = 0.0f;
+      z_max         = 1.0f;
+      r_max         = 1.0f;
+      m_max         = 0.0f;
+      v_m_lim       = 1.0f;
       LocalProfCode = NULL;
-      #endif
       }
 
    /*---- Destructor ---------------------------------------------------------*/
    ~TransformClass(void)
       {
-      if (DegTable != NULL) {free(DegTable); DegTable = NULL;}
+      if (ProfTable != NULL) {free(ProfTable); ProfTable = NULL;}
+      if (TabIndex  != NULL) {free(TabIndex);  TabIndex  = NULL;}
       }
 
    /*-------------------------------------------------------------------------
@@ -103,72 +259,80 @@ class TransformClass
       
       The intersection occurs only if : (m_max - m) < 0, otherwise 
       r = extreme value.
+
+      The table is keyed on u = m / (1 + |m|) rather than the view vector
+      angle, so no atan( ) is needed during the lookup. Entries are not 
+      evenly spaced: the u range is seeded with a few uniform segments, 
+      which are split until the interpolation error is below TabTol. This
+      places most entries where the profile curve bends. NewTabRes keeps 
+      its original meaning, the error is comparable to a uniform table 
+      with 1/NewTabRes degree steps.
+
+      ProfCurveID selects a built-in profile curve functor for building the
+      table. ProfCode must still be valid, and must match the built-in curve.
      ------------------------------------------------------------------------*/
-     bool InitTable(VideoClass* Video, byte* ProfCode, float ProfEquLim, dword NewDegRes)
+     bool InitTable(VideoClass* Video, byte* ProfCode, float ProfEquLim, dword NewTabRes, dword ProfCurveID = PROFCURVE_GENERIC)
       {
       if ((Video == NULL) || (ProfCode == NULL)) {return false;}
 
       //Ensure that the Video mode is valid.
       if (!Video->ModeValid) {return false;}
       
-      //Notes on DegTable: Forward gradients DegTable[0] to DegTable[ArrayShift-1],
-      // backard gradients DegTable[ArrayShift+1] to DegTable[ArraySize-1].
-      DegRes     = (NewDegRes > 0) ? NewDegRes : 1;
-      DegResInv  = 1.0f / (float)DegRes;
-      ArrayShift = 90  * DegRes;
-      ArraySize  = 180 * DegRes + 1;
-      
-      //(Re)allocate the profile curve table
-      DegRec* TempPtr = (DegRec*)realloc(DegTable, ArraySize*sizeof(DegRec));
-      if (TempPtr == NULL) {return false;}
-      DegTable = TempPtr;
-
-
       //Compute maximums
       r_max      = ProfEquLim;
       EquSolver.Execute(z_max, ProfCode, r_max);
       v_m_lim    = (r_max != 0.0f) ? (z_max / r_max) : ((z_max < 0.0f) ? -10000.0f : 10000.0f);
-
       
       //Find the tangent just before the limit
       float z_d, r_d = r_max-0.1;
       EquSolver.Execute(z_d, ProfCode, r_d);
-      float m_max = (z_d - z_max) / (r_d - r_max);
+      m_max = (z_d - z_max) / (r_d - r_max);
 
-      #if defined (TRANSFORM_SLOW)
       LocalProfCode = ProfCode;
-      #endif
 
-      //---- Handle forward and backward view vectors 
-      //     (both with and infinite gradient). ----
-      DegTable[0].R           =  0.0f;
-      DegTable[0].Z           =  1.0f;
-      DegTable[ArraySize-1].R =  100.0f;
-      DegTable[ArraySize-1].Z = -1.0f;
-      
-      //---- Setup the table ----
-      float view_hyp = 1.0f;
-      for (int Deg = 1; Deg < ArraySize-1; Deg++)
+      //Error tolerance, equivalent to the r error of a 1/NewTabRes degree step
+      TabTol = fabs(r_max) * deg2rad(1.0f / (float)((NewTabRes > 0) ? NewTabRes : 1));
+      if (TabTol < 0.00001f) {TabTol = 0.00001f;}
+
+      //---- Build the table, specialized on the profile curve ----
+      bool Status;
+      switch (ProfCurveID)
+         {
+         case PROFCURVE_PLANE     : {ProfCurve_Plane     Curve;           Status = Tab_Build(Curve);} break;
+         case PROFCURVE_LINE      : {ProfCurve_Line      Curve;           Status = Tab_Build(Curve);} break;
+         case PROFCURVE_PARABOLA  : {ProfCurve_Parabola  Curve;           Status = Tab_Build(Curve);} break;
+         case PROFCURVE_SPHERE    : {ProfCurve_Sphere    Curve;           Status = Tab_Build(Curve);} break;
+         case PROFCURVE_HYPERBOLA : {ProfCurve_Hyperbola Curve;           Status = Tab_Build(Curve);} break;
+         case PROFCURVE_TANH      : {ProfCurve_Tanh      Curve;           Status = Tab_Build(Curve);} break;
+         default                  : {ProfCurve_Generic   Curve(ProfCode); Status = Tab_Build(Curve);} break;
+         }
+      if (!Status) {return false;}
+
+      //---- Derivatives for cubic interpolation (finite differences) ----
+      int J;
+      for (J = 0; J < TabSize; J++)
          {
-         float Angle  = deg2rad((float)(ArrayShift-Deg) * DegResInv);
-         float view_r = cos(Angle) * view_hyp;
-         float view_z = sin(Angle) * view_hyp;
-         float m      = view_z / view_r;
+         int   J1 = (J > 0)         ? (J - 1) : J;
+         int   J2 = (J < TabSize-1) ? (J + 1) : J;
+         float du = ProfTable[J2].U - ProfTable[J1].U;
+         ProfTable[J].dR = (ProfTable[J2].R - ProfTable[J1].R) / du;
+         ProfTable[J].dZ = (ProfTable[J2].Z - ProfTable[J1].Z) / du;
+         }
 
-         //Compute the r and z intercept for the interval [0, r_max]
-         if (m >= v_m_lim)
-            {
-            DegTable[Deg].R = ProfCurve_FindRoot(m, ProfCode, ProfEquLim);
-            EquSolver.Execute(DegTable[Deg].Z, ProfCode, DegTable[Deg].R);            
-            }
+      //---- Setup the uniform segment index ----
+      TabIndexSize  = TabSize * 2;
+      TabIndexScale = (float)TabIndexSize * 0.5f;
+
+      int* TempPtr = (int*)realloc(TabIndex, TabIndexSize*sizeof(int));
+      if (TempPtr == NULL) {return false;}
+      TabIndex = TempPtr;
 
-         //Compute the r and z intercept for the interval [r_max, inf]
-         else 
-            {
-            float dm = (m_max - m);
-            DegTable[Deg].R = (dm < 0.0) ? ((m_max*r_max - z_max) / dm) : 100.0f;
-            DegTable[Deg].Z = m * DegTable[Deg].R;
-            }
+      int Seg = 0;
+      for (J = 0; J < TabIndexSize; J++)
+         {
+         float u = -1.0f + (float)J / TabIndexScale;
+         while ((Seg < TabSize - 2) && (ProfTable[Seg + 1].U <= u)) {Seg++;}
+         TabIndex[J] = Seg;
          }
 
       return true;
@@ -266,7 +430,7 @@ class TransformClass
      ------------------------------------------------------------------------*/
    __forceinline bool ProfCurve_Transform(PointRec &tPoint, PointRec &Point)
       {
-      if (DegTable == NULL) {return false;}
+      if (ProfTable == NULL) {return false;}
       
       //Use the X and Y coordinates to find the radius, which is used 
       // to find the gradient of the view vector (in profile curve space).
@@ -277,21 +441,22 @@ class TransformClass
       //Compute the inverse of R to avoid divisions
       R = (R != 0.0f) ? (1.0f / R) : 1.0f;
 
-      //Compute the angle of the view vector in degrees, which is used
-      // as the lookup table index. This is done by computing the 
-      // arc tangent of the view vector gradient.
+      //Find the r and z intersection from the view vector gradient. The 
+      // table key is a bounded function of the gradient (no atan( ) needed).
+      float rInt, zInt;
       #if defined (TRANSFORM_SLOW)
-         int Deg = 0;
-         DegTable[Deg].R = ProfCurve_FindRoot(V.Z * R, LocalProfCode, r_max);
+         rInt = ProfCurve_FindRoot(V.Z * R, LocalProfCode, r_max);
+         EquSolver.Execute(zInt, LocalProfCode, rInt);
       #else
-         int Deg = ArrayShift - (int)(rad2deg(atan(V.Z * R)) * (float)DegRes);
+         float m = V.Z * R;
+         Tab_Lookup(m / (1.0f + fabs(m)), rInt, zInt);
       #endif
 
       SystemFlags.AccumPoints++;
 
       //The curved display coordinates is obtained by scaling the V[X,Y] to 
       // unit coordinates and then further scaling them by the r-Int value.
-      R *= DegTable[Deg].R;
+      R *= rInt;
       tPoint.X = V.X * R;
       tPoint.Y = V.Y * R;
 
@@ -300,11 +465,11 @@ class TransformClass
       tPoint.Z = sqrt(SqrMag_XY + sqr(V.Z)) * 2.0f; //Increase magnitude size by 2 (gives better point "sort" in z buffer)
       
       //rInt value is stored in tPoint->t.
-      tPoint.t = DegTable[Deg].R;
+      tPoint.t = rInt;
       
       //If r-Int spans outside the clipping region, the point is flagged 
       // invisible.
-      return (DegTable[Deg].R < r_max);
+      return (rInt < r_max);
       #undef V
       }
 
@@ -320,7 +485,7 @@ class TransformClass
      ------------------------------------------------------------------------*/
    __forceinline bool ProfCurve_Transform(PointRec &tPoint, PointRec &Point, float d)
       {
-      if (DegTable == NULL) {return false;}
+      if (ProfTable == NULL) {return false;}
       
       //Use the X and Y coordinates to find the radius, which is used 
       // to find the gradient of the view vector (in profile curve space).
@@ -331,26 +496,27 @@ class TransformClass
       //Compute the inverse of R to avoid divisions
       R = (R != 0.0f) ? (1.0f / R) : 1.0f;
 
-      //Compute the angle of the view vector in degrees, which is used
-      // as the lookup table index. This is done by computing the 
-      // arc tangent of the view vector gradient.
+      //Find the r and z intersection from the view vector gradient. The 
+      // table key is a bounded function of the gradient (no atan( ) needed).
+      float rInt, zInt;
       #if defined (TRANSFORM_SLOW)
-         int Deg = 0;
-         DegTable[Deg].R = ProfCurve_FindRoot(V.Z * R, LocalProfCode, r_max);
+         rInt = ProfCurve_FindRoot(V.Z * R, LocalProfCode, r_max);
+         EquSolver.Execute(zInt, LocalProfCode, rInt);
       #else
-         int Deg = ArrayShift - (int)(rad2deg(atan(V.Z * R)) * (float)DegRes);
+         float m = V.Z * R;
+         Tab_Lookup(m / (1.0f + fabs(m)), rInt, zInt);
       #endif
 
       SystemFlags.AccumPoints++;
 
       //The curved display coordinates is obtained by scaling the V[X,Y,Z] to 
       // unit coordinates and then further scaling them by the m-Int value.
-      R *= DegTable[Deg].R;
+      R *= rInt;
       tPoint.X = V.X * R;
       tPoint.Y = V.Y * R;
 
       //Projector compensation (only for points that are in front ot d)
-      float t = (DegTable[Deg].Z > d) ? fabs(d / (DegTable[Deg].Z - d)) : 100.0f;
+      float t = (zInt > d) ? fabs(d / (zInt - d)) : 100.0f;
       tPoint.X *= t;
       tPoint.Y *= t;
 
@@ -359,14 +525,78 @@ class TransformClass
       tPoint.Z = sqrt(SqrMag_XY + sqr(V.Z)) * 2.0f;  //Increase magnitude size by 2 (gives better point "sort" in z buffer)
       
       //rInt value is stored in tPoint->t.
-      tPoint.t = DegTable[Deg].R;
+      tPoint.t = rInt;
       
       //If r-Int spans outside the clipping region, the point is flagged 
       // invisible.
-      return (DegTable[Deg].R < r_max);
+      return (rInt < r_max);
       #undef V
       }
 
+   /*-------------------------------------------------------------------------
+      Transforms a batch of points according to the profile curve. The 
+      points are stored as a structure of arrays, and are transformed in 
+      place. The first pass has no table lookups, and can be vectorized by 
+      the compiler. The result is the same as calling ProfCurve_Transform( ) 
+      for each point.
+
+      X, Y, Z  : Input point coordinates (view space). Returns the 
+                 transformed coordinates.
+      T        : Returns the r intersection (same as tPoint.t).
+      W        : Scratch array of Count entries.
+      Visible  : Returns a non-zero value for each visible point.
+      Count    : Number of points.
+      PComp    : Enables projector compensation.
+      d        : The Z dinstance of the projector from the origin.
+     ------------------------------------------------------------------------*/
+   void ProfCurve_TransformBatch(float* X, float* Y, float* Z, float* T, float* W, byte* Visible, dword Count, bool PComp, float d)
+      {
+      dword I;
+
+      if (ProfTable == NULL) 
+         {
+         for (I = 0; I < Count; I++) {Visible[I] = 0;}
+         return;
+         }
+
+      //-- Pass 1: Inverse of the XY radius, depth and the table key --
+      for (I = 0; I < Count; I++)
+         {
+         float SqrMag_XY = X[I]*X[I] + Y[I]*Y[I];
+         float R         = sqrt(SqrMag_XY);
+         R               = (R != 0.0f) ? (1.0f / R) : 1.0f;
+         float m         = Z[I] * R;
+
+         W[I] = sqrt(SqrMag_XY + Z[I]*Z[I]) * 2.0f;      //Depth value for the Z buffer
+         Z[I] = m / (1.0f + fabs(m));                     //Table key
+         T[I] = R;
+         }
+
+      //-- Pass 2: Table lookup and scaling --
+      for (I = 0; I < Count; I++)
+         {
+         float rInt, zInt;
+         #if defined (TRANSFORM_SLOW)
+            float m = Z[I] / (1.0f - fabs(Z[I]));
+            rInt = ProfCurve_FindRoot(m, LocalProfCode, r_max);
+            EquSolver.Execute(zInt, LocalProfCode, rInt);
+         #else
+            Tab_Lookup(Z[I], rInt, zInt);
+         #endif
+
+         float Scale = T[I] * rInt;
+         if (PComp) {Scale *= (zInt > d) ? fabs(d / (zInt - d)) : 100.0f;}
+
+         X[I]      *= Scale;
+         Y[I]      *= Scale;
+         Z[I]       = W[I];
+         T[I]       = rInt;
+         Visible[I] = (rInt < r_max);
+         }
+
+      SystemFlags.AccumPoints += Count;
+      }
+
    /*-------------------------------------------------------------------------
       Performs a perspective view compensation for a panoramic transformed 
       point.
@@ -0,0 +1,321 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*     Asynchronous Frame Output Queue (at this stage Windows 9x and NT only) */
+/*============================================================================*/
+
+/*----------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ----------------------------------------------------------------------------*/
+#ifndef __FRAMEQUEUE_CPP__
+#define __FRAMEQUEUE_CPP__
+
+
+/*----------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ----------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+#include "../mem_data/bitmap.cpp"
+#include "../disk_io/tga_fmt.cpp"
+#include "../disk_io/ppm_fmt.cpp"
+
+
+/*----------------------------------------------------------------------------
+   Definitions.
+  ----------------------------------------------------------------------------*/
+#define FRAMEQ_MAX_THREADS 4                    //Maximum number of writer threads
+#define FRAMEQ_SLOTS       8                    //Number of frames that can wait in the queue
+#define FRAMEQ_NAME_SIZE   256                  //Maximum file name length, including the terminator
+
+//File formats:
+#define FRAMEQ_TGA         0x00                 //RLE compressed TGA
+#define FRAMEQ_PPM         0x01                 //Binary PPM
+
+
+/*----------------------------------------------------------------------------
+   Queued frame record.
+  ----------------------------------------------------------------------------*/
+struct FrameJobRec
+   {
+   BitmapRec   Bitmap;                          //Frame to save, owned by the queue
+   char        FileName[FRAMEQ_NAME_SIZE];
+   dword       Format;                          //File format (see FRAMEQ_* above)
+   };
+
+
+/*----------------------------------------------------------------------------
+   Frame queue class. Saves captured frames on background threads, so that
+   the render loop doesn't wait for the encoding and the disk. The caller
+   hands the frame over with Push( ), and continues immediately, unless the
+   queue is full, in which case Push( ) waits for a free slot. Each writer
+   thread has its own encoders, since they keep their buffers between
+   saves. On other OS the frames are saved by the caller.
+  ----------------------------------------------------------------------------*/
+class FrameQueueClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   bool        Initialized;
+   dword       ThreadCount;                     //Number of writer threads
+   volatile long Failed;                        //Number of frames that couldn't be saved since the last Flush( )
+
+   /*-------------------------------------------------------------------------
+      Writer record. Holds the encoders and the frame being saved.
+     -------------------------------------------------------------------------*/
+   struct WriterRec
+      {
+      FrameQueueClass* Queue;
+      FrameJobRec      Job;
+      TGA_Class        TGA_Writer;
+      PPM_Class        PPM_Writer;
+      };
+
+   WriterRec   Writer[FRAMEQ_MAX_THREADS];
+
+   /*-------------------------------------------------------------------------
+      Saves the frame of a writer, then releases the frame. Returns true on
+      success.
+     -------------------------------------------------------------------------*/
+   static bool Save(WriterRec* W)
+      {
+      bool Status = false;
+      switch (W->Job.Format)
+         {
+         case FRAMEQ_TGA : Status = W->TGA_Writer.Save(W->Job.FileName, &W->Job.Bitmap, true);  break;
+         case FRAMEQ_PPM : Status = W->PPM_Writer.Save(W->Job.FileName, &W->Job.Bitmap, false); break;
+         }
+
+      if (!Status) {printf("FrameQueueClass::Save( ): Failed to save \"%s\".\n", W->Job.FileName);}
+      W->Job.Bitmap.DeleteData();
+      return Status;
+      }
+
+   //==== Win32 specific ====
+   #if defined (WIN32) || defined (WIN32_NT)
+   HANDLE      Thread[FRAMEQ_MAX_THREADS];
+   HANDLE      Queued;                          //Semaphore, counts the frames in the slots
+   HANDLE      Free;                            //Semaphore, counts the free slots
+   HANDLE      Idle;                            //Signalled when the last pending frame is saved
+   CRITICAL_SECTION Lock;                       //Guards the slots
+   volatile LONG Pending;                       //Number of frames queued or being saved
+   volatile bool Quit;
+
+   FrameJobRec Slot[FRAMEQ_SLOTS];
+   dword       Head;                            //Next slot to save
+   dword       Tail;                            //Next free slot
+
+   /*-------------------------------------------------------------------------
+      Writer thread entry point. The frame is moved out of its slot before
+      it's saved, so the slot is free for the next frame straight away.
+     -------------------------------------------------------------------------*/
+   static DWORD WINAPI WriterProc(LPVOID Param)
+      {
+      WriterRec*       W     = (WriterRec*)Param;
+      FrameQueueClass* Queue = W->Queue;
+
+      for (;;)
+         {
+         WaitForSingleObject(Queue->Queued, INFINITE);
+         if (Queue->Quit) {break;}
+
+         EnterCriticalSection(&Queue->Lock);
+         FrameJobRec* Job = &Queue->Slot[Queue->Head];
+         Queue->Head = (Queue->Head + 1) % FRAMEQ_SLOTS;
+
+         W->Job.Bitmap.MoveFrom(&Job->Bitmap);
+         strcpy(W->Job.FileName, Job->FileName);
+         W->Job.Format = Job->Format;
+         LeaveCriticalSection(&Queue->Lock);
+         ReleaseSemaphore(Queue->Free, 1, NULL);
+
+         if (!Save(W)) {InterlockedIncrement((LONG*)&Queue->Failed);}
+         if (InterlockedDecrement((LONG*)&Queue->Pending) == 0) {SetEvent(Queue->Idle);}
+         }
+
+      return 0;
+      }
+   #endif
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Constructor --------------------------------------------------------*/
+   FrameQueueClass(void)
+      {
+      Initialized = false;
+      ThreadCount = 0;
+      Failed      = 0;
+
+      for (dword I = 0; I < FRAMEQ_MAX_THREADS; I++) {Writer[I].Queue = this;}
+
+      #if defined (WIN32) || defined (WIN32_NT)
+         Queued  = NULL;
+         Free    = NULL;
+         Idle    = NULL;
+         Pending = 0;
+         Head    = 0;
+         Tail    = 0;
+      #endif
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~FrameQueueClass(void) {Shutdown();}
+
+   /*-------------------------------------------------------------------------
+      Starts the writer threads. Init( ) is called by Push( ) on first use,
+      so it's only necessary to call this to set the number of threads.
+
+      Threads  : Number of writer threads. If 0, one less than the number of
+                 processors is used (but at least one).
+     -------------------------------------------------------------------------*/
+   void Init(dword Threads)
+      {
+      Shutdown();
+      Initialized = true;
+      Failed      = 0;
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         if (Threads == 0)
+            {
+            SYSTEM_INFO Info;
+            GetSystemInfo(&Info);
+            Threads = (Info.dwNumberOfProcessors > 1) ? Info.dwNumberOfProcessors - 1 : 1;
+            }
+         if (Threads > FRAMEQ_MAX_THREADS) {Threads = FRAMEQ_MAX_THREADS;}
+
+         Quit    = false;
+         Pending = 0;
+         Head    = 0;
+         Tail    = 0;
+
+         Queued = CreateSemaphore(NULL, 0, FRAMEQ_SLOTS, NULL);
+         Free   = CreateSemaphore(NULL, FRAMEQ_SLOTS, FRAMEQ_SLOTS, NULL);
+         Idle   = CreateEvent(NULL, FALSE, FALSE, NULL);
+         if ((Queued == NULL) || (Free == NULL) || (Idle == NULL))
+            {printf("FrameQueueClass::Init( ): Failed to create the semaphores, frames are saved serially.\n"); Shutdown(); Initialized = true; return;}
+
+         InitializeCriticalSection(&Lock);
+
+         for (ThreadCount = 0; ThreadCount < Threads; ThreadCount++)
+            {
+            DWORD ID;
+            Thread[ThreadCount] = CreateThread(NULL, 0, WriterProc, &Writer[ThreadCount], 0, &ID);
+            if (Thread[ThreadCount] == NULL) {break;}
+            }
+
+         if (ThreadCount == 0) {DeleteCriticalSection(&Lock);}
+
+      //==== Other OS ====
+      #else
+         (void)Threads;
+         ThreadCount = 0;
+      #endif
+      }
+
+   /*-------------------------------------------------------------------------
+      Saves all the queued frames, then stops the writer threads.
+     -------------------------------------------------------------------------*/
+   void Shutdown(void)
+      {
+      if (!Initialized) {return;}
+      Flush();
+      Initialized = false;
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         if (ThreadCount > 0)
+            {
+            Quit = true;
+            ReleaseSemaphore(Queued, ThreadCount, NULL);
+            WaitForMultipleObjects(ThreadCount, Thread, TRUE, INFINITE);
+
+            for (dword I = 0; I < ThreadCount; I++) {CloseHandle(Thread[I]);}
+            DeleteCriticalSection(&Lock);
+            }
+
+         if (Queued != NULL) {CloseHandle(Queued); Queued = NULL;}
+         if (Free   != NULL) {CloseHandle(Free);   Free   = NULL;}
+         if (Idle   != NULL) {CloseHandle(Idle);   Idle   = NULL;}
+      #endif
+
+      ThreadCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Queues a frame to be saved. The frame is moved into the queue, so the
+      Bitmap is empty on return. If the queue is full, the function waits
+      until a slot becomes free. Returns false on fail, but the errors of the
+      writer threads are only reported by Flush( ).
+
+      Bitmap   : Frame to save.
+      FileName : File name with path to save.
+      Format   : File format (see FRAMEQ_* above).
+     -------------------------------------------------------------------------*/
+   bool Push(BitmapRec* Bitmap, char* FileName, dword Format)
+      {
+      if ((Bitmap == NULL) || (FileName == NULL)) {return false;}
+      if (strlen(FileName) >= FRAMEQ_NAME_SIZE) {printf("FrameQueueClass::Push( ): File name is too long.\n"); return false;}
+      if (!Initialized) {Init(0);}
+
+      //-- Without writer threads, save the frame here --
+      if (ThreadCount == 0)
+         {
+         Writer[0].Job.Bitmap.MoveFrom(Bitmap);
+         strcpy(Writer[0].Job.FileName, FileName);
+         Writer[0].Job.Format = Format;
+         return Save(&Writer[0]);
+         }
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         WaitForSingleObject(Free, INFINITE);
+
+         EnterCriticalSection(&Lock);
+         FrameJobRec* Job = &Slot[Tail];
+         Tail = (Tail + 1) % FRAMEQ_SLOTS;
+
+         Job->Bitmap.MoveFrom(Bitmap);
+         strcpy(Job->FileName, FileName);
+         Job->Format = Format;
+         LeaveCriticalSection(&Lock);
+
+         InterlockedIncrement((LONG*)&Pending);
+         ReleaseSemaphore(Queued, 1, NULL);
+      #endif
+
+      return true;
+      }
+
+   /*-------------------------------------------------------------------------
+      Waits until all the queued frames are saved. Returns false if any of
+      the frames failed since the last Flush( ).
+     -------------------------------------------------------------------------*/
+   bool Flush(void)
+      {
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         //Idle may be left signalled by an earlier frame, so Pending is
+         //checked again after each wake up
+         if (ThreadCount > 0) {while (Pending > 0) {WaitForSingleObject(Idle, INFINITE);}}
+      #endif
+
+      bool Status = (Failed == 0);
+      Failed = 0;
+      return Status;
+      }
+
+   /*==== End Class ==========================================================*/
+   };
+
+
+
+/*----------------------------------------------------------------------------
+  Global Declarations.
+  ----------------------------------------------------------------------------*/
+FrameQueueClass FrameQueue;
+
+/*==== End of file ===========================================================*/
+#endif
@@ -0,0 +1,256 @@
+/*============================================================================*/
+/* Cosmic Ray [Tau] - Dominik Deak                                            */
+/*                                                                            */
+/*        Parallel Job System (at this stage Windows 9x and NT only)          */
+/*============================================================================*/
+
+/*----------------------------------------------------------------------------
+   Don't include this file if it's already defined.
+  ----------------------------------------------------------------------------*/
+#ifndef __JOBS_CPP__
+#define __JOBS_CPP__
+
+
+/*----------------------------------------------------------------------------
+   Include libraries and other source files needed in this file.
+  ----------------------------------------------------------------------------*/
+#include "../_common/std_inc.h"
+
+
+/*----------------------------------------------------------------------------
+   Definitions.
+  ----------------------------------------------------------------------------*/
+#define JOBS_MAX_THREADS   16                   //Maximum number of worker threads
+
+
+/*----------------------------------------------------------------------------
+   Job function. Processes the range [Begin, End) of the Data.
+  ----------------------------------------------------------------------------*/
+typedef void (*JobFuncPtr)(void* Data, dword Begin, dword End);
+
+/*----------------------------------------------------------------------------
+   Job record.
+  ----------------------------------------------------------------------------*/
+struct JobRec
+   {
+   JobFuncPtr  Func;
+   void*       Data;
+   dword       Begin;
+   dword       End;
+   };
+
+
+/*----------------------------------------------------------------------------
+   Job system class. Runs a batch of independent jobs on a pool of worker
+   threads, one thread per processor. The calling thread also takes part
+   in the processing, and Run( ) returns once all the jobs are complete.
+   On other OS the jobs are processed serially.
+  ----------------------------------------------------------------------------*/
+class JobSystemClass
+   {
+   /*==== Private Declarations ===============================================*/
+   private:
+
+   bool        Initialized;
+   dword       ThreadCount;                     //Number of worker threads
+
+   JobRec*     Jobs;                            //Current batch
+   dword       JobCount;
+
+   //==== Win32 specific ====
+   #if defined (WIN32) || defined (WIN32_NT)
+   HANDLE      Thread[JOBS_MAX_THREADS];
+   HANDLE      Start[JOBS_MAX_THREADS];         //Signals a worker to start on the current batch
+   HANDLE      Done;                            //Signalled when all the workers finished the batch
+   volatile LONG NextJob;                       //Index of the next job to process
+   volatile LONG Active;                        //Number of workers still processing the batch
+   volatile bool Quit;
+
+   struct WorkerRec
+      {
+      JobSystemClass* System;
+      dword           Index;
+      };
+
+   WorkerRec   Worker[JOBS_MAX_THREADS];
+
+   /*-------------------------------------------------------------------------
+      Worker thread entry point.
+     -------------------------------------------------------------------------*/
+   static DWORD WINAPI WorkerProc(LPVOID Param)
+      {
+      JobSystemClass* System = ((WorkerRec*)Param)->System;
+      dword           Index  = ((WorkerRec*)Param)->Index;
+
+      for (;;)
+         {
+         WaitForSingleObject(System->Start[Index], INFINITE);
+         if (System->Quit) {break;}
+
+         System->Process();
+         if (InterlockedDecrement((LONG*)&System->Active) == 0) {SetEvent(System->Done);}
+         }
+
+      return 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Processes jobs from the current batch until there are none left.
+     -------------------------------------------------------------------------*/
+   void Process(void)
+      {
+      LONG I;
+      while ((I = InterlockedIncrement((LONG*)&NextJob) - 1) < (LONG)JobCount)
+         {
+         Jobs[I].Func(Jobs[I].Data, Jobs[I].Begin, Jobs[I].End);
+         }
+      }
+   #endif
+
+
+   /*==== Public Declarations ================================================*/
+   public:
+
+   /*---- Constructor --------------------------------------------------------*/
+   JobSystemClass(void)
+      {
+      Initialized = false;
+      ThreadCount = 0;
+      Jobs        = NULL;
+      JobCount    = 0;
+
+      #if defined (WIN32) || defined (WIN32_NT)
+         Done     = NULL;
+      #endif
+      }
+
+   /*---- Destructor ---------------------------------------------------------*/
+   ~JobSystemClass(void) {Shutdown();}
+
+   /*-------------------------------------------------------------------------
+      Starts the worker threads. Init( ) is called by Run( ) on first use,
+      so it's only necessary to call this to set the number of threads.
+
+      Threads  : Number of worker threads. If 0, one less than the number
+                 of processors is used (the caller is the extra thread).
+     -------------------------------------------------------------------------*/
+   void Init(dword Threads)
+      {
+      Shutdown();
+      Initialized = true;
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         if (Threads == 0)
+            {
+            SYSTEM_INFO Info;
+            GetSystemInfo(&Info);
+            Threads = (Info.dwNumberOfProcessors > 1) ? Info.dwNumberOfProcessors - 1 : 0;
+            }
+         if (Threads > JOBS_MAX_THREADS) {Threads = JOBS_MAX_THREADS;}
+         if (Threads == 0) {return;}
+
+         Quit = false;
+         Done = CreateEvent(NULL, FALSE, FALSE, NULL);
+         if (Done == NULL) {printf("JobSystemClass::Init( ): CreateEvent( ) failed, jobs are processed serially.\n"); return;}
+
+         for (ThreadCount = 0; ThreadCount < Threads; ThreadCount++)
+            {
+            DWORD ID;
+            Worker[ThreadCount].System = this;
+            Worker[ThreadCount].Index  = ThreadCount;
+
+            Start[ThreadCount] = CreateEvent(NULL, FALSE, FALSE, NULL);
+            if (Start[ThreadCount] == NULL) {break;}
+
+            Thread[ThreadCount] = CreateThread(NULL, 0, WorkerProc, &Worker[ThreadCount], 0, &ID);
+            if (Thread[ThreadCount] == NULL) {CloseHandle(Start[ThreadCount]); break;}
+            }
+
+      //==== Other OS ====
+      #else
+         (void)Threads;
+         ThreadCount = 0;
+      #endif
+      }
+
+   /*-------------------------------------------------------------------------
+      Stops the worker threads.
+     -------------------------------------------------------------------------*/
+   void Shutdown(void)
+      {
+      if (!Initialized) {return;}
+      Initialized = false;
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         if (ThreadCount > 0)
+            {
+            Quit = true;
+            dword I;
+            for (I = 0; I < ThreadCount; I++) {SetEvent(Start[I]);}
+            WaitForMultipleObjects(ThreadCount, Thread, TRUE, INFINITE);
+
+            for (I = 0; I < ThreadCount; I++)
+               {
+               CloseHandle(Thread[I]);
+               CloseHandle(Start[I]);
+               }
+            }
+         if (Done != NULL) {CloseHandle(Done); Done = NULL;}
+      #endif
+
+      ThreadCount = 0;
+      }
+
+   /*-------------------------------------------------------------------------
+      Runs a batch of jobs, and returns when all of them are complete. The
+      jobs must be independent of each other, as they are processed in no
+      particular order.
+     -------------------------------------------------------------------------*/
+   void Run(JobRec* NewJobs, dword Count)
+      {
+      if ((NewJobs == NULL) || (Count == 0)) {return;}
+      if (!Initialized) {Init(0);}
+
+      //-- Process small batches on the calling thread --
+      if ((ThreadCount == 0) || (Count == 1))
+         {
+         for (dword I = 0; I < Count; I++) {NewJobs[I].Func(NewJobs[I].Data, NewJobs[I].Begin, NewJobs[I].End);}
+         return;
+         }
+
+      //==== Win32 specific ====
+      #if defined (WIN32) || defined (WIN32_NT)
+         Jobs     = NewJobs;
+         JobCount = Count;
+         NextJob  = 0;
+         Active   = ThreadCount;
+
+         for (dword I = 0; I < ThreadCount; I++) {SetEvent(Start[I]);}
+         Process();
+         WaitForSingleObject(Done, INFINITE);
+
+         Jobs     = NULL;
+         JobCount = 0;
+      #endif
+      }
+
+   /*-------------------------------------------------------------------------
+      Returns the number of threads processing the jobs (including the
+      caller).
+     -------------------------------------------------------------------------*/
+   inline dword Threads(void) {return ThreadCount + 1;}
+
+   /*==== End Class ==========================================================*/
+   };
+
+
+
+/*----------------------------------------------------------------------------
+  Global Declarations.
+  ----------------------------------------------------------------------------*/
+JobSystemClass JobSystem;
+
+/*==== End of file ===========================================================*/
+#endif